@@ -84,6 +84,7 @@ void testAccBootStrap() {
 }
 
 void testAccInstances() {
+    //! [testAccInstances]
     Instances i = NULL;
     T *t = _t_newi(0,TEST_INT_SYMBOL,1);
 
@@ -107,8 +108,62 @@ void testAccInstances() {
     t = _a_get_instance(&i,x);
     spec_is_ptr_equal(t,NULL);
 
-    spec_is_str_equal(t2s(i),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:2) (DELETED_INSTANCE) (TEST_INT_SYMBOL:4)) (SYMBOL_INSTANCES:TEST_STR_SYMBOL (TEST_STR_SYMBOL:fish))))");
+    spec_is_str_equal(t2s(i->store),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:2) (DELETED_INSTANCE) (TEST_INT_SYMBOL:4)) (SYMBOL_INSTANCES:TEST_STR_SYMBOL (TEST_STR_SYMBOL:fish))))");
+
+    // deleting again does nothing, and the next instance added reuses the deleted address
+    _a_delete_instance(&i,x);
+    Xaddr y = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,5));
+    spec_is_xaddr_equal(G_sem,y,x);
+    spec_is_str_equal(t2s(i->store),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:2) (TEST_INT_SYMBOL:5) (TEST_INT_SYMBOL:4)) (SYMBOL_INSTANCES:TEST_STR_SYMBOL (TEST_STR_SYMBOL:fish))))");
+    y = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,6));
+    spec_is_equal(y.addr,4);
     _a_free_instances(&i);
+    //! [testAccInstances]
+}
+
+void testAccCompactInstances() {
+    //! [testAccCompactInstances]
+    Instances i = NULL;
+    Xaddr x[5];
+    int j;
+    for(j=0;j<5;j++)
+        x[j] = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,j));
+    Xaddr s = _a_new_instance(&i,_t_new_str(0,TEST_STR_SYMBOL,"fish"));
+
+    _a_delete_instance(&i,x[1]);
+    _a_delete_instance(&i,x[3]);
+    _a_delete_instance(&i,x[4]);
+    _a_delete_instance(&i,s);
+
+    // only the trailing deleted instances can go without changing anyone's address, and
+    // symbols with no instances left go altogether
+    spec_is_equal(_a_compact_instances(&i),3);
+    spec_is_str_equal(t2s(i->store),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:0) (DELETED_INSTANCE) (TEST_INT_SYMBOL:2))))");
+    spec_is_str_equal(t2s(_a_get_instance(&i,x[2])),"(TEST_INT_SYMBOL:2)");
+    spec_is_ptr_equal(_a_get_instance(&i,s),NULL);
+
+    // the addresses that were reclaimed aren't handed out again from the free list
+    Xaddr y = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,5));
+    spec_is_equal(y.addr,2);
+    y = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,6));
+    spec_is_equal(y.addr,4);
+    y = _a_new_instance(&i,_t_new_str(0,TEST_STR_SYMBOL,"cow"));
+    spec_is_equal(y.addr,1);
+    spec_is_equal(_a_compact_instances(&i),0);
+
+    // deleted addresses stay deleted (and reusable) across serializing
+    _a_delete_instance(&i,x[2]);
+    S *ser = __a_serialize_instances(&i);
+    _a_free_instances(&i);
+    __a_unserialize_instances(G_sem,&i,ser);
+    free(ser);
+    spec_is_ptr_equal(_a_get_instance(&i,x[2]),NULL);
+    spec_is_str_equal(t2s(_a_get_instance(&i,y)),"(TEST_STR_SYMBOL:cow)");
+    y = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,7));
+    spec_is_equal(y.addr,3);
+
+    _a_free_instances(&i);
+    //! [testAccCompactInstances]
 }
 
 void testAccGetInstances() {
@@ -125,7 +180,7 @@ void testAccGetInstances() {
     t = _t_newi(0,TEST_INT_SYMBOL,4);
     _a_new_instance(&i,t);
 
-    spec_is_str_equal(t2s(i),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:2) (TEST_INT_SYMBOL:3) (TEST_INT_SYMBOL:4))))");
+    spec_is_str_equal(t2s(i->store),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:2) (TEST_INT_SYMBOL:3) (TEST_INT_SYMBOL:4))))");
 
     _a_delete_instance(&i,x);
 
@@ -134,6 +189,26 @@ void testAccGetInstances() {
     spec_is_str_equal(t2s(t),"(ITERATION_DATA (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:2) (TEST_INT_SYMBOL:4))");
     _t_free(t);
 
+    //! [testAccGetInstances]
+    // the instances can also be walked one at a time with a cursor which skips deleted instances
+    int cursor = 0;
+    int end = _a_instance_slots(&i,TEST_INT_SYMBOL);
+    spec_is_equal(end,4);
+    t = _a_next_instance(&i,TEST_INT_SYMBOL,&cursor,end);
+    spec_is_str_equal(t2s(t),"(TEST_INT_SYMBOL:1)");
+    t = _a_next_instance(&i,TEST_INT_SYMBOL,&cursor,end);
+    spec_is_str_equal(t2s(t),"(TEST_INT_SYMBOL:2)");
+    t = _a_next_instance(&i,TEST_INT_SYMBOL,&cursor,end);
+    spec_is_str_equal(t2s(t),"(TEST_INT_SYMBOL:4)");
+    spec_is_equal(cursor,4);
+    // instances added after the walk started don't get picked up
+    _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,5));
+    _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,6));
+    spec_is_ptr_equal(_a_next_instance(&i,TEST_INT_SYMBOL,&cursor,end),NULL);
+    cursor = 0;
+    spec_is_ptr_equal(_a_next_instance(&i,TEST_STR_SYMBOL,&cursor,_a_instance_slots(&i,TEST_STR_SYMBOL)),NULL);
+    //! [testAccGetInstances]
+
     _a_free_instances(&i);
 
 }
@@ -168,6 +243,67 @@ void testAccPersistInstances() {
     free(s);
 }
 
+void testAccSerializeInstances() {
+    //! [testAccSerializeInstances]
+    Instances i = NULL;
+    Xaddr x1 = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,1));
+    Xaddr x2 = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,2));
+    Xaddr x3 = _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,3));
+    Xaddr y = _a_new_instance(&i,_t_new_str(0,TEST_STR_SYMBOL,"fish"));
+    _a_delete_instance(&i,x2);
+    _a_add_scape(G_sem,&i,__s_new(TEST_INT_SYMBOL,TEST_INT_SYMBOL,NULL,false,true));
+
+    // a section per symbol, listed up front
+    InstanceImage *m = (InstanceImage *)__a_serialize_instances(&i);
+    spec_is_equal(m->magic,INSTANCES_MAGIC|INSTANCES_VERSION);
+    spec_is_equal(m->sections,2);
+    spec_is_sem_equal(m->section[0].symbol,TEST_INT_SYMBOL);
+    spec_is_equal(m->section[0].count,3);
+    spec_is_sem_equal(m->section[1].symbol,TEST_STR_SYMBOL);
+    spec_is_equal(m->section[1].count,1);
+    spec_is_equal(m->section[1].offset % 8,0);
+    spec_is_true(m->scapes != 0);
+
+    Instances j = NULL;
+    __a_unserialize_instances(G_sem,&j,(S *)m);
+    spec_is_str_equal(t2s(_a_get_instance(&j,x1)),"(TEST_INT_SYMBOL:1)");
+    spec_is_ptr_equal(_a_get_instance(&j,x2),NULL);
+    spec_is_str_equal(t2s(_a_get_instance(&j,x3)),"(TEST_INT_SYMBOL:3)");
+    spec_is_str_equal(t2s(_a_get_instance(&j,y)),"(TEST_STR_SYMBOL:fish)");
+    // the deleted slot is still free for reuse, and the scape came along
+    spec_is_equal(_a_new_instance(&j,_t_newi(0,TEST_INT_SYMBOL,4)).addr,x2.addr);
+    spec_is_str_equal(t2s(_s_seek(_a_find_scape(&j,TEST_INT_SYMBOL,TEST_INT_SYMBOL),NULL)->key),"(TEST_INT_SYMBOL:1)");
+    _a_free_instances(&j);
+    free(m);
+
+    // just one symbol's instances can be loaded from a file
+    char *fn = "tmp/test_instances.x";
+    _a_serialize_instances(&i,fn);
+    _a_load_instances(G_sem,&j,fn,&TEST_STR_SYMBOL);
+    spec_is_str_equal(t2s(_a_get_instance(&j,y)),"(TEST_STR_SYMBOL:fish)");
+    spec_is_ptr_equal(_a_get_instance(&j,x1),NULL);
+    _a_free_instances(&j);
+    _a_unserialize_instances(G_sem,&j,fn);
+    spec_is_str_equal(t2s(_a_get_instance(&j,x3)),"(TEST_INT_SYMBOL:3)");
+    _a_free_instances(&j);
+    unlink(fn);
+
+    // stores serialized as a PARAMS tree can still be read
+    T *t = _t_new_root(PARAMS);
+    T *sym = _t_news(t,STRUCTURE_SYMBOL,TEST_INT_SYMBOL);
+    _t_newi(sym,TEST_INT_SYMBOL,5);
+    H h = _m_new_from_t(t);
+    S *ser = _m_serialize(h.m);
+    _m_free(h);_t_free(t);
+    __a_unserialize_instances(G_sem,&j,ser);
+    spec_is_str_equal(t2s(_a_get_instance(&j,x1)),"(TEST_INT_SYMBOL:5)");
+    _a_free_instances(&j);
+    free(ser);
+
+    _a_free_instances(&i);
+    //! [testAccSerializeInstances]
+}
+
 void testAccToken() {
     Instances i = NULL;
     T *t,*token1,*token2,*d1,*d2;
@@ -182,7 +318,7 @@ void testAccToken() {
     token1 = _a_gen_token(&i,x,d1);
     token2 = _a_gen_token(&i,x,d2);
 
-    spec_is_str_equal(t2s(i),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1))) (INSTANCE_TOKENS (LAST_TOKEN:2) (INSTANCE_TOKEN:1 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:-1641288256)) (INSTANCE_TOKEN:2 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:1282387645))))");
+    spec_is_str_equal(t2s(i->store),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1))) (INSTANCE_TOKENS (LAST_TOKEN:2) (INSTANCE_TOKEN:1 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:-1641288256)) (INSTANCE_TOKEN:2 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:1282387645))))");
 
     // test getting back xaddrs from tokens and their dependency
     xx = _a_get_token_xaddr(&i,token1,d1);
@@ -202,10 +338,10 @@ void testAccToken() {
     spec_is_true(is_null_xaddr(xx));
     _a_add_dependency(&i,token1,d3);
     char *with_two_dependencies = "(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1))) (INSTANCE_TOKENS (LAST_TOKEN:2) (INSTANCE_TOKEN:1 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:-1641288256) (DEPENDENCY_HASH:-226474859)) (INSTANCE_TOKEN:2 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:1282387645))))";
-    spec_is_str_equal(t2s(i),with_two_dependencies);
+    spec_is_str_equal(t2s(i->store),with_two_dependencies);
     // check that dependency isn't added in twice
     _a_add_dependency(&i,token1,d3);
-    spec_is_str_equal(t2s(i),with_two_dependencies);
+    spec_is_str_equal(t2s(i->store),with_two_dependencies);
 
     xx = _a_get_token_xaddr(&i,token1,d3);
     spec_is_xaddr_equal(G_sem,x,xx);
@@ -215,13 +351,13 @@ void testAccToken() {
 
     // test deleting a dependency
     _a_delete_dependency(&i,token1,d3);
-    spec_is_str_equal(t2s(i),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1))) (INSTANCE_TOKENS (LAST_TOKEN:2) (INSTANCE_TOKEN:1 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:-1641288256)) (INSTANCE_TOKEN:2 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:1282387645))))");
+    spec_is_str_equal(t2s(i->store),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1))) (INSTANCE_TOKENS (LAST_TOKEN:2) (INSTANCE_TOKEN:1 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:-1641288256)) (INSTANCE_TOKEN:2 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:1282387645))))");
     xx = _a_get_token_xaddr(&i,token1,d3);
     spec_is_true(is_null_xaddr(xx));
 
     // test deleting a token
     _a_delete_token(&i,token1);
-    spec_is_str_equal(t2s(i),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1))) (INSTANCE_TOKENS (LAST_TOKEN:2) (INSTANCE_TOKEN:2 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:1282387645))))");
+    spec_is_str_equal(t2s(i->store),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:1))) (INSTANCE_TOKENS (LAST_TOKEN:2) (INSTANCE_TOKEN:2 (TOKEN_XADDR:TEST_INT_SYMBOL.1) (DEPENDENCY_HASH:1282387645))))");
 
     _t_free(token1);
     _t_free(token2);
@@ -232,6 +368,430 @@ void testAccToken() {
 
 }
 
+T *__acc_person(char *name,int age) {
+    T *t = _t_newr(0,TEST_ANYTHING_SYMBOL);
+    _t_new_str(t,TEST_NAME_SYMBOL,name);
+    _t_newi(t,TEST_INT_SYMBOL,age);
+    return t;
+}
+
+void testAccScapes() {
+    //! [testAccScapes]
+    Instances i = NULL;
+    int count;
+    Xaddr *xs;
+    Xaddr x1 = _a_new_instance(&i,__acc_person("fred",42));
+
+    // existing instances get scaped when the scape is added
+    _a_add_scape(G_sem,&i,__s_new(TEST_INT_SYMBOL,TEST_ANYTHING_SYMBOL,NULL,true,false));
+    Scape *s = _a_find_scape(&i,TEST_ANYTHING_SYMBOL,TEST_INT_SYMBOL);
+    spec_is_true(s != NULL);
+    spec_is_ptr_equal(s->sem,G_sem);
+    spec_is_ptr_equal(_a_find_scape(&i,TEST_ANYTHING_SYMBOL,TEST_NAME_SYMBOL),NULL);
+    spec_is_ptr_equal(_a_find_scape(&i,TEST_INT_SYMBOL,TEST_INT_SYMBOL),NULL);
+
+    T *k42 = _t_newi(0,TEST_INT_SYMBOL,42);
+    T *k33 = _t_newi(0,TEST_INT_SYMBOL,33);
+
+    xs = _s_get_all(s,k42,&count);
+    spec_is_equal(count,1);
+    spec_is_xaddr_equal(G_sem,xs[0],x1);
+
+    // new instances get scaped
+    Xaddr x2 = _a_new_instance(&i,__acc_person("jane",42));
+    Xaddr x3 = _a_new_instance(&i,__acc_person("joe",33));
+    _a_new_instance(&i,_t_newi(0,TEST_INT_SYMBOL,42));  // not the scape's data source
+    _s_get_all(s,k42,&count);
+    spec_is_equal(count,2);
+    _s_get_all(s,k33,&count);
+    spec_is_equal(count,1);
+
+    // setting an instance moves it to its new key
+    _a_set_instance(&i,x2,__acc_person("jane",33));
+    xs = _s_get_all(s,k33,&count);
+    spec_is_equal(count,2);
+    spec_is_xaddr_equal(G_sem,xs[1],x2);
+    xs = _s_get_all(s,k42,&count);
+    spec_is_equal(count,1);
+    spec_is_xaddr_equal(G_sem,xs[0],x1);
+
+    // deleting removes it, and a reused slot gets scaped again
+    _a_delete_instance(&i,x1);
+    spec_is_ptr_equal(_s_get_all(s,k42,&count),NULL);
+    Xaddr x4 = _a_new_instance(&i,__acc_person("mary",42));
+    spec_is_xaddr_equal(G_sem,x4,x1);
+    xs = _s_get_all(s,k42,&count);
+    spec_is_equal(count,1);
+    spec_is_xaddr_equal(G_sem,xs[0],x4);
+
+    // scapes are persisted with the instances, and are rebuilt when they get unserialized,
+    // as are any already on the store being unserialized into
+    _a_add_scape(G_sem,&i,__s_new(TEST_INT_SYMBOL,TEST_INT_SYMBOL,NULL,true,true));
+    S *ser = __a_serialize_instances(&i);
+    Instances j = NULL;
+    int path[] = {1,TREE_PATH_TERMINATOR};
+    _a_add_scape(G_sem,&j,__s_new(TEST_NAME_SYMBOL,TEST_ANYTHING_SYMBOL,path,false,false));
+    __a_unserialize_instances(G_sem,&j,ser);
+    free(ser);
+    T *k = _t_new_str(0,TEST_NAME_SYMBOL,"joe");
+    Scape *sj = _a_find_scape(&j,TEST_ANYTHING_SYMBOL,TEST_NAME_SYMBOL);
+    spec_is_xaddr_equal(G_sem,_s_get(sj,k),x3);
+    spec_is_equal(HASH_COUNT(sj->data),3);
+
+    // names are unique in that scape, so an instance can't take a name that's already in use
+    T *t = __acc_person("joe",20);
+    Xaddr xn = {TEST_ANYTHING_SYMBOL,0};
+    spec_is_false(_a_can_scape(&j,t,xn));
+    spec_is_true(_a_can_scape(&j,t,x3));
+    spec_is_true(_a_can_scape(&i,t,xn));
+    _t_free(t);
+    _t_free(k);
+    sj = _a_find_scape(&j,TEST_ANYTHING_SYMBOL,TEST_INT_SYMBOL);
+    spec_is_true(sj->multi);
+    spec_is_ptr_equal(sj->order,NULL);
+    _s_get_all(sj,k33,&count);
+    spec_is_equal(count,2);
+    sj = _a_find_scape(&j,TEST_INT_SYMBOL,TEST_INT_SYMBOL);
+    spec_is_true(sj->order != NULL);
+    spec_is_str_equal(t2s(_s_seek(sj,NULL)->key),"(TEST_INT_SYMBOL:42)");
+
+    _a_free_instances(&i);
+    _a_free_instances(&j);
+    _t_free(k42);
+    _t_free(k33);
+    //! [testAccScapes]
+}
+
+// collect replayed records as INTEGERs of the payload
+void _testAccWALReplay(WalRecord *r,void *payload,void *arg) {
+    T *t = arg;
+    _t_newi(t,TEST_INT_SYMBOL,*(int *)payload);
+}
+
+void *_testAccWALThread(void *arg) {
+    WAL *w = arg;
+    int i;
+    for(i=0;i<50;i++) {
+        uint64_t seq = _wl_append(w,WalNewInstance,1,&i,sizeof(int),NULL,0);
+        _wl_sync(w,seq);
+    }
+    return NULL;
+}
+
+void testAccWAL() {
+    //! [testAccWAL]
+    char *fn = "tmp/test.log";
+    unlink(fn);
+    struct stat st;
+
+    spec_is_equal(_wl_replay(fn,_testAccWALReplay,NULL),-1);
+
+    WAL *w = _wl_open(fn);
+    int i = 1,j = 2;
+    char *str = "fish";
+    uint64_t seq = _wl_append(w,WalNewInstance,1,&i,sizeof(int),NULL,0);
+    spec_is_long_equal(seq,1);
+    _wl_append(w,WalSetInstance,1,&j,sizeof(int),str,strlen(str)+1);
+
+    // nothing is written till the log is synced
+    stat(fn,&st);
+    spec_is_long_equal(st.st_size,0);
+    _wl_flush(w);
+    stat(fn,&st);
+    size_t good = st.st_size;
+    spec_is_long_equal(good,2*sizeof(WalRecord)+sizeof(int)+sizeof(int)+5);
+
+    // records that were never synced don't get written
+    i = 3;
+    _wl_append(w,WalDeleteInstance,1,&i,sizeof(int),NULL,0);
+    _wl_truncate(w);
+    stat(fn,&st);
+    spec_is_long_equal(st.st_size,0);
+
+    // group commit from many threads at once
+    pthread_t threads[4];
+    for(i=0;i<4;i++) pthread_create(&threads[i],0,_testAccWALThread,w);
+    for(i=0;i<4;i++) pthread_join(threads[i],NULL);
+    _wl_close(w);
+    T *t = _t_new_root(PARAMS);
+    spec_is_equal(_wl_replay(fn,_testAccWALReplay,t),200);
+    _t_free(t);
+
+    w = _wl_open(fn);
+    _wl_truncate(w);
+    i = 1;
+    _wl_append(w,WalNewInstance,1,&i,sizeof(int),NULL,0);
+    _wl_append(w,WalSetInstance,1,&j,sizeof(int),str,strlen(str)+1);
+    _wl_close(w);
+
+    // a torn record at the end of the log gets cut off
+    FILE *f = fopen(fn,"a");
+    fwrite("torn",1,4,f);
+    fclose(f);
+    t = _t_new_root(PARAMS);
+    spec_is_equal(_wl_replay(fn,_testAccWALReplay,t),2);
+    spec_is_str_equal(t2s(t),"(PARAMS (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:2))");
+    _t_free(t);
+    stat(fn,&st);
+    spec_is_long_equal(st.st_size,good);
+
+    // as does one that fails its checksum
+    f = fopen(fn,"r+");
+    fseek(f,-2,SEEK_END);
+    fputc('X',f);
+    fclose(f);
+    t = _t_new_root(PARAMS);
+    spec_is_equal(_wl_replay(fn,_testAccWALReplay,t),1);
+    spec_is_str_equal(t2s(t),"(PARAMS (TEST_INT_SYMBOL:1))");
+    _t_free(t);
+    stat(fn,&st);
+    spec_is_long_equal(st.st_size,sizeof(WalRecord)+sizeof(int));
+
+    // rotating moves everything appended so far to the old log and carries on in an empty one
+    char *old = "tmp/test.log.old";
+    w = _wl_open(fn);
+    _wl_append(w,WalSetInstance,1,&j,sizeof(int),NULL,0);
+    _wl_rotate(w,old);
+    _wl_append(w,WalDeleteInstance,1,&i,sizeof(int),NULL,0);
+    _wl_close(w);
+    t = _t_new_root(PARAMS);
+    spec_is_equal(_wl_replay(old,_testAccWALReplay,t),2);
+    spec_is_equal(_wl_replay(fn,_testAccWALReplay,t),1);
+    spec_is_str_equal(t2s(t),"(PARAMS (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:2) (TEST_INT_SYMBOL:1))");
+    _t_free(t);
+
+    // once started, the log gets committed periodically on its own thread
+    w = _wl_open(fn);
+    _wl_truncate(w);
+    _wl_start(w,10*NS_PER_MS);
+    _wl_append(w,WalSetInstance,1,&j,sizeof(int),NULL,0);
+    for(i=0;i<100 && w->synced < 1;i++) sleepms(10);
+    spec_is_long_equal(w->synced,1);
+    stat(fn,&st);
+    spec_is_long_equal(st.st_size,sizeof(WalRecord)+sizeof(int));
+    _wl_close(w);
+    //! [testAccWAL]
+    unlink(fn);
+    unlink(old);
+}
+
+void testAccBootReplay() {
+    //! [testAccBootReplay]
+    char *dname = "tmp/test_vm_wal";
+    system("rm -rf tmp/test_vm_wal");
+
+    _a_boot(dname);
+    Receptor *r = G_vm->r;
+    Xaddr x1 = _r_new_instance(r,_t_newi(0,TEST_INT_SYMBOL,1));
+    Xaddr x2 = _r_new_instance(r,_t_newi(0,TEST_INT_SYMBOL,2));
+    Xaddr x3 = _r_new_instance(r,_t_newi(0,TEST_INT_SYMBOL,3));
+    _r_set_instance(r,x1,_t_newi(0,TEST_INT_SYMBOL,10));
+    _r_delete_instance(r,x2);
+
+    // definitions made with the helpers get logged just like ones made with _r_define
+    Symbol hs = _r_define_symbol(r,INTEGER,"hat_size");
+    T *def = _t_new_root(SYMBOL_DEFINITION);
+    _t_new_str(_t_newr(def,SYMBOL_LABEL),ENGLISH_LABEL,"shoe_size");
+    _t_news(def,SYMBOL_STRUCTURE,INTEGER);
+    Symbol s = _r_define(r,def,SEM_TYPE_SYMBOL);
+
+    // receptors that get created or deleted are logged too
+    Receptor *nr = _r_new(G_vm->sem,TEST_RECEPTOR);
+    Xaddr xi = _r_new_instance(nr,_t_newi(0,TEST_INT_SYMBOL,99));
+    Xaddr xr = _v_new_receptor(G_vm,r,TEST_RECEPTOR,nr);
+    Xaddr xd = _r_new_instance(r,_t_new_receptor(0,TEST_RECEPTOR,_r_new(G_vm->sem,TEST_RECEPTOR)));
+    _r_delete_instance(r,xd);
+    _wl_flush(G_vm->wal);
+
+    // crash, i.e. go down without taking a snapshot
+    __r_kill(G_vm->r);
+    _v_join_thread(&G_vm->clock_thread);
+    _v_join_thread(&G_vm->vm_thread);
+    _v_free(G_vm);
+    G_vm = NULL;
+
+    // the changes get replayed on top of the snapshot taken at first boot
+    _a_boot(dname);
+    r = G_vm->r;
+    spec_is_str_equal(t2s(_r_get_instance(r,x1)),"(TEST_INT_SYMBOL:10)");
+    spec_is_ptr_equal(_r_get_instance(r,x2),NULL);
+    spec_is_str_equal(t2s(_r_get_instance(r,x3)),"(TEST_INT_SYMBOL:3)");
+    spec_is_str_equal(_sem_get_name(G_vm->sem,hs),"hat_size");
+    spec_is_str_equal(_sem_get_name(G_vm->sem,s),"shoe_size");
+    T *rt = _r_get_instance(r,xr);
+    spec_is_true(rt != NULL);
+    if (rt) {
+        spec_is_str_equal(t2s(_r_get_instance(__r_get_receptor(rt),xi)),"(TEST_INT_SYMBOL:99)");
+    }
+    spec_is_ptr_equal(_r_get_instance(r,xd),NULL);
+
+    // the deleted address is free for reuse after the replay too
+    Xaddr x = _r_new_instance(r,_t_newi(0,TEST_INT_SYMBOL,4));
+    spec_is_equal(x.addr,x2.addr);
+
+    // a clean shut down takes a snapshot and empties the log
+    _a_shut_down();
+    char fn[1000];
+    struct stat st;
+    sprintf(fn,"%s/vmhostlog.x",dname);
+    stat(fn,&st);
+    spec_is_long_equal(st.st_size,0);
+
+    _a_boot(dname);
+    spec_is_str_equal(t2s(_r_get_instance(G_vm->r,x)),"(TEST_INT_SYMBOL:4)");
+    spec_is_str_equal(_sem_get_name(G_vm->sem,s),"shoe_size");
+    //! [testAccBootReplay]
+    _a_shut_down();
+}
+
+// inode of the file the vmhost's instances of a symbol are checkpointed to, which changes whenever it's rewritten
+ino_t _testAccSectionInode(char *dir,Symbol s) {
+    char fn[1000];
+    struct stat st;
+    sprintf(fn,"%s/vmhost_i0_%d.%d.%d.x",dir,s.context,s.semtype,s.id);
+    if (stat(fn,&st)) return 0;
+    return st.st_ino;
+}
+
+void testAccCheckpoint() {
+    //! [testAccCheckpoint]
+    char *dname = "tmp/test_vm_ckpt";
+    char fn[1000];
+    struct stat st;
+    system("rm -rf tmp/test_vm_ckpt");
+
+    _a_boot(dname);
+    Receptor *r = G_vm->r;
+    Xaddr xi = _r_new_instance(r,_t_newi(0,TEST_INT_SYMBOL,1));
+    Xaddr xs = _r_new_instance(r,_t_new_str(0,TEST_STR_SYMBOL,"fish"));
+
+    // checkpointing writes out each symbol's instances and starts a new log
+    spec_is_true(_a_checkpoint(false));
+    ino_t ii = _testAccSectionInode(dname,TEST_INT_SYMBOL);
+    ino_t is = _testAccSectionInode(dname,TEST_STR_SYMBOL);
+    spec_is_true(ii != 0);
+    spec_is_true(is != 0);
+    sprintf(fn,"%s/vmhostlog.x",dname);
+    stat(fn,&st);
+    spec_is_long_equal(st.st_size,0);
+    sprintf(fn,"%s/vmhostlog.old.x",dname);
+    spec_is_equal(stat(fn,&st),-1);
+
+    // only the instances that changed get written again
+    _r_set_instance(r,xi,_t_newi(0,TEST_INT_SYMBOL,2));
+    spec_is_true(_a_checkpoint(true));
+    _v_join_thread(&G_vm->checkpoint_thread);
+    spec_is_true(_testAccSectionInode(dname,TEST_INT_SYMBOL) != ii);
+    spec_is_true(_testAccSectionInode(dname,TEST_STR_SYMBOL) == is);
+
+    // and deleted instances at the end get reclaimed
+    Xaddr xd = _r_new_instance(r,_t_newi(0,TEST_INT_SYMBOL,99));
+    _r_delete_instance(r,xd);
+    spec_is_equal(_a_instance_slots(&r->instances,TEST_INT_SYMBOL),2);
+    spec_is_true(_a_checkpoint(false));
+    spec_is_equal(_a_instance_slots(&r->instances,TEST_INT_SYMBOL),1);
+
+    // a checkpoint that can't be written keeps the rotated log
+    char tfn[1000];
+    _r_set_instance(r,xs,_t_new_str(0,TEST_STR_SYMBOL,"cod"));
+    sprintf(tfn,"%s/vmhost_i0_%d.%d.%d.x.tmp",dname,TEST_STR_SYMBOL.context,TEST_STR_SYMBOL.semtype,TEST_STR_SYMBOL.id);
+    mkdir(tfn,0700);
+    spec_is_true(_a_checkpoint(false));
+    spec_is_true(_testAccSectionInode(dname,TEST_STR_SYMBOL) == is);
+    spec_is_equal(stat(fn,&st),0);
+    rmdir(tfn);
+
+    // and the next one writes everything out again and then gets rid of it
+    spec_is_true(_a_checkpoint(false));
+    spec_is_true(_testAccSectionInode(dname,TEST_STR_SYMBOL) != is);
+    spec_is_equal(stat(fn,&st),-1);
+
+    // crash after some more changes
+    Xaddr xi2 = _r_new_instance(r,_t_newi(0,TEST_INT_SYMBOL,3));
+    _wl_flush(G_vm->wal);
+    __r_kill(G_vm->r);
+    _v_join_thread(&G_vm->clock_thread);
+    _v_join_thread(&G_vm->vm_thread);
+    _v_free(G_vm);
+    G_vm = NULL;
+
+    // and the instances come back from the checkpoint and the log
+    _a_boot(dname);
+    r = G_vm->r;
+    spec_is_str_equal(t2s(_r_get_instance(r,xi)),"(TEST_INT_SYMBOL:2)");
+    spec_is_str_equal(t2s(_r_get_instance(r,xi2)),"(TEST_INT_SYMBOL:3)");
+    spec_is_str_equal(t2s(_r_get_instance(r,xs)),"(TEST_STR_SYMBOL:cod)");
+    //! [testAccCheckpoint]
+    _a_shut_down();
+}
+
+void testAccLazyReceptors() {
+    //! [testAccLazyReceptors]
+    char *dname = "tmp/test_vm_lazy";
+    char fn[1000];
+    struct stat st;
+    system("rm -rf tmp/test_vm_lazy");
+
+    _a_boot(dname);
+    Receptor *r = _r_new(G_vm->sem,TEST_RECEPTOR);
+    Xaddr x = _v_new_receptor(G_vm,G_vm->r,TEST_RECEPTOR,r);
+    _r_new_instance(r,_t_newi(0,TEST_INT_SYMBOL,314));
+    _a_shut_down();
+
+    // at boot the receptors only get stubbed, and the ones activated get loaded
+    _a_boot(dname);
+    Xaddr cx = {CLOCK_RECEPTOR,1};
+    Receptor *clock = __r_get_receptor(_r_get_instance(G_vm->r,cx));
+    spec_is_ptr_equal(clock->image,NULL);
+    spec_is_str_equal(t2s(_t_child(clock->root,1)),"(INSTANCE_OF:CLOCK_RECEPTOR)");
+    r = __r_get_receptor(_r_get_instance(G_vm->r,x));
+    spec_is_true(r->image != NULL);
+    spec_is_ptr_equal(r->root,NULL);
+
+    // a stub serializes to the image it was loaded from
+    void *surface;
+    size_t length;
+    _r_serialize(r,&surface,&length);
+    spec_is_long_equal(length,__r_image_size(r->image));
+    spec_is_true(memcmp(surface,r->image,length) == 0);
+    free(surface);
+
+    // which loads on first use
+    _r_materialize(r);
+    spec_is_ptr_equal(r->image,NULL);
+    spec_is_str_equal(t2s(_t_child(r->root,1)),"(INSTANCE_OF:TEST_RECEPTOR)");
+    Xaddr ix = {TEST_INT_SYMBOL,1};
+    spec_is_str_equal(t2s(_r_get_instance(r,ix)),"(TEST_INT_SYMBOL:314)");
+
+    // an idle receptor can be evicted to a file of its own and loaded again
+    spec_is_true(_a_evict(G_vm,r));
+    spec_is_true(r->image != NULL);
+    sprintf(fn,"%s/vmhost_r%d.x",dname,r->context);
+    spec_is_equal(stat(fn,&st),0);
+    _r_materialize(r);
+    spec_is_str_equal(t2s(_r_get_instance(r,ix)),"(TEST_INT_SYMBOL:314)");
+
+    // but not active ones or the vmhost's own receptor
+    spec_is_false(_a_evict(G_vm,clock));
+    spec_is_false(_a_evict(G_vm,G_vm->r));
+
+    // evicting idle receptors down to a limit
+    G_vm->max_loaded_receptors = 1;
+    spec_is_equal(_a_evict_idle(G_vm),1);
+    spec_is_true(r->image != NULL);
+    spec_is_ptr_equal(clock->image,NULL);
+    spec_is_equal(_a_evict_idle(G_vm),0);
+
+    // evicted receptors are checkpointed from their images
+    _a_shut_down();
+    _a_boot(dname);
+    r = __r_get_receptor(_r_get_instance(G_vm->r,x));
+    _r_materialize(r);
+    spec_is_str_equal(t2s(_r_get_instance(r,ix)),"(TEST_INT_SYMBOL:314)");
+    //! [testAccLazyReceptors]
+    _a_shut_down();
+}
+
 void testAccumulator() {
     struct stat st = {0};
     char *temp_dir = "tmp";
@@ -242,6 +802,13 @@ void testAccumulator() {
     testAccBootStrap();
     testAccInstances();
     testAccGetInstances();
+    testAccCompactInstances();
+    testAccScapes();
     testAccPersistInstances();
+    testAccSerializeInstances();
     testAccToken();
+    testAccWAL();
+    testAccBootReplay();
+    testAccCheckpoint();
+    testAccLazyReceptors();
 }
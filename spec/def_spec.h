@@ -113,6 +113,11 @@ void testGetSize() {
     float ls[] = {2.0};
     spec_is_long_equal(_d_get_structure_size(G_sem,latstruct,ll),sizeof(ls));
 
+    // sizes that don't depend on the surface get worked out without one
+    spec_is_equal(__d_get_fixed_size(G_sem,latlong),sizeof(ll));
+    spec_is_equal(__d_get_fixed_size(G_sem,INTEGER),sizeof(int));
+    spec_is_equal(__d_get_fixed_size(G_sem,CSTRING),SYMBOL_SIZE_VARIABLE);
+
     //@todo what about sizing with optional structural elements...
 
     //! [testGetSize]
@@ -205,9 +210,9 @@ void testDefSysDefs() {
     spec_is_sem_equal(vmhr,SYS_RECEPTOR);
 
     spec_is_equal(G_sem->contexts,_NUM_DEFAULT_CONTEXTS);
-    spec_is_equal(_t_children(G_sem->stores[0].definitions),6);  // should have slots for all the defs
-    spec_is_equal(_t_children(_t_child(G_sem->stores[0].definitions,SEM_TYPE_STRUCTURE)),NUM_SYS_STRUCTURES-1);
-    spec_is_equal(_t_children(_t_child(G_sem->stores[0].definitions,SEM_TYPE_SYMBOL)),NUM_SYS_SYMBOLS-1);
+    spec_is_equal(_t_children(__sem_context(G_sem,0)->definitions),6);  // should have slots for all the defs
+    spec_is_equal(_t_children(_t_child(__sem_context(G_sem,0)->definitions,SEM_TYPE_STRUCTURE)),NUM_SYS_STRUCTURES-1);
+    spec_is_equal(_t_children(_t_child(__sem_context(G_sem,0)->definitions,SEM_TYPE_SYMBOL)),NUM_SYS_SYMBOLS-1);
 
     dump2json(G_sem,__sem_context(G_sem,SYS_CONTEXT)->definitions,"sysdefs");
 
@@ -252,6 +257,72 @@ void testDefReceptor() {
     //@todo undefining things??
 }
 
+void testDefImage() {
+    //! [testDefImage]
+    // the image compiled in was made from the current base_defs, for this machine's data layout
+    spec_is_equal(G_base_defs_image_hash,BASE_DEFS_IMAGE_HASH);
+    spec_is_equal(G_base_defs_image_ids_count,NUM_BASE_DEF_IDS);
+
+    T *http_req_example = G_http_req_example;
+
+    // build the base definitions the slow way
+    SemTable *built = _sem_new();
+    base_contexts(built);
+    base_defs(built);
+    SemanticID ids[NUM_BASE_DEF_IDS];
+    int i;
+    for(i=0;i<NUM_BASE_DEF_IDS;i++) ids[i] = *G_base_def_ids[i];
+    T *data = G_http_req_example;
+
+    // and load them from the image
+    SemTable *sem = _sem_new();
+    spec_is_true(load_base_defs_image(sem));
+
+    // which gives the same definitions, down to the byte when serialized
+    H h = _m_new_from_t(_t_root(__sem_context(built,0)->definitions));
+    S *sb = _m_serialize(h.m);
+    _m_free(h);
+    h = _m_new_from_t(_t_root(__sem_context(sem,0)->definitions));
+    S *si = _m_serialize(h.m);
+    _m_free(h);
+    spec_is_long_equal(si->total_size,sb->total_size);
+    spec_is_true(!memcmp(si,sb,sb->total_size));
+    free(sb);
+    free(si);
+
+    // and the same contexts, all of which are in the one tree of the root context
+    spec_is_equal(sem->contexts,built->contexts);
+    spec_is_ptr_equal(_t_root(__sem_context(sem,CLOCK_CONTEXT)->definitions),_t_root(__sem_context(sem,0)->definitions));
+    spec_is_equal(_d_get_receptor_context(sem,CLOCK_RECEPTOR),CLOCK_CONTEXT);
+    T *paths = _sem_context_paths(sem);
+    T *built_paths = _sem_context_paths(built);
+    spec_is_str_equal(t2s(paths),t2s(built_paths));
+    _t_free(paths);
+    _t_free(built_paths);
+
+    // the same ids
+    int mismatches = 0;
+    for(i=0;i<NUM_BASE_DEF_IDS;i++) if (!semeq(ids[i],*G_base_def_ids[i])) mismatches++;
+    spec_is_equal(mismatches,0);
+
+    // and the same global data
+    spec_is_true(G_http_req_example != data);
+    spec_is_str_equal(t2s(G_http_req_example),t2s(data));
+
+    // labels get looked up in it like in any other semtable
+    Symbol s;
+    spec_is_true(_sem_get_by_label(sem,"HTTP_REQUEST",&s));
+    spec_is_true(semeq(s,HTTP_REQUEST));
+    //! [testDefImage]
+
+    _t_free(data);
+    _t_free(G_http_req_example);
+    G_http_req_example = http_req_example;
+    _t_free(_t_root(__sem_context(built,0)->definitions));
+    _sem_free(built);
+    _t_free(_t_root(__sem_context(sem,0)->definitions));
+    _sem_free(sem);
+}
 
 void testDef() {
     testDefSysDefs();
@@ -264,4 +335,5 @@ void testDef() {
     testDefProcessTemplate();
     testDefSemtrex();
     testDefReceptor();
+    testDefImage();
 }
@@ -6,6 +6,8 @@
 
 #include "../src/ceptr.h"
 #include "../src/process.h"
+#include "../src/trace.h"
+#include "../src/profile.h"
 
 void testRunTree() {
     T *code;
@@ -126,6 +128,130 @@ void testProcessNew() {
     _r_free(r);
 }
 
+void testProcessQuery() {
+    //! [testProcessQuery]
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+    Q *q = r->q;
+    _r_add_scape(r,__s_new(TEST_INT_SYMBOL,TEST_ANYTHING_SYMBOL,NULL,true,false));
+    int j;
+    for(j=0;j<5;j++) {
+        T *t = _t_newr(0,TEST_ANYTHING_SYMBOL);
+        _t_newi(t,TEST_INT_SYMBOL,j%2);
+        _r_new_instance(r,t);
+    }
+
+    T *n = _t_newr(0,QUERY);
+    _t_news(n,QUERY_TYPE,TEST_ANYTHING_SYMBOL);
+    _t_newi(n,TEST_INT_SYMBOL,1);
+    T *run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(run_tree),"(RUN_TREE (QUERY_RESULTS (WHICH_XADDR:TEST_ANYTHING_SYMBOL.2) (WHICH_XADDR:TEST_ANYTHING_SYMBOL.4)) (PARAMS))");
+
+    // no matches
+    n = _t_newr(0,QUERY);
+    _t_news(n,QUERY_TYPE,TEST_ANYTHING_SYMBOL);
+    _t_newi(n,TEST_INT_SYMBOL,7);
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(run_tree),"(RUN_TREE (QUERY_RESULTS) (PARAMS))");
+
+    // querying by a key that has no scape is an error
+    n = _t_newr(0,QUERY);
+    _t_news(n,QUERY_TYPE,TEST_ANYTHING_SYMBOL);
+    _t_new_str(n,TEST_NAME_SYMBOL,"fred");
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    Qe *e = _p_addrt2q(q,run_tree);
+    _p_reduceq(q);
+    spec_is_equal(e->context->err,noScapeReductionErr);
+
+    // as is a range query on a scape that isn't ordered
+    n = _t_parse(G_sem,0,"(QUERY_RANGE (QUERY_TYPE:TEST_ANYTHING_SYMBOL) (TEST_INT_SYMBOL:0) (TEST_INT_SYMBOL:1))");
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    e = _p_addrt2q(q,run_tree);
+    _p_reduceq(q);
+    spec_is_equal(e->context->err,unorderedScapeReductionErr);
+
+    _r_free(r);
+    //! [testProcessQuery]
+}
+
+void testProcessQueryRange() {
+    //! [testProcessQueryRange]
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+    Q *q = r->q;
+    int path[] = {2,TREE_PATH_TERMINATOR};
+    _r_add_scape(r,__s_new(TEST_INT_SYMBOL,TEST_ANYTHING_SYMBOL,path,true,true));
+    int path1[] = {1,TREE_PATH_TERMINATOR};
+    _r_add_scape(r,__s_new(TEST_NAME_SYMBOL,TEST_ANYTHING_SYMBOL,path1,false,true));
+    char *names[] = {"fred","jane","joe","jo","mary"};
+    int ages[] = {42,31,35,19,40};
+    int j;
+    for(j=0;j<5;j++) {
+        T *t = _t_newr(0,TEST_ANYTHING_SYMBOL);
+        _t_new_str(t,TEST_NAME_SYMBOL,names[j]);
+        _t_newi(t,TEST_INT_SYMBOL,ages[j]);
+        _r_new_instance(r,t);
+    }
+
+    T *n = _t_parse(G_sem,0,"(QUERY_RANGE (QUERY_TYPE:TEST_ANYTHING_SYMBOL) (TEST_INT_SYMBOL:30) (TEST_INT_SYMBOL:40))");
+    T *run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(run_tree),"(RUN_TREE (QUERY_RESULTS (WHICH_XADDR:TEST_ANYTHING_SYMBOL.2) (WHICH_XADDR:TEST_ANYTHING_SYMBOL.3) (WHICH_XADDR:TEST_ANYTHING_SYMBOL.5)) (PARAMS))");
+
+    // without a "to" the range goes to the end
+    n = _t_parse(G_sem,0,"(QUERY_RANGE (QUERY_TYPE:TEST_ANYTHING_SYMBOL) (TEST_INT_SYMBOL:40))");
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(run_tree),"(RUN_TREE (QUERY_RESULTS (WHICH_XADDR:TEST_ANYTHING_SYMBOL.5) (WHICH_XADDR:TEST_ANYTHING_SYMBOL.1)) (PARAMS))");
+
+    n = _t_parse(G_sem,0,"(QUERY_PREFIX (QUERY_TYPE:TEST_ANYTHING_SYMBOL) (TEST_NAME_SYMBOL:\"jo\"))");
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(run_tree),"(RUN_TREE (QUERY_RESULTS (WHICH_XADDR:TEST_ANYTHING_SYMBOL.4) (WHICH_XADDR:TEST_ANYTHING_SYMBOL.3)) (PARAMS))");
+
+    // names are unique, so a new instance with a name that's taken is an error
+    n = _t_parse(G_sem,0,"(NEW (NEW_TYPE:TEST_ANYTHING_SYMBOL) (TEST_ANYTHING_SYMBOL (TEST_NAME_SYMBOL:\"jane\") (TEST_INT_SYMBOL:50)))");
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    Qe *e = _p_addrt2q(q,run_tree);
+    _p_reduceq(q);
+    spec_is_equal(e->context->err,duplicateKeyReductionErr);
+    spec_is_equal(_a_instance_slots(&r->instances,TEST_ANYTHING_SYMBOL),5);
+
+    // query results are an iteration source, giving the instances in order
+    FILE *output;
+    char *output_data = NULL;
+    size_t size;
+    output = open_memstream(&output_data,&size);
+    Stream *st = _st_new_unix_stream(output,0);
+    // instances deleted after the query are skipped
+    Xaddr x = {TEST_ANYTHING_SYMBOL,5};
+    n = _t_parse(G_sem,0,"(ITERATE (PARAMS) (QUERY_RANGE (QUERY_TYPE:TEST_ANYTHING_SYMBOL) (TEST_INT_SYMBOL:0)) (STREAM_WRITE % (PARAM_REF:/1/1/1/1/1)))",_t_new_cptr(0,EDGE_STREAM,st));
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _r_delete_instance(r,x);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(output_data,"jojanejoefred");
+
+    _st_free(st);
+    free(output_data);
+    _r_free(r);
+    //! [testProcessQueryRange]
+}
+
 void testProcessDefine() {
     Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
 
@@ -179,6 +305,43 @@ void testProcessDo() {
     _t_free(code);
 }
 
+Error _testTranscodeCstring2Integers(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    char *c = (char *)_t_surface(src);
+    T *x = __t_newr(0,to_sym,true);
+    while(*c) {
+        __t_newi(x,TEST_INT_SYMBOL,*c-'0',true);
+        c++;
+    }
+    *result = x;
+    return noReductionErr;
+}
+
+void testProcessTranscoderRegistry() {
+    //! [testProcessTranscoderRegistry]
+    // the built in transcoders are registered by def_sys
+    spec_is_true(semeq(_p_get_transcoder(G_sem,HTTP_RESPONSE,LINES),http_response_2_lines));
+    // and can be found by the structure of the source or target
+    spec_is_true(semeq(_p_get_transcoder(G_sem,TODAY,LINE),date2usshortdate));
+    spec_is_true(semeq(_p_get_transcoder(G_sem,LINES,HTTP_RESPONSE),NULL_PROCESS));
+    Transcoder *tc = _p_find_transcoder(G_sem,TEST_STR_SYMBOL,TEST_INT_SYMBOL);
+    spec_is_true(tc && tc->fn);
+
+    // native transcoders parse the source surface straight into the target tree
+    _p_add_native_transcoder(G_sem,TEST_STR_SYMBOL,TEST_INTEGERS,_testTranscodeCstring2Integers);
+    T *x,*n = _t_new_str(0,TEST_STR_SYMBOL,"314");
+    spec_is_equal(_p_transcode(G_sem,n,TEST_INTEGERS,_sem_get_symbol_structure(G_sem,TEST_INTEGERS),&x),noReductionErr);
+    spec_is_str_equal(t2s(x),"(TEST_INTEGERS (TEST_INT_SYMBOL:3) (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:4))");
+    _t_free(x);
+
+    // registering a process replaces the native transcoder
+    _p_add_transcoder(G_sem,TEST_STR_SYMBOL,TEST_INTEGERS,NOOP);
+    spec_is_true(semeq(_p_get_transcoder(G_sem,TEST_STR_SYMBOL,TEST_INTEGERS),NOOP));
+    //! [testProcessTranscoderRegistry]
+    tc = _p_find_transcoder(G_sem,TEST_STR_SYMBOL,TEST_INTEGERS);
+    HASH_DEL(G_sem->transcoders,tc);
+    free(tc);
+}
+
 void testProcessTranscode() {
     Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
 
@@ -267,6 +430,14 @@ void testProcessTranscode() {
     spec_is_equal(_p_reduceq(q),noReductionErr);
     spec_is_str_equal(t2s(run_tree),"(RUN_TREE (HTTP_REQUEST (HTTP_REQUEST_METHOD:GET) (HTTP_REQUEST_PATH (HTTP_REQUEST_PATH_SEGMENTS (HTTP_REQUEST_PATH_SEGMENT:path) (HTTP_REQUEST_PATH_SEGMENT:to) (HTTP_REQUEST_PATH_SEGMENT:file.ext))) (HTTP_REQUEST_PATH_QUERY (HTTP_REQUEST_PATH_QUERY_PARAMS (HTTP_REQUEST_PATH_QUERY_PARAM (PARAM_KEY:name) (PARAM_VALUE:joe)) (HTTP_REQUEST_PATH_QUERY_PARAM (PARAM_KEY:age) (PARAM_VALUE:30)))) (HTTP_REQUEST_VERSION (VERSION_MAJOR:0) (VERSION_MINOR:9))) (PARAMS))");
 
+    // the native parser of a CSTRING makes the same request tree as the semtrex transcoder
+    n = _t_parse(G_sem,0,"(TRANSCODE (TRANSCODE_PARAMS (TRANSCODE_TO:HTTP_REQUEST)) (TRANSCODE_ITEMS (TEST_STR_SYMBOL:\"GET /path/to/file.ext?name=joe&age=30 HTTP/0.9\n\")))");
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(run_tree),"(RUN_TREE (HTTP_REQUEST (HTTP_REQUEST_METHOD:GET) (HTTP_REQUEST_PATH (HTTP_REQUEST_PATH_SEGMENTS (HTTP_REQUEST_PATH_SEGMENT:path) (HTTP_REQUEST_PATH_SEGMENT:to) (HTTP_REQUEST_PATH_SEGMENT:file.ext))) (HTTP_REQUEST_PATH_QUERY (HTTP_REQUEST_PATH_QUERY_PARAMS (HTTP_REQUEST_PATH_QUERY_PARAM (PARAM_KEY:name) (PARAM_VALUE:joe)) (HTTP_REQUEST_PATH_QUERY_PARAM (PARAM_KEY:age) (PARAM_VALUE:30)))) (HTTP_REQUEST_VERSION (VERSION_MAJOR:0) (VERSION_MINOR:9))) (PARAMS))");
+
     debug_disable(D_TRANSCODE);
     debug_disable(D_REDUCE+D_REDUCEV);
     debug_disable(D_STEP);
@@ -634,6 +805,58 @@ void testProcessString() {
 
 }
 
+void testProcessRope() {
+    //! [testProcessRope]
+    T *run_tree = _t_new_root(RUN_TREE);
+    R *c = __p_make_context(run_tree,0,0,NULL);
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+
+    // appending moves chars, strings and the pieces of other ropes into the rope
+    T *n = _t_new_root(ROPE_APPEND);
+    T *rope = _t_newr(n,ASCII_ROPE);
+    _t_new_str(rope,TEST_STR_SYMBOL,"Fred");
+    char xx = ' ';
+    _t_new(n,ASCII_CHAR,&xx,sizeof(char));
+    _t_new_str(n,TEST_STR_SYMBOL,"Smith");
+    T *other = _t_newr(n,ASCII_ROPE);
+    _t_new_str(other,TEST_STR_SYMBOL,", Jr.");
+    spec_is_equal(__p_reduce_sys_proc(c,ROPE_APPEND,n,r->q),noReductionErr);
+    spec_is_str_equal(t2s(n),"(ASCII_ROPE (TEST_STR_SYMBOL:Fred) (ASCII_STR: ) (TEST_STR_SYMBOL:Smith) (TEST_STR_SYMBOL:, Jr.))");
+
+    size_t l;
+    char *str = _t_flatten_rope(n,&l);
+    spec_is_str_equal(str,"Fred Smith, Jr.");
+    spec_is_long_equal(l,15);
+    free(str);
+
+    // ropes only get flattened when they are written out
+    char buffer[500] = "";
+    FILE *stream = fmemopen(buffer, 500, "r+");
+    Stream *st = _st_new_unix_stream(stream,0);
+    _t_write(G_sem,n,st);
+    spec_is_str_equal(buffer,"Fred Smith, Jr.");
+    _st_free(st);
+
+    // or transcoded to a CSTRING
+    T *x;
+    spec_is_equal(_p_transcode(G_sem,n,TEST_NAME_SYMBOL,CSTRING,&x),noReductionErr);
+    spec_is_str_equal(t2s(x),"(TEST_NAME_SYMBOL:Fred Smith, Jr.)");
+
+    spec_is_equal(_p_transcode(G_sem,x,ASCII_ROPE,ROPE,&n),noReductionErr);
+    spec_is_str_equal(t2s(n),"(ASCII_ROPE (TEST_NAME_SYMBOL:Fred Smith, Jr.))");
+    _t_free(n);
+
+    n = _t_new_root(ROPE_APPEND);
+    _t_newr(n,ASCII_ROPE);
+    _t_newi(n,TEST_INT_SYMBOL,314);
+    spec_is_equal(__p_reduce_sys_proc(c,ROPE_APPEND,n,r->q),incompatibleTypeReductionErr);
+    _t_free(n);
+    //! [testProcessRope]
+
+    _p_free_context(c);
+    _r_free(r);
+}
+
 void testProcessRespond() {
     // testing responding to a signal requires setting up a sending signal context
 
@@ -974,14 +1197,14 @@ void testProcessConverseListen() {
     _r_deliver(r,s);
     spec_is_equal(_p_reduceq(q),noReductionErr);
     // we should have no instances in the instance store, because the signal wasn't part of the conversation
-    spec_is_str_equal(t2s(r->instances),"");
+    spec_is_ptr_equal(r->instances,NULL);
 
     T *cid = _t_clone(_t_getv(cons,1,ConversationIdentIdx,TREE_PATH_TERMINATOR));
     s = __r_make_signal(r->addr,r->addr,DEFAULT_ASPECT,TEST_INT_SYMBOL,_t_clone(t),0,0,cid);
     _r_deliver(r,s);
     spec_is_equal(_p_reduceq(q),noReductionErr);
     debug_disable(D_LISTEN+D_SIGNALS);
-    spec_is_str_equal(t2s(r->instances),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:314))))");
+    spec_is_str_equal(t2s(r->instances->store),"(INSTANCE_STORE (INSTANCES (SYMBOL_INSTANCES:TEST_INT_SYMBOL (TEST_INT_SYMBOL:314))))");
 
 
     // test __r_cleanup (should actually be testing it via a call to COMPLETE)
@@ -1069,15 +1292,18 @@ void testProcessStream() {
     R *c = e->context;
 
     // after reduction the context should be in the blocked state
-
+    // (holding the stream's lock keeps the reader thread from completing the read, and so
+    // from unblocking the context, before we can check)
+    flockfile(stream);
     spec_is_equal(_p_reduceq(q),noReductionErr);
     spec_is_equal(q->contexts_count,0);
     spec_is_ptr_equal(q->blocked,e);
     spec_is_equal(c->state,Block);
+    funlockfile(stream);
 
     // wait for read to complete, after which it should have also unblocked the
     // context which should thus be ready for reduction again.
-    while(!(st->flags&StreamHasData) && st->flags&StreamAlive ) {sleepms(1);};
+    while((!(st->flags&StreamHasData) && st->flags&StreamAlive) || q->wakeups || q->owned) {sleepms(1);};
     spec_is_equal(q->contexts_count,1);
 
     spec_is_equal(_p_reduceq(q),noReductionErr);
@@ -1527,6 +1753,321 @@ void testProcessSignatureMatching() {
 
 }
 
+typedef struct {
+    Process p;
+    bool done;
+    int checks;
+    int errors;
+} _testSigDescReaderState;
+
+// check a process's signature descriptor over and over while it keeps getting rebuilt
+void *_testSigDescReader(void *arg) {
+    _testSigDescReaderState *st = arg;
+    SemReader r;
+    _sem_reader_online(G_sem,&r);
+    while (!__atomic_load_n(&st->done,__ATOMIC_ACQUIRE)) {
+        SigDesc *d = __p_get_sigdesc(G_sem,st->p);
+        if (d->slot_count != 3 || d->slots[0].kind != SigSlotStructure) st->errors++;
+        __atomic_add_fetch(&st->checks,1,__ATOMIC_RELEASE);
+        _sem_quiescent(G_sem,&r);
+    }
+    _sem_reader_offline(G_sem,&r);
+    return NULL;
+}
+
+void testProcessSignatureCache() {
+    Process if_even = G_ifeven;
+
+    //! [testProcessSignatureCache]
+    SigDesc *d = __p_get_sigdesc(G_sem,if_even);
+    spec_is_true(d->has_signature);
+    spec_is_equal(d->slot_count,3);
+    spec_is_equal(d->required,3);
+    spec_is_equal(d->template_count,-1);
+    spec_is_equal(d->slots[0].kind,SigSlotStructure);
+    spec_is_equal(d->slots[0].param_idx,1);
+    spec_is_true(semeq(d->slots[0].expected,INTEGER));
+    spec_is_equal(d->slots[1].kind,SigSlotAny);
+    spec_is_equal(d->slots[2].param_idx,3);
+
+    // the descriptor is cached until the definitions change
+    spec_is_ptr_equal(__p_get_sigdesc(G_sem,if_even),d);
+    _sem_changed(G_sem);
+    d = __p_get_sigdesc(G_sem,if_even);
+    spec_is_equal(d->generation,G_sem->generation);
+    spec_is_equal(d->slot_count,3);
+
+    // template signatures get their expected semantic refs pre-hashed
+    d = __p_get_sigdesc(G_sem,send_request);
+    spec_is_true(d->template_count > 0);
+    spec_is_ptr_equal(__p_get_sigdesc(G_sem,send_request),d);
+
+    // descriptors can be rebuilt while other threads are checking signatures with them
+    _testSigDescReaderState st = {if_even,false,0,0};
+    SemReader r;
+    _sem_reader_online(G_sem,&r);
+    pthread_t t;
+    pthread_create(&t,0,_testSigDescReader,&st);
+    int i;
+    for(i=0;i<1000;i++) {
+        _sem_changed(G_sem);
+        __p_get_sigdesc(G_sem,if_even);
+        _sem_quiescent(G_sem,&r);
+    }
+    for(i=0;i<200 && __atomic_load_n(&st.checks,__ATOMIC_ACQUIRE) < 100;i++) sleepms(10);
+    __atomic_store_n(&st.done,true,__ATOMIC_RELEASE);
+    pthread_join(t,NULL);
+    _sem_reader_offline(G_sem,&r);
+    spec_is_equal(st.errors,0);
+    spec_is_true(st.checks > 0);
+    //! [testProcessSignatureCache]
+}
+
+void testProcessMemoize() {
+    //! [testProcessMemoize]
+    T *code = _t_parse(G_sem,0,"(ADD_INT (PARAM_REF:/2/1) (PARAM_REF:/2/1))");
+    T *signature = __p_make_signature("result",SIGNATURE_STRUCTURE,INTEGER,
+                                      "val",SIGNATURE_STRUCTURE,INTEGER,
+                                      NULL);
+    Process dbl = _d_define_process(G_sem,code,"double","double an integer",signature,NULL,TEST_CONTEXT);
+    spec_is_true(!__p_get_sigdesc(G_sem,dbl)->pure);
+    _d_set_process_pure(G_sem,dbl);
+    spec_is_true(__p_get_sigdesc(G_sem,dbl)->pure);
+
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+    Q *q = r->q;
+
+    // the second call with the same param comes straight from the cache
+    T *n = _t_new_root(ADD_INT);
+    _t_newi(_t_newr(n,dbl),TEST_INT_SYMBOL,3);
+    _t_newi(_t_newr(n,dbl),TEST_INT_SYMBOL,3);
+    T *run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(_t_child(run_tree,1)),"(TEST_INT_SYMBOL:12)");
+    spec_is_long_equal(q->memo.misses,1);
+    spec_is_long_equal(q->memo.hits,1);
+    spec_is_equal(HASH_COUNT(q->memo.entries),1);
+
+    // the least recently used results get evicted when the cache is full
+    q->memo.size = 1;
+    n = _t_newr(0,dbl);
+    _t_newi(n,TEST_INT_SYMBOL,4);
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(_t_child(run_tree,1)),"(TEST_INT_SYMBOL:8)");
+    spec_is_long_equal(q->memo.misses,2);
+    spec_is_long_equal(q->memo.evictions,1);
+
+    T *t = _t_newr(0,dbl);
+    _t_newi(t,TEST_INT_SYMBOL,4);
+    TreeHash h = _t_hash(G_sem,t);
+    spec_is_str_equal(t2s(__p_memo_get(q,dbl,h,t)),"(TEST_INT_SYMBOL:8)");
+
+    // results are only used if the params really are the same, not just their hash
+    T *t5 = _t_newr(0,dbl);
+    _t_newi(t5,TEST_INT_SYMBOL,5);
+    spec_is_ptr_equal(__p_memo_get(q,dbl,h,t5),NULL);
+    _t_free(t5);
+
+    // and results computed before the definitions changed aren't used
+    _sem_changed(G_sem);
+    spec_is_ptr_equal(__p_memo_get(q,dbl,h,t),NULL);
+    spec_is_equal(HASH_COUNT(q->memo.entries),0);
+    _t_free(t);
+
+    _r_free(r);
+    //! [testProcessMemoize]
+}
+
+// a native transcoder that hands back a run tree for the reduction to push
+Error _testTranscodeToRunTree(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    T *code = __t_newr(0,NOOP,true);
+    __t_newi(code,to_sym,*(int *)_t_surface(src),true);
+    *result = __p_build_run_tree(code,0);
+    _t_free(code);
+    return redoReduction;
+}
+
+void testProcessTrace() {
+    //! [testProcessTrace]
+    T *code = _t_parse(G_sem,0,"(ADD_INT (PARAM_REF:/2/1) (PARAM_REF:/2/1))");
+    T *signature = __p_make_signature("result",SIGNATURE_STRUCTURE,INTEGER,
+                                      "val",SIGNATURE_STRUCTURE,INTEGER,
+                                      NULL);
+    Process dbl = _d_define_process(G_sem,code,"trace double","double an integer",signature,NULL,TEST_CONTEXT);
+
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+    Q *q = r->q;
+    spec_is_ptr_equal(q->trace,NULL);
+    _p_trace(q,TRACE_BUFFER_SIZE);
+
+    T *n = _t_new_root(ADD_INT);
+    _t_newi(_t_newr(n,dbl),TEST_INT_SYMBOL,3);
+    _t_newi(n,TEST_INT_SYMBOL,1);
+    T *run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    Qe *e = _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(_t_child(run_tree,1)),"(TEST_INT_SYMBOL:7)");
+
+    // the call to the defined process brackets the reduction of its code
+    TraceBuffer *tb = q->trace;
+    spec_is_equal(_tr_count(tb),6);
+    int types[] = {TraceStepBegin,TraceStepBegin,TraceStepEnd,TraceStepEnd,TraceStepBegin,TraceStepEnd};
+    Symbol syms[] = {dbl,ADD_INT,ADD_INT,NULL_SYMBOL,ADD_INT,ADD_INT};
+    int i;
+    for(i=0;i<6;i++) {
+        spec_is_equal(tb->events[i].type,types[i]);
+        spec_is_sem_equal(tb->events[i].symbol,syms[i]);
+        spec_is_equal(tb->events[i].id,e->id);
+    }
+
+    char *buf;
+    size_t size;
+    FILE *out = open_memstream(&buf,&size);
+    _tr_dump(G_sem,tb,out);
+    fclose(out);
+    char *expected = "{\"traceEvents\":[{\"name\":\"trace double\",\"cat\":\"reduce\",\"ph\":\"B\"";
+    spec_is_true(!strncmp(buf,expected,strlen(expected)));
+    spec_is_true(strstr(buf,"{\"name\":\"ADD_INT\",\"cat\":\"reduce\",\"ph\":\"B\"") != NULL);
+    spec_is_true(strstr(buf,"{\"ph\":\"E\"") != NULL);
+    free(buf);
+
+    // a sys process that returns a run tree pushes a context for it, which is bracketed too
+    _p_add_native_transcoder(G_sem,TEST_INT_SYMBOL,TEST_INT_SYMBOL2,_testTranscodeToRunTree);
+    n = _t_parse(G_sem,0,"(TRANSCODE (TRANSCODE_PARAMS (TRANSCODE_TO:TEST_INT_SYMBOL2)) (TRANSCODE_ITEMS (TEST_INT_SYMBOL:314)))");
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    e = _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(_t_child(run_tree,1)),"(TEST_INT_SYMBOL2:314)");
+    spec_is_equal(_tr_count(tb),12);
+    int rtypes[] = {TraceStepBegin,TraceStepEnd,TraceStepBegin,TraceStepBegin,TraceStepEnd,TraceStepEnd};
+    Symbol rsyms[] = {TRANSCODE,TRANSCODE,NOOP,NOOP,NOOP,NULL_SYMBOL};
+    for(i=0;i<6;i++) {
+        spec_is_equal(tb->events[i+6].type,rtypes[i]);
+        spec_is_sem_equal(tb->events[i+6].symbol,rsyms[i]);
+        spec_is_equal(tb->events[i+6].id,e->id);
+    }
+    Transcoder *tc = _p_find_transcoder(G_sem,TEST_INT_SYMBOL,TEST_INT_SYMBOL2);
+    HASH_DEL(G_sem->transcoders,tc);
+    free(tc);
+    _r_free(r);
+
+    // a full buffer overwrites the oldest events
+    tb = _tr_new(3,0);
+    spec_is_long_equal(tb->mask,3);
+    for(i=1;i<=6;i++) __tr_event(tb,TraceBlock,NULL_SYMBOL,i);
+    spec_is_equal(_tr_count(tb),4);
+    out = open_memstream(&buf,&size);
+    _tr_dump(G_sem,tb,out);
+    fclose(out);
+    expected = "{\"traceEvents\":[{\"name\":\"block\",\"cat\":\"queue\",\"ph\":\"i\"";
+    spec_is_true(!strncmp(buf,expected,strlen(expected)));
+    spec_is_true(strstr(buf,"\"tid\":2}") == NULL);
+    spec_is_true(strstr(buf,"\"tid\":3}") != NULL);
+    spec_is_true(strstr(buf,"\"tid\":6}]}") != NULL);
+    free(buf);
+    _tr_free(tb);
+    //! [testProcessTrace]
+}
+
+void testProcessProfile() {
+    //! [testProcessProfile]
+    T *code = _t_parse(G_sem,0,"(ADD_INT (PARAM_REF:/2/1) (PARAM_REF:/2/1))");
+    T *signature = __p_make_signature("result",SIGNATURE_STRUCTURE,INTEGER,
+                                      "val",SIGNATURE_STRUCTURE,INTEGER,
+                                      NULL);
+    Process dbl = _d_define_process(G_sem,code,"profile double","double an integer",signature,NULL,TEST_CONTEXT);
+
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+    Q *q = r->q;
+    spec_is_ptr_equal(q->profile,NULL);
+    _p_profile(q);
+
+    T *n = _t_new_root(ADD_INT);
+    _t_newi(_t_newr(n,dbl),TEST_INT_SYMBOL,3);
+    _t_newi(_t_newr(n,dbl),TEST_INT_SYMBOL,4);
+    T *run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(_t_child(run_tree,1)),"(TEST_INT_SYMBOL:14)");
+
+    Profile *p = q->profile;
+    spec_is_equal(HASH_COUNT(p->processes),2);
+    ProfileEntry *d = __pf_entry(p,dbl);
+    ProfileEntry *a = __pf_entry(p,ADD_INT);
+    spec_is_long_equal(d->calls,2);
+    spec_is_long_equal(a->calls,3);
+    // the process's own work and the adds it called are all included in its time
+    spec_is_true(d->inclusive_time >= d->exclusive_time);
+    spec_is_true(a->inclusive_time == a->exclusive_time);
+    // resolving the param refs allocates nodes in the process
+    spec_is_true(d->allocs > 0);
+    spec_is_true(d->alloc_bytes >= d->allocs*sizeof(T));
+
+    T *t = _pf_report(p);
+    spec_is_equal(_t_children(t),2);
+    spec_is_sem_equal(_t_symbol(_t_child(t,1)),PROCESS_PROFILE);
+    spec_is_equal(_t_children(_t_child(t,1)),6);
+    spec_is_long_equal(*(uint64_t *)_t_surface(_t_getv(t,1,2,TREE_PATH_TERMINATOR)) + *(uint64_t *)_t_surface(_t_getv(t,2,2,TREE_PATH_TERMINATOR)),5);
+    _t_free(t);
+
+    char *buf;
+    size_t size;
+    FILE *out = open_memstream(&buf,&size);
+    _pf_folded(G_sem,p,out);
+    fclose(out);
+    spec_is_true(strstr(buf,"profile double;ADD_INT ") != NULL);
+    spec_is_true(strstr(buf,"\nADD_INT ") != NULL || !strncmp(buf,"ADD_INT ",8));
+    free(buf);
+
+    // the profile can also be had at runtime with MAGIC
+    n = _t_newi(0,MAGIC,MagicProfile);
+    run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    t = _t_child(run_tree,1);
+    spec_is_sem_equal(_t_symbol(t),RECEPTOR_PROFILE);
+    // the MAGIC call itself gets counted only after it has built the report
+    spec_is_equal(_t_children(t),2);
+    spec_is_long_equal(__pf_entry(p,MAGIC)->calls,1);
+
+    _r_free(r);
+    //! [testProcessProfile]
+}
+
+void testProcessFoldConstants() {
+    //! [testProcessFoldConstants]
+    // constant sub-trees get reduced but anything depending on params, quoted, or that fails is left alone
+    T *code = _t_parse(G_sem,0,"(IF (EQ_INT (PARAM_REF:/2/1) (ADD_INT (TEST_INT_SYMBOL:1) (MULT_INT (TEST_INT_SYMBOL:2) (TEST_INT_SYMBOL:3)))) (CONCAT_STR (RESULT_SYMBOL:TEST_NAME_SYMBOL) (TEST_STR_SYMBOL:\"Fred\") (TEST_STR_SYMBOL:\" Smith\")) (NOOP (QUOTE (ADD_INT (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:1))) (DIV_INT (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:0))))");
+    T *signature = __p_make_signature("result",SIGNATURE_PASSTHRU,NULL_STRUCTURE,
+                                      "val",SIGNATURE_STRUCTURE,INTEGER,
+                                      NULL);
+    Process p = _d_define_process(G_sem,code,"folded","a process with constants in it",signature,NULL,TEST_CONTEXT);
+    T *def = _sem_get_def(G_sem,p);
+    spec_is_str_equal(t2s(_t_child(def,ProcessDefCodeIdx)),"(process:IF (process:EQ_INT (PARAM_REF:/2/1) (TEST_INT_SYMBOL:7)) (TEST_NAME_SYMBOL:Fred Smith) (process:NOOP (process:QUOTE (process:ADD_INT (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:1))) (process:DIV_INT (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:0))))");
+
+    // a whole tree of constants folds down to its value
+    T *t = _t_parse(G_sem,0,"(NOOP (IF (LT_INT (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:2)) (SUB_INT (TEST_INT_SYMBOL:5) (TEST_INT_SYMBOL:3)) (TEST_INT_SYMBOL:0)))");
+    _p_fold_constants(G_sem,t);
+    spec_is_str_equal(t2s(t),"(TEST_INT_SYMBOL:2)");
+    _t_free(t);
+
+    // but side effects never are
+    t = _t_parse(G_sem,0,"(NOOP (STREAM_CLOSE (ADD_INT (TEST_INT_SYMBOL:1) (TEST_INT_SYMBOL:2))))");
+    _p_fold_constants(G_sem,t);
+    spec_is_str_equal(t2s(t),"(process:NOOP (process:STREAM_CLOSE (TEST_INT_SYMBOL:3)))");
+    _t_free(t);
+    //! [testProcessFoldConstants]
+}
+
 void testProcessError() {
     T *t = _t_new_root(RUN_TREE);
     T *n = _t_parse(G_sem,0,"(NOOP (DIV_INT (TEST_INT_SYMBOL:100) (TEST_INT_SYMBOL:0)))");
@@ -1625,6 +2166,10 @@ void testProcessIterateOnSymbol() {
     x = _r_new_instance(r,t);
     t = _t_new_str(0,TEST_STR_SYMBOL,"thing2 ");
     x = _r_new_instance(r,t);
+    // deleted instances get skipped
+    t = _t_new_str(0,TEST_STR_SYMBOL,"thing3 ");
+    x = _r_new_instance(r,t);
+    _r_delete_instance(r,x);
 
     Q *q = r->q;
     Qe *e = _p_addrt2q(q,run_tree);
@@ -1638,6 +2183,24 @@ void testProcessIterateOnSymbol() {
     _st_free(st);
     free(output_data);
     _r_free(r);
+
+    // a body that adds instances of the symbol being iterated on only sees the ones there
+    // were when the iteration started
+    r = _r_new(G_sem,TEST_RECEPTOR);
+    _r_new_instance(r,_t_new_str(0,TEST_STR_SYMBOL,"thing1"));
+    _r_new_instance(r,_t_new_str(0,TEST_STR_SYMBOL,"thing2"));
+    code = _t_parse(G_sem,0,"(ITERATE (PARAMS) (ITERATE_ON_SYMBOL:TEST_STR_SYMBOL) (NEW (NEW_TYPE:TEST_STR_SYMBOL) (PARAM_REF:/1/1/1/1)))");
+    run_tree = __p_build_run_tree(code,0);
+    _t_free(code);
+    q = r->q;
+    e = _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_ptr_equal(q->completed,e);
+    t = _t_new_root(ITERATION_DATA);
+    _a_get_instances(&r->instances,TEST_STR_SYMBOL,t);
+    spec_is_str_equal(t2s(t),"(ITERATION_DATA (TEST_STR_SYMBOL:thing1) (TEST_STR_SYMBOL:thing2) (TEST_STR_SYMBOL:thing1) (TEST_STR_SYMBOL:thing2))");
+    _t_free(t);
+    _r_free(r);
 }
 
 void testProcessListen() {
@@ -1888,6 +2451,116 @@ void testProcessWakeup() {
     _r_free(r);
 }
 
+void testProcessInbox() {
+    //! [testProcessInbox]
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+    Q *q = r->q;
+
+    T *p = _t_parse(G_sem,0,"(NOOP (TEST_INT_SYMBOL:314))");
+    T *code =_t_rclone(p);
+    T *run_tree = __p_build_run_tree(code,0);
+    _t_free(code);
+
+    // pretend some other thread owns the q, i.e. is reducing it
+    q->owned = 1;
+
+    // so adding a run tree only gets as far as the inbox
+    Qe *e = _p_addrt2q(q,run_tree);
+    spec_is_ptr_equal(q->inbox,e);
+    spec_is_ptr_equal(q->active,NULL);
+    spec_is_equal(q->contexts_count,0);
+
+    // and unblocks are posted for later too
+    _p_unblock(q,e->id);
+    spec_is_true(q->wakeups != NULL);
+
+    // once the q is released the inbox gets drained
+    q->owned = 0;
+    __p_try_drain(q);
+    spec_is_ptr_equal(q->inbox,NULL);
+    spec_is_ptr_equal(q->wakeups,NULL);
+    spec_is_ptr_equal(q->active,e);
+    spec_is_equal(q->contexts_count,1);
+
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    spec_is_str_equal(t2s(run_tree),"(RUN_TREE (TEST_INT_SYMBOL:314) (PARAMS))");
+    spec_is_ptr_equal(q->completed,e);
+
+    // cleaning up returns the queue element to the pool where it gets reused
+    _p_cleanup(q);
+    spec_is_ptr_equal(q->qes.free,e);
+    spec_is_equal(q->qes.free_count,1);
+    code =_t_rclone(p);
+    run_tree = __p_build_run_tree(code,0);
+    _t_free(code);
+    spec_is_ptr_equal(_p_addrt2q(q,run_tree),e);
+    spec_is_ptr_equal(q->qes.free,NULL);
+    spec_is_equal(q->qes.free_count,0);
+
+    _t_free(p);
+    _r_free(r);
+    //! [testProcessInbox]
+}
+
+void testProcessFramePools() {
+    //! [testProcessFramePools]
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+    Q *q = r->q;
+
+    // an iteration whose body is a cond that has a process call as its condition,
+    // uses one of each kind of frame
+    T *p = _t_parse(G_sem,0,"(ITERATE (PARAMS) (TEST_INT_SYMBOL:2) (COND (CONDITIONS (COND_PAIR (NOOP) (TEST_INT_SYMBOL:1)))))");
+    T *pair = _t_getv(p,3,1,1,TREE_PATH_TERMINATOR);
+    T *call = _t_new_root(G_ifeven);
+    _t_newi(call,TEST_INT_SYMBOL,2);
+    _t_newi(call,BOOLEAN,1);
+    _t_newi(call,BOOLEAN,0);
+    _t_replace(pair,1,call);
+
+    T *c =_t_rclone(p);
+    T *run_tree = __p_build_run_tree(c,0);
+    _t_free(c);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+
+    // only the top context is still in use, and the second process call reused the
+    // frame freed by the first one.
+    spec_is_equal(q->contexts.in_use,1);
+    spec_is_equal(q->contexts.peak,2);
+    spec_is_equal(q->contexts.free_count,1);
+    spec_is_long_equal(q->contexts.allocs,3);
+    spec_is_long_equal(q->contexts.reuses,1);
+    spec_is_equal(q->iterations.in_use,0);
+    spec_is_equal(q->iterations.free_count,1);
+    spec_is_equal(q->conds.in_use,0);
+    spec_is_equal(q->conds.free_count,1);
+    spec_is_long_equal(q->conds.allocs,2);
+    spec_is_long_equal(q->conds.reuses,1);
+
+    _p_cleanup(q);
+    spec_is_equal(q->contexts.in_use,0);
+    spec_is_equal(q->contexts.free_count,2);
+    spec_is_equal(q->qes.in_use,0);
+    spec_is_equal(q->qes.free_count,1);
+
+    // running it again is satisfied entirely from the pools
+    c =_t_rclone(p);
+    run_tree = __p_build_run_tree(c,0);
+    _t_free(c);
+    _p_addrt2q(q,run_tree);
+    spec_is_equal(_p_reduceq(q),noReductionErr);
+    _p_cleanup(q);
+    spec_is_long_equal(q->contexts.allocs,6);
+    spec_is_long_equal(q->contexts.reuses,4);
+    spec_is_long_equal(q->iterations.reuses,1);
+    spec_is_long_equal(q->conds.reuses,3);
+    spec_is_long_equal(q->qes.reuses,1);
+
+    _t_free(p);
+    _r_free(r);
+    //! [testProcessFramePools]
+}
+
 void testProcess() {
     _defIfEven();
     testProcessParameter();
@@ -1895,9 +2568,12 @@ void testProcess() {
     testProcessGet();
     testProcessDel();
     testProcessNew();
+    testProcessQuery();
+    testProcessQueryRange();
     testProcessDefine();
     testProcessDo();
     testProcessTranscode();
+    testProcessTranscoderRegistry();
     testProcessDissolve();
     testProcessSemtrex();
     testProcessFill();
@@ -1909,6 +2585,7 @@ void testProcess() {
     testProcessIntMath();
     testProcessPath();
     testProcessString();
+    testProcessRope();
     testProcessRespond();
     testProcessSay();
     testProcessRequest();
@@ -1923,6 +2600,11 @@ void testProcess() {
     testProcessRefs();
     testProcessReduceDefinedProcess();
     testProcessSignatureMatching();
+    testProcessSignatureCache();
+    testProcessMemoize();
+    testProcessFoldConstants();
+    testProcessTrace();
+    testProcessProfile();
     testProcessError();
     testProcessRaise();
     testProcessIterate();
@@ -1935,4 +2617,6 @@ void testProcess() {
     testRunTreeTemplate();
     testProcessContinue();
     testProcessWakeup();
+    testProcessInbox();
+    testProcessFramePools();
 }
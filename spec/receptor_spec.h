@@ -139,6 +139,7 @@ void testReceptorDeliverConversation() {
 }
 
 void testReceptorConversations() {
+    //! [testReceptorConversations]
     Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
     spec_is_str_equal(_td(r,r->conversations),"(CONVERSATIONS)");
 
@@ -165,11 +166,41 @@ void testReceptorConversations() {
 
     spec_is_ptr_equal(_r_find_conversation(r,&u3),c3);
 
+    // conversations at all levels are indexed by uuid
+    spec_is_equal(HASH_COUNT(r->conversation_index),3);
+    UUIDt unknown = __uuid_gen();
+    spec_is_ptr_equal(_r_find_conversation(r,&unknown),NULL);
+
+    // cleaning up a conversation removes its sub-conversations from the index too
+    __r_cleanup_conversation(r,&u);
+    spec_is_ptr_equal(_r_find_conversation(r,&u),NULL);
+    spec_is_ptr_equal(_r_find_conversation(r,&u2),NULL);
+    spec_is_ptr_equal(_r_find_conversation(r,&u3),c3);
+    spec_is_equal(HASH_COUNT(r->conversation_index),1);
+
+    // lots of open conversations
+    int i;
+    UUIDt us[1000];
+    for(i=0;i<1000;i++) {
+        us[i] = __uuid_gen();
+        _r_add_conversation(r,&u3,&us[i],0,0);
+    }
+    spec_is_equal(HASH_COUNT(r->conversation_index),1001);
+    spec_is_ptr_equal(_r_find_conversation(r,&us[999]),_t_child(_t_child(c3,ConversationConversationsIdx),1000));
+
+    // a receptor rebuilt from its tree gets its index rebuilt too
+    Receptor *r2 = __r_init(_t_clone(r->root),G_sem);
+    spec_is_equal(HASH_COUNT(r2->conversation_index),1001);
+    spec_is_true(_r_find_conversation(r2,&us[500]) != NULL);
+    _r_free(r2);
+
     _r_free(r);
+    //! [testReceptorConversations]
 }
 
 extern int G_next_process_id;
 void testReceptorResponseDeliver() {
+    //! [testReceptorResponseDeliver]
     Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
 
     G_next_process_id = 0; // reset the process ids so the test will always work
@@ -210,7 +241,19 @@ void testReceptorResponseDeliver() {
 
     // get the original signal uuid from the run tree
     UUIDt response_id = *(UUIDt *)_t_surface(_t_child(_t_child(rt,1),1));
-    T *s = __r_make_signal(from,to,DEFAULT_ASPECT,TESTING,_t_new_str(0,TEST_STR_SYMBOL,"foo"),&response_id,0,0);
+
+    // the pending response is indexed by that uuid
+    spec_is_ptr_equal(_r_find_pending_response(r,&response_id),pr);
+    spec_is_equal(HASH_COUNT(r->pending_index),1);
+
+    // a response to some other request doesn't go anywhere
+    UUIDt other_id = __uuid_gen();
+    T *s = __r_make_signal(from,to,DEFAULT_ASPECT,TESTING,_t_new_str(0,TEST_STR_SYMBOL,"bar"),&other_id,0,0);
+    spec_is_equal(_r_deliver(r,s),noDeliveryErr);
+    spec_is_ptr_equal(r->q->blocked->context->run_tree,rt);
+    spec_is_equal(HASH_COUNT(r->pending_index),1);
+
+    s = __r_make_signal(from,to,DEFAULT_ASPECT,TESTING,_t_new_str(0,TEST_STR_SYMBOL,"foo"),&response_id,0,0);
 
     //    debug_enable(D_SIGNALS);
     spec_is_equal(_r_deliver(r,s),noDeliveryErr);
@@ -226,8 +269,11 @@ void testReceptorResponseDeliver() {
 
     // and the pending_responses list should be cleared too because we only asked for one response.
     spec_is_str_equal(_td(r,r->pending_responses),"(PENDING_RESPONSES)");
+    spec_is_ptr_equal(_r_find_pending_response(r,&response_id),NULL);
+    spec_is_equal(HASH_COUNT(r->pending_index),0);
 
     _r_free(r);
+    //! [testReceptorResponseDeliver]
 }
 
 void testReceptorEndCondition() {
@@ -265,6 +311,107 @@ void testReceptorEndCondition() {
 
 }
 
+void testReceptorTimeouts() {
+    //! [testReceptorTimeouts]
+    Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
+    TimerWheel *w = _tw_new(TIMER_RESOLUTION);
+    uint64_t start = _tw_now();
+    _r_start_timeouts(r,w);
+
+    // a request that has to be responded to within a second
+    T *p = _t_parse(G_sem,0,"(NOOP (REQUEST (TO_ADDRESS (RECEPTOR_ADDR:99)) (ASPECT_IDENT:DEFAULT_ASPECT) (CARRIER:TESTING) (TEST_INT_SYMBOL:314) (RESPONSE_CARRIER:TESTING) (END_CONDITIONS)))");
+    _t_add(_t_getv(p,1,6,TREE_PATH_TERMINATOR),__r_make_timestamp(TIMEOUT_AT,1));
+    T *code = _t_rclone(p);
+    _t_free(p);
+    Qe *e = _p_addrt2q(r->q,__p_build_run_tree(code,0));
+    _t_free(code);
+    spec_is_equal(_p_reduceq(r->q),noReductionErr);
+    spec_is_ptr_equal(r->q->blocked,e);
+    spec_is_equal(_t_children(r->pending_responses),1);
+    spec_is_equal(HASH_COUNT(r->timeouts),1);
+
+    // a listener that expires in three seconds and one that never does
+    T *pattern = _t_new_root(PATTERN);
+    _sl(pattern,TEST_INT_SYMBOL);
+    T *until = _t_new_root(END_CONDITIONS);
+    _t_add(until,__r_make_timestamp(TIMEOUT_AT,3));
+    _r_add_expectation(r,DEFAULT_ASPECT,TESTING,pattern,_t_news(0,ACTION,NULL_PROCESS),0,until,NULL,NULL);
+    pattern = _t_new_root(PATTERN);
+    _sl(pattern,TEST_INT_SYMBOL);
+    _r_add_expectation(r,DEFAULT_ASPECT,TESTING,pattern,_t_news(0,ACTION,NULL_PROCESS),0,0,NULL,NULL);
+    T *es = __r_get_expectations(r,DEFAULT_ASPECT);
+    spec_is_equal(_t_children(es),2);
+    spec_is_equal(HASH_COUNT(r->timeouts),2);
+
+    // a conversation that ends in a second, with a listener of its own
+    UUIDt u = __uuid_gen();
+    until = _t_new_root(END_CONDITIONS);
+    _t_add(until,__r_make_timestamp(TIMEOUT_AT,1));
+    _r_add_conversation(r,0,&u,until,0);
+    pattern = _t_new_root(PATTERN);
+    _sl(pattern,TEST_INT_SYMBOL);
+    _r_add_expectation(r,DEFAULT_ASPECT,TESTING,pattern,_t_news(0,ACTION,NULL_PROCESS),0,0,NULL,__cid_new(0,&u,0));
+    spec_is_equal(_t_children(es),3);
+    spec_is_equal(HASH_COUNT(r->timeouts),3);
+
+    // TIMEOUT_AT is only to the second, so all we know is nothing's due yet
+    spec_is_equal(_tw_advance(w,start),0);
+    spec_is_equal(_t_children(r->pending_responses),1);
+    spec_is_equal(_t_children(es),3);
+
+    // once the second is up the request and the conversation are queued up to be expired
+    _tw_advance(w,start+1500*NS_PER_MS);
+    spec_is_true(r->expired != NULL);
+    spec_is_equal(_t_children(r->pending_responses),1);
+    spec_is_equal(_t_children(es),3);
+
+    // and expiring them outside the wheel's lock removes the request, waking the process
+    // that made it with a timeout error, and the conversation's listener
+    _r_expire_timeouts(r);
+    spec_is_ptr_equal(r->expired,NULL);
+    spec_is_equal(_t_children(r->pending_responses),0);
+    spec_is_equal(_t_children(es),2);
+    spec_is_equal(HASH_COUNT(r->timeouts),1);
+    spec_is_ptr_equal(_r_find_conversation(r,&u),_t_child(r->conversations,1));
+    _p_reduceq(r->q);
+    spec_is_ptr_equal(r->q->blocked,NULL);
+    spec_is_ptr_equal(r->q->completed,e);
+    spec_is_equal(e->context->err,timeoutReductionErr);
+
+    _tw_advance(w,start+3500*NS_PER_MS);
+    _r_expire_timeouts(r);
+    spec_is_equal(_t_children(es),1);
+    spec_is_str_equal(_td(r,_t_child(_t_child(es,1),ExpectationEndCondsIdx)),"(END_CONDITIONS (UNLIMITED))");
+    spec_is_equal(HASH_COUNT(r->timeouts),0);
+    spec_is_equal(w->count,0);
+
+    // removing an item doesn't touch the wheel, its timer just does nothing when it goes off
+    until = _t_new_root(END_CONDITIONS);
+    _t_add(until,__r_make_timestamp(TIMEOUT_AT,5));
+    pattern = _t_new_root(PATTERN);
+    _sl(pattern,TEST_INT_SYMBOL);
+    _r_add_expectation(r,DEFAULT_ASPECT,TESTING,pattern,_t_news(0,ACTION,NULL_PROCESS),0,until,NULL,NULL);
+    _r_remove_expectation(r,_t_child(es,2));
+    spec_is_equal(HASH_COUNT(r->timeouts),0);
+    spec_is_equal(w->count,1);
+    _tw_advance(w,start+5500*NS_PER_MS);
+    spec_is_ptr_equal(r->expired,NULL);
+    spec_is_equal(w->count,0);
+    spec_is_equal(_t_children(es),1);
+
+    // freeing a receptor unschedules anything it still has outstanding
+    until = _t_new_root(END_CONDITIONS);
+    _t_add(until,__r_make_timestamp(TIMEOUT_AT,10));
+    pattern = _t_new_root(PATTERN);
+    _sl(pattern,TEST_INT_SYMBOL);
+    _r_add_expectation(r,DEFAULT_ASPECT,TESTING,pattern,_t_news(0,ACTION,NULL_PROCESS),0,until,NULL,NULL);
+    spec_is_equal(w->count,1);
+    _r_free(r);
+    spec_is_equal(w->count,0);
+    _tw_free(w);
+    //! [testReceptorTimeouts]
+}
+
 void testReceptorExpectation() {
     //! [testReceptorExpectation]
     Receptor *r = _r_new(G_sem,TEST_RECEPTOR);
@@ -748,7 +895,7 @@ void testReceptorEdgeListener() {
     T *code = _t_parse(r->sem,0,"(CONVERSE (SCOPE (LISTEN (ASPECT_IDENT:DEFAULT_ASPECT) (CARRIER:LINE) (PATTERN (SEMTREX_SYMBOL_ANY)) (ACTION:echo2stream) (PARAMS (PARAM_REF:/2/1) (SLOT (USAGE:NULL_SYMBOL)))) (ITERATE (PARAMS) (STREAM_ALIVE (PARAM_REF:/2/1)) (SAY % (ASPECT_IDENT:DEFAULT_ASPECT) (CARRIER:LINE) (STREAM_READ (PARAM_REF:/2/1) (RESULT_SYMBOL:LINE)))) (STREAM_CLOSE (PARAM_REF:/2/1))) (BOOLEAN:1))",__r_make_addr(0,TO_ADDRESS,r->addr));
     T *err_handler = _t_parse(r->sem,0,"(CONTINUE (POP_PATH (PARAM_REF:/4/1/1) (RESULT_SYMBOL:CONTINUE_LOCATION) (POP_COUNT:2)) (CONTINUE_VALUE (BOOLEAN:0)))");
     // listen and then send the received LINE directly back to your self.  Acts like "echo."
-    SocketListener *l = _r_addListener(r,8888,code,0,err_handler,DELIM_LF);
+    SocketListener *l = _r_addListener(r,8888,code,0,err_handler,DELIM_LF,0);
     _v_activate(v,edge);
 
     //@todo currently we don't actually have a real symbol for the EDGE_SPEC and we're just using PARAMS.  FIXME!
@@ -874,6 +1021,7 @@ void testReceptor() {
     testReceptorDeliverConversation();
     testReceptorConversations();
     testReceptorEndCondition();
+    testReceptorTimeouts();
     testReceptorExpectation();
     testReceptorDef();
     testReceptorDefMatch();
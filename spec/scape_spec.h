@@ -20,20 +20,24 @@ void testScapeNew() {
 void testScapeAddElement() {
     //! [testScapeAddElement]
     Scape *s = _s_new(TEST_INT_SYMBOL,TEST_STR_SYMBOL);
+    s->sem = G_sem;
     Xaddr x = {1,3};  // DUMMY XADDR
     T *t = _t_newi(0,TEST_INT_SYMBOL,31415);
-    TreeHash h = _t_hash(G_sem,t);
-    _s_add(s,h,x);
+    spec_is_true(_s_add(s,t,x));
 
     // check that element was added
-    Xaddr xg = _s_get(s,h);
+    Xaddr xg = _s_get(s,t);
     spec_is_sem_equal(xg.symbol,x.symbol);
     spec_is_equal(xg.addr,x.addr);
 
-    // check that a different hash returns the null xaddr
+    // only one element per key unless the scape is multi-valued
+    Xaddr x2 = {TEST_STR_SYMBOL,4};
+    spec_is_false(_s_add(s,t,x2));
+    spec_is_xaddr_equal(G_sem,_s_get(s,t),x);
+
+    // check that a different key returns the null xaddr
     t->contents.symbol = TEST_INT_SYMBOL2;
-    h = _t_hash(G_sem,t);
-    xg = _s_get(s,h);
+    xg = _s_get(s,t);
     spec_is_true(is_null_xaddr(xg));
 
     _s_free(s);
@@ -41,7 +45,277 @@ void testScapeAddElement() {
     //! [testScapeAddElement]
 }
 
+// find two integers whose TEST_INT_SYMBOL trees have the same hash
+int __testScapeHashCmp(const void *a,const void *b) {
+    TreeHash ha = ((TreeHash *)a)[0],hb = ((TreeHash *)b)[0];
+    return ha < hb ? -1 : ha > hb;
+}
+void _testScapeCollision(int *a,int *b) {
+    int i,n = 300000;
+    TreeHash *h = malloc(sizeof(TreeHash)*2*n);
+    T *t = _t_newi(0,TEST_INT_SYMBOL,0);
+    for(i=0;i<n;i++) {
+        *(int *)_t_surface(t) = i;
+        h[i*2] = _t_hash(G_sem,t);
+        h[i*2+1] = i;
+    }
+    _t_free(t);
+    qsort(h,n,sizeof(TreeHash)*2,__testScapeHashCmp);
+    for(i=1;i<n && h[i*2] != h[i*2-2];i++);
+    if (i == n) raise_error("no collision found");
+    *a = h[i*2-1];
+    *b = h[i*2+1];
+    free(h);
+}
+
+void testScapeIndex() {
+    //! [testScapeIndex]
+    Scape *s = __s_new(TEST_INT_SYMBOL,TEST_ANYTHING_SYMBOL,NULL,true,false);
+    s->sem = G_sem;
+    T *t1 = _t_newr(0,TEST_ANYTHING_SYMBOL);
+    _t_new_str(t1,TEST_NAME_SYMBOL,"fred");
+    _t_newi(t1,TEST_INT_SYMBOL,42);
+    T *t2 = _t_newr(0,TEST_ANYTHING_SYMBOL);
+    _t_new_str(t2,TEST_NAME_SYMBOL,"jane");
+    _t_newi(t2,TEST_INT_SYMBOL,42);
+    T *t3 = _t_newr(0,TEST_ANYTHING_SYMBOL);
+    _t_new_str(t3,TEST_NAME_SYMBOL,"joe");
+    Xaddr x1 = {TEST_ANYTHING_SYMBOL,1},x2 = {TEST_ANYTHING_SYMBOL,2},x3 = {TEST_ANYTHING_SYMBOL,3};
+
+    // the key is found by symbol anywhere in the instance
+    spec_is_str_equal(t2s(_s_key(s,t1)),"(TEST_INT_SYMBOL:42)");
+    spec_is_ptr_equal(_s_key(s,t3),NULL);
+
+    // a multi-valued scape keeps all the instances with the same key
+    _s_index(s,t1,x1);
+    _s_index(s,t2,x2);
+    _s_index(s,t3,x3);  // no key, so not scaped
+    T *k = _t_newi(0,TEST_INT_SYMBOL,42);
+    int count;
+    Xaddr *xs = _s_get_all(s,k,&count);
+    spec_is_equal(count,2);
+    spec_is_equal(xs[0].addr,1);
+    spec_is_equal(xs[1].addr,2);
+    spec_is_equal(HASH_COUNT(s->data),1);
+
+    _s_unindex(s,t1,x1);
+    xs = _s_get_all(s,k,&count);
+    spec_is_equal(count,1);
+    spec_is_equal(xs[0].addr,2);
+
+    // removing the last value removes the key
+    _s_remove(s,k,x2);
+    spec_is_ptr_equal(_s_get_all(s,k,&count),NULL);
+    spec_is_equal(count,0);
+    spec_is_equal(HASH_COUNT(s->data),0);
+    _s_free(s);
+
+    // the key can also be given by path, in which case it's only looked for there
+    int path[] = {1,TREE_PATH_TERMINATOR};
+    s = __s_new(TEST_NAME_SYMBOL,TEST_ANYTHING_SYMBOL,path,false,false);
+    s->sem = G_sem;
+    spec_is_str_equal(t2s(_s_key(s,t1)),"(TEST_NAME_SYMBOL:fred)");
+    s->key_source = TEST_INT_SYMBOL;
+    spec_is_ptr_equal(_s_key(s,t1),NULL);
+    s->key_source = TEST_NAME_SYMBOL;
+
+    _s_index(s,t1,x1);
+    _s_index(s,t2,x2);
+    spec_is_equal(HASH_COUNT(s->data),2);
+    spec_is_equal(_s_get(s,_t_child(t2,1)).addr,2);
+
+    // a scape that isn't multi-valued won't index a second instance with a key it has
+    T *t4 = _t_newr(0,TEST_ANYTHING_SYMBOL);
+    _t_new_str(t4,TEST_NAME_SYMBOL,"fred");
+    Xaddr x4 = {TEST_ANYTHING_SYMBOL,4};
+    spec_is_false(_s_can_index(s,t4,x4));
+    spec_is_true(_s_can_index(s,t4,x1));
+    spec_is_true(_s_can_index(s,t3,x4));
+    spec_is_false(_s_index(s,t4,x4));
+    spec_is_equal(_s_get(s,_t_child(t4,1)).addr,1);
+    _t_free(t4);
+
+    _s_free(s);
+
+    // keys whose hashes collide are still kept apart
+    int a,b;
+    _testScapeCollision(&a,&b);
+    T *ka = _t_newi(0,TEST_INT_SYMBOL,a);
+    T *kb = _t_newi(0,TEST_INT_SYMBOL,b);
+    spec_is_true(_t_hash(G_sem,ka) == _t_hash(G_sem,kb));
+    s = __s_new(TEST_INT_SYMBOL,TEST_INT_SYMBOL,NULL,false,false);
+    s->sem = G_sem;
+    spec_is_true(_s_add(s,ka,x1));
+    spec_is_true(_s_add(s,kb,x2));
+    spec_is_equal(HASH_COUNT(s->data),1);
+    spec_is_equal(_s_get(s,ka).addr,1);
+    spec_is_equal(_s_get(s,kb).addr,2);
+    _s_remove(s,ka,x1);
+    spec_is_true(is_null_xaddr(_s_get(s,ka)));
+    spec_is_equal(_s_get(s,kb).addr,2);
+    _s_free(s);
+    _t_free(ka);_t_free(kb);
+    _t_free(k);_t_free(t1);_t_free(t2);_t_free(t3);
+    //! [testScapeIndex]
+}
+
+// build a QUERY_RESULTS string of just the addrs of the results
+char *__scape_addrs(T *t,char *buf) {
+    char *b = buf;
+    *b = 0;
+    DO_KIDS(t,b += sprintf(b,"%s%d",i>1?",":"",((Xaddr *)_t_surface(_t_child(t,i)))->addr));
+    _t_free(t);
+    return buf;
+}
+
+void testScapeOrdered() {
+    //! [testScapeOrdered]
+    char buf[1000];
+    Scape *s = __s_new(TEST_INT_SYMBOL,TEST_ANYTHING_SYMBOL,NULL,true,true);
+    s->sem = G_sem;
+    int ages[] = {35,22,40,35,31,60,29,35,40,18};
+    int j;
+    T *t[10];
+    for(j=0;j<10;j++) {
+        t[j] = _t_newr(0,TEST_ANYTHING_SYMBOL);
+        _t_newi(t[j],TEST_INT_SYMBOL,ages[j]);
+        Xaddr x = {TEST_ANYTHING_SYMBOL,j+1};
+        _s_index(s,t[j],x);
+    }
+
+    // iterating from the start goes in key order (and address order for the same key)
+    ScapeNode *n;
+    char *b = buf;
+    for(n=_s_seek(s,NULL);n;n=n->next[0]) b += sprintf(b,"%d:%d ",*(int *)_t_surface(n->key),n->value.addr);
+    spec_is_str_equal(buf,"18:10 22:2 29:7 31:5 35:1 35:4 35:8 40:3 40:9 60:6 ");
+
+    T *from = _t_newi(0,TEST_INT_SYMBOL,30);
+    T *to = _t_newi(0,TEST_INT_SYMBOL,40);
+    spec_is_str_equal(__scape_addrs(_s_range(s,from,to),buf),"5,1,4,8,3,9");
+    spec_is_str_equal(__scape_addrs(_s_range(s,NULL,from),buf),"10,2,7");
+    spec_is_str_equal(__scape_addrs(_s_range(s,to,NULL),buf),"3,9,6");
+    spec_is_str_equal(t2s(_s_seek(s,from)->key),"(TEST_INT_SYMBOL:31)");
+    *(int *)_t_surface(from) = 61;
+    spec_is_ptr_equal(_s_seek(s,from),NULL);
+
+    // unindexing removes just that instance
+    Xaddr x4 = {TEST_ANYTHING_SYMBOL,4};
+    _s_unindex(s,t[3],x4);
+    spec_is_str_equal(__scape_addrs(_s_range(s,to,NULL),buf),"3,9,6");
+    *(int *)_t_surface(to) = 35;
+    spec_is_str_equal(__scape_addrs(_s_range(s,to,to),buf),"1,8");
+
+    // the definition of the scape can be saved and used to make a new one
+    T *spec = _s_spec(0,s);
+    spec_is_str_equal(t2s(spec),"(SCAPE_SPEC (SCAPE_KEY_SOURCE:TEST_INT_SYMBOL) (SCAPE_DATA_SOURCE:TEST_ANYTHING_SYMBOL) (SCAPE_MULTI:1) (SCAPE_ORDERED:1))");
+    Scape *s2 = _s_new_from_spec(spec);
+    spec_is_true(s2->multi);
+    spec_is_true(s2->order != NULL);
+    spec_is_ptr_equal(s2->key_path,NULL);
+    _s_free(s2);
+    _t_free(spec);
+
+    _s_free(s);
+    for(j=0;j<10;j++) _t_free(t[j]);
+    _t_free(from);_t_free(to);
+
+    // prefix scans on strings
+    int path[] = {1,TREE_PATH_TERMINATOR};
+    s = __s_new(TEST_NAME_SYMBOL,TEST_ANYTHING_SYMBOL,path,false,true);
+    s->sem = G_sem;
+    char *names[] = {"joe","mary","jo","fred","joanne","jim"};
+    for(j=0;j<6;j++) {
+        t[j] = _t_newr(0,TEST_ANYTHING_SYMBOL);
+        _t_new_str(t[j],TEST_NAME_SYMBOL,names[j]);
+        Xaddr x = {TEST_ANYTHING_SYMBOL,j+1};
+        _s_index(s,t[j],x);
+    }
+    T *p = _t_new_str(0,TEST_NAME_SYMBOL,"jo");
+    spec_is_str_equal(__scape_addrs(_s_prefix(s,p),buf),"3,5,1");
+    _t_free(p);
+    p = _t_new_str(0,TEST_NAME_SYMBOL,"j");
+    spec_is_str_equal(__scape_addrs(_s_prefix(s,p),buf),"6,3,5,1");
+    _t_free(p);
+    p = _t_new_str(0,TEST_NAME_SYMBOL,"z");
+    spec_is_str_equal(__scape_addrs(_s_prefix(s,p),buf),"");
+    _t_free(p);
+    spec = _s_spec(0,s);
+    spec_is_str_equal(t2s(spec),"(SCAPE_SPEC (SCAPE_KEY_SOURCE:TEST_NAME_SYMBOL) (SCAPE_DATA_SOURCE:TEST_ANYTHING_SYMBOL) (SCAPE_MULTI:0) (SCAPE_ORDERED:1) (SCAPE_KEY_PATH:/1))");
+    s2 = _s_new_from_spec(spec);
+    spec_is_equal(s2->key_path[0],1);
+    spec_is_equal(s2->key_path[1],TREE_PATH_TERMINATOR);
+    _s_free(s2);
+    _t_free(spec);
+    _s_free(s);
+    for(j=0;j<6;j++) _t_free(t[j]);
+
+    // keys with children are compared child by child, and prefixes are leading children
+    s = __s_new(TODAY,TEST_ANYTHING_SYMBOL,NULL,true,true);
+    s->sem = G_sem;
+    int dates[][3] = {{2016,3,1},{2015,12,31},{2016,1,15},{2016,3,2},{2017,1,1}};
+    for(j=0;j<5;j++) {
+        t[j] = _t_newr(0,TEST_ANYTHING_SYMBOL);
+        T *d = _t_newr(t[j],TODAY);
+        _t_newi(d,YEAR,dates[j][0]);
+        _t_newi(d,MONTH,dates[j][1]);
+        _t_newi(d,DAY,dates[j][2]);
+        Xaddr x = {TEST_ANYTHING_SYMBOL,j+1};
+        _s_index(s,t[j],x);
+    }
+    spec_is_str_equal(__scape_addrs(_s_range(s,NULL,NULL),buf),"2,3,1,4,5");
+    p = _t_newr(0,TODAY);
+    _t_newi(p,YEAR,2016);
+    spec_is_str_equal(__scape_addrs(_s_prefix(s,p),buf),"3,1,4");
+    _t_newi(p,MONTH,3);
+    spec_is_str_equal(__scape_addrs(_s_prefix(s,p),buf),"1,4");
+    spec_is_true(_s_cmp(G_sem,p,_t_child(t[0],1)) < 0);
+    spec_is_equal(_s_cmp(G_sem,_t_child(t[0],1),_t_child(t[0],1)),0);
+    _t_free(p);
+    _s_free(s);
+    for(j=0;j<5;j++) _t_free(t[j]);
+    //! [testScapeOrdered]
+}
+
+void testScapeOrderedMany() {
+    // enough keys to use a bunch of the skiplist's levels
+    Scape *s = __s_new(TEST_INT_SYMBOL,TEST_ANYTHING_SYMBOL,NULL,true,true);
+    s->sem = G_sem;
+    int j,n = 10000;
+    T *k = _t_newi(0,TEST_INT_SYMBOL,0);
+    Xaddr x = {TEST_ANYTHING_SYMBOL,0};
+    for(j=0;j<n;j++) {
+        *(int *)_t_surface(k) = (j*7919)%n;
+        x.addr = j+1;
+        __s_order_add(s,k,x);
+    }
+    spec_is_true(s->levels > 3);
+    // remove the odd keys
+    for(j=0;j<n;j++) {
+        *(int *)_t_surface(k) = (j*7919)%n;
+        x.addr = j+1;
+        if ((j*7919)%n & 1) __s_order_remove(s,k,x);
+    }
+    ScapeNode *sn;
+    int count = 0,last = -1;
+    bool ordered = true;
+    for(sn=_s_seek(s,NULL);sn;sn=sn->next[0]) {
+        int v = *(int *)_t_surface(sn->key);
+        if (v <= last || v & 1) ordered = false;
+        last = v;
+        count++;
+    }
+    spec_is_true(ordered);
+    spec_is_equal(count,n/2);
+    *(int *)_t_surface(k) = 5001;
+    spec_is_equal(*(int *)_t_surface(_s_seek(s,k)->key),5002);
+    _t_free(k);
+    _s_free(s);
+}
+
 void testScape() {
     testScapeNew();
     testScapeAddElement();
+    testScapeIndex();
+    testScapeOrdered();
+    testScapeOrderedMany();
 }
@@ -16,6 +16,14 @@ void testSemTableCreate() {
     spec_is_equal(sem->contexts,1);
     Symbol s = {SYS_CONTEXT,0,0};
     spec_is_long_equal((long)_sem_context(sem,s)->definitions,1234L);
+
+    // the table grows as needed without moving the contexts already in it
+    ContextStore *ctx = _sem_context(sem,s);
+    int i;
+    for(i=1;i<200;i++) _sem_new_context(sem,(T *)(1234L+i));
+    spec_is_equal(sem->contexts,200);
+    spec_is_ptr_equal(_sem_context(sem,s),ctx);
+    spec_is_long_equal((long)__sem_context(sem,199)->definitions,1234L+199);
     _sem_free(sem);
     //! [testSemTableCreate]
 }
@@ -44,6 +52,26 @@ void testSemGetSymbolStructure() {
     spec_is_structure_equal(0,_sem_get_symbol_structure(G_sem,STRUCTURE_DEFINITION),TUPLE_OF_STRUCTURE_LABEL_AND_STRUCTURE_DEF);
     spec_is_structure_equal(0,_sem_get_symbol_structure(G_sem,STRUCTURE_SYMBOL),SYMBOL);
 
+    // symbols get cached the first time they're looked up, along with their sizes
+    ContextStore *ctx = _sem_context(G_sem,TEST_INT_SYMBOL);
+    spec_is_structure_equal(0,_sem_get_symbol_structure(G_sem,TEST_INT_SYMBOL),INTEGER);
+    spec_is_structure_equal(0,ctx->symbols[TEST_INT_SYMBOL.id].structure,INTEGER);
+    spec_is_equal(_sem_get_symbol_size(G_sem,TEST_INT_SYMBOL),sizeof(int));
+    spec_is_equal(_sem_get_symbol_size(G_sem,TEST_STR_SYMBOL),SYMBOL_SIZE_VARIABLE);
+
+    // including symbols declared without a structure, once it's been set
+    T *d = __r_make_definitions();
+    int c = _sem_new_context(G_sem,d);
+    Symbol s = _d_define_symbol(G_sem,NULL_STRUCTURE,"street number",c);
+    spec_is_structure_equal(0,_sem_get_symbol_structure(G_sem,s),NULL_STRUCTURE);
+    spec_is_equal(_sem_get_symbol_size(G_sem,s),SYMBOL_SIZE_VARIABLE);
+    __d_set_symbol_structure(__sem_get_defs(G_sem,SEM_TYPE_SYMBOL,c),s,INTEGER);
+    spec_is_structure_equal(0,_sem_get_symbol_structure(G_sem,s),INTEGER);
+    spec_is_equal(_sem_get_symbol_size(G_sem,s),sizeof(int));
+    _sem_free_context(G_sem,c);
+    spec_is_ptr_equal(_sem_context(G_sem,s)->symbols,NULL);
+    _t_free(d);
+
     //! [testSemGetSymbolStructure]
 }
 
@@ -61,6 +89,35 @@ void testSemGetByLabel() {
 
     spec_is_false(_sem_get_by_label(G_sem,"non existent symbol",&s));
 
+    // lookups can be limited to a semantic type
+    spec_is_true(_sem_get_by_label_of_type(G_sem,"OCTET_STREAM",&s,SEM_TYPE_SYMBOL));
+    spec_is_sem_equal(s,OCTET_STREAM);
+    spec_is_false(_sem_get_by_label_of_type(G_sem,"OCTET_STREAM",&s,SEM_TYPE_PROCESS));
+    spec_is_true(_sem_get_by_label_of_type(G_sem,"INTEGER",&s,SEM_TYPE_STRUCTURE));
+    spec_is_sem_equal(s,INTEGER);
+
+    // new definitions can be looked up as soon as they are defined
+    T *d = __r_make_definitions();
+    int ctx = _sem_new_context(G_sem,d);
+    spec_is_false(_sem_get_by_label(G_sem,"shoe size",&s));
+    Symbol ss = _d_define_symbol(G_sem,INTEGER,"shoe size",ctx);
+    spec_is_true(__sem_get_by_label(G_sem,"shoe size",&s,ctx));
+    spec_is_sem_equal(s,ss);
+    spec_is_true(_sem_get_by_label(G_sem,"shoe size",&s));
+    spec_is_sem_equal(s,ss);
+
+    // labels that are also defined in an earlier context are found there first
+    Symbol si = _d_define_symbol(G_sem,INTEGER,"INTEGER",ctx);
+    spec_is_true(_sem_get_by_label_of_type(G_sem,"INTEGER",&s,SEM_TYPE_SYMBOL));
+    spec_is_sem_equal(s,si);
+    spec_is_true(_sem_get_by_label(G_sem,"INTEGER",&s));
+    spec_is_sem_equal(s,INTEGER);
+
+    // and can't be once their context is gone
+    _sem_free_context(G_sem,ctx);
+    _t_free(d);
+    spec_is_false(_sem_get_by_label(G_sem,"shoe size",&s));
+
     //! [testSemGetByLabel]
 }
 
@@ -71,6 +128,78 @@ void testSemAddLabel() {
     //! [testSemAddLabel]
 }
 
+typedef struct {
+    SemTable *sem;
+    Context c;
+    bool done;
+    int seen;
+    int errors;
+} _testSemReaderState;
+
+// look up all the symbols of a context over and over while they're being defined
+void *_testSemReader(void *arg) {
+    _testSemReaderState *st = arg;
+    SemReader r;
+    _sem_reader_online(st->sem,&r);
+    while (!__atomic_load_n(&st->done,__ATOMIC_ACQUIRE)) {
+        T *defs = __sem_get_defs(st->sem,SEM_TYPE_SYMBOL,st->c);
+        int i,n = _t_children(defs);
+        for(i=1;i<=n;i++) {
+            Symbol s = {st->c,SEM_TYPE_SYMBOL,i};
+            if (!semeq(_sem_get_symbol_structure(st->sem,s),INTEGER)) st->errors++;
+            if (_sem_get_name(st->sem,s)[0] != 's') st->errors++;
+        }
+        __atomic_store_n(&st->seen,n,__ATOMIC_RELEASE);
+        _sem_quiescent(st->sem,&r);
+    }
+    _sem_reader_offline(st->sem,&r);
+    return NULL;
+}
+
+void testSemConcurrentReaders() {
+    //! [testSemConcurrentReaders]
+    T *d = __r_make_definitions();
+    int ctx = _sem_new_context(G_sem,d);
+    char label[20];
+    int i;
+
+    // definitions can be added while another thread reads them
+    _testSemReaderState st = {G_sem,ctx,false,0,0};
+    pthread_t t;
+    pthread_create(&t,0,_testSemReader,&st);
+    for(i=1;i<=300;i++) {
+        sprintf(label,"s%d",i);
+        _d_define_symbol(G_sem,INTEGER,label,ctx);
+    }
+    // give the reader a chance to look at all of them
+    for(i=0;i<200 && __atomic_load_n(&st.seen,__ATOMIC_ACQUIRE) < 300;i++) sleepms(10);
+    __atomic_store_n(&st.done,true,__ATOMIC_RELEASE);
+    pthread_join(t,NULL);
+    spec_is_equal(st.errors,0);
+    spec_is_equal(st.seen,300);
+    spec_is_equal(_t_children(__sem_get_defs(G_sem,SEM_TYPE_SYMBOL,ctx)),300);
+    Symbol s;
+    spec_is_true(__sem_get_by_label(G_sem,"s300",&s,ctx));
+    spec_is_equal(s.id,300);
+
+    // memory replaced while a reader is registered is kept until the reader is quiescent
+    SemReader r;
+    _sem_reader_online(G_sem,&r);
+    // (enough definitions to fill the symbol defs' child array, so it has to be replaced)
+    for(i=301;i<=330;i++) {
+        sprintf(label,"s%d",i);
+        _d_define_symbol(G_sem,INTEGER,label,ctx);
+    }
+    spec_is_true(G_sem->retired != NULL);
+    _sem_quiescent(G_sem,&r);
+    spec_is_ptr_equal(G_sem->retired,NULL);
+    _sem_reader_offline(G_sem,&r);
+
+    _sem_free_context(G_sem,ctx);
+    _t_free(d);
+    //! [testSemConcurrentReaders]
+}
+
 void testSemTable() {
     testSemTableCreate();
     testSemTableGetName();
@@ -78,4 +207,5 @@ void testSemTable() {
     testSemGetSymbolStructure();
     testSemGetByLabel();
     testSemAddLabel();
+    testSemConcurrentReaders();
 }
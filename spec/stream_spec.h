@@ -6,6 +6,7 @@
 
 #include "../src/ceptr.h"
 #include "../src/stream.h"
+#include "../src/http.h"
 #include <unistd.h>
 #include <errno.h>
 
@@ -116,6 +117,147 @@ void testStreamScan() {
 
 }
 
+void testStreamScanHTTP() {
+    //! [testStreamScanHTTP]
+    Stream * s = __st_alloc_stream();
+    s->type = 99;       // typed doesn't matter, just testing scan.
+    s->buf_size = 1000;
+    s->flags |= StreamUnitHTTP;
+    s->delim = DELIM_CRLF;
+    s->delim_len = 2;
+
+    // a request with only part of its headers is a partial unit
+    char *reqs = "GET /a HTTP/1.1\r\nHost: x\r\n\r\nPOST /b HTTP/1.1\r\nContent-Length: 5\r\n\r\nhelloPUT /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n";
+    s->buf = reqs;
+    s->bytes_used = 20;
+    __st_init_scan(s);
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanPartial);
+
+    // pipelined requests are scanned as consecutive units
+    s->bytes_used = strlen(reqs);
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanSuccess);
+    spec_is_equal(s->unit_start,0);
+    spec_is_equal(s->unit_size,28);
+
+    // with the body given by the Content-Length
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanSuccess);
+    spec_is_buffer_equal(_st_data(s),"POST /b HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello",_st_data_size(s));
+
+    // or by the chunked encoding
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanSuccess);
+    spec_is_buffer_equal(_st_data(s),"PUT /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n",_st_data_size(s));
+
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanComplete);
+
+    // a body that hasn't fully arrived is partial
+    s->buf = "POST /b HTTP/1.1\r\nContent-Length: 5\r\n\r\nhel";
+    s->bytes_used = strlen(s->buf);
+    __st_init_scan(s);
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanPartial);
+    s->buf = "POST /b HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello";
+    s->bytes_used = strlen(s->buf);
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanSuccess);
+    spec_is_equal(s->unit_size,s->bytes_used);
+
+    // a body size that isn't a number fails the request, and ends the stream because
+    // nothing after it can be framed
+    s->buf = "POST /b HTTP/1.1\r\nContent-Length: -1\r\n\r\nhelloGET /a HTTP/1.1\r\n\r\n";
+    s->bytes_used = strlen(s->buf);
+    __st_init_scan(s);
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanSuccess);
+    spec_is_true(s->flags & StreamUnitBad);
+    spec_is_buffer_equal(_st_data(s),"POST /b HTTP/1.1\r\nContent-Length: -1\r\n\r\n",_st_data_size(s));
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanComplete);
+
+    // as does one that's too big
+    s->flags &= ~StreamUnitBad;
+    s->buf = "POST /b HTTP/1.1\r\nContent-Length: 18446744073709551615\r\n\r\nhello";
+    s->bytes_used = strlen(s->buf);
+    __st_init_scan(s);
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanSuccess);
+    spec_is_true(s->flags & StreamUnitBad);
+
+    // or a bad chunk size
+    s->flags &= ~StreamUnitBad;
+    s->buf = "PUT /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n-1\r\nabc\r\n0\r\n\r\n";
+    s->bytes_used = strlen(s->buf);
+    __st_init_scan(s);
+    __st_scan(s);
+    spec_is_equal(s->scan_state,StreamScanSuccess);
+    spec_is_true(s->flags & StreamUnitBad);
+    //! [testStreamScanHTTP]
+
+    _st_free(s);
+}
+
+void testStreamReadHTTP() {
+    FILE *input;
+
+    // use a tiny buffer so the requests arrive over many partial loads
+    char data[] = "GET /a HTTP/1.1\r\nHost: x\r\n\r\nPOST /b HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello";
+    input = fmemopen(data, strlen(data), "r");
+    Stream *s = __st_new_unix_stream(input,4);
+    s->flags |= StreamUnitHTTP;
+
+    _st_start_read(s);
+    while(!(s->flags&StreamHasData) && _st_is_alive(s)) {sleepms(1);};
+    spec_is_buffer_equal(_st_data(s),"GET /a HTTP/1.1\r\nHost: x\r\n\r\n",_st_data_size(s));
+    _st_data_consumed(s);
+
+    _st_start_read(s);
+    while(!(s->flags&StreamHasData) && _st_is_alive(s)) {sleepms(1);};
+    spec_is_buffer_equal(_st_data(s),"POST /b HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello",_st_data_size(s));
+    _st_data_consumed(s);
+
+    _st_start_read(s);
+    while(!(s->flags&StreamHasData) && _st_is_alive(s) ) {sleepms(1);};
+    spec_is_false(s->flags&StreamHasData);
+    spec_is_false(_st_is_alive(s));
+
+    void *status;
+    int rc = pthread_join(s->pthread, &status);
+    if (rc) {
+        raise_error("ERROR; return code from pthread_join() is %d\n", rc);
+    }
+    _st_free(s);
+}
+
+void testHTTPParseRequest() {
+    //! [testHTTPParseRequest]
+    char *req = "GET /path/to/file.ext?name=joe&age=30 HTTP/1.1\r\nHost: ceptr.org\r\nAccept: */*\r\n\r\n";
+    T *t = _http_parse_request(req,strlen(req));
+    spec_is_str_equal(t2s(t),"(HTTP_REQUEST (HTTP_REQUEST_METHOD:GET) (HTTP_REQUEST_PATH (HTTP_REQUEST_PATH_SEGMENTS (HTTP_REQUEST_PATH_SEGMENT:path) (HTTP_REQUEST_PATH_SEGMENT:to) (HTTP_REQUEST_PATH_SEGMENT:file.ext))) (HTTP_REQUEST_PATH_QUERY (HTTP_REQUEST_PATH_QUERY_PARAMS (HTTP_REQUEST_PATH_QUERY_PARAM (PARAM_KEY:name) (PARAM_VALUE:joe)) (HTTP_REQUEST_PATH_QUERY_PARAM (PARAM_KEY:age) (PARAM_VALUE:30)))) (HTTP_REQUEST_VERSION (VERSION_MAJOR:1) (VERSION_MINOR:1)) (HTTP_REQUEST_HEADERS (HTTP_REQUEST_HOST:ceptr.org) (HTTP_GENERAL_HEADER (HEADER_KEY:Accept) (HEADER_VALUE:*/*))))");
+    _t_free(t);
+
+    req = "POST /x HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello";
+    t = _http_parse_request(req,strlen(req));
+    spec_is_str_equal(t2s(t),"(HTTP_REQUEST (HTTP_REQUEST_METHOD:POST) (HTTP_REQUEST_PATH (HTTP_REQUEST_PATH_SEGMENTS (HTTP_REQUEST_PATH_SEGMENT:x))) (HTTP_REQUEST_VERSION (VERSION_MAJOR:1) (VERSION_MINOR:1)) (HTTP_REQUEST_HEADERS (HTTP_GENERAL_HEADER (HEADER_KEY:Content-Length) (HEADER_VALUE:5))) (HTTP_REQUEST_BODY (OCTET_STREAM:hello)))");
+    _t_free(t);
+
+    // chunked bodies get de-chunked
+    req = "POST /x HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n2\r\nde\r\n0\r\n\r\n";
+    t = _http_parse_request(req,strlen(req));
+    spec_is_str_equal(t2s(_t_child(t,5)),"(HTTP_REQUEST_BODY (OCTET_STREAM:abcde))");
+    _t_free(t);
+
+    // malformed requests return NULL
+    req = "GET nopath HTTP/1.1\r\n\r\n";
+    spec_is_ptr_equal(_http_parse_request(req,strlen(req)),NULL);
+    req = "GET /x HTTZ/1.1\r\n\r\n";
+    spec_is_ptr_equal(_http_parse_request(req,strlen(req)),NULL);
+    //! [testHTTPParseRequest]
+}
+
 void testStreamFileLoad() {
     FILE *input;
     //debug_enable(D_STREAM);
@@ -301,7 +443,7 @@ void testStreamSocket() {
     //    debug_enable(D_SOCKET+D_STREAM);
 
     int arg = 31415;
-    SocketListener *l = _st_new_socket_listener(8888,testSocketListernCallback,&arg,DELIM_LF);
+    SocketListener *l = _st_new_socket_listener(8888,testSocketListernCallback,&arg,DELIM_LF,0);
     char *result = doSys("echo 'testing!\nfish\n' | nc localhost 8888");
     spec_is_str_equal(result,"fishy");
     free(result);
@@ -319,10 +461,13 @@ void testStream() {
     testStreamCreate();
     testStreamAlive();
     testStreamScan();
+    testStreamScanHTTP();
     testStreamFileLoad();
     testStreamRead(1000);
     testStreamRead(10);
     testStreamRead(2);
+    testStreamReadHTTP();
+    testHTTPParseRequest();
     testStreamWrite();
     testStreamWriteLine();
     testStreamSocket();
@@ -155,7 +155,22 @@ void testTreeRealloc() {
 	ts[i] = _t_new(t,TEST_STR_SYMBOL,tname,3);
     }
     spec_is_str_equal((char *)_t_surface(ts[11]),"tl");
+
+    // the child array doubles as it fills, so it holds many more children than a block
+    for (i=12;i<100;i++) _t_newi(t,TEST_INT_SYMBOL,i);
+    spec_is_equal(_t_children(t),100);
+    spec_is_equal(*(int *)_t_surface(_t_child(t,100)),99);
+
+    // children can be moved wholesale onto another node
+    T *u = _t_newr(0,TEST_TREE_SYMBOL);
+    _t_newi(u,TEST_INT_SYMBOL,-1);
+    __t_append_children(u,t);
+    spec_is_equal(_t_children(t),0);
+    spec_is_equal(_t_children(u),101);
+    spec_is_str_equal((char *)_t_surface(_t_child(u,2)),"ta");
+    spec_is_ptr_equal(_t_parent(_t_child(u,101)),u);
     _t_free(t);
+    _t_free(u);
 }
 
 void testTreePathGet() {
@@ -485,6 +500,34 @@ void testTreeHash() {
     //! [testTreeHash]
 }
 
+void testTreeEqual() {
+    //! [testTreeEqual]
+    T *t = _t_parse(G_sem,0,"(PARAMS (TEST_INT_SYMBOL:1) (PARAMS (TEST_STR_SYMBOL:\"fish\")))");
+    T *c = _t_clone(t);
+    spec_is_true(_t_equal(G_sem,t,c));
+
+    // a different surface makes them unequal
+    int p[] = {1,TREE_PATH_TERMINATOR};
+    T *v = _t_get(c,p);
+    (*(int *)_t_surface(v))++;
+    spec_is_true(!_t_equal(G_sem,t,c));
+    (*(int *)_t_surface(v))--;
+    spec_is_true(_t_equal(G_sem,t,c));
+
+    // as does a string of a different length
+    T *s = _t_parse(G_sem,0,"(PARAMS (TEST_INT_SYMBOL:1) (PARAMS (TEST_STR_SYMBOL:\"fishy\")))");
+    spec_is_true(!_t_equal(G_sem,t,s));
+    _t_free(s);
+
+    // or a different shape
+    _t_newi(c,TEST_INT_SYMBOL,1);
+    spec_is_true(!_t_equal(G_sem,t,c));
+
+    _t_free(t);
+    _t_free(c);
+    //! [testTreeEqual]
+}
+
 void testUUID() {
     spec_is_long_equal(sizeof(UUIDt),16); //128 bits
     UUIDt u = __uuid_gen();
@@ -756,6 +799,7 @@ void testTree() {
     testTreeMorphLowLevel();
     testTreeDetach();
     testTreeHash();
+    testTreeEqual();
     testUUID();
     testTreeSerialize();
     testTreeJSON();
@@ -16,8 +16,8 @@ void testVMHostCreate() {
     SemTable *sem = v->r->sem;
     // test that the base contexts and defs were created
     spec_is_equal(sem->contexts,_NUM_DEFAULT_CONTEXTS);
-    spec_is_equal(_t_children(_t_child(sem->stores[0].definitions,SEM_TYPE_SYMBOL)),NUM_SYS_SYMBOLS-1);
-    spec_is_equal(_t_children(_t_child(sem->stores[0].definitions,SEM_TYPE_STRUCTURE)),NUM_SYS_STRUCTURES-1);
+    spec_is_equal(_t_children(_t_child(__sem_context(sem,0)->definitions,SEM_TYPE_SYMBOL)),NUM_SYS_SYMBOLS-1);
+    spec_is_equal(_t_children(_t_child(__sem_context(sem,0)->definitions,SEM_TYPE_STRUCTURE)),NUM_SYS_STRUCTURES-1);
 
     spec_is_str_equal(t2s(v->r->root),"(RECEPTOR_INSTANCE (INSTANCE_OF:SYS_RECEPTOR) (CONTEXT_NUM:0) (PARENT_CONTEXT_NUM:-1) (RECEPTOR_STATE (FLUX (DEFAULT_ASPECT (EXPECTATIONS) (SIGNALS))) (PENDING_SIGNALS) (PENDING_RESPONSES) (CONVERSATIONS) (RECEPTOR_ELAPSED_TIME:0)))");
 
@@ -359,6 +359,79 @@ void testVMHostShell() {
     free(output_data);
 }
 
+void testVMHostTrace() {
+    //! [testVMHostTrace]
+    G_vm = _v_new();
+    SemTable *gsem = G_sem;
+    G_sem = G_vm->sem;
+
+    _v_instantiate_builtins(G_vm);
+
+    FILE *input,*output;
+    char commands[] = "receptors\n";
+    input = fmemopen(commands, strlen(commands), "r");
+    char *output_data = NULL;
+    size_t size;
+    output = open_memstream(&output_data,&size);
+
+    Stream *output_stream, *input_stream;
+    Receptor *i_r,*o_r;
+
+    makeShell(G_vm,input,output,&i_r,&o_r,&input_stream,&output_stream);
+
+    // turning on tracing before starting traces every receptor the vmhost runs
+    _v_trace(G_vm,TRACE_BUFFER_SIZE);
+    spec_is_equal(G_vm->trace_size,TRACE_BUFFER_SIZE);
+
+    // including a sys process that hands back a run tree to be reduced in a new context
+    _p_add_native_transcoder(G_sem,YEAR,MONTH,_testTranscodeToRunTree);
+    T *n = _t_parse(G_sem,0,"(TRANSCODE (TRANSCODE_PARAMS (TRANSCODE_TO:MONTH)) (TRANSCODE_ITEMS (YEAR:12)))");
+    T *run_tree = __p_build_run_tree(n,0);
+    _t_free(n);
+    Qe *e = _p_addrt2q(i_r->q,run_tree);
+    int pid = e->id;
+    _v_start_vmhost(G_vm);
+    sleep(1);
+    __r_kill(G_vm->r);
+
+    _v_join_thread(&G_vm->clock_thread);
+    _v_join_thread(&G_vm->vm_thread);
+
+    spec_is_true(i_r->q->trace != NULL);
+    spec_is_true(_tr_count(i_r->q->trace) > 0);
+
+    // every step it began was ended, including the pushed context
+    TraceBuffer *tb = i_r->q->trace;
+    int i,depth = 0,begins = 0;
+    for(i=0;i<_tr_count(tb);i++) {
+        if (tb->events[i].id != pid) continue;
+        if (tb->events[i].type == TraceStepBegin) {depth++;begins++;}
+        else if (tb->events[i].type == TraceStepEnd) depth--;
+    }
+    spec_is_equal(begins,3);
+    spec_is_equal(depth,0);
+
+    // and dumping collects all their traces into one file
+    char *buf;
+    size_t len;
+    FILE *out = open_memstream(&buf,&len);
+    _v_dump_trace(G_vm,out);
+    fclose(out);
+    char *expected = "{\"traceEvents\":[";
+    spec_is_true(!strncmp(buf,expected,strlen(expected)));
+    spec_is_true(strstr(buf,"\"cat\":\"reduce\"") != NULL);
+    free(buf);
+    //! [testVMHostTrace]
+
+    _v_free(G_vm);
+    G_vm = NULL;
+    G_sem = gsem;
+
+    _st_free(input_stream);
+    _st_free(output_stream);
+    free(output_data);
+}
+
 void testVMHostSerialize() {
     G_vm = _v_new();
     _v_instantiate_builtins(G_vm);
@@ -383,11 +456,89 @@ void testVMHostSerialize() {
     _v_free(G_vm);
     G_vm=NULL;
 }
+int G_timer_fired;
+uint64_t G_timer_last;
+bool G_timer_in_order;
+void __test_timer(Timer *t) {
+    G_timer_fired++;
+    (*(int *)t->arg)++;
+    if (t->expires < G_timer_last) G_timer_in_order = false;
+    G_timer_last = t->expires;
+}
+
+void testTimerWheel() {
+    //! [testTimerWheel]
+    TimerWheel *w = _tw_new(NS_PER_MS);
+    uint64_t start = w->origin;
+    int once = 0,cancelled = 0,far = 0,periodic = 0;
+    Timer t1,t2,t3,t4;
+    _tw_init_timer(&t1,__test_timer,&once);
+    _tw_init_timer(&t2,__test_timer,&cancelled);
+    _tw_init_timer(&t3,__test_timer,&far);
+    _tw_init_timer(&t4,__test_timer,&periodic);
+
+    _tw_add(w,&t1,5*NS_PER_MS,0);
+    _tw_add(w,&t2,300*NS_PER_MS,0);
+    _tw_add(w,&t3,70000*NS_PER_MS,0);    // past the first two levels of the wheel
+    _tw_add(w,&t4,10*NS_PER_MS,10*NS_PER_MS);
+    spec_is_equal(w->count,4);
+    spec_is_true(_tw_scheduled(&t2));
+    _tw_cancel(w,&t2);
+    spec_is_false(_tw_scheduled(&t2));
+    spec_is_equal(w->count,3);
+
+    // nothing's due yet
+    spec_is_equal(_tw_advance(w,start),0);
+
+    // the one-shot fires once and is no longer scheduled
+    _tw_advance(w,start+50*NS_PER_MS);
+    spec_is_equal(once,1);
+    spec_is_false(_tw_scheduled(&t1));
+    spec_is_true(periodic >= 4 && periodic <= 5);
+
+    // the periodic timer keeps going, and a cancelled timer never fires
+    _tw_advance(w,start+1000*NS_PER_MS);
+    spec_is_true(periodic >= 99 && periodic <= 100);
+    spec_is_equal(cancelled,0);
+    spec_is_equal(far,0);
+
+    _tw_cancel(w,&t4);
+    spec_is_equal(w->count,1);
+    spec_is_equal(_tw_advance(w,start+71000*NS_PER_MS),1);
+    spec_is_equal(far,1);
+    spec_is_equal(once,1);
+    spec_is_equal(w->count,0);
+    _tw_free(w);
+
+    // lots of timers spread across all the levels all fire, and in order
+    w = _tw_new(NS_PER_MS);
+    start = w->origin;
+    int i,count = 0,total = 100000;
+    Timer *timers = malloc(sizeof(Timer)*total);
+    for(i=0;i<total;i++) {
+        _tw_init_timer(&timers[i],__test_timer,&count);
+        _tw_add(w,&timers[i],(uint64_t)(rand()%100000)*NS_PER_MS,0);
+    }
+    spec_is_equal(w->count,total);
+    G_timer_fired = 0;
+    G_timer_last = 0;
+    G_timer_in_order = true;
+    spec_is_equal(_tw_advance(w,start+101000*NS_PER_MS),total);
+    spec_is_equal(count,total);
+    spec_is_true(G_timer_in_order);
+    spec_is_equal(w->count,0);
+    free(timers);
+    _tw_free(w);
+    //! [testTimerWheel]
+}
+
 void testVMHost() {
     testVMHostCreate();
+    testTimerWheel();
     //testVMHostLoadReceptorPackage();
     //testVMHostInstallReceptor();
     //testVMHostActivateReceptor();
     testVMHostShell();
+    testVMHostTrace();
     //   testVMHostSerialize();
 }
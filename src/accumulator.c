@@ -14,8 +14,13 @@
 #include "receptor.h"
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "debug.h"
 #include "util.h"
+#include "wal.h"
+#include "def.h"
 
 VMHost *G_vm = 0;
 
@@ -23,18 +28,20 @@ VMHost *G_vm = 0;
 #define SEM_FN "sem"
 
 #define __a_vm_state_fn(buf,dir) __a_vm_fn(buf,dir,"state")
+#define __a_vm_log_fn(buf,dir) __a_vm_fn(buf,dir,"log")
+#define __a_vm_old_log_fn(buf,dir) __a_vm_fn(buf,dir,"log.old")
 #define __a_vmfn(buf,dir) __a_vm_fn(buf,dir,"")
 void __a_vm_fn(char *buf,char *dir,char *suffix) {
     sprintf(buf,"%s/vmhost%s.x",dir,suffix);
 }
 
-void __a_serializet(T *t,char *name) {
-    char fn[1000];
+void __a_add_file(CheckpointFile **files,char *name,void *data,size_t length);
+SymbolInstances *__a_find(Instances *instances,Symbol s);
+
+void __a_serializet(CheckpointFile **files,T *t,char *name) {
     H h =_m_new_from_t(t);
     S *s = _m_serialize(h.m);
-    __a_vm_fn(fn,G_vm->dir,name);
-    writeFile(fn,s,s->total_size);
-    free(s);
+    __a_add_file(files,name,s,s->total_size);
     _m_free(h);
 }
 
@@ -49,15 +56,403 @@ T *__a_unserializet(char *dir_path,char *name) {
     return t;
 }
 
+// find the receptor that creates a context, searching the receptor instances of r
+// (the instances of stubs only get searched, by loading them, if materialize is set)
+Receptor *__a_find_receptor(Receptor *r,Context c,bool materialize) {
+    if (r->context == c) return r;
+    if (r->image) {
+        if (!materialize) return NULL;
+        _r_materialize(r);
+    }
+    T *x = __a_get_instances(&r->instances);
+    if (!x) return NULL;
+    T *p,*t;
+    Receptor *f;
+    int i,j;
+    for(i=1;i<=_t_children(x);i++) {
+        p = _t_child(x,i);
+        if (!is_receptor(*(Symbol *)_t_surface(p))) continue;
+        for(j=1;j<=_t_children(p);j++) {
+            t = _t_child(p,j);
+            if (!semeq(_t_symbol(t),DELETED_INSTANCE) && (f = __a_find_receptor(__r_get_receptor(t),c,materialize)))
+                return f;
+        }
+    }
+    return NULL;
+}
+
+// set the log of a receptor and all the receptors in its instances
+void __a_set_wal(Receptor *r,WAL *w) {
+    r->wal = w;
+    T *x = __a_get_instances(&r->instances);
+    if (!x) return;
+    T *p,*t;
+    int i,j;
+    for(i=1;i<=_t_children(x);i++) {
+        p = _t_child(x,i);
+        if (!is_receptor(*(Symbol *)_t_surface(p))) continue;
+        for(j=1;j<=_t_children(p);j++) {
+            t = _t_child(p,j);
+            if (!semeq(_t_symbol(t),DELETED_INSTANCE)) __a_set_wal(__r_get_receptor(t),w);
+        }
+    }
+}
+
+// get a tree back out of the serialized part of a log record
+T *__a_unserialize_payload(void *payload,size_t length) {
+    // copy it out because log records aren't aligned
+    S *s = malloc(length);
+    memcpy(s,payload,length);
+    H h = _m_unserialize(s);
+    free(s);
+    T *t = _t_new_from_m(h);
+    _m_free(h);
+    return t;
+}
+
+// apply a log record on top of the vmhost's snapshot
+void __a_replay(WalRecord *rec,void *payload,void *arg) {
+    VMHost *v = arg;
+    Receptor *r = __a_find_receptor(v->r,rec->context,false);
+    if (!r) r = __a_find_receptor(v->r,rec->context,true);
+    // receptors being created and deleted are logged too, so the receptor must be there
+    if (!r) raise_error("log record %d for unknown receptor context %d",rec->type,rec->context);
+    if (rec->type == WalDefine) {
+        SemanticID sid = *(SemanticID *)payload;
+        // already in the checkpoint, i.e. replaying the log of a checkpoint that was written
+        // out but not yet cleaned up after
+        if (_t_children(__sem_get_defs(v->sem,sid.semtype,sid.context)) >= sid.id) return;
+        T *def = __a_unserialize_payload(payload+sizeof(SemanticID),rec->length-sizeof(SemanticID));
+        SemanticID n = is_receptor(sid) ?
+            __d_define_receptor(v->sem,def,rec->context) :
+            _d_define(v->sem,def,sid.semtype,rec->context);
+        if (!semeq(n,sid)) raise_error("log out of step with snapshot at definition %d.%d.%d",sid.context,sid.semtype,sid.id);
+        return;
+    }
+    _r_materialize(r);
+    Xaddr x = *(Xaddr *)payload;
+    if (rec->type == WalDeleteInstance) {
+        _a_delete_instance(&r->instances,x);
+        return;
+    }
+    void *p = payload+sizeof(Xaddr);
+    size_t length = rec->length-sizeof(Xaddr);
+    T *t;
+    if (is_receptor(x.symbol)) {
+        // logged receptors are serialized with all their instances in place, so the copy can go once it's loaded
+        void *surface = malloc(length);
+        memcpy(surface,p,length);
+        t = _t_new_receptor(0,x.symbol,__r_unserialize(v->sem,surface,NULL));
+        free(surface);
+    }
+    else t = __a_unserialize_payload(p,length);
+    __a_put_instance(&r->instances,x,t);
+}
+
+// compact the instance stores of a receptor and of all the loaded receptors in it
+void __a_compact_receptor(Receptor *r) {
+    if (r->image) return;
+    _a_compact_instances(&r->instances);
+    T *x = __a_get_instances(&r->instances);
+    if (!x) return;
+    DO_KIDS(x,
+            T *s = _t_child(x,i);
+            if (is_receptor(*(Symbol *)_t_surface(s))) {
+                T *c;
+                int j;
+                for(j=1;j<=_t_children(s);j++) {
+                    c = _t_child(s,j);
+                    if (!semeq(_t_symbol(c),DELETED_INSTANCE)) __a_compact_receptor(__r_get_receptor(c));
+                }
+            }
+            );
+}
+
+// mark all the instances of a receptor and of the loaded receptors in it as changed, so the
+// next checkpoint writes them out again after one that failed
+void __a_dirty_receptor(Receptor *r) {
+    if (r->image) return;
+    T *x = __a_get_instances(&r->instances);
+    if (!x) return;
+    DO_KIDS(x,
+            T *s = _t_child(x,i);
+            Symbol sym = *(Symbol *)_t_surface(s);
+            __a_find(&r->instances,sym)->dirty = true;
+            if (is_receptor(sym)) {
+                T *c;
+                int j;
+                for(j=1;j<=_t_children(s);j++) {
+                    c = _t_child(s,j);
+                    if (!semeq(_t_symbol(c),DELETED_INSTANCE)) __a_dirty_receptor(__r_get_receptor(c));
+                }
+            }
+            );
+}
+
+// take a copy of everything a checkpoint writes out, and start a new log for the changes after it
+// (this has to happen when nothing's being reduced, i.e. on the vmhost thread or while it's stopped)
+CheckpointFile *__a_checkpoint_cut(VMHost *v) {
+    char fn[1000];
+    CheckpointFile *files = NULL,*main = NULL,*f;
+
+    if (v->wal) {
+        __a_vm_old_log_fn(fn,v->dir);
+        _wl_rotate(v->wal,fn);
+    }
+
+    // nothing's walking the stores now, so it's a good time to reclaim deleted instances
+    __a_compact_receptor(v->r);
+    if (__atomic_exchange_n(&v->checkpoint_failed,false,__ATOMIC_ACQUIRE)) __a_dirty_receptor(v->r);
+
+    // the vmhost receptor, with the instances that have changed split out into their own files
+    void *surface;
+    size_t length;
+    __r_serialize(v->r,&surface,&length,&files);
+    __a_add_file(&main,"",surface,length);
+
+    // other parts of the vmhost
+    int i;
+    H h = _m_newr(null_H,SYS_STATE);
+    H har = _m_newr(h,ACTIVE_RECEPTORS);
+    for (i=0;i<v->active_receptor_count;i++) {
+        _m_new(har,RECEPTOR_XADDR,&v->active_receptors[i].x,sizeof(Xaddr));
+    }
+    S *s = _m_serialize(h.m);
+    _m_free(h);
+    __a_add_file(&main,"state",s,s->total_size);
+
+    T *paths = _sem_context_paths(v->sem);
+    __a_serializet(&main,paths,PATHS_FN);
+    _t_free(paths);
+
+    // the semtable
+    __a_serializet(&main,_t_root(__sem_context(v->sem,0)->definitions),SEM_FN);
+
+    // the files of instances go out first so the vmhost is the last thing to change
+    if (!files) return main;
+    for(f=files;f->next;f=f->next);
+    f->next = main;
+    return files;
+}
+
+// write a file out to a temporary file and rename it into place once it's synced
+bool __a_write_file(char *fn,CheckpointFile *f) {
+    char tmp[1010];
+    sprintf(tmp,"%s.tmp",fn);
+    int fd = open(tmp,O_WRONLY|O_CREAT|O_TRUNC,0600);
+    if (fd == -1) return false;
+    size_t done = 0;
+    while (done < f->length) {
+        ssize_t n = write(fd,f->data+done,f->length-done);
+        if (n < 0) break;
+        done += n;
+    }
+    bool ok = done == f->length && !fsync(fd);
+    if (close(fd)) ok = false;
+    if (ok && !rename(tmp,fn)) return true;
+    unlink(tmp);
+    return false;
+}
+
+// write out files to the vmhost's directory, stopping at the first one that fails
+// (the files get freed either way)
+bool __a_write_files(char *dir,CheckpointFile *files) {
+    char fn[1000];
+    CheckpointFile *f;
+    bool ok = true;
+    while((f = files)) {
+        __a_vm_fn(fn,dir,f->name);
+        if (ok && !__a_write_file(fn,f)) ok = false;
+        files = f->next;
+        free(f->name);
+        free(f->data);
+        free(f);
+    }
+    if (!ok) return false;
+    // make the renames durable
+    int d = open(dir,O_RDONLY);
+    if (d == -1) return false;
+    if (fsync(d)) ok = false;
+    close(d);
+    return ok;
+}
+
+// write out the files of a checkpoint and get rid of the log they replace, which is kept
+// for the next checkpoint if the files couldn't all be written
+bool __a_write_checkpoint(char *dir,CheckpointFile *files) {
+    char fn[1000];
+    if (!__a_write_files(dir,files)) return false;
+    __a_vm_old_log_fn(fn,dir);
+    unlink(fn);
+    return true;
+}
+
+// the vmhost thread hands the checkpoint over before starting this, and only looks at it again once checkpointing is cleared
+void *__a_checkpoint_thread(void *arg) {
+    VMHost *v = arg;
+    CheckpointFile *files = __atomic_exchange_n(&v->checkpoint,NULL,__ATOMIC_ACQUIRE);
+    if (!__a_write_checkpoint(v->dir,files)) __atomic_store_n(&v->checkpoint_failed,true,__ATOMIC_RELAXED);
+    __atomic_store_n(&v->checkpointing,false,__ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * checkpoint the vmhost without stopping it
+ *
+ * the state of the vmhost gets copied and the log rotated in one go, which must happen
+ * between reductions, i.e. from a timer or while the vmhost isn't running.  The instance
+ * stores get compacted first, and instances of symbols that haven't changed since the last
+ * checkpoint aren't copied or written again.
+ * Writing the copy out can then happen in the background while processing carries on, and
+ * the rotated log is removed once the checkpoint is on disk.  Until then a crash leaves
+ * both logs to be replayed on top of the previous checkpoint, and if the checkpoint can't
+ * be written the rotated log is kept for the next one to add to, and the next one writes
+ * out all the instances again.
+ *
+ * @param[in] background true to write the checkpoint out in its own thread
+ * @returns false if the previous checkpoint was still being written so this one was skipped
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccCheckpoint
+ */
+bool _a_checkpoint(bool background) {
+    VMHost *v = G_vm;
+    if (__atomic_load_n(&v->checkpointing,__ATOMIC_ACQUIRE)) return false;
+    _v_join_thread(&v->checkpoint_thread);
+    // keep the clock and other timers from changing anything while it's copied
+    _tw_lock(v->timers);
+    __atomic_store_n(&v->checkpointing,true,__ATOMIC_RELAXED);
+    __atomic_store_n(&v->checkpoint,__a_checkpoint_cut(v),__ATOMIC_RELEASE);
+    _tw_unlock(v->timers);
+    if (background) _v_start_thread(&v->checkpoint_thread,__a_checkpoint_thread,v);
+    else __a_checkpoint_thread(v);
+    return true;
+}
+
+// map a file into memory read only
+void *__a_map(char *file,size_t *size) {
+    int fd = open(file,O_RDONLY);
+    if (fd == -1) raise_error("Can't open input file %s!\n",file);
+    struct stat st;
+    fstat(fd,&st);
+    void *m = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (m == MAP_FAILED) raise_error("Can't map input file %s!\n",file);
+    *size = st.st_size;
+    return m;
+}
+
+// whether a receptor, and all the receptors in its instances, have nothing going on
+bool __a_idle(VMHost *v,Receptor *r) {
+    if (r->image) return true;
+    int i,j;
+    for(i=0;i<v->active_receptor_count;i++)
+        if (v->active_receptors[i].r == r) return false;
+    if (r->q && (r->q->contexts_count || r->q->completed || r->q->blocked || r->q->inbox)) return false;
+    if (_t_children(r->pending_signals) || _t_children(r->pending_responses) || _t_children(r->conversations) || r->timeouts || r->edge) return false;
+    T *x = __a_get_instances(&r->instances);
+    if (!x) return true;
+    for(i=1;i<=_t_children(x);i++) {
+        T *p = _t_child(x,i);
+        if (!is_receptor(*(Symbol *)_t_surface(p))) continue;
+        for(j=1;j<=_t_children(p);j++) {
+            T *t = _t_child(p,j);
+            if (!semeq(_t_symbol(t),DELETED_INSTANCE) && !__a_idle(v,__r_get_receptor(t))) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * put a receptor that isn't in use back on disk
+ *
+ * the receptor gets written out to a file of its own and turned back into a stub that
+ * loads it again on first use.  Like checkpointing, this has to happen between reductions.
+ *
+ * @param[in] v the vmhost
+ * @param[in] r the receptor
+ * @returns true if the receptor was evicted or already was a stub, false if it's in use or couldn't be written out
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccLazyReceptors
+ */
+bool _a_evict(VMHost *v,Receptor *r) {
+    if (r->image) return true;
+    if (r == v->r || !__a_idle(v,r)) return false;
+    char name[100],fn[1000];
+    CheckpointFile *files = NULL;
+    void *surface;
+    size_t length,size;
+    __r_serialize(r,&surface,&length,&files);
+    sprintf(name,"_r%d",r->context);
+    __a_add_file(&files,name,surface,length);
+    if (!__a_write_files(v->dir,files)) {
+        __a_dirty_receptor(r);
+        return false;
+    }
+    __a_vm_fn(fn,v->dir,name);
+    void *m = __a_map(fn,&size);
+    __r_stub(r,m,m,size,v->dir);
+    return true;
+}
+
+/**
+ * evict idle receptors while more than the vmhost's max_loaded_receptors are loaded
+ *
+ * @param[in] v the vmhost
+ * @returns the number of receptors evicted
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccLazyReceptors
+ */
+int _a_evict_idle(VMHost *v) {
+    T *x = __a_get_instances(&v->r->instances);
+    if (!x) return 0;
+    int i,j,loaded = 0,evicted = 0;
+    for(i=1;i<=_t_children(x);i++) {
+        T *p = _t_child(x,i);
+        if (!is_receptor(*(Symbol *)_t_surface(p))) continue;
+        for(j=1;j<=_t_children(p);j++) {
+            T *t = _t_child(p,j);
+            if (!semeq(_t_symbol(t),DELETED_INSTANCE) && !__r_get_receptor(t)->image) loaded++;
+        }
+    }
+    for(i=1;i<=_t_children(x) && loaded > v->max_loaded_receptors;i++) {
+        T *p = _t_child(x,i);
+        if (!is_receptor(*(Symbol *)_t_surface(p))) continue;
+        for(j=1;j<=_t_children(p) && loaded > v->max_loaded_receptors;j++) {
+            T *t = _t_child(p,j);
+            if (semeq(_t_symbol(t),DELETED_INSTANCE)) continue;
+            Receptor *r = __r_get_receptor(t);
+            if (!r->image && _a_evict(v,r)) {
+                loaded--;
+                evicted++;
+            }
+        }
+    }
+    return evicted;
+}
+
+void __a_checkpoint_tick(Timer *t) {
+    VMHost *v = t->arg;
+    if (v->max_loaded_receptors) _a_evict_idle(v);
+    _a_checkpoint(true);
+}
+
 /**
  * bootstrap the ceptr system
  *
  * starts up the vmhost and wakes up receptors that should be running in it.
  *
+ * changes to instances and definitions are logged from then on, and if the system
+ * wasn't shut down cleanly the log gets replayed on top of the last snapshot, so nothing
+ * is lost but what hadn't been synced to the log yet.
+ *
  * @TODO check the compository to verify our version of the vmhost
  *
  */
 void _a_boot(char *dir_path) {
+    bool recover = false;
 
     // check if the storage directory exists
     struct stat st = {0};
@@ -70,36 +465,38 @@ void _a_boot(char *dir_path) {
         G_vm = _v_new();
         // create the basic receptors that all VMHosts have
         _v_instantiate_builtins(G_vm);
+
+        // take the first checkpoint for the log to be replayed on top of
+        recover = true;
     }
     else {
         char fn[1000];
-        void *buffer;
         // unserialize the semtable base tree
         SemTable *sem = _sem_new();
         T *t = __a_unserializet(dir_path,SEM_FN);
-        sem->stores[0].definitions = t;
 
         // restore definitions to the correct store slots
         T *paths = __a_unserializet(dir_path,PATHS_FN);
-        int i = 0;
-        int c = _t_children(paths);
-        for(i=1;i<=c;i++) {
-            T *p = _t_child(paths,i);
-            if (semeq(RECEPTOR_PATH,_t_symbol(p))) {
-                T *x = _t_get(t,(int *)_t_surface(p));
-                sem->stores[i-1].definitions = x;
-            }
-        }
+        _sem_restore_contexts(sem,t,paths);
         _t_free(paths);
-        sem->contexts = c+1;
 
-        // unserialize all of the vmhost's instantiated receptors and other instances
+        // unserialize the vmhost's instances, but only make stubs for its receptors, which
+        // get loaded on first use from the mapped file
+        size_t size;
         __a_vmfn(fn,dir_path);
-        buffer = readFile(fn,0);
-
-        Receptor *r = _r_unserialize(sem,buffer);
+        void *image = __a_map(fn,&size);
+        Receptor *r = __r_new_stub(sem,0,image,dir_path);
+        __r_materialize(r,true);
         G_vm = __v_init(r,sem);
-        free(buffer);
+        G_vm->image = image;
+        G_vm->image_size = size;
+
+        // bring the checkpoint up to date with any changes since it was taken, which are
+        // in the log rotated out when it was taken if it wasn't finished, and the current log
+        __a_vm_old_log_fn(fn,dir_path);
+        recover = _wl_replay(fn,__a_replay,G_vm) >= 0;
+        __a_vm_log_fn(fn,dir_path);
+        if (_wl_replay(fn,__a_replay,G_vm) > 0) recover = true;
 
         // unserialize other vmhost state data
         S *s;
@@ -110,7 +507,7 @@ void _a_boot(char *dir_path) {
 
         H hars; hars.m=h.m; hars.a = _m_child(h,1); // first child is ACTIVE_RECEPTORS
         H har; har.m=h.m;
-        int j = _m_children(hars);
+        int i,j = _m_children(hars);
         for (i=1;i<=j;i++) {
             har.a = _m_child(hars,i);
             if(!semeq(_m_symbol(har),RECEPTOR_XADDR)) raise_error("expecting RECEPTOR_XADDR!");
@@ -120,6 +517,19 @@ void _a_boot(char *dir_path) {
     }
     G_vm->dir = dir_path;
 
+    char fn[1000];
+    __a_vm_log_fn(fn,dir_path);
+    if (recover) {
+        // checkpoint what was recovered before starting a new log
+        _a_checkpoint(false);
+        unlink(fn);
+    }
+    G_vm->wal = _wl_open(fn);
+    __a_set_wal(G_vm->r,G_vm->wal);
+    _wl_start(G_vm->wal,WAL_SYNC_INTERVAL);
+    _tw_init_timer(&G_vm->checkpoint_timer,__a_checkpoint_tick,G_vm);
+    _tw_add(G_vm->timers,&G_vm->checkpoint_timer,CHECKPOINT_INTERVAL,CHECKPOINT_INTERVAL);
+
     // _a_check_vm_host_version_on_the_compository();
 
     _v_start_vmhost(G_vm);
@@ -138,45 +548,9 @@ void _a_shut_down() {
     _v_join_thread(&G_vm->clock_thread);
     _v_join_thread(&G_vm->vm_thread);
 
-    char fn[1000];
-
-    // serialize the semtable
-    __a_serializet(_t_root(G_vm->sem->stores[0].definitions),SEM_FN);
-
-    int i;
-    T *paths = _t_new_root(RECEPTOR_PATHS);
-    for (i=0;i<G_vm->sem->contexts;i++) { // we don't need the path of the root so start at 1
-        int *p = _t_get_path(G_vm->sem->stores[i].definitions);
-        if (p) {
-            _t_new(paths,RECEPTOR_PATH,p,sizeof(int)*(_t_path_depth(p)+1));
-            free(p);
-        }
-        else
-            _t_newr(paths,STRUCTURE_ANYTHING); // should be something like DELETED_CONTEXT
-    }
-    __a_serializet(paths,PATHS_FN);
-    _t_free(paths);
-
-    // serialize the receptor part of the vmhost
-    void *surface;
-    size_t length;
-    _r_serialize(G_vm->r,&surface,&length);
-    //    _r_unserialize(surface);
-    __a_vmfn(fn,G_vm->dir);
-    writeFile(fn,surface,length);
-    free(surface);
-
-    // serialize other parts of the vmhost
-    H h = _m_newr(null_H,SYS_STATE);
-    H har = _m_newr(h,ACTIVE_RECEPTORS);
-    for (i=0;i<G_vm->active_receptor_count;i++) {
-        _m_new(har,RECEPTOR_XADDR,&G_vm->active_receptors[i].x,sizeof(Xaddr));
-    }
-    S *s = _m_serialize(h.m);
-    __a_vm_state_fn(fn,G_vm->dir);
-    writeFile(fn,s,s->total_size);
-    free(s);
-    _m_free(h);
+    // wait for any checkpoint in progress and take a last one, which leaves the log empty
+    _v_join_thread(&G_vm->checkpoint_thread);
+    _a_checkpoint(false);
 
     // free the memory used by the SYS_RECEPTOR
     _v_free(G_vm);
@@ -185,45 +559,178 @@ void _a_shut_down() {
 
 /*------------------------------------------------------------------------*/
 
-T *__a_find(T *t,SemanticID sym) {
-    T *p;
-    DO_KIDS(t,
-            p =_t_child(t,i);
-            if (semeq(*(Symbol *)_t_surface(p),sym)) return p;
-            );
-    return NULL;
+// look up the index entry for a symbol's instances
+SymbolInstances *__a_find(Instances *instances,Symbol s) {
+    SymbolInstances *si = NULL;
+    if (*instances) HASH_FIND(hh,(*instances)->index,&s,sizeof(Symbol),si);
+    return si;
 }
 
 T *__a_get_instances(Instances *instances) {
-    T *t = *instances;
-    if (!t) return NULL;
-    t = _t_child(t,InstanceStoreInstancesIdx);
+    if (!*instances) return NULL;
+    T *t = _t_child((*instances)->store,InstanceStoreInstancesIdx);
     if (!t) raise_error("Missing INSTANCES");
     return t;
 }
 
-Xaddr _a_new_instance(Instances *instances,T *t) {
-    T *x = __a_get_instances(instances);
-    if (!x) {
-        x = *instances = _t_new_root(INSTANCE_STORE);
-        x = _t_newr(x,INSTANCES);
+// add the index entry for an existing SYMBOL_INSTANCES node
+SymbolInstances *__a_index_symbol(Instances *instances,T *t) {
+    SymbolInstances *si = malloc(sizeof(SymbolInstances));
+    si->symbol = *(Symbol *)_t_surface(t);
+    si->instances = t;
+    si->free = NULL;
+    si->free_count = si->free_size = 0;
+    si->dirty = true;
+    HASH_ADD(hh,(*instances)->index,symbol,sizeof(Symbol),si);
+    return si;
+}
+
+// create the instance store if there isn't one yet
+Instances __a_get_store(Instances *instances) {
+    if (!*instances) {
+        Instances i = *instances = malloc(sizeof(InstanceStore));
+        i->store = _t_new_root(INSTANCE_STORE);
+        _t_newr(i->store,INSTANCES);
+        i->index = NULL;
+        i->scapes = NULL;
+    }
+    return *instances;
+}
+
+// get the index entry for a symbol's instances, adding a SYMBOL_INSTANCES for it if needed
+SymbolInstances *__a_get_symbol(Instances *instances,Symbol s) {
+    __a_get_store(instances);
+    SymbolInstances *si = __a_find(instances,s);
+    if (!si) si = __a_index_symbol(instances,_t_news(__a_get_instances(instances),SYMBOL_INSTANCES,s));
+    return si;
+}
+
+// remember that an address is free for reuse
+void __a_push_free(SymbolInstances *si,int addr) {
+    if (si->free_count == si->free_size) {
+        si->free_size = si->free_size ? si->free_size*2 : 8;
+        si->free = realloc(si->free,sizeof(int)*si->free_size);
+    }
+    si->free[si->free_count++] = addr;
+}
+
+// add an instance to, or remove it from, all the scapes of its symbol
+void __a_scape(Instances *instances,T *t,Xaddr x,bool add) {
+    Scape *s;
+    for(s=(*instances)->scapes;s;s=s->next) {
+        if (semeq(s->data_source,x.symbol)) {
+            if (!add) _s_unindex(s,t,x);
+            else if (!_s_index(s,t,x)) raise_error("instance's key is already in a scape that only allows one instance per key");
+        }
+    }
+}
+
+/**
+ * check that an instance can go into a store without giving a key to more than one instance
+ * in a scape that only allows one instance per key
+ *
+ * @param[in] instances the instance store
+ * @param[in] t the instance
+ * @param[in] x the address it would have (with addr 0 for a new instance)
+ * @returns false if one of the scapes of its symbol already has its key for another instance
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccScapes
+ */
+bool _a_can_scape(Instances *instances,T *t,Xaddr x) {
+    Scape *s;
+    if (!*instances) return true;
+    for(s=(*instances)->scapes;s;s=s->next)
+        if (semeq(s->data_source,x.symbol) && !_s_can_index(s,t,x)) return false;
+    return true;
+}
+
+/**
+ * attach a scape to an instance store
+ *
+ * the existing instances of the scape's data source are scaped right away, and from then
+ * on the scape is kept up to date as instances are added, set and deleted.  The store
+ * takes ownership of the scape.  Adding an instance whose key a scape that only allows one
+ * instance per key already has is an error, which callers can check for with _a_can_scape.
+ *
+ * @param[in] sem the semantic table used to hash the keys
+ * @param[in] instances the instance store
+ * @param[in] s the scape
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccScapes
+ */
+void _a_add_scape(SemTable *sem,Instances *instances,Scape *s) {
+    Instances store = __a_get_store(instances);
+    s->sem = sem;
+    s->next = store->scapes;
+    store->scapes = s;
+    SymbolInstances *si = __a_find(instances,s->data_source);
+    if (si) {
+        Xaddr x = {s->data_source,0};
+        DO_KIDS(si->instances,
+                T *t = _t_child(si->instances,i);
+                x.addr = i;
+                if (!semeq(_t_symbol(t),DELETED_INSTANCE) && !_s_index(s,t,x))
+                    raise_error("instances have the same key in a scape that only allows one instance per key");
+                );
+    }
+}
+
+/**
+ * find the scape on an instance store that indexes a symbol by a key
+ *
+ * @param[in] instances the instance store
+ * @param[in] data_source the symbol of the scaped instances
+ * @param[in] key_source the symbol of the key
+ * @returns the scape or NULL if there isn't one
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccScapes
+ */
+Scape *_a_find_scape(Instances *instances,Symbol data_source,Symbol key_source) {
+    Scape *s = NULL;
+    if (*instances) {
+        for(s=(*instances)->scapes;s;s=s->next)
+            if (semeq(s->data_source,data_source) && semeq(s->key_source,key_source)) break;
     }
+    return s;
+}
+
+/**
+ * add an instance to an instance store
+ *
+ * the address of a deleted instance of the same symbol gets reused if there is one
+ *
+ * @param[in] instances the instance store
+ * @param[in] t the instance, which the store takes ownership of
+ * @returns the address of the instance
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccInstances
+ */
+Xaddr _a_new_instance(Instances *instances,T *t) {
     Symbol s = _t_symbol(t);
-    T *si =  __a_find(x,s);
-    if (!si) si = _t_news(x,SYMBOL_INSTANCES,s);
-    _t_add(si,t);
+    SymbolInstances *si = __a_get_symbol(instances,s);
     Xaddr result;
     result.symbol = s;
-    result.addr = _t_children(si);
+    if (si->free_count) {
+        result.addr = si->free[--si->free_count];
+        _t_replace(si->instances,result.addr,t);
+    }
+    else {
+        _t_add(si->instances,t);
+        result.addr = _t_children(si->instances);
+    }
+    si->dirty = true;
+    __a_scape(instances,t,result,true);
     return result;
 }
 
 T *_a_get_instance(Instances *instances,Xaddr x) {
-    T *t = __a_get_instances(instances);
-    if (!t) return NULL;
-    t = __a_find(t,x.symbol);
-    if (t) {
-        t = _t_child(t,x.addr);
+    SymbolInstances *si = __a_find(instances,x.symbol);
+    if (si) {
+        T *t = _t_child(si->instances,x.addr);
         if (t && !semeq(_t_symbol(t),DELETED_INSTANCE)) return t;
     }
     return NULL;
@@ -233,82 +740,308 @@ T *_a_set_instance(Instances *instances,Xaddr x,T *r) {
     //@todo sanity check on t's symbol type?
     T *t = _a_get_instance(instances,x);
     if (t) {
+        __a_scape(instances,t,x,false);
+        __a_scape(instances,r,x,true);
         _t_replace(_t_parent(t),_t_node_index(t),r);
+        __a_find(instances,x.symbol)->dirty = true;
         return t;
     }
     return NULL;
 }
 
+/**
+ * get the number of instance slots of a symbol, i.e. where a walk with _a_next_instance should end
+ *
+ * @param[in] instances the instance store
+ * @param[in] s the symbol
+ * @returns the number of slots, including those of deleted instances
+ */
+int _a_instance_slots(Instances *instances,Symbol s) {
+    SymbolInstances *si = __a_find(instances,s);
+    return si ? _t_children(si->instances) : 0;
+}
+
+/**
+ * walk the instances of a symbol one at a time
+ *
+ * instance slots don't move (deleted instances are replaced by a DELETED_INSTANCE) so the
+ * cursor stays valid even if instances are added or deleted between calls.  The walk stops
+ * at the slot count taken with _a_instance_slots when it started, so instances added during
+ * the walk aren't returned (and a walk that adds instances still ends) except ones that
+ * reuse the slot of a deleted instance the cursor hasn't reached yet.
+ *
+ * @param[in] instances the instance store
+ * @param[in] s the symbol whose instances to walk
+ * @param[in,out] cursor the address of the last instance returned, start with 0
+ * @param[in] end the number of slots when the walk started
+ * @returns the next live instance (not a copy) or NULL if there are no more
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccGetInstances
+ */
+T *_a_next_instance(Instances *instances,Symbol s,int *cursor,int end) {
+    SymbolInstances *si = __a_find(instances,s);
+    if (!si) return NULL;
+    T *x = si->instances;
+    int c = _t_children(x);
+    if (end < c) c = end;
+    while (*cursor < c) {
+        T *t = _t_child(x,++*cursor);
+        if (!semeq(_t_symbol(t),DELETED_INSTANCE)) return t;
+    }
+    return NULL;
+}
+
 void _a_get_instances(Instances *instances,Symbol s,T *t) {
     T *c;
-    T *x = __a_get_instances(instances);
-    if (!x) return;
-    x = __a_find(x,s);
-    if (x)
-        DO_KIDS(x,
-                c = _t_child(x,i);
-                if (!semeq(_t_symbol(c),DELETED_INSTANCE))
-                    _t_add(t,_t_clone(c));
-                );
+    int cursor = 0;
+    int end = _a_instance_slots(instances,s);
+    while((c = _a_next_instance(instances,s,&cursor,end)))
+        _t_add(t,_t_clone(c));
 }
 
+/**
+ * delete an instance
+ *
+ * the instance is replaced by a DELETED_INSTANCE so the addresses of the others don't change,
+ * and its address gets reused by the next instance of the symbol added.
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccInstances
+ */
 void _a_delete_instance(Instances *instances,Xaddr x) {
-    T *t = __a_get_instances(instances);
-    if (!t) return;
-    t = __a_find(t,x.symbol);
-    if (t) {
-        t = _t_child(t,x.addr);
-        if (t) {
+    SymbolInstances *si = __a_find(instances,x.symbol);
+    if (si) {
+        T *t = _t_child(si->instances,x.addr);
+        if (t && !semeq(_t_symbol(t),DELETED_INSTANCE)) {
+            __a_scape(instances,t,x,false);
             T *d = _t_new_root(DELETED_INSTANCE);
             _t_replace_node(t,d);
+            __a_push_free(si,x.addr);
+            si->dirty = true;
         }
     }
 }
 
+// put an instance at a given address, i.e. when replaying the log
+void __a_put_instance(Instances *instances,Xaddr x,T *t) {
+    SymbolInstances *si = __a_get_symbol(instances,x.symbol);
+    T *p = si->instances;
+    int i;
+    // pad out to the address with deleted instances
+    while (_t_children(p) < x.addr) {
+        _t_add(p,_t_new_root(DELETED_INSTANCE));
+        __a_push_free(si,_t_children(p));
+    }
+    T *o = _t_child(p,x.addr);
+    if (semeq(_t_symbol(o),DELETED_INSTANCE)) {
+        for(i=0;i<si->free_count && si->free[i] != x.addr;i++);
+        if (i < si->free_count) si->free[i] = si->free[--si->free_count];
+    }
+    else __a_scape(instances,o,x,false);
+    _t_replace(p,x.addr,t);
+    si->dirty = true;
+    __a_scape(instances,t,x,true);
+}
+
+/**
+ * compact an instance store
+ *
+ * trailing deleted instances are removed, as are the instance lists of symbols with
+ * no instances left.  The addresses of live instances never change so this is safe to do
+ * at any point the caller has exclusive access to the store, which is why checkpointing
+ * does it just before copying the stores.
+ *
+ * @param[in] instances the instance store
+ * @returns the number of deleted instance slots reclaimed
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccCompactInstances
+ */
+int _a_compact_instances(Instances *instances) {
+    if (!*instances) return 0;
+    int reclaimed = 0;
+    SymbolInstances *si,*tmp;
+    HASH_ITER(hh,(*instances)->index,si,tmp) {
+        T *x = si->instances;
+        int c = _t_children(x);
+        while (c && semeq(_t_symbol(_t_child(x,c)),DELETED_INSTANCE)) {
+            _t_free(_t_detach_by_idx(x,c));
+            c--;
+            reclaimed++;
+            si->dirty = true;
+        }
+        if (!c) {
+            HASH_DEL((*instances)->index,si);
+            _t_detach_by_ptr(_t_parent(x),x);
+            _t_free(x);
+            free(si->free);
+            free(si);
+        }
+        else {
+            // drop the reclaimed addresses from the free list
+            int i,j = 0;
+            for(i=0;i<si->free_count;i++)
+                if (si->free[i] <= c) si->free[j++] = si->free[i];
+            si->free_count = j;
+        }
+    }
+    return reclaimed;
+}
+
 void _a_free_instances(Instances *instances) {
-    T *x = *instances;
-    if (x) {
-        _t_free(x);
+    Instances i = *instances;
+    if (i) {
+        SymbolInstances *si,*tmp;
+        HASH_ITER(hh,i->index,si,tmp) {
+            HASH_DEL(i->index,si);
+            free(si->free);
+            free(si);
+        }
+        Scape *s;
+        while((s = i->scapes)) {
+            i->scapes = s->next;
+            _s_free(s);
+        }
+        _t_free(i->store);
+        free(i);
         *instances = NULL;
     }
 }
 
-S *__a_serialize_instances(Instances *instances) {
+// add a file for a checkpoint to write out
+void __a_add_file(CheckpointFile **files,char *name,void *data,size_t length) {
+    CheckpointFile *f = malloc(sizeof(CheckpointFile));
+    f->name = strdup(name);
+    f->data = data;
+    f->length = length;
+    f->next = *files;
+    *files = f;
+}
+
+// name of the file a receptor's instances of a symbol get checkpointed to
+void __a_section_name(char *buf,Context c,Symbol s) {
+    sprintf(buf,"_i%d_%d.%d.%d",c,s.context,s.semtype,s.id);
+}
+
+// append to a serialized instance store being built, keeping everything 8 byte aligned
+size_t __a_append(InstanceImage **m,size_t *size,void *data,size_t length) {
+    size_t at = (*m)->total_size;
+    size_t end = (at+length+7) & ~7;
+    if (end > *size) {
+        while (end > *size) *size *= 2;
+        *m = realloc(*m,*size);
+    }
+    if (data) memcpy(((void *)*m)+at,data,length);
+    memset(((void *)*m)+at+length,0,end-at-length);
+    (*m)->total_size = end;
+    return at;
+}
+
+// append the slots of a symbol's instances
+void __a_append_slots(InstanceImage **m,size_t *size,SymbolInstances *si,CheckpointFile **files) {
+    T *p = si->instances;
+    bool is_receptor = is_receptor(si->symbol);
+    size_t length;
+    DO_KIDS(p,
+            T *c = _t_child(p,i);
+            if (semeq(_t_symbol(c),DELETED_INSTANCE)) {
+                length = 0;
+                __a_append(m,size,&length,sizeof(size_t));
+            }
+            else if (is_receptor) {
+                void *surface;
+                Receptor *r = __r_get_receptor(c);
+                __r_serialize(r,&surface,&length,files);
+                __a_append(m,size,&length,sizeof(size_t));
+                __a_append(m,size,&r->context,sizeof(Context));
+                __a_append(m,size,surface,length);
+                free(surface);
+            }
+            else {
+                H h = _m_new_from_t(c);
+                S *ss = _m_serialize(h.m);
+                _m_free(h);
+                __a_append(m,size,&ss->total_size,sizeof(size_t));
+                __a_append(m,size,ss,ss->total_size);
+                free(ss);
+            }
+            );
+}
+
+// serialize the instances of all the symbols in a store, or just one of them
+InstanceImage *__a_image(Instances *instances,Context ctx,CheckpointFile **files,Symbol *only) {
     T *x = __a_get_instances(instances);
-    T *t = _t_new_root(PARAMS);
-    if (x) {
-        T *p;
-        Symbol s;
-        DO_KIDS(x,
-                p =_t_child(x,i);
-                s = *(Symbol *)_t_surface(p);
-                T *sym = _t_news(t,STRUCTURE_SYMBOL,s);  // just using this symbol to store the symbol type
-                T *c;
-                DO_KIDS(p,
-                        c = _t_child(p,i);
-                        if (is_receptor(s)) {
-                            void *surface;
-                            size_t length;
-                            Receptor *r = __r_get_receptor(c);
-                            _r_serialize(r,&surface,&length);
-                            c = _t_new(0,SERIALIZED_RECEPTOR,surface,length);
-                            //@todo create a version of _t_new that doesn't have to realloc the surface but can just use it
-                            free(surface);
-                        }
-                        else c = _t_clone(c);
-                        _t_add(sym,c);
-                        );
-                );
+    int n = only ? 1 : (x ? _t_children(x) : 0);
+    size_t size = sizeof(InstanceImage)+n*sizeof(InstanceSection);
+    InstanceImage *m = malloc(size);
+    memset(m,0,size);
+    m->magic = INSTANCES_MAGIC|INSTANCES_VERSION;
+    m->total_size = 0;
+    __a_append(&m,&size,NULL,sizeof(InstanceImage)+n*sizeof(InstanceSection));
+    m->sections = n;
+    int j;
+    for(j=0;j<n;j++) {
+        Symbol s = only ? *only : *(Symbol *)_t_surface(_t_child(x,j+1));
+        SymbolInstances *si = __a_find(instances,s);
+        InstanceSection *sec = &m->section[j];
+        sec->symbol = s;
+        sec->count = _t_children(si->instances);
+        if (files && !only && !is_receptor(s)) {
+            // checkpointed to a file of its own, which only needs writing if it's changed
+            sec->flags = InstanceSectionExternal;
+            if (si->dirty) {
+                char name[100];
+                InstanceImage *sm = __a_image(instances,ctx,NULL,&s);
+                __a_section_name(name,ctx,s);
+                __a_add_file(files,name,sm,sm->total_size);
+                si->dirty = false;
+            }
+            continue;
+        }
+        size_t at = m->total_size;
+        __a_append_slots(&m,&size,si,files);
+        sec = &m->section[j];
+        sec->offset = at;
+        sec->length = m->total_size-at;
     }
-    H h = _m_new_from_t(t);
-    S *s = _m_serialize(h.m);
-    _m_free(h);_t_free(t);
-    return s;
+    if (!only && x && (*instances)->scapes) {
+        // the scapes get rebuilt when the instances are unserialized
+        T *t = _t_new_root(PARAMS);
+        Scape *sc;
+        for(sc=(*instances)->scapes;sc;sc=sc->next) _s_spec(t,sc);
+        H h = _m_new_from_t(t);
+        S *ss = _m_serialize(h.m);
+        _m_free(h);_t_free(t);
+        size_t at = __a_append(&m,&size,ss,ss->total_size);
+        m->scapes = at;
+        free(ss);
+    }
+    return m;
+}
+
+/**
+ * serialize an instance store
+ *
+ * the instances of each symbol get their own section, listed in a table at the start so
+ * that a reader can go straight to the symbols it wants.  When checkpointing, the sections
+ * of all but receptor instances are split out into their own files instead, and the files
+ * of symbols that haven't changed since the last checkpoint aren't written again.
+ * Receptor instances are always serialized in place (with their own instances split out
+ * the same way).
+ *
+ * @param[in] instances the instance store
+ * @param[in] ctx the context of the receptor the store belongs to
+ * @param[in,out] files list to add the files of changed symbols to, or NULL to serialize all the instances in place
+ * @returns the serialized store, an InstanceImage
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccSerializeInstances
+ */
+S *___a_serialize_instances(Instances *instances,Context ctx,CheckpointFile **files) {
+    return (S *)__a_image(instances,ctx,files,NULL);
 }
 
-// the quick and dirty serialization builds a new tree
-// which we will just serialize as an mtree.
-// is is very inefficient @fixme
 void _a_serialize_instances(Instances *i,char *file) {
 
     S *s = __a_serialize_instances(i);
@@ -326,57 +1059,206 @@ void _a_serialize_instances(Instances *i,char *file) {
     free(s);
 }
 
-void __a_unserialize_instances(SemTable *sem,Instances *instances,S *s) {
+// add the instances of a symbol from a STRUCTURE_SYMBOL tree of them (stores serialized as PARAMS trees)
+void __a_load_symbol(SemTable *sem,Instances *instances,T *u,char *dir) {
+    SemanticID s = *(SemanticID *)_t_surface(u);
+    int is_receptor = is_receptor(s);
+    SymbolInstances *si = __a_get_symbol(instances,s);
+    while(_t_children(u)) {
+        T *i = _t_detach_by_idx(u,1);
+        // deleted instances keep their place so that the addresses don't change
+        if (semeq(_t_symbol(i),DELETED_INSTANCE)) {
+            _t_add(si->instances,i);
+            __a_push_free(si,_t_children(si->instances));
+            continue;
+        }
+        if (is_receptor) {
+            Receptor *r = __r_unserialize(sem,_t_surface(i),dir);
+            _t_free(i);
+            i = _t_new_receptor(0,s,r);
+        }
+        _t_add(si->instances,i);
+        Xaddr x = {s,_t_children(si->instances)};
+        __a_scape(instances,i,x,true);
+    }
+}
+
+// add the scapes of a serialized store
+void __a_load_scapes(SemTable *sem,Instances *instances,S *s) {
     H h = _m_unserialize(s);
     T *t = _t_new_from_m(h);
+    _m_free(h);
+    DO_KIDS(t,
+            T *u = _t_child(t,i);
+            if (semeq(_t_symbol(u),SCAPE_SPEC)) {
+                Scape *sc = _s_new_from_spec(u);
+                if (_a_find_scape(instances,sc->data_source,sc->key_source)) _s_free(sc);
+                else _a_add_scape(sem,instances,sc);
+            }
+            );
+    _t_free(t);
+}
 
+// read stores serialized as a PARAMS tree of STRUCTURE_SYMBOLs and SCAPE_SPECs, from before there were sections
+// (stores that split symbols out into files of their own in a tree like this never got released, so they aren't supported)
+void __a_load_params(SemTable *sem,Instances *instances,S *s,char *dir) {
+    H h = _m_unserialize(s);
+    T *t = _t_new_from_m(h);
     _m_free(h);
-    int j,c = _t_children(t);
-    for(j=1;j<=c;j++) {
-        T *u = _t_child(t,j);
-        SemanticID s = *(SemanticID *)_t_surface(u);
-        int is_receptor = is_receptor(s);
-        while(_t_children(u)) {
-            T *i = _t_detach_by_idx(u,1);
-            if (is_receptor) {
-                Receptor *r = _r_unserialize(sem,_t_surface(i));
-                _t_free(i);
-                i = _t_new_receptor(0,s,r);
+    DO_KIDS(t,
+            T *u = _t_child(t,i);
+            if (semeq(_t_symbol(u),STRUCTURE_SYMBOL)) __a_load_symbol(sem,instances,u,dir);
+            else if (!semeq(_t_symbol(u),SCAPE_SPEC)) raise_error("unsupported instance store format");
+            );
+    _t_free(t);
+    __a_load_scapes(sem,instances,s);
+}
+
+// make sure the part of a serialized store from p to end has room for length bytes, so that
+// nothing reads past the end of a truncated or corrupt store
+void __a_check_room(void *p,void *end,size_t length) {
+    if (p > end || length > (size_t)(end-p)) raise_error("corrupt instance store");
+}
+
+// make sure a serialized tree (or receptor image) fits in the part of a store from p to end
+void __a_check_tree(void *p,void *end,bool receptor) {
+    __a_check_room(p,end,sizeof(S));
+    size_t size = ((S *)p)->total_size;
+    __a_check_room(p,end,size);
+    if (!receptor) return;
+    __a_check_room(p+size,end,sizeof(S));
+    __a_check_room(p+size,end,((S *)(p+size))->total_size);
+}
+
+// add the instances of a section
+void __a_load_section(SemTable *sem,Instances *instances,InstanceImage *m,InstanceSection *sec,Context ctx,char *dir,bool lazy) {
+    Symbol s = sec->symbol;
+    SymbolInstances *si = __a_get_symbol(instances,s);
+    void *p = ((void *)m)+sec->offset;
+    void *end = p+sec->length;
+    uint32_t j;
+    for(j=0;j<sec->count;j++) {
+        __a_check_room(p,end,sizeof(size_t));
+        size_t length = *(size_t *)p;
+        p += sizeof(size_t);
+        T *t;
+        if (length) {
+            if (is_receptor(s) && (m->magic & 0xff) >= 2) __a_check_room(p,end,8+((length+7) & ~7));
+            else __a_check_room(p,end,(length+7) & ~7);
+            __a_check_tree(is_receptor(s) && (m->magic & 0xff) >= 2 ? p+8 : p,end,is_receptor(s));
+        }
+        if (!length) {
+            // deleted instances keep their place so that the addresses don't change
+            _t_add(si->instances,_t_new_root(DELETED_INSTANCE));
+            __a_push_free(si,_t_children(si->instances));
+            continue;
+        }
+        if (is_receptor(s)) {
+            // older images don't have the context needed to make a stub
+            if ((m->magic & 0xff) < 2) t = _t_new_receptor(0,s,__r_unserialize(sem,p,dir));
+            else {
+                Context c = *(Context *)p;
+                p += 8;
+                Receptor *r = __r_new_stub(sem,c,p,dir);
+                if (!lazy) _r_materialize(r);
+                t = _t_new_receptor(0,s,r);
             }
-            _a_new_instance(instances, i);
         }
+        else {
+            H h = _m_unserialize((S *)p);
+            t = _t_new_from_m(h);
+            _m_free(h);
+        }
+        p += (length+7) & ~7;
+        _t_add(si->instances,t);
+        Xaddr x = {s,_t_children(si->instances)};
+        __a_scape(instances,t,x,true);
     }
-    _t_free(t);
 }
 
-void _a_unserialize_instances(SemTable *sem,Instances *instances,char *file) {
-    FILE *ofp;
-
-    ofp = fopen(file, "r");
-    if (ofp == NULL) {
-        raise_error("Can't open input file %s!\n",file);
+// add the instances of a serialized store, or just those of one symbol
+void __a_load_image(SemTable *sem,Instances *instances,InstanceImage *m,Context ctx,char *dir,Symbol *only,bool lazy) {
+    if (m->magic == matrixImpl) {
+        if (only) raise_error("can't load part of an instance store without sections");
+        __a_load_params(sem,instances,(S *)m,dir);
+        return;
     }
-    else {
-        Mmagic magic;
-        fread(&magic, 1,sizeof(magic), ofp);
-        // @todo check magic value
-        size_t total_size;
-        fread(&magic, 1,sizeof(magic), ofp);
-        S *s = malloc(total_size);
-        s->magic = magic;
-        s->total_size = total_size;
-        size_t read_size = total_size-sizeof(Mmagic)-sizeof(total_size);
-        fread(&s->levels,1,read_size,ofp);
-        fclose(ofp);
-        __a_unserialize_instances(sem,instances,s);
-        free(s);
+    if ((m->magic & ~0xff) != INSTANCES_MAGIC) raise_error("not a serialized instance store");
+    if ((m->magic & 0xff) > INSTANCES_VERSION) raise_error("instance store format version %d is newer than this one",m->magic & 0xff);
+    void *start = m,*end = start+m->total_size;
+    __a_check_room(start,end,sizeof(InstanceImage));
+    __a_check_room(start+sizeof(InstanceImage),end,(size_t)m->sections*sizeof(InstanceSection));
+    void *data = &m->section[m->sections];
+    uint32_t j;
+    for(j=0;j<m->sections;j++) {
+        InstanceSection *sec = &m->section[j];
+        if (only && !semeq(*only,sec->symbol)) continue;
+        if (!(sec->flags & InstanceSectionExternal) && (sec->offset < (size_t)(data-start) || sec->offset > m->total_size))
+            raise_error("corrupt instance store");
+        if (!(sec->flags & InstanceSectionExternal)) __a_check_room(start+sec->offset,end,sec->length);
+        if (sec->flags & InstanceSectionExternal) {
+            char name[100],fn[1000];
+            if (!dir) raise_error("no directory to load instances from");
+            __a_section_name(name,ctx,sec->symbol);
+            __a_vm_fn(fn,dir,name);
+            ___a_load_instances(sem,instances,fn,ctx,dir,&sec->symbol);
+            // what's in the file is what's checkpointed
+            __a_find(instances,sec->symbol)->dirty = false;
+        }
+        else __a_load_section(sem,instances,m,sec,ctx,dir,lazy);
+    }
+    if (!only && m->scapes) {
+        if (m->scapes < (size_t)(data-start) || m->scapes > m->total_size) raise_error("corrupt instance store");
+        __a_check_tree(start+m->scapes,end,false);
+        __a_load_scapes(sem,instances,start+m->scapes);
     }
 }
 
+/**
+ * unserialize an instance store
+ *
+ * @param[in] sem the semantic table
+ * @param[in] instances the instance store to add the instances to
+ * @param[in] s the serialized store
+ * @param[in] ctx the context of the receptor the store belongs to
+ * @param[in] dir the directory to load the files of checkpointed sections from, or NULL if there aren't any
+ * @param[in] lazy true to make stubs for receptor instances that get loaded on first use,
+ *            in which case s must stay put until they are
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccSerializeInstances
+ */
+void ___a_unserialize_instances(SemTable *sem,Instances *instances,S *s,Context ctx,char *dir,bool lazy) {
+    __a_load_image(sem,instances,(InstanceImage *)s,ctx,dir,NULL,lazy);
+}
+
+/**
+ * load instances from a file holding a serialized instance store
+ *
+ * the file gets mapped rather than read, so loading just one symbol's instances only
+ * touches that symbol's section of the file.
+ *
+ * @param[in] sem the semantic table
+ * @param[in] instances the instance store to add the instances to
+ * @param[in] file the file
+ * @param[in] ctx the context of the receptor the store belongs to
+ * @param[in] dir the directory to load the files of checkpointed sections from, or NULL if there aren't any
+ * @param[in] only the symbol whose instances to load, or NULL to load them all
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccSerializeInstances
+ */
+void ___a_load_instances(SemTable *sem,Instances *instances,char *file,Context ctx,char *dir,Symbol *only) {
+    size_t size;
+    void *m = __a_map(file,&size);
+    if (size < sizeof(S) || ((S *)m)->total_size > size) raise_error("truncated instance store %s",file);
+    __a_load_image(sem,instances,m,ctx,dir,only,false);
+    munmap(m,size);
+}
+
 T *__a_get_tokens(Instances *instances) {
-    T *t = *instances;
-    if (!t) raise_error("uninitialized instances");
-    t = _t_child(t,InstanceStoreTokensIdx);
+    if (!*instances) raise_error("uninitialized instances");
+    T *t = _t_child((*instances)->store,InstanceStoreTokensIdx);
     return t;
 }
 
@@ -384,7 +1266,7 @@ T *_a_gen_token(Instances *instances,Xaddr x,T *dependency) {
     T *tokens = __a_get_tokens(instances);
     T *c;
     if (!tokens) {
-        tokens = _t_newr(*instances,INSTANCE_TOKENS);
+        tokens = _t_newr((*instances)->store,INSTANCE_TOKENS);
         c = _t_newi64(tokens,LAST_TOKEN,0);
     }
     else c = _t_child(tokens,InstanceTokensLastTokenIdx);
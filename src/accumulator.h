@@ -16,21 +16,40 @@
 #include "mtree.h"
 #include "vmhost.h"
 
+/// default interval between background checkpoints of the vmhost
+#define CHECKPOINT_INTERVAL (60*NS_PER_SEC)
+
 void _a_boot(char *dir_name);
 void _a_start_vmhost();
 void _a_shut_down();
+bool _a_checkpoint(bool background);
+bool _a_evict(VMHost *v,Receptor *r);
+int _a_evict_idle(VMHost *v);
+void __a_set_wal(Receptor *r,WAL *w);
 
 Xaddr _a_new_instance(Instances *i,T *t);
 T *_a_get_instance(Instances *i,Xaddr x);
+T *__a_get_instances(Instances *instances);
+int _a_instance_slots(Instances *instances,Symbol s);
+T *_a_next_instance(Instances *instances,Symbol s,int *cursor,int end);
 void _a_get_instances(Instances *instances,Symbol s,T *t);
 T *_a_set_instance(Instances *instances,Xaddr x,T *t);
 void _a_delete_instance(Instances *instances,Xaddr x);
+void __a_put_instance(Instances *instances,Xaddr x,T *t);
+int _a_compact_instances(Instances *instances);
 void _a_free_instances(Instances *i);
+void _a_add_scape(SemTable *sem,Instances *instances,Scape *s);
+Scape *_a_find_scape(Instances *instances,Symbol data_source,Symbol key_source);
+bool _a_can_scape(Instances *instances,T *t,Xaddr x);
 
-S *__a_serialize_instances(Instances *i);
+S *___a_serialize_instances(Instances *instances,Context ctx,CheckpointFile **files);
+#define __a_serialize_instances(i) ___a_serialize_instances(i,0,NULL)
 void _a_serialize_instances(Instances *i,char *file);
-void __a_unserialize_instances(SemTable *sem,Instances *instances,S *s);
-void _a_unserialize_instances(SemTable *sem,Instances *i,char *file);
+void ___a_unserialize_instances(SemTable *sem,Instances *instances,S *s,Context ctx,char *dir,bool lazy);
+#define __a_unserialize_instances(sem,i,s) ___a_unserialize_instances(sem,i,s,0,NULL,false)
+void ___a_load_instances(SemTable *sem,Instances *instances,char *file,Context ctx,char *dir,Symbol *only);
+#define _a_unserialize_instances(sem,i,file) ___a_load_instances(sem,i,file,0,NULL,NULL)
+#define _a_load_instances(sem,i,file,s) ___a_load_instances(sem,i,file,0,NULL,s)
 
 T *_a_gen_token(Instances *i,Xaddr x,T *dependency);
 Xaddr _a_get_token_xaddr(Instances *i,T *token,T *dependency);
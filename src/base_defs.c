@@ -109,6 +109,8 @@ SemanticID ASCII_CHAR={0,0,0};
 SemanticID ONE_OR_MORE_OF_ASCII_CHAR={0,0,0};
 SemanticID ASCII_CHARS={0,0,0};
 SemanticID ASCII_STR={0,0,0};
+SemanticID ROPE={0,0,0};
+SemanticID ASCII_ROPE={0,0,0};
 SemanticID RECEPTOR_XADDR={0,0,0};
 SemanticID EXPECTATIONS={0,0,0};
 SemanticID SIGNALS={0,0,0};
@@ -116,6 +118,12 @@ SemanticID ASPECT={0,0,0};
 SemanticID DEFAULT_ASPECT={0,0,0};
 SemanticID ONE_OR_MORE_OF_STRUCTURE_OF_ASPECT={0,0,0};
 SemanticID FLUX={0,0,0};
+SemanticID SCAPE_KEY_SOURCE={0,0,0};
+SemanticID SCAPE_DATA_SOURCE={0,0,0};
+SemanticID SCAPE_KEY_PATH={0,0,0};
+SemanticID SCAPE_MULTI={0,0,0};
+SemanticID SCAPE_ORDERED={0,0,0};
+SemanticID LIST_OF_SCAPE_KEY_SOURCE_AND_SCAPE_DATA_SOURCE_AND_SCAPE_MULTI_AND_SCAPE_ORDERED_AND_ZERO_OR_ONE_OF_SCAPE_KEY_PATH={0,0,0};
 SemanticID SCAPE_SPEC={0,0,0};
 SemanticID ASPECT_IDENT={0,0,0};
 SemanticID ASPECT_TYPE={0,0,0};
@@ -186,7 +194,8 @@ SemanticID PROCESS_INTENTION={0,0,0};
 SemanticID PROCESS_SIGNATURE={0,0,0};
 SemanticID ANY_SYMBOL={0,0,0};
 SemanticID CODE={0,0,0};
-SemanticID LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK={0,0,0};
+SemanticID PROCESS_PURE={0,0,0};
+SemanticID LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK_AND_ZERO_OR_ONE_OF_PROCESS_PURE={0,0,0};
 SemanticID PROCESS_DEFINITION={0,0,0};
 SemanticID ZERO_OR_MORE_OF_PROCESS_DEFINITION={0,0,0};
 SemanticID GOAL={0,0,0};
@@ -298,6 +307,16 @@ SemanticID BINDING_PAIR={0,0,0};
 SemanticID ONE_OR_MORE_OF_BINDING_PAIR={0,0,0};
 SemanticID BINDINGS={0,0,0};
 SemanticID RECEPTOR_ELAPSED_TIME={0,0,0};
+SemanticID PROFILED_PROCESS={0,0,0};
+SemanticID PROFILE_CALLS={0,0,0};
+SemanticID PROFILE_INCLUSIVE_TIME={0,0,0};
+SemanticID PROFILE_EXCLUSIVE_TIME={0,0,0};
+SemanticID PROFILE_ALLOCATIONS={0,0,0};
+SemanticID PROFILE_ALLOCATED_BYTES={0,0,0};
+SemanticID LIST_OF_PROFILED_PROCESS_AND_PROFILE_CALLS_AND_PROFILE_INCLUSIVE_TIME_AND_PROFILE_EXCLUSIVE_TIME_AND_PROFILE_ALLOCATIONS_AND_PROFILE_ALLOCATED_BYTES={0,0,0};
+SemanticID PROCESS_PROFILE={0,0,0};
+SemanticID ZERO_OR_MORE_OF_PROCESS_PROFILE={0,0,0};
+SemanticID RECEPTOR_PROFILE={0,0,0};
 SemanticID RECEPTOR_LABEL={0,0,0};
 SemanticID RECEPTOR_IDENTITY={0,0,0};
 SemanticID TUPLE_OF_RECEPTOR_LABEL_AND_DEFINITIONS={0,0,0};
@@ -346,8 +365,15 @@ SemanticID DEAD_STREAM_READ_ERR={0,0,0};
 SemanticID MISSING_SEMANTIC_MAP_ERR={0,0,0};
 SemanticID MISMATCH_SEMANTIC_MAP_ERR={0,0,0};
 SemanticID STRUCTURE_MISMATCH_ERR={0,0,0};
+SemanticID TIMEOUT_ERR={0,0,0};
+SemanticID DUPLICATE_KEY_ERR={0,0,0};
+SemanticID NO_SCAPE_ERR={0,0,0};
+SemanticID UNORDERED_SCAPE_ERR={0,0,0};
 SemanticID WHICH_XADDR={0,0,0};
 SemanticID NEW_TYPE={0,0,0};
+SemanticID QUERY_TYPE={0,0,0};
+SemanticID ZERO_OR_MORE_OF_WHICH_XADDR={0,0,0};
+SemanticID QUERY_RESULTS={0,0,0};
 SemanticID TIMEOUT_AT={0,0,0};
 SemanticID COUNT={0,0,0};
 SemanticID UNLIMITED={0,0,0};
@@ -368,6 +394,9 @@ SemanticID DEF_PROTOCOL={0,0,0};
 SemanticID NEW={0,0,0};
 SemanticID GET={0,0,0};
 SemanticID DEL={0,0,0};
+SemanticID QUERY={0,0,0};
+SemanticID QUERY_RANGE={0,0,0};
+SemanticID QUERY_PREFIX={0,0,0};
 SemanticID DO={0,0,0};
 SemanticID PARAM_PATH={0,0,0};
 SemanticID STRUCTURE_OF_CSTRING={0,0,0};
@@ -416,6 +445,7 @@ SemanticID STREAM_CLOSE={0,0,0};
 SemanticID CONCAT_STR={0,0,0};
 SemanticID EXPAND_STR={0,0,0};
 SemanticID CONTRACT_STR={0,0,0};
+SemanticID ROPE_APPEND={0,0,0};
 SemanticID EQUALITY_TEST_SYMBOL={0,0,0};
 SemanticID EQ_SYM={0,0,0};
 SemanticID ADD_INT={0,0,0};
@@ -685,6 +715,708 @@ SemanticID HTTP_ASPECT={0,0,0};
 SemanticID HTTP_REQUEST_HANDLER={0,0,0};
 SemanticID httpresp={0,0,0};
 
+SemanticID *G_base_def_ids[] = {
+    &SYS_RECEPTOR,
+    &COMPOSITORY,
+    &DEV_COMPOSITORY,
+    &TEST_RECEPTOR,
+    &CLOCK_RECEPTOR,
+    &STREAM_EDGE,
+    &INTERNET,
+    &BIT,
+    &INTEGER,
+    &INTEGER64,
+    &FLOAT,
+    &CHAR,
+    &CSTRING,
+    &SYMBOL,
+    &STRUCTURE,
+    &PROCESS,
+    &PROTOCOL,
+    &RECEPTOR,
+    &SCAPE,
+    &ENUM,
+    &TREE_PATH,
+    &XADDR,
+    &SURFACE,
+    &TREE,
+    &RECEPTOR_SURFACE,
+    &SEMTREX,
+    &CPOINTER,
+    &UUID,
+    &BLOB,
+    &STRUCTURES,
+    &SYMBOLS,
+    &PROCESSES,
+    &PROTOCOLS,
+    &RECEPTORS,
+    &SCAPES,
+    &LIST_OF_STRUCTURES_AND_SYMBOLS_AND_PROCESSES_AND_PROTOCOLS_AND_RECEPTORS_AND_ZERO_OR_MORE_OF_SCAPES,
+    &DEFINITIONS,
+    &STRUCTURE_SYMBOL,
+    &STRUCTURE_SEQUENCE,
+    &STRUCTURE_OR,
+    &STRUCTURE_ZERO_OR_MORE,
+    &STRUCTURE_ONE_OR_MORE,
+    &STRUCTURE_STRUCTURE,
+    &STRUCTURE_ANYTHING,
+    &STRUCTURE_DEF,
+    &LABEL,
+    &STRUCTURE_LABEL,
+    &TUPLE_OF_STRUCTURE_LABEL_AND_STRUCTURE_DEF,
+    &STRUCTURE_DEFINITION,
+    &ZERO_OR_MORE_OF_STRUCTURE_DEFINITION,
+    &ONE_OR_MORE_OF_STRUCTURE_DEF,
+    &STRUCTURE_ZERO_OR_ONE,
+    &SYMBOL_STRUCTURE,
+    &SYMBOL_LABEL,
+    &TUPLE_OF_SYMBOL_LABEL_AND_SYMBOL_STRUCTURE,
+    &SYMBOL_DEFINITION,
+    &ZERO_OR_MORE_OF_SYMBOL_DEFINITION,
+    &BOOLEAN,
+    &SEMTREX_MATCH_PATH,
+    &SEMTREX_SYMBOL_LITERAL,
+    &SEMTREX_SYMBOL_LITERAL_NOT,
+    &SEMTREX_SEQUENCE,
+    &SEMTREX_OR,
+    &SEMTREX_NOT,
+    &SEMTREX_SYMBOL_ANY,
+    &SEMTREX_ZERO_OR_MORE,
+    &SEMTREX_ONE_OR_MORE,
+    &SEMTREX_ZERO_OR_ONE,
+    &SEMTREX_VALUE_LITERAL,
+    &SEMTREX_VALUE_LITERAL_NOT,
+    &SEMTREX_GROUP,
+    &SEMTREX_WALK,
+    &SEMTREX_DESCEND,
+    &SEMTREX_DEF,
+    &SEMTREX_SYMBOL,
+    &ONE_OR_MORE_OF_SEMTREX_SYMBOL,
+    &SEMTREX_SYMBOL_SET,
+    &SEMTREX_SYMBOL_LITERAL_DEF,
+    &ONE_OR_MORE_OF_SEMTREX_DEF,
+    &PAIR_OF_SEMTREX_DEF,
+    &ZERO_OR_ONE_OF_ANY_SYMBOL,
+    &ONE_OR_MORE_OF_ANY_SYMBOL,
+    &SEMTREX_VALUE_SET,
+    &SEMTREX_VALUE_LITERAL_DEF,
+    &SEMTREX_MATCH,
+    &SEMTREX_MATCH_CURSOR,
+    &SEMTREX_MATCH_RESULTS,
+    &SEMTREX_MATCH_SYMBOL,
+    &SEMTREX_MATCH_SIBLINGS_COUNT,
+    &ASCII_CHAR,
+    &ONE_OR_MORE_OF_ASCII_CHAR,
+    &ASCII_CHARS,
+    &ASCII_STR,
+    &ROPE,
+    &ASCII_ROPE,
+    &RECEPTOR_XADDR,
+    &EXPECTATIONS,
+    &SIGNALS,
+    &ASPECT,
+    &DEFAULT_ASPECT,
+    &ONE_OR_MORE_OF_STRUCTURE_OF_ASPECT,
+    &FLUX,
+    &SCAPE_KEY_SOURCE,
+    &SCAPE_DATA_SOURCE,
+    &SCAPE_KEY_PATH,
+    &SCAPE_MULTI,
+    &SCAPE_ORDERED,
+    &LIST_OF_SCAPE_KEY_SOURCE_AND_SCAPE_DATA_SOURCE_AND_SCAPE_MULTI_AND_SCAPE_ORDERED_AND_ZERO_OR_ONE_OF_SCAPE_KEY_PATH,
+    &SCAPE_SPEC,
+    &ASPECT_IDENT,
+    &ASPECT_TYPE,
+    &ASPECT_LABEL,
+    &TUPLE_OF_ASPECT_TYPE_AND_ASPECT_LABEL,
+    &ASPECT_DEF,
+    &ONE_OR_MORE_OF_ASPECT_DEF,
+    &ASPECTS,
+    &CARRIER,
+    &BODY,
+    &SIGNAL_UUID,
+    &IN_RESPONSE_TO_UUID,
+    &CONVERSATION_UUID,
+    &RECEPTOR_PATH,
+    &ONE_OR_MORE_OF_RECEPTOR_PATH,
+    &RECEPTOR_PATHS,
+    &RECEPTOR_ADDR,
+    &RECEPTOR_ADDRESS,
+    &FROM_ADDRESS,
+    &TO_ADDRESS,
+    &END_CONDITIONS,
+    &LIST_OF_SIGNAL_UUID,
+    &ENVELOPE,
+    &LIST_OF_CONVERSATION_UUID,
+    &CONVERSATION_IDENT,
+    &LIST_OF_FROM_ADDRESS_AND_TO_ADDRESS_AND_ASPECT_IDENT_AND_CARRIER_AND_ZERO_OR_ONE_OF_CONVERSATION_IDENT_AND_ZERO_OR_ONE_OF_LOGICAL_OR_OF_END_CONDITIONS_AND_IN_RESPONSE_TO_UUID,
+    &HEAD,
+    &TUPLE_OF_HEAD_AND_BODY,
+    &MESSAGE,
+    &TUPLE_OF_ENVELOPE_AND_MESSAGE,
+    &SIGNAL,
+    &ZERO_OR_MORE_OF_SIGNAL,
+    &PENDING_SIGNALS,
+    &CODE_PATH,
+    &PROCESS_IDENT,
+    &CODE_REF,
+    &WAKEUP_REFERENCE,
+    &LIST_OF_SIGNAL_UUID_AND_CARRIER_AND_WAKEUP_REFERENCE_AND_END_CONDITIONS_AND_ZERO_OR_ONE_OF_CONVERSATION_IDENT,
+    &PENDING_RESPONSE,
+    &ZERO_OR_MORE_OF_PENDING_RESPONSE,
+    &PENDING_RESPONSES,
+    &RESPONSE_CARRIER,
+    &PATTERN,
+    &ACTION,
+    &PARAMS,
+    &SEMANTIC_MAP,
+    &LIST_OF_CARRIER_AND_PATTERN_AND_ACTION_AND_PARAMS_AND_END_CONDITIONS_AND_ZERO_OR_ONE_OF_SEMANTIC_MAP_AND_ZERO_OR_ONE_OF_CONVERSATION_UUID,
+    &EXPECTATION,
+    &ZERO_OR_MORE_OF_EXPECTATION,
+    &CONVERSATION,
+    &ZERO_OR_MORE_OF_CONVERSATION,
+    &CONVERSATIONS,
+    &LIST_OF_CONVERSATION_UUID_AND_END_CONDITIONS_AND_CONVERSATIONS_AND_ZERO_OR_ONE_OF_WAKEUP_REFERENCE,
+    &TRANSCODER,
+    &OPERATOR,
+    &VALIDATOR,
+    &PROCESS_OF_STRUCTURE,
+    &PROCESS_OF_SYMBOL,
+    &PROCESS_OF_PROCESS,
+    &LOGICAL_OR_OF_PROCESS_OF_STRUCTURE_AND_PROCESS_OF_SYMBOL_AND_PROCESS_OF_PROCESS,
+    &PROCESS_OF,
+    &LOGICAL_OR_OF_TRANSCODER_AND_OPERATOR_AND_VALIDATOR,
+    &PROCESS_TYPE,
+    &TUPLE_OF_PROCESS_OF_AND_PROCESS_TYPE,
+    &PROCESS_LINK,
+    &PROCESS_NAME,
+    &PROCESS_INTENTION,
+    &PROCESS_SIGNATURE,
+    &ANY_SYMBOL,
+    &CODE,
+    &PROCESS_PURE,
+    &LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK_AND_ZERO_OR_ONE_OF_PROCESS_PURE,
+    &PROCESS_DEFINITION,
+    &ZERO_OR_MORE_OF_PROCESS_DEFINITION,
+    &GOAL,
+    &ROLE,
+    &USAGE,
+    &WEAL,
+    &SEMANTIC_REFERENCE,
+    &SLOT_IS_VALUE_OF,
+    &SLOT_CHILDREN,
+    &SLOT_STRUCTURE,
+    &SLOT,
+    &REPLACEMENT_VALUE,
+    &TUPLE_OF_SEMANTIC_REFERENCE_AND_REPLACEMENT_VALUE,
+    &SEMANTIC_LINK,
+    &SEMANTIC_LINKS,
+    &PROTOCOL_DEFAULTS,
+    &SIGNATURE_LABEL,
+    &SIGNATURE_STRUCTURE,
+    &SIGNATURE_SYMBOL,
+    &SIGNATURE_PROCESS,
+    &SIGNATURE_RECEPTOR,
+    &SIGNATURE_PROTOCOL,
+    &SIGNATURE_PASSTHRU,
+    &SIGNATURE_ANY,
+    &SIGNATURE_OPTIONAL,
+    &LOGICAL_OR_OF_SIGNATURE_STRUCTURE_AND_SIGNATURE_SYMBOL_AND_SIGNATURE_PROCESS_AND_SIGNATURE_PASSTHRU,
+    &SIGNATURE_OUTPUT_TYPE,
+    &SIGNATURE_SEMANTIC_VARIANTS,
+    &TUPLE_OF_SIGNATURE_SEMANTIC_VARIANTS_AND_ZERO_OR_ONE_OF_SIGNATURE_OPTIONAL,
+    &SIGNATURE_INPUT_TYPE,
+    &TUPLE_OF_SIGNATURE_LABEL_AND_SIGNATURE_INPUT_TYPE,
+    &INPUT_SIGNATURE,
+    &TUPLE_OF_SIGNATURE_LABEL_AND_SIGNATURE_OUTPUT_TYPE,
+    &OUTPUT_SIGNATURE,
+    &EXPECTED_SLOT,
+    &LIST_OF_ZERO_OR_MORE_OF_EXPECTED_SLOT,
+    &TEMPLATE_SIGNATURE,
+    &PROCESS_FORM,
+    &LIST_OF_CODE_AND_PARAMS_AND_ZERO_OR_ONE_OF_CODE_AND_ZERO_OR_ONE_OF_PARAMS,
+    &RUN_TREE,
+    &PARAM_REF,
+    &SIGNAL_REF,
+    &ZERO_OR_MORE_OF_ANY_SYMBOL,
+    &RESULT_SYMBOL,
+    &RESULT_STRUCTURE,
+    &RESULT_PROCESS,
+    &RESULT_RECEPTOR,
+    &RESULT_PROTOCOL,
+    &REDUCTION_ERROR_SYMBOL,
+    &ONE_OR_MORE_OF_ROLE,
+    &SOURCE,
+    &DESTINATION,
+    &LIST_OF_ROLE_AND_SOURCE_AND_PATTERN_AND_ACTION_AND_ZERO_OR_ONE_OF_PARAMS,
+    &EXPECT,
+    &LIST_OF_ROLE_AND_DESTINATION_AND_ACTION,
+    &INITIATE,
+    &PNAME,
+    &TUPLE_OF_PNAME_AND_ONE_OR_MORE_OF_LOGICAL_OR_OF_RESOLUTION_AND_LINKAGE,
+    &INCLUSION,
+    &INTERACTION,
+    &WHICH_INTERACTION,
+    &PROTOCOL_DEFINITION,
+    &ZERO_OR_MORE_OF_PROTOCOL_DEFINITION,
+    &ACTUAL_PROCESS,
+    &ACTUAL_RECEPTOR,
+    &ACTUAL_SYMBOL,
+    &ACTUAL_PROTOCOL,
+    &ACTUAL_VALUE,
+    &TUPLE_OF_GOAL_AND_ACTUAL_PROCESS,
+    &WHICH_PROCESS,
+    &TUPLE_OF_ROLE_AND_ACTUAL_RECEPTOR,
+    &WHICH_RECEPTOR,
+    &TUPLE_OF_USAGE_AND_ACTUAL_SYMBOL,
+    &WHICH_SYMBOL,
+    &TUPLE_OF_WEAL_AND_ACTUAL_PROTOCOL,
+    &WHICH_PROTOCOL,
+    &TUPLE_OF_ACTUAL_SYMBOL_AND_ACTUAL_VALUE,
+    &WHICH_VALUE,
+    &MAPPING,
+    &RESOLUTION,
+    &PAIR_OF_GOAL,
+    &WHICH_GOAL,
+    &PAIR_OF_ROLE,
+    &WHICH_ROLE,
+    &PAIR_OF_USAGE,
+    &WHICH_USAGE,
+    &PAIR_OF_WEAL,
+    &WHICH_WEAL,
+    &LINK,
+    &LINKAGE,
+    &ONE_OR_MORE_OF_RESOLUTION,
+    &PROTOCOL_BINDINGS,
+    &PROTOCOL_LABEL,
+    &LIST_OF_ZERO_OR_MORE_OF_ROLE_AND_ZERO_OR_MORE_OF_GOAL_AND_ZERO_OR_MORE_OF_USAGE_AND_ZERO_OR_MORE_OF_WEAL,
+    &PROTOCOL_SEMANTICS,
+    &LIST_OF_PROTOCOL_LABEL_AND_PROTOCOL_SEMANTICS_AND_ZERO_OR_MORE_OF_PROTOCOL_DEFAULTS_AND_ZERO_OR_MORE_OF_STRUCTURE_OF_INTERACTION_AND_ZERO_OR_MORE_OF_INCLUSION,
+    &ZERO_OR_MORE_OF_STRUCTURE_OF_SCAPE,
+    &MANIFEST_LABEL,
+    &MANIFEST_SPEC,
+    &TUPLE_OF_MANIFEST_LABEL_AND_MANIFEST_SPEC,
+    &MANIFEST_PAIR,
+    &ONE_OR_MORE_OF_MANIFEST_PAIR,
+    &MANIFEST,
+    &RECEPTOR_IDENTIFIER,
+    &LIST_OF_MANIFEST_AND_RECEPTOR_IDENTIFIER_AND_DEFINITIONS,
+    &RECEPTOR_PACKAGE,
+    &TUPLE_OF_MANIFEST_LABEL_AND_ANY_SYMBOL,
+    &BINDING_PAIR,
+    &ONE_OR_MORE_OF_BINDING_PAIR,
+    &BINDINGS,
+    &RECEPTOR_ELAPSED_TIME,
+    &PROFILED_PROCESS,
+    &PROFILE_CALLS,
+    &PROFILE_INCLUSIVE_TIME,
+    &PROFILE_EXCLUSIVE_TIME,
+    &PROFILE_ALLOCATIONS,
+    &PROFILE_ALLOCATED_BYTES,
+    &LIST_OF_PROFILED_PROCESS_AND_PROFILE_CALLS_AND_PROFILE_INCLUSIVE_TIME_AND_PROFILE_EXCLUSIVE_TIME_AND_PROFILE_ALLOCATIONS_AND_PROFILE_ALLOCATED_BYTES,
+    &PROCESS_PROFILE,
+    &ZERO_OR_MORE_OF_PROCESS_PROFILE,
+    &RECEPTOR_PROFILE,
+    &RECEPTOR_LABEL,
+    &RECEPTOR_IDENTITY,
+    &TUPLE_OF_RECEPTOR_LABEL_AND_DEFINITIONS,
+    &RECEPTOR_DEFINITION,
+    &ZERO_OR_MORE_OF_RECEPTOR_DEFINITION,
+    &LIST_OF_FLUX_AND_PENDING_SIGNALS_AND_PENDING_RESPONSES_AND_CONVERSATIONS_AND_RECEPTOR_ELAPSED_TIME,
+    &RECEPTOR_STATE,
+    &PARENT_CONTEXT_NUM,
+    &CONTEXT_NUM,
+    &INSTANCE_OF,
+    &LIST_OF_INSTANCE_OF_AND_CONTEXT_NUM_AND_PARENT_CONTEXT_NUM_AND_RECEPTOR_STATE,
+    &RECEPTOR_INSTANCE,
+    &SERIALIZED_RECEPTOR,
+    &ZERO_OR_MORE_OF_RECEPTOR_XADDR,
+    &ACTIVE_RECEPTORS,
+    &LIST_OF_ACTIVE_RECEPTORS,
+    &SYS_STATE,
+    &YEAR,
+    &MONTH,
+    &DAY,
+    &HOUR,
+    &MINUTE,
+    &SECOND,
+    &DATE,
+    &TIME,
+    &TODAY,
+    &NOW,
+    &TIMESTAMP,
+    &TICK,
+    &DELIMITER,
+    &US_SHORT_DATE,
+    &SHORT_TIME,
+    &ERROR_LOCATION,
+    &LIST_OF_ANY_SYMBOL,
+    &ERROR_DATA,
+    &REDUCTION_ERROR,
+    &ZERO_DIVIDE_ERR,
+    &TOO_FEW_PARAMS_ERR,
+    &TOO_MANY_PARAMS_ERR,
+    &SIGNATURE_MISMATCH_ERR,
+    &NOT_A_PROCESS_ERR,
+    &NOT_IN_SIGNAL_CONTEXT_ERR,
+    &INCOMPATIBLE_TYPE_ERR,
+    &UNIX_ERRNO_ERR,
+    &DEAD_STREAM_READ_ERR,
+    &MISSING_SEMANTIC_MAP_ERR,
+    &MISMATCH_SEMANTIC_MAP_ERR,
+    &STRUCTURE_MISMATCH_ERR,
+    &TIMEOUT_ERR,
+    &DUPLICATE_KEY_ERR,
+    &NO_SCAPE_ERR,
+    &UNORDERED_SCAPE_ERR,
+    &WHICH_XADDR,
+    &NEW_TYPE,
+    &QUERY_TYPE,
+    &ZERO_OR_MORE_OF_WHICH_XADDR,
+    &QUERY_RESULTS,
+    &TIMEOUT_AT,
+    &COUNT,
+    &UNLIMITED,
+    &LOGICAL_OR_OF_COUNT_AND_UNLIMITED,
+    &REPETITIONS,
+    &TUPLE_OF_ZERO_OR_ONE_OF_TIMEOUT_AT_AND_ZERO_OR_ONE_OF_REPETITIONS,
+    &EDGE_STREAM,
+    &EDGE_LISTENER,
+    &ITERATE_ON_SYMBOL,
+    &ITERATION_DATA,
+    &SCOPE,
+    &NOOP,
+    &DEF_SYMBOL,
+    &DEF_STRUCTURE,
+    &DEF_PROCESS,
+    &DEF_RECEPTOR,
+    &DEF_PROTOCOL,
+    &NEW,
+    &GET,
+    &DEL,
+    &QUERY,
+    &QUERY_RANGE,
+    &QUERY_PREFIX,
+    &DO,
+    &PARAM_PATH,
+    &STRUCTURE_OF_CSTRING,
+    &PARAM_LABEL,
+    &LOGICAL_OR_OF_PARAM_PATH_AND_PARAM_LABEL,
+    &PARAMETER_REFERENCE,
+    &RESULT_VALUE,
+    &RESULT_LABEL,
+    &LOGICAL_OR_OF_RESULT_SYMBOL_AND_RESULT_VALUE_AND_RESULT_LABEL,
+    &PARAMETER_RESULT,
+    &PARAMETER,
+    &DISSOLVE,
+    &TRANSCODE_TO,
+    &TUPLE_OF_TRANSCODE_TO_AND_ZERO_OR_MORE_OF_ANY_SYMBOL,
+    &TRANSCODE_PARAMS,
+    &TRANSCODE_ITEMS,
+    &TRANSCODE,
+    &LABEL_SYMBOL,
+    &LABEL_TYPE,
+    &GET_LABEL,
+    &PAIR_OF_ANY_SYMBOL,
+    &COND_PAIR,
+    &COND_ELSE,
+    &TUPLE_OF_ZERO_OR_MORE_OF_COND_PAIR_AND_COND_ELSE,
+    &CONDITIONS,
+    &COND,
+    &IF,
+    &ITERATE,
+    &SAY,
+    &REQUEST,
+    &CONVERSE,
+    &COMPLETE,
+    &THIS_SCOPE,
+    &SELF_ADDR,
+    &LISTEN,
+    &MATCH,
+    &RESPOND,
+    &QUOTE,
+    &FILL,
+    &FILL_FROM_MATCH,
+    &RAISE,
+    &STREAM_READ,
+    &STREAM_WRITE,
+    &STREAM_ALIVE,
+    &STREAM_CLOSE,
+    &CONCAT_STR,
+    &EXPAND_STR,
+    &CONTRACT_STR,
+    &ROPE_APPEND,
+    &EQUALITY_TEST_SYMBOL,
+    &EQ_SYM,
+    &ADD_INT,
+    &SUB_INT,
+    &MULT_INT,
+    &DIV_INT,
+    &MOD_INT,
+    &EQ_INT,
+    &LT_INT,
+    &GT_INT,
+    &LTE_INT,
+    &GTE_INT,
+    &POP_COUNT,
+    &POP_PATH,
+    &CONTINUE_LOCATION,
+    &CONTINUE_VALUE,
+    &CONTINUE,
+    &INITIATE_PROTOCOL,
+    &MAGIC,
+    &STX_SL,
+    &STX_OP,
+    &STX_CP,
+    &STX_SET,
+    &STX_OS,
+    &STX_CS,
+    &STX_LABEL,
+    &STX_OG,
+    &STX_CG,
+    &STX_EQ,
+    &STX_NEQ,
+    &STX_WALK,
+    &STX_STAR,
+    &STX_PLUS,
+    &STX_Q,
+    &STX_OR,
+    &STX_COMMA,
+    &STX_EXCEPT,
+    &STX_NOT,
+    &STX_VAL_S,
+    &STX_VAL_C,
+    &STX_VAL_I,
+    &STX_VAL_F,
+    &STX_TOKEN_LIST,
+    &STX_TOKENS,
+    &STX_SIBS,
+    &STX_CHILD,
+    &STX_POSTFIX,
+    &TREE_DELTA_PATH,
+    &TREE_DELTA_VALUE,
+    &TREE_DELTA_COUNT,
+    &TREE_DELTA,
+    &TREE_DELTA_ADD,
+    &TREE_DELTA_REPLACE,
+    &SYMBOL_INSTANCES,
+    &DELETED_INSTANCE,
+    &INSTANCE_TOKEN,
+    &LAST_TOKEN,
+    &ZERO_OR_MORE_OF_SYMBOL_INSTANCES,
+    &INSTANCES,
+    &TUPLE_OF_LAST_TOKEN_AND_ZERO_OR_MORE_OF_INSTANCE_TOKEN,
+    &INSTANCE_TOKENS,
+    &TUPLE_OF_INSTANCES_AND_ZERO_OR_ONE_OF_INSTANCE_TOKENS,
+    &INSTANCE_STORE,
+    &DEPENDENCY_HASH,
+    &TOKEN_XADDR,
+    &ENGLISH_LABEL,
+    &SPANISH_LABEL,
+    &FRENCH_LABEL,
+    &GERMAN_LABEL,
+    &P_OP,
+    &P_CP,
+    &P_COLON,
+    &P_INTERPOLATE,
+    &P_LABEL,
+    &P_VAL_S,
+    &P_VAL_C,
+    &P_VAL_I,
+    &P_VAL_F,
+    &P_VAL_PATH,
+    &ZERO_OR_MORE_OF_LOGICAL_OR_OF_P_OP_AND_P_CP_AND_P_COLON_AND_P_LABEL_AND_P_VAL_S_AND_P_VAL_C_AND_P_VAL_I_AND_P_VAL_F_AND_P_VAL_PATH,
+    &P_TOKENS,
+    &date2usshortdate,
+    &time2shortime,
+    &REQUESTER,
+    &RESPONDER,
+    &REQUEST_TYPE,
+    &RESPONSE_TYPE,
+    &CHANNEL,
+    &REQUEST_HANDLER,
+    &RESPONSE_HANDLER,
+    &RESPONSE_HANDLER_PARAMETERS,
+    &backnforth,
+    &send_request,
+    &send_response,
+    &REQUESTING,
+    &RECOGNIZER,
+    &RECOGNIZEE,
+    &RECOGNITION,
+    &are_you,
+    &i_am,
+    &fill_i_am,
+    &RECOGNIZE,
+    &LINE,
+    &ZERO_OR_MORE_OF_LINE,
+    &LINES,
+    &VERB,
+    &COMMAND_PARAMETER,
+    &COMMAND,
+    &SHELL_COMMAND,
+    &LINE_SENDER,
+    &COMMAND_RECEIVER,
+    &parse_line,
+    &COMMAND_TYPE,
+    &line_2_command,
+    &PARSE_COMMAND_FROM_LINE,
+    &COMMAND_SHELL,
+    &SERVER,
+    &CLIENT,
+    &PING,
+    &YUP,
+    &HANDLER,
+    &respond_with_yup,
+    &alive,
+    &ALIVE,
+    &GROUP,
+    &MEMBER,
+    &enrollment,
+    &converse,
+    &MESSAGE_TEXT,
+    &request_membership,
+    &enroll,
+    &speak,
+    &group_listen,
+    &group1,
+    &TEST_INT_SYMBOL,
+    &TEST_INT_SYMBOL2,
+    &TEST_INT64_SYMBOL,
+    &TEST_FLOAT_SYMBOL,
+    &TEST_STR_SYMBOL,
+    &TEST_TREE_SYMBOL,
+    &TEST_ANYTHING_SYMBOL,
+    &TEST_ANYTHING_SYMBOL2,
+    &TEST_NAME_SYMBOL,
+    &TEST_ALPHABETIZE_SCAPE_SYMBOL,
+    &TEST_SYMBOL_SYMBOL,
+    &TESTING,
+    &TEST_CHAR_SYMBOL,
+    &ZERO_OR_MORE_OF_TEST_INT_SYMBOL,
+    &TEST_INTEGERS,
+    &TIME_TELLER,
+    &TIME_HEARER,
+    &CLOCK_TELL_TIME,
+    &tell_time,
+    &time_request,
+    &OCTET_STREAM,
+    &PARAM_KEY,
+    &PARAM_VALUE,
+    &KEY_VALUE_PARAM,
+    &VERSION_MAJOR,
+    &VERSION_MINOR,
+    &VERSION,
+    &STATUS_VALUE,
+    &STATUS_TEXT,
+    &STATUS,
+    &HTTP_REQUEST_PATH_SEGMENT,
+    &ZERO_OR_MORE_OF_HTTP_REQUEST_PATH_SEGMENT,
+    &HTTP_REQUEST_PATH_SEGMENTS,
+    &FILE_NAME,
+    &FILE_EXTENSION,
+    &FILE_HANDLE,
+    &HTTP_REQUEST_PATH_FILE,
+    &HTTP_REQUEST_PATH_QUERY_PARAM,
+    &ZERO_OR_MORE_OF_HTTP_REQUEST_PATH_QUERY_PARAM,
+    &HTTP_REQUEST_PATH_QUERY_PARAMS,
+    &ZERO_OR_MORE_OF_HTTP_REQUEST_PATH_QUERY_PARAMS,
+    &HTTP_REQUEST_PATH_QUERY,
+    &URI,
+    &HTTP_HEADER_LABEL,
+    &MEDIA_TYPE_LABEL,
+    &MEDIA_TYPE_IDENT,
+    &MEDIA_SUBTYPE_IDENT,
+    &MEDIA_PARAM,
+    &MEDIA_TYPE,
+    &CONTENT_TYPE,
+    &TEXT_MEDIA_TYPE,
+    &HTML_TEXT_MEDIA_SUBTYPE,
+    &PLAIN_TEXT_MEDIA_SUBTYPE,
+    &CEPTR_TEXT_MEDIA_SUBTYPE,
+    &MEDIA_TYPE_SEPARATOR,
+    &HEADER_SEPARATOR,
+    &meda_type_2_ascii_str,
+    &content_type_2_line,
+    &CONTENT_ENCODING,
+    &HEADER_KEY,
+    &HEADER_VALUE,
+    &HEADER,
+    &LINE_HEADER,
+    &LIST_OF_ZERO_OR_MORE_OF_HEADER,
+    &LINE_HEADERS,
+    &HTTP_RESPONSE_HEADER,
+    &HTTP_GENERAL_HEADER,
+    &LOGICAL_OR_OF_CONTENT_TYPE_AND_CONTENT_ENCODING,
+    &HTTP_ENTITY_HEADER,
+    &HTTP_REQUEST_HOST,
+    &HTTP_REQUEST_USER_AGENT,
+    &HTTP_REQUEST_METHOD,
+    &HTTP_REQUEST_PATH,
+    &HTTP_REQUEST_VERSION,
+    &LIST_OF_HTTP_REQUEST_VERSION_AND_HTTP_REQUEST_METHOD_AND_HTTP_REQUEST_PATH,
+    &HTTP_REQUEST_LINE,
+    &HTTP_REQUEST_BODY,
+    &LOGICAL_OR_OF_HTTP_REQUEST_HOST_AND_HTTP_REQUEST_USER_AGENT,
+    &HTTP_REQUEST_HEADER,
+    &ZERO_OR_MORE_OF_LOGICAL_OR_OF_HTTP_REQUEST_HEADER_AND_HTTP_GENERAL_HEADER_AND_HTTP_ENTITY_HEADER,
+    &HTTP_REQUEST_HEADERS,
+    &LIST_OF_HTTP_REQUEST_LINE_AND_HTTP_REQUEST_HEADERS_AND_HTTP_REQUEST_BODY,
+    &HTTP_REQUEST,
+    &HTTP_RESPONSE_BODY,
+    &HTTP_RESPONSE_STATUS,
+    &LOGICAL_OR_OF_HTTP_GENERAL_HEADER_AND_HTTP_RESPONSE_HEADER_AND_HTTP_ENTITY_HEADER,
+    &HTTP_HEADER,
+    &ZERO_OR_MORE_OF_HTTP_HEADER,
+    &HTTP_HEADERS,
+    &LIST_OF_HTTP_RESPONSE_STATUS_AND_HTTP_HEADERS_AND_HTTP_RESPONSE_BODY,
+    &HTTP_RESPONSE,
+    & http_response_status_2_ascii_str,
+    &http_response_2_lines,
+    &HTML_DOCUMENT,
+    &HTML_TOK_TAG_OPEN,
+    &HTML_TOK_TAG_CLOSE,
+    &HTML_TOK_TAG_SELFCLOSE,
+    &HTML_TAG,
+    &HTML_TOKENS,
+    &HTML_ATTRIBUTE,
+    &ZERO_OR_MORE_OF_HTML_ATTRIBUTE,
+    &HTML_ATTRIBUTES,
+    &HTML_CONTENT,
+    &HTML_TEXT,
+    &HTML_ELEMENT,
+    &HTML_HTML,
+    &HTML_HEAD,
+    &HTML_TITLE,
+    &HTML_BODY,
+    &HTML_DIV,
+    &HTML_P,
+    &HTML_IMG,
+    &HTML_A,
+    &HTML_B,
+    &HTML_UL,
+    &HTML_OL,
+    &HTML_LI,
+    &HTML_SPAN,
+    &HTML_H1,
+    &HTML_H2,
+    &HTML_H3,
+    &HTML_H4,
+    &HTML_FORM,
+    &HTML_INPUT,
+    &HTML_BUTTON,
+    &HTTP_CLIENT,
+    &HTTP_SERVER,
+    &HTTP_REQUEST_PARSER,
+    &line_2_httpreq,
+    &PARSE_HTTP_REQUEST_FROM_LINE,
+    &ascii_chars_2_http_req,
+    &HTTP_ASPECT,
+    &HTTP_REQUEST_HANDLER,
+    &httpresp
+};
+T **G_base_def_data[] = {&G_http_req_example};
+
 void base_defs(SemTable *sem) {
   sT(SYS_CONTEXT,BIT,1,NULL_SYMBOL);
   sT(SYS_CONTEXT,INTEGER,1,NULL_SYMBOL);
@@ -793,6 +1525,8 @@ void base_defs(SemTable *sem) {
   sTs(SYS_CONTEXT,ONE_OR_MORE_OF_ASCII_CHAR,sT_PLUS(sT_SYM(ASCII_CHAR)));
   sY(SYS_CONTEXT,ASCII_CHARS,ONE_OR_MORE_OF_ASCII_CHAR);
   sY(SYS_CONTEXT,ASCII_STR,CSTRING);
+  sTs(SYS_CONTEXT,ROPE,sT_STAR(sT_PCNT(CSTRING)));
+  sY(SYS_CONTEXT,ASCII_ROPE,ROPE);
   sY(SYS_CONTEXT,RECEPTOR_XADDR,XADDR);
   sY(SYS_CONTEXT,EXPECTATIONS,NULL_STRUCTURE);
   sY(SYS_CONTEXT,SIGNALS,NULL_STRUCTURE);
@@ -800,7 +1534,13 @@ void base_defs(SemTable *sem) {
   sY(SYS_CONTEXT,DEFAULT_ASPECT,ASPECT);
   sTs(SYS_CONTEXT,ONE_OR_MORE_OF_STRUCTURE_OF_ASPECT,sT_PLUS(sT_PCNT(ASPECT)));
   sY(SYS_CONTEXT,FLUX,ONE_OR_MORE_OF_STRUCTURE_OF_ASPECT);
-  sY(SYS_CONTEXT,SCAPE_SPEC,NULL_STRUCTURE);
+  sY(SYS_CONTEXT,SCAPE_KEY_SOURCE,SYMBOL);
+  sY(SYS_CONTEXT,SCAPE_DATA_SOURCE,SYMBOL);
+  sY(SYS_CONTEXT,SCAPE_KEY_PATH,TREE_PATH);
+  sY(SYS_CONTEXT,SCAPE_MULTI,BIT);
+  sY(SYS_CONTEXT,SCAPE_ORDERED,BIT);
+  sTs(SYS_CONTEXT,LIST_OF_SCAPE_KEY_SOURCE_AND_SCAPE_DATA_SOURCE_AND_SCAPE_MULTI_AND_SCAPE_ORDERED_AND_ZERO_OR_ONE_OF_SCAPE_KEY_PATH,sT_SEQ(5,sT_SYM(SCAPE_KEY_SOURCE),sT_SYM(SCAPE_DATA_SOURCE),sT_SYM(SCAPE_MULTI),sT_SYM(SCAPE_ORDERED),sT_QMRK(sT_SYM(SCAPE_KEY_PATH))));
+  sY(SYS_CONTEXT,SCAPE_SPEC,LIST_OF_SCAPE_KEY_SOURCE_AND_SCAPE_DATA_SOURCE_AND_SCAPE_MULTI_AND_SCAPE_ORDERED_AND_ZERO_OR_ONE_OF_SCAPE_KEY_PATH);
   sY(SYS_CONTEXT,ASPECT_IDENT,SYMBOL);
   sY(SYS_CONTEXT,ASPECT_TYPE,BIT);
   sY(SYS_CONTEXT,ASPECT_LABEL,CSTRING);
@@ -873,8 +1613,9 @@ void base_defs(SemTable *sem) {
   sY(SYS_CONTEXT,PROCESS_SIGNATURE,NULL_STRUCTURE);
   sTs(SYS_CONTEXT,ANY_SYMBOL,sT_BANG);
   sY(SYS_CONTEXT,CODE,ANY_SYMBOL);
-  sTs(SYS_CONTEXT,LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK,sT_SEQ(5,sT_SYM(PROCESS_NAME),sT_SYM(PROCESS_INTENTION),sT_SYM(CODE),sT_SYM(PROCESS_SIGNATURE),sT_QMRK(sT_SYM(PROCESS_LINK))));
-  sY(SYS_CONTEXT,PROCESS_DEFINITION,LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK);
+  sY(SYS_CONTEXT,PROCESS_PURE,NULL_STRUCTURE);
+  sTs(SYS_CONTEXT,LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK_AND_ZERO_OR_ONE_OF_PROCESS_PURE,sT_SEQ(6,sT_SYM(PROCESS_NAME),sT_SYM(PROCESS_INTENTION),sT_SYM(CODE),sT_SYM(PROCESS_SIGNATURE),sT_QMRK(sT_SYM(PROCESS_LINK)),sT_QMRK(sT_SYM(PROCESS_PURE))));
+  sY(SYS_CONTEXT,PROCESS_DEFINITION,LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK_AND_ZERO_OR_ONE_OF_PROCESS_PURE);
   sTs(SYS_CONTEXT,ZERO_OR_MORE_OF_PROCESS_DEFINITION,sT_STAR(sT_SYM(PROCESS_DEFINITION)));
   sYs(SYS_CONTEXT,PROCESSES,ZERO_OR_MORE_OF_PROCESS_DEFINITION);
   sY(SYS_CONTEXT,GOAL,NULL_STRUCTURE);
@@ -996,6 +1737,16 @@ void base_defs(SemTable *sem) {
   sTs(SYS_CONTEXT,ONE_OR_MORE_OF_BINDING_PAIR,sT_PLUS(sT_SYM(BINDING_PAIR)));
   sY(SYS_CONTEXT,BINDINGS,ONE_OR_MORE_OF_BINDING_PAIR);
   sY(SYS_CONTEXT,RECEPTOR_ELAPSED_TIME,INTEGER);
+  sY(SYS_CONTEXT,PROFILED_PROCESS,PROCESS);
+  sY(SYS_CONTEXT,PROFILE_CALLS,INTEGER64);
+  sY(SYS_CONTEXT,PROFILE_INCLUSIVE_TIME,INTEGER64);
+  sY(SYS_CONTEXT,PROFILE_EXCLUSIVE_TIME,INTEGER64);
+  sY(SYS_CONTEXT,PROFILE_ALLOCATIONS,INTEGER64);
+  sY(SYS_CONTEXT,PROFILE_ALLOCATED_BYTES,INTEGER64);
+  sTs(SYS_CONTEXT,LIST_OF_PROFILED_PROCESS_AND_PROFILE_CALLS_AND_PROFILE_INCLUSIVE_TIME_AND_PROFILE_EXCLUSIVE_TIME_AND_PROFILE_ALLOCATIONS_AND_PROFILE_ALLOCATED_BYTES,sT_SEQ(6,sT_SYM(PROFILED_PROCESS),sT_SYM(PROFILE_CALLS),sT_SYM(PROFILE_INCLUSIVE_TIME),sT_SYM(PROFILE_EXCLUSIVE_TIME),sT_SYM(PROFILE_ALLOCATIONS),sT_SYM(PROFILE_ALLOCATED_BYTES)));
+  sY(SYS_CONTEXT,PROCESS_PROFILE,LIST_OF_PROFILED_PROCESS_AND_PROFILE_CALLS_AND_PROFILE_INCLUSIVE_TIME_AND_PROFILE_EXCLUSIVE_TIME_AND_PROFILE_ALLOCATIONS_AND_PROFILE_ALLOCATED_BYTES);
+  sTs(SYS_CONTEXT,ZERO_OR_MORE_OF_PROCESS_PROFILE,sT_STAR(sT_SYM(PROCESS_PROFILE)));
+  sY(SYS_CONTEXT,RECEPTOR_PROFILE,ZERO_OR_MORE_OF_PROCESS_PROFILE);
   sY(SYS_CONTEXT,RECEPTOR_LABEL,LABEL);
   sT(SYS_CONTEXT,RECEPTOR_IDENTITY,2,RECEPTOR_LABEL,RECEPTOR_IDENTIFIER);
   sTs(SYS_CONTEXT,TUPLE_OF_RECEPTOR_LABEL_AND_DEFINITIONS,sT_SEQ(2,sT_SYM(RECEPTOR_LABEL),sT_SYM(DEFINITIONS)));
@@ -1045,8 +1796,15 @@ void base_defs(SemTable *sem) {
   sY(SYS_CONTEXT,MISSING_SEMANTIC_MAP_ERR,REDUCTION_ERROR);
   sY(SYS_CONTEXT,MISMATCH_SEMANTIC_MAP_ERR,REDUCTION_ERROR);
   sY(SYS_CONTEXT,STRUCTURE_MISMATCH_ERR,REDUCTION_ERROR);
+  sY(SYS_CONTEXT,TIMEOUT_ERR,REDUCTION_ERROR);
+  sY(SYS_CONTEXT,DUPLICATE_KEY_ERR,REDUCTION_ERROR);
+  sY(SYS_CONTEXT,NO_SCAPE_ERR,REDUCTION_ERROR);
+  sY(SYS_CONTEXT,UNORDERED_SCAPE_ERR,REDUCTION_ERROR);
   sY(SYS_CONTEXT,WHICH_XADDR,XADDR);
   sY(SYS_CONTEXT,NEW_TYPE,SYMBOL);
+  sY(SYS_CONTEXT,QUERY_TYPE,SYMBOL);
+  sTs(SYS_CONTEXT,ZERO_OR_MORE_OF_WHICH_XADDR,sT_STAR(sT_SYM(WHICH_XADDR)));
+  sY(SYS_CONTEXT,QUERY_RESULTS,ZERO_OR_MORE_OF_WHICH_XADDR);
   sY(SYS_CONTEXT,TIMEOUT_AT,TIMESTAMP);
   sY(SYS_CONTEXT,COUNT,INTEGER);
   sY(SYS_CONTEXT,UNLIMITED,NULL_STRUCTURE);
@@ -1068,6 +1826,9 @@ void base_defs(SemTable *sem) {
   sP(SYS_CONTEXT,NEW,0,"new instance","xaddr",SIGNATURE_SYMBOL,WHICH_XADDR,"what",SIGNATURE_SYMBOL,NEW_TYPE,"value",SIGNATURE_ANY,NULL_STRUCTURE,0L);
   sP(SYS_CONTEXT,GET,0,"get instance value","value",SIGNATURE_ANY,NULL_STRUCTURE,"what",SIGNATURE_SYMBOL,WHICH_XADDR,0L);
   sP(SYS_CONTEXT,DEL,0,"delete instance","value",SIGNATURE_ANY,NULL_STRUCTURE,"what",SIGNATURE_SYMBOL,WHICH_XADDR,0L);
+  sP(SYS_CONTEXT,QUERY,0,"query instances","results",SIGNATURE_SYMBOL,QUERY_RESULTS,"of",SIGNATURE_SYMBOL,QUERY_TYPE,"key",SIGNATURE_ANY,NULL_STRUCTURE,0L);
+  sP(SYS_CONTEXT,QUERY_RANGE,0,"query a range of instances","results",SIGNATURE_SYMBOL,QUERY_RESULTS,"of",SIGNATURE_SYMBOL,QUERY_TYPE,"from",SIGNATURE_ANY,NULL_STRUCTURE,"to",SIGNATURE_OPTIONAL,SIGNATURE_ANY,NULL_STRUCTURE,0L);
+  sP(SYS_CONTEXT,QUERY_PREFIX,0,"query instances by key prefix","results",SIGNATURE_SYMBOL,QUERY_RESULTS,"of",SIGNATURE_SYMBOL,QUERY_TYPE,"prefix",SIGNATURE_ANY,NULL_STRUCTURE,0L);
   sP(SYS_CONTEXT,DO,0,"do","result",SIGNATURE_PASSTHRU,NULL_STRUCTURE,"actions",SIGNATURE_SYMBOL,SCOPE,0L);
   sY(SYS_CONTEXT,PARAM_PATH,TREE_PATH);
   sTs(SYS_CONTEXT,STRUCTURE_OF_CSTRING,sT_PCNT(CSTRING));
@@ -1116,6 +1877,7 @@ void base_defs(SemTable *sem) {
   sP(SYS_CONTEXT,CONCAT_STR,0,"concatinate strings","concatenation",SIGNATURE_STRUCTURE,CSTRING,"into",SIGNATURE_SYMBOL,RESULT_SYMBOL,"str1",SIGNATURE_STRUCTURE,CSTRING,"str2",SIGNATURE_STRUCTURE,CSTRING,0L);
   sP(SYS_CONTEXT,EXPAND_STR,0,"expand string","ascii tree",SIGNATURE_SYMBOL,ASCII_CHARS,"str",SIGNATURE_STRUCTURE,CSTRING,0L);
   sP(SYS_CONTEXT,CONTRACT_STR,0,"contract to string","string",SIGNATURE_STRUCTURE,CSTRING,"into",SIGNATURE_SYMBOL,RESULT_SYMBOL,0L);
+  sP(SYS_CONTEXT,ROPE_APPEND,0,"append to rope","rope",SIGNATURE_STRUCTURE,ROPE,"rope",SIGNATURE_STRUCTURE,ROPE,"str",SIGNATURE_ANY,NULL_STRUCTURE,0L);
   sY(SYS_CONTEXT,EQUALITY_TEST_SYMBOL,SYMBOL);
   sP(SYS_CONTEXT,EQ_SYM,0,"test equality","equality",SIGNATURE_SYMBOL,BOOLEAN,"symbol1",SIGNATURE_STRUCTURE,SYMBOL,"symbol2",SIGNATURE_STRUCTURE,SYMBOL,0L);
   sP(SYS_CONTEXT,ADD_INT,0,"addition","sum",SIGNATURE_STRUCTURE,INTEGER,"augend",SIGNATURE_STRUCTURE,INTEGER,"addend",SIGNATURE_STRUCTURE,INTEGER,0L);
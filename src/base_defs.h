@@ -15,6 +15,11 @@
 
 void base_defs(SemTable *sem);
 void base_contexts(SemTable *sem);
+#define BASE_DEFS_HASH 0x5a6bf745
+#define NUM_BASE_DEF_IDS 698
+#define NUM_BASE_DEF_DATA 1
+extern SemanticID *G_base_def_ids[];
+extern T **G_base_def_data[];
 SemanticID SYS_RECEPTOR;
 SemanticID COMPOSITORY;
 SemanticID DEV_COMPOSITORY;
@@ -76,11 +81,17 @@ enum SYSSymbolIDs {
     ASCII_CHAR_ID,
     ASCII_CHARS_ID,
     ASCII_STR_ID,
+    ASCII_ROPE_ID,
     RECEPTOR_XADDR_ID,
     EXPECTATIONS_ID,
     SIGNALS_ID,
     DEFAULT_ASPECT_ID,
     FLUX_ID,
+    SCAPE_KEY_SOURCE_ID,
+    SCAPE_DATA_SOURCE_ID,
+    SCAPE_KEY_PATH_ID,
+    SCAPE_MULTI_ID,
+    SCAPE_ORDERED_ID,
     SCAPE_SPEC_ID,
     ASPECT_IDENT_ID,
     ASPECT_TYPE_ID,
@@ -130,6 +141,7 @@ enum SYSSymbolIDs {
     PROCESS_INTENTION_ID,
     PROCESS_SIGNATURE_ID,
     CODE_ID,
+    PROCESS_PURE_ID,
     PROCESS_DEFINITION_ID,
     GOAL_ID,
     ROLE_ID,
@@ -201,6 +213,14 @@ enum SYSSymbolIDs {
     BINDING_PAIR_ID,
     BINDINGS_ID,
     RECEPTOR_ELAPSED_TIME_ID,
+    PROFILED_PROCESS_ID,
+    PROFILE_CALLS_ID,
+    PROFILE_INCLUSIVE_TIME_ID,
+    PROFILE_EXCLUSIVE_TIME_ID,
+    PROFILE_ALLOCATIONS_ID,
+    PROFILE_ALLOCATED_BYTES_ID,
+    PROCESS_PROFILE_ID,
+    RECEPTOR_PROFILE_ID,
     RECEPTOR_LABEL_ID,
     RECEPTOR_DEFINITION_ID,
     RECEPTOR_STATE_ID,
@@ -237,8 +257,14 @@ enum SYSSymbolIDs {
     MISSING_SEMANTIC_MAP_ERR_ID,
     MISMATCH_SEMANTIC_MAP_ERR_ID,
     STRUCTURE_MISMATCH_ERR_ID,
+    TIMEOUT_ERR_ID,
+    DUPLICATE_KEY_ERR_ID,
+    NO_SCAPE_ERR_ID,
+    UNORDERED_SCAPE_ERR_ID,
     WHICH_XADDR_ID,
     NEW_TYPE_ID,
+    QUERY_TYPE_ID,
+    QUERY_RESULTS_ID,
     TIMEOUT_AT_ID,
     COUNT_ID,
     UNLIMITED_ID,
@@ -360,11 +386,17 @@ SemanticID SEMTREX_MATCH_SIBLINGS_COUNT;
 SemanticID ASCII_CHAR;
 SemanticID ASCII_CHARS;
 SemanticID ASCII_STR;
+SemanticID ASCII_ROPE;
 SemanticID RECEPTOR_XADDR;
 SemanticID EXPECTATIONS;
 SemanticID SIGNALS;
 SemanticID DEFAULT_ASPECT;
 SemanticID FLUX;
+SemanticID SCAPE_KEY_SOURCE;
+SemanticID SCAPE_DATA_SOURCE;
+SemanticID SCAPE_KEY_PATH;
+SemanticID SCAPE_MULTI;
+SemanticID SCAPE_ORDERED;
 SemanticID SCAPE_SPEC;
 SemanticID ASPECT_IDENT;
 SemanticID ASPECT_TYPE;
@@ -414,6 +446,7 @@ SemanticID PROCESS_NAME;
 SemanticID PROCESS_INTENTION;
 SemanticID PROCESS_SIGNATURE;
 SemanticID CODE;
+SemanticID PROCESS_PURE;
 SemanticID PROCESS_DEFINITION;
 SemanticID GOAL;
 SemanticID ROLE;
@@ -485,6 +518,14 @@ SemanticID RECEPTOR_PACKAGE;
 SemanticID BINDING_PAIR;
 SemanticID BINDINGS;
 SemanticID RECEPTOR_ELAPSED_TIME;
+SemanticID PROFILED_PROCESS;
+SemanticID PROFILE_CALLS;
+SemanticID PROFILE_INCLUSIVE_TIME;
+SemanticID PROFILE_EXCLUSIVE_TIME;
+SemanticID PROFILE_ALLOCATIONS;
+SemanticID PROFILE_ALLOCATED_BYTES;
+SemanticID PROCESS_PROFILE;
+SemanticID RECEPTOR_PROFILE;
 SemanticID RECEPTOR_LABEL;
 SemanticID RECEPTOR_DEFINITION;
 SemanticID RECEPTOR_STATE;
@@ -521,8 +562,14 @@ SemanticID DEAD_STREAM_READ_ERR;
 SemanticID MISSING_SEMANTIC_MAP_ERR;
 SemanticID MISMATCH_SEMANTIC_MAP_ERR;
 SemanticID STRUCTURE_MISMATCH_ERR;
+SemanticID TIMEOUT_ERR;
+SemanticID DUPLICATE_KEY_ERR;
+SemanticID NO_SCAPE_ERR;
+SemanticID UNORDERED_SCAPE_ERR;
 SemanticID WHICH_XADDR;
 SemanticID NEW_TYPE;
+SemanticID QUERY_TYPE;
+SemanticID QUERY_RESULTS;
 SemanticID TIMEOUT_AT;
 SemanticID COUNT;
 SemanticID UNLIMITED;
@@ -639,8 +686,10 @@ enum SYSStructureIDs {
     ONE_OR_MORE_OF_ANY_SYMBOL_ID,
     SEMTREX_VALUE_LITERAL_DEF_ID,
     ONE_OR_MORE_OF_ASCII_CHAR_ID,
+    ROPE_ID,
     ASPECT_ID,
     ONE_OR_MORE_OF_STRUCTURE_OF_ASPECT_ID,
+    LIST_OF_SCAPE_KEY_SOURCE_AND_SCAPE_DATA_SOURCE_AND_SCAPE_MULTI_AND_SCAPE_ORDERED_AND_ZERO_OR_ONE_OF_SCAPE_KEY_PATH_ID,
     TUPLE_OF_ASPECT_TYPE_AND_ASPECT_LABEL_ID,
     ONE_OR_MORE_OF_ASPECT_DEF_ID,
     ONE_OR_MORE_OF_RECEPTOR_PATH_ID,
@@ -662,7 +711,7 @@ enum SYSStructureIDs {
     LOGICAL_OR_OF_TRANSCODER_AND_OPERATOR_AND_VALIDATOR_ID,
     TUPLE_OF_PROCESS_OF_AND_PROCESS_TYPE_ID,
     ANY_SYMBOL_ID,
-    LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK_ID,
+    LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK_AND_ZERO_OR_ONE_OF_PROCESS_PURE_ID,
     ZERO_OR_MORE_OF_PROCESS_DEFINITION_ID,
     SEMANTIC_REFERENCE_ID,
     SLOT_STRUCTURE_ID,
@@ -703,6 +752,8 @@ enum SYSStructureIDs {
     LIST_OF_MANIFEST_AND_RECEPTOR_IDENTIFIER_AND_DEFINITIONS_ID,
     TUPLE_OF_MANIFEST_LABEL_AND_ANY_SYMBOL_ID,
     ONE_OR_MORE_OF_BINDING_PAIR_ID,
+    LIST_OF_PROFILED_PROCESS_AND_PROFILE_CALLS_AND_PROFILE_INCLUSIVE_TIME_AND_PROFILE_EXCLUSIVE_TIME_AND_PROFILE_ALLOCATIONS_AND_PROFILE_ALLOCATED_BYTES_ID,
+    ZERO_OR_MORE_OF_PROCESS_PROFILE_ID,
     RECEPTOR_IDENTITY_ID,
     TUPLE_OF_RECEPTOR_LABEL_AND_DEFINITIONS_ID,
     ZERO_OR_MORE_OF_RECEPTOR_DEFINITION_ID,
@@ -715,6 +766,7 @@ enum SYSStructureIDs {
     TIMESTAMP_ID,
     LIST_OF_ANY_SYMBOL_ID,
     REDUCTION_ERROR_ID,
+    ZERO_OR_MORE_OF_WHICH_XADDR_ID,
     LOGICAL_OR_OF_COUNT_AND_UNLIMITED_ID,
     TUPLE_OF_ZERO_OR_ONE_OF_TIMEOUT_AT_AND_ZERO_OR_ONE_OF_REPETITIONS_ID,
     STRUCTURE_OF_CSTRING_ID,
@@ -769,8 +821,10 @@ SemanticID ZERO_OR_ONE_OF_ANY_SYMBOL;
 SemanticID ONE_OR_MORE_OF_ANY_SYMBOL;
 SemanticID SEMTREX_VALUE_LITERAL_DEF;
 SemanticID ONE_OR_MORE_OF_ASCII_CHAR;
+SemanticID ROPE;
 SemanticID ASPECT;
 SemanticID ONE_OR_MORE_OF_STRUCTURE_OF_ASPECT;
+SemanticID LIST_OF_SCAPE_KEY_SOURCE_AND_SCAPE_DATA_SOURCE_AND_SCAPE_MULTI_AND_SCAPE_ORDERED_AND_ZERO_OR_ONE_OF_SCAPE_KEY_PATH;
 SemanticID TUPLE_OF_ASPECT_TYPE_AND_ASPECT_LABEL;
 SemanticID ONE_OR_MORE_OF_ASPECT_DEF;
 SemanticID ONE_OR_MORE_OF_RECEPTOR_PATH;
@@ -792,7 +846,7 @@ SemanticID LOGICAL_OR_OF_PROCESS_OF_STRUCTURE_AND_PROCESS_OF_SYMBOL_AND_PROCESS_
 SemanticID LOGICAL_OR_OF_TRANSCODER_AND_OPERATOR_AND_VALIDATOR;
 SemanticID TUPLE_OF_PROCESS_OF_AND_PROCESS_TYPE;
 SemanticID ANY_SYMBOL;
-SemanticID LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK;
+SemanticID LIST_OF_PROCESS_NAME_AND_PROCESS_INTENTION_AND_CODE_AND_PROCESS_SIGNATURE_AND_ZERO_OR_ONE_OF_PROCESS_LINK_AND_ZERO_OR_ONE_OF_PROCESS_PURE;
 SemanticID ZERO_OR_MORE_OF_PROCESS_DEFINITION;
 SemanticID SEMANTIC_REFERENCE;
 SemanticID SLOT_STRUCTURE;
@@ -833,6 +887,8 @@ SemanticID ONE_OR_MORE_OF_MANIFEST_PAIR;
 SemanticID LIST_OF_MANIFEST_AND_RECEPTOR_IDENTIFIER_AND_DEFINITIONS;
 SemanticID TUPLE_OF_MANIFEST_LABEL_AND_ANY_SYMBOL;
 SemanticID ONE_OR_MORE_OF_BINDING_PAIR;
+SemanticID LIST_OF_PROFILED_PROCESS_AND_PROFILE_CALLS_AND_PROFILE_INCLUSIVE_TIME_AND_PROFILE_EXCLUSIVE_TIME_AND_PROFILE_ALLOCATIONS_AND_PROFILE_ALLOCATED_BYTES;
+SemanticID ZERO_OR_MORE_OF_PROCESS_PROFILE;
 SemanticID RECEPTOR_IDENTITY;
 SemanticID TUPLE_OF_RECEPTOR_LABEL_AND_DEFINITIONS;
 SemanticID ZERO_OR_MORE_OF_RECEPTOR_DEFINITION;
@@ -845,6 +901,7 @@ SemanticID TIME;
 SemanticID TIMESTAMP;
 SemanticID LIST_OF_ANY_SYMBOL;
 SemanticID REDUCTION_ERROR;
+SemanticID ZERO_OR_MORE_OF_WHICH_XADDR;
 SemanticID LOGICAL_OR_OF_COUNT_AND_UNLIMITED;
 SemanticID TUPLE_OF_ZERO_OR_ONE_OF_TIMEOUT_AT_AND_ZERO_OR_ONE_OF_REPETITIONS;
 SemanticID STRUCTURE_OF_CSTRING;
@@ -872,6 +929,9 @@ enum SYSProcessIDs {
     NEW_ID,
     GET_ID,
     DEL_ID,
+    QUERY_ID,
+    QUERY_RANGE_ID,
+    QUERY_PREFIX_ID,
     DO_ID,
     PARAMETER_ID,
     DISSOLVE_ID,
@@ -900,6 +960,7 @@ enum SYSProcessIDs {
     CONCAT_STR_ID,
     EXPAND_STR_ID,
     CONTRACT_STR_ID,
+    ROPE_APPEND_ID,
     EQ_SYM_ID,
     ADD_INT_ID,
     SUB_INT_ID,
@@ -926,6 +987,9 @@ SemanticID DEF_PROTOCOL;
 SemanticID NEW;
 SemanticID GET;
 SemanticID DEL;
+SemanticID QUERY;
+SemanticID QUERY_RANGE;
+SemanticID QUERY_PREFIX;
 SemanticID DO;
 SemanticID PARAMETER;
 SemanticID DISSOLVE;
@@ -954,6 +1018,7 @@ SemanticID STREAM_CLOSE;
 SemanticID CONCAT_STR;
 SemanticID EXPAND_STR;
 SemanticID CONTRACT_STR;
+SemanticID ROPE_APPEND;
 SemanticID EQ_SYM;
 SemanticID ADD_INT;
 SemanticID SUB_INT;
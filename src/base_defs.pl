@@ -10,11 +10,16 @@
 use strict;
 use warnings;
 use Data::Dumper;
+use Digest::MD5;
 
 my $fh = openf('<','src/base_defs');
 my $cfh = openf('>','src/base_defs.c');
 my $hfh = openf('>','src/base_defs.h');
 
+# everything the base definitions image depends on (the Makefile's prerequisites of
+# src/base_defs.h need to be kept the same)
+my @image_sources = ('src/base_defs','src/def.c','src/sys_defs.c','src/semtable.c','src/tree.c','src/mtree.c','src/mtree.h','src/ceptr_types.h','src/tools/mkimage.c');
+
 sub openf {
     my $rw = shift;
     my $fn = shift;
@@ -247,14 +252,25 @@ foreach my $CTX (@contexts) {
     print $cfh "SemanticID $ctx_name={0,0,0};\n";
 }
 
+my @ids;
+foreach my $CTX (@contexts) {
+    push @ids,&makeRecptorName($CTX);
+}
 foreach my $s (@d) {
     my @x = @$s;
     next if ($x[0] eq 'SetSymbol');
     next if ($x[0] eq 'Data');
     next if ($x[0] eq 'Label');
     print $cfh "SemanticID $x[2]={0,0,0};\n";
+    push @ids,$x[2];
 }
 
+# everything that base_defs sets up outside of the definitions tree, for the prebuilt
+# image in base_defs_image.c to restore
+print $cfh "\nSemanticID *G_base_def_ids[] = {\n".join(",\n",map {"    &$_"} @ids)."\n};\n";
+my @data = map {"&G_$_"} sort keys %global_data;
+print $cfh "T **G_base_def_data[] = {".join(',',@data)."};\n";
+
 print $cfh "\n";
 
 
@@ -305,6 +321,21 @@ void base_defs(SemTable *sem);
 void base_contexts(SemTable *sem);
 EOF
 
+# a digest of the source, and of the code that builds, serializes and restores the definitions,
+# so that a prebuilt image of different definitions won't get used (the layout of the serialized
+# data is mixed in at compile time, see BASE_DEFS_IMAGE_HASH)
+my $digest = Digest::MD5->new;
+foreach my $src (@image_sources) {
+    open(my $dfh,'<:raw',$src) or die "Could not open '$src' $!";
+    $digest->add(do {local $/; <$dfh>});
+    close $dfh;
+}
+print $hfh '#define BASE_DEFS_HASH 0x'.substr($digest->hexdigest,0,8)."\n";
+print $hfh '#define NUM_BASE_DEF_IDS '.scalar(@ids)."\n";
+print $hfh '#define NUM_BASE_DEF_DATA '.scalar(@data)."\n";
+print $hfh "extern SemanticID *G_base_def_ids[];\n";
+print $hfh "extern T **G_base_def_data[];\n";
+
 my @ctxe;
 foreach my $CTX (@contexts) {
     push @ctxe,$CTX."_CONTEXT";
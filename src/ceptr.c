@@ -9,7 +9,9 @@
 #include "accumulator.h"
 #include "shell.h"
 #include "protocol.h"
+#include "trace.h"
 #include <stdio.h>
+#include <string.h>
 
 void setupHTTP(VMHost *v) {
 
@@ -25,7 +27,7 @@ void setupHTTP(VMHost *v) {
     // add an error handler that just completes the iteration
     T *err_handler = _t_parse(r->sem,0,"(CONTINUE (POP_PATH (PARAM_REF:/4/1/1) (RESULT_SYMBOL:CONTINUE_LOCATION) (POP_COUNT:5)) (CONTINUE_VALUE (BOOLEAN:0)))");
 
-    SocketListener *l = _r_addListener(r,8888,code,0,err_handler,DELIM_CRLF);
+    SocketListener *l = _r_addListener(r,8888,code,0,err_handler,DELIM_CRLF,StreamUnitHTTP);
     _v_activate(v,edge);
 
     T *bindings = _t_new_root(PROTOCOL_BINDINGS);
@@ -44,6 +46,14 @@ void setupHTTP(VMHost *v) {
 
 int main(int argc, const char **argv) {
 
+    // ceptr --trace <file> traces all the reductions and writes the trace to file on quitting
+    const char *trace_file = NULL;
+    if (argc == 3 && !strcmp(argv[1],"--trace")) trace_file = argv[2];
+    else if (argc > 1) {
+        fprintf(stderr,"usage: %s [--trace <file>]\n",argv[0]);
+        return 1;
+    }
+
     G_sem = def_sys();
     //char *dname = "tmp/shell_vm";
     //_a_boot(dname);
@@ -63,6 +73,7 @@ int main(int argc, const char **argv) {
 
     setupHTTP(G_vm);
 
+    if (trace_file) _v_trace(G_vm,TRACE_BUFFER_SIZE);
     _v_start_vmhost(G_vm);
 
     while (G_vm->r->state == Alive) {
@@ -72,6 +83,15 @@ int main(int argc, const char **argv) {
     _v_join_thread(&G_vm->clock_thread);
     _v_join_thread(&G_vm->vm_thread);
 
+    if (trace_file) {
+        FILE *f = fopen(trace_file,"w");
+        if (!f) fprintf(stderr,"unable to write trace to %s\n",trace_file);
+        else {
+            _v_dump_trace(G_vm,f);
+            fclose(f);
+        }
+    }
+
     sys_free(G_sem);
     return 0;
 }
@@ -9,6 +9,7 @@
 // NOTE: the actual values of the types matter because they must match the order they show
 // up in the definition trees
 enum SemanticTypes {SEM_TYPE_STRUCTURE=1,SEM_TYPE_SYMBOL,SEM_TYPE_PROCESS,SEM_TYPE_RECEPTOR,SEM_TYPE_PROTOCOL};
+#define MAX_SEM_TYPE SEM_TYPE_PROTOCOL
 #define is_symbol(s) ((s).semtype == SEM_TYPE_SYMBOL)
 #define is_process(s) ((s).semtype == SEM_TYPE_PROCESS)
 #define is_structure(s) ((s).semtype == SEM_TYPE_STRUCTURE)
@@ -152,8 +153,51 @@ typedef struct table_elem {
 } table_elem;
 typedef table_elem *LabelTable;
 
-// for now store instances in an INSTANCES semantic tree
-typedef T *Instances;
+// index entry for the instances of one symbol in an instance store
+typedef struct SymbolInstances {
+    Symbol symbol;       ///< key
+    T *instances;        ///< the SYMBOL_INSTANCES node holding the instances
+    int *free;           ///< stack of addresses of deleted instances available for reuse
+    int free_count;
+    int free_size;
+    bool dirty;          ///< changed since the instances were last checkpointed
+    UT_hash_handle hh;
+} SymbolInstances;
+
+// for now store instances in an INSTANCES semantic tree, indexed by symbol
+typedef struct InstanceStore {
+    T *store;                ///< INSTANCE_STORE semantic tree
+    SymbolInstances *index;  ///< the SYMBOL_INSTANCES of the store hashed by symbol
+    struct Scape *scapes;    ///< scapes kept up to date with the instances
+} InstanceStore;
+typedef InstanceStore *Instances;
+
+/// Mmagic of a serialized instance store, with the version of the format in the low byte
+#define INSTANCES_MAGIC 0x43495300
+#define INSTANCES_VERSION 2
+enum InstanceSectionFlags {InstanceSectionExternal=1};
+
+// entry in the section table of a serialized instance store
+typedef struct InstanceSection {
+    Symbol symbol;
+    uint32_t count;      ///< number of instance slots, deleted ones included
+    uint32_t flags;      ///< InstanceSectionExternal if the instances are checkpointed to a file of their own
+    size_t offset;       ///< of the instances from the start of the image
+    size_t length;
+} InstanceSection;
+
+// a serialized instance store, which starts out like an S so it can be handled like one.
+// each section holds the slots of a symbol in order, as a size_t length (0 for a deleted
+// instance) followed by the serialized instance, everything aligned to 8 bytes.  From
+// version 2 the slots of receptors also have the receptor's context between the two, so a
+// stub can be made for it without unserializing it.
+typedef struct InstanceImage {
+    Mmagic magic;        ///< INSTANCES_MAGIC|INSTANCES_VERSION
+    size_t total_size;
+    uint32_t sections;   ///< number of entries in the section table
+    size_t scapes;       ///< offset of the serialized SCAPE_SPECs, 0 if there aren't any
+    InstanceSection section[];
+} InstanceImage;
 
 typedef struct ConversationState ConversationState;
 struct ConversationState {
@@ -177,6 +221,10 @@ struct R {
     R *callee;        ///< a pointer to the context we've invoked
     T *sem_map;       ///< semantic map in effect for this context
     ConversationState *conversation;  ///< record of the conversation state active in this context frame
+    Process memo;     ///< pure process whose result this context is to memoize (or NULL_PROCESS)
+    TreeHash memo_hash; ///< hash of the process node this context was called from
+    T *memo_params;   ///< copy of that process node, to tell apart calls whose hashes collide
+    Process process;  ///< the defined process this context is running (NULL_PROCESS for plain run trees)
 };
 
 // ** structure to hold in process accounting
@@ -185,6 +233,106 @@ struct Accounting {
     uint64_t elapsed_time;
 };
 
+// link for a free frame, stored in the first bytes of the frame itself
+typedef struct Frame Frame;
+struct Frame {
+    Frame *next;
+};
+
+// pool of free same-sized frames for reuse, with occupancy statistics
+typedef struct FramePool {
+    Frame *free;         ///< lock-free stack of free frames
+    int free_count;      ///< number of frames on the free stack
+    int in_use;          ///< number of frames currently handed out by the pool
+    int peak;            ///< high water mark of in_use
+    uint64_t allocs;     ///< total number of frames handed out
+    uint64_t reuses;     ///< how many of those came off the free stack rather than malloc
+} FramePool;
+
+// kinds of reduction trace events
+enum TraceEventType {TraceStepBegin,TraceStepEnd,TraceBlock,TraceUnblock,TraceDeliver,TraceMatch};
+
+// fixed size binary reduction trace event
+typedef struct TraceEvent {
+    uint64_t time;       ///< timestamp in ticks (see TraceBuffer)
+    SemanticID symbol;   ///< process, carrier etc. that the event is about
+    int id;              ///< process id of the Qe the event happened in (0 for receptor level events)
+    int type;            ///< TraceEventType
+} TraceEvent;
+
+// ring buffer of trace events, written lock-free by any number of threads
+typedef struct TraceBuffer {
+    TraceEvent *events;
+    uint64_t mask;        ///< size-1, where the size is a power of 2
+    uint64_t head;        ///< total number of events recorded, the oldest get overwritten
+    uint64_t start_ticks; ///< timestamp when the buffer was created
+    uint64_t start_ns;    ///< CLOCK_MONOTONIC nanoseconds when the buffer was created
+    int pid;              ///< what to report as the pid in dumps (the receptor address)
+} TraceBuffer;
+
+// key for a memoized pure process result
+typedef struct MemoKey {
+    Process process;
+    TreeHash hash;       ///< hash of the process node with its reduced parameters
+} MemoKey;
+
+// memoized result of a pure process
+typedef struct MemoEntry {
+    MemoKey key;
+    int generation;      ///< definitions generation of the SemTable the result was computed at
+    T *params;           ///< the process node with its reduced parameters (the key's hash may collide)
+    T *result;
+    UT_hash_handle hh;
+} MemoEntry;
+
+// bounded LRU cache of pure process results, with hit statistics
+typedef struct MemoCache {
+    MemoEntry *entries;  ///< hash of the entries, kept in least to most recently used order
+    int size;            ///< maximum number of entries, the least recently used are evicted past this
+    uint64_t hits;       ///< lookups answered from the cache
+    uint64_t misses;     ///< lookups that had to reduce the process
+    uint64_t evictions;  ///< entries dropped to stay within size
+} MemoCache;
+
+// profiling counters of one process
+typedef struct ProfileEntry {
+    Process process;
+    uint64_t calls;
+    uint64_t inclusive_time;  ///< cpu ns spent in the process and everything it called
+    uint64_t exclusive_time;  ///< cpu ns spent in the process itself
+    uint64_t allocs;          ///< tree nodes allocated by the process itself
+    uint64_t alloc_bytes;     ///< bytes of nodes and surfaces allocated by the process itself
+    UT_hash_handle hh;
+} ProfileEntry;
+
+// cpu time spent at the top of one call stack, for exporting folded stacks
+typedef struct ProfileStack {
+    Process *path;            ///< the processes on the stack, outermost first (the hash key)
+    int depth;
+    uint64_t time;
+    UT_hash_handle hh;
+} ProfileStack;
+
+// snapshot of the counters the profiler attributes
+typedef struct ProfileMark {
+    uint64_t time;
+    uint64_t allocs;
+    uint64_t bytes;
+} ProfileMark;
+
+#define PROFILE_MAX_DEPTH 64
+
+// per-Q profile of the processes reduced
+typedef struct Profile {
+    ProfileEntry *processes;
+    ProfileStack *stacks;
+    Process path[PROFILE_MAX_DEPTH+1]; ///< call stack of the step being profiled (with room for a sys process)
+    int depth;
+    ProfileMark step;         ///< counters when the step began
+    ProfileMark sys;          ///< counters when the sys process call began
+    ProfileMark spent;        ///< what has been attributed to sys processes so far in the step
+} Profile;
+
 // Processing Queue element
 typedef struct Qe Qe;
 struct Qe {
@@ -195,12 +343,117 @@ struct Qe {
     Qe *prev;
 };
 
+// request to unblock a process, posted to a Q's inbox from threads that don't own the Q
+typedef struct Qwakeup Qwakeup;
+struct Qwakeup {
+    int id;              ///< process id of the blocked process
+    int err;             ///< error state to resume the process in
+    T *with;             ///< value to replace the blocked node_pointer with (or NULL)
+    Qwakeup *next;
+};
+
 typedef struct ReceptorAddress {
     int addr;
 } ReceptorAddress;
 
 typedef struct Receptor Receptor;
 
+typedef struct UUIDt {
+    uint64_t data;
+    uint64_t time;
+} UUIDt;
+
+// entry in a receptor's index of its conversations (at all levels of nesting) by UUID
+typedef struct ConversationIndex {
+    UUIDt uuid;
+    T *conversation;
+    UT_hash_handle hh;
+} ConversationIndex;
+
+// entry in a receptor's index of its pending responses by the UUID of the request
+typedef struct PendingResponseIndex {
+    UUIDt uuid;
+    T *pending_response;
+    UT_hash_handle hh;
+} PendingResponseIndex;
+
+typedef struct Timer Timer;
+typedef void (*TimerFn)(Timer *t);
+
+// a timer scheduled in a TimerWheel, usually embedded as the first member of whatever it times
+struct Timer {
+    uint64_t expires;    ///< wheel tick at which the timer fires
+    uint64_t interval;   ///< ticks between firings for periodic timers, 0 for one-shot
+    TimerFn fn;          ///< called when the timer fires
+    void *arg;
+    Timer *next;
+    Timer **pprev;       ///< pointer to the link pointing at this timer, NULL if not scheduled
+};
+
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1<<TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+// hierarchical timer wheel, each level's slots span TIMER_WHEEL_SLOTS of the level below's
+typedef struct TimerWheel {
+    uint64_t now;        ///< the last tick processed
+    uint64_t resolution; ///< nanoseconds per tick
+    uint64_t origin;     ///< monotonic time in nanoseconds of tick 0
+    int count;           ///< number of scheduled timers
+    Timer *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    pthread_mutex_t mutex;
+} TimerWheel;
+
+// types of the records in a write-ahead log
+enum WalRecordType {WalNewInstance=1,WalSetInstance,WalDeleteInstance,WalDefine};
+
+// header of a write-ahead log record, followed by length bytes of payload
+typedef struct WalRecord {
+    uint32_t crc;        ///< checksum of the rest of the header and the payload
+    uint32_t length;     ///< length of the payload
+    uint32_t type;       ///< WalRecordType
+    Context context;     ///< context of the receptor the record is about
+} WalRecord;
+
+// append-only log of mutations since the last snapshot, group committed to disk
+typedef struct WAL {
+    int fd;
+    char *file;          ///< path of the log
+    char *buf;           ///< records appended but not yet written
+    size_t len;
+    size_t size;
+    uint64_t appended;   ///< sequence number of the last record appended
+    uint64_t synced;     ///< sequence number of the last record known to be on disk
+    bool syncing;        ///< whether a thread is writing and syncing a batch
+    pthread_mutex_t mutex;
+    pthread_cond_t cond; ///< signaled when a batch has been synced
+    pthread_t thread;    ///< thread that periodically syncs whatever has been appended
+    bool committing;     ///< whether the commit thread should keep going
+    uint64_t interval;   ///< nanoseconds between the commit thread's syncs
+    pthread_cond_t stop; ///< signaled to stop the commit thread
+} WAL;
+
+// a file to be written out by a checkpoint
+typedef struct CheckpointFile CheckpointFile;
+struct CheckpointFile {
+    char *name;          ///< suffix of the file name in the vmhost's directory
+    void *data;
+    size_t length;
+    CheckpointFile *next;
+};
+
+// timer expiring a receptor's pending response, expectation or conversation at its TIMEOUT_AT
+typedef struct Timeout {
+    Timer timer;
+    T *t;                ///< the item to expire (hash key)
+    Symbol kind;         ///< what the item is, so it can be handled without looking at it
+    Receptor *r;
+    bool cancelled;      ///< the item has gone, so there's nothing to expire
+    bool fired;          ///< the timer has gone off and the timeout is waiting to be expired
+    struct Timeout *next;///< next timeout waiting to be expired
+    UT_hash_handle hh;
+} Timeout;
+
 // Processing Queue structure
 typedef struct Q Q;
 struct Q {
@@ -209,20 +462,126 @@ struct Q {
     Qe *active;          ///< active processes
     Qe *completed;       ///< completed processes (pending cleanup)
     Qe *blocked;         ///< blocked processes
-    pthread_mutex_t mutex;
+    Qe *inbox;           ///< lock-free stack of added processes not yet on the active list
+    Qwakeup *wakeups;    ///< lock-free stack of pending unblock requests
+    FramePool qes;       ///< pool of queue elements
+    FramePool contexts;  ///< pool of run-tree contexts
+    FramePool iterations;///< pool of ITERATE state frames
+    FramePool conds;     ///< pool of COND state frames
+    MemoCache memo;      ///< memoized results of pure processes
+    TraceBuffer *trace;  ///< reduction trace events (NULL unless tracing is on)
+    Profile *profile;    ///< per-process profile (NULL unless profiling is on)
+    int owned;           ///< set while a thread owns the active/completed/blocked lists
 };
 
 // SemTable structures
+
+// entry in a context's label table, for a label that is the first label of some definitions
+typedef struct LabelEntry {
+    char *label;                        ///< key
+    SemanticAddr ids[MAX_SEM_TYPE+1];   ///< lowest id of each semtype with the label (0 if none)
+    UT_hash_handle hh;
+} LabelEntry;
+
+// entry in the semtable's global label index, i.e. which contexts define a label
+typedef struct GlobalLabel {
+    char *label;                        ///< key
+    int count;                          ///< number of contexts
+    int size;
+    Context *contexts;                  ///< the contexts, in ascending order
+    UT_hash_handle hh;
+} GlobalLabel;
+
+#define SYMBOL_SIZE_UNKNOWN -2         ///< symbol isn't in the cache
+#define SYMBOL_SIZE_VARIABLE -1        ///< symbol's size depends on its surface
+
+// what there is to know about a symbol for sizing and checking it, flattened out of its definition
+typedef struct SymbolInfo {
+    Structure structure;
+    int size;                           ///< size of the symbol's surface or SYMBOL_SIZE_VARIABLE/SYMBOL_SIZE_UNKNOWN
+} SymbolInfo;
+
 typedef struct ContextStore {
     T *definitions;
-    //LabelTable table;    ///< the label table for this context?
+    LabelEntry *labels;                 ///< label table for this context's definitions
+    T *indexed_defs;                    ///< definitions the label table was built from
+    int indexed[MAX_SEM_TYPE+1];        ///< how many definitions of each semtype are in the label table
+    SymbolInfo *symbols;                ///< cache of symbol info indexed by SemanticAddr
+    int symbol_slots;                   ///< number of entries allocated in symbols
+    T *symbols_defs;                    ///< definitions the symbol cache was built from
+    struct SigDesc **sigs;              ///< cache of process signature descriptors indexed by SemanticAddr
+    int sig_slots;                      ///< number of entries allocated in sigs
 } ContextStore;
 
-//@todo convert to malloc
-#define MAX_CONTEXTS 100
+// kinds of input signature slots
+enum SigSlotKind {SigSlotStructure,SigSlotSymbol,SigSlotAny,SigSlotProcess,SigSlotUnknown};
+
+// precomputed input signature slot
+typedef struct SigSlot {
+    int param_idx;        ///< child index of the parameter this slot checks
+    int kind;             ///< SigSlotKind
+    bool optional;        ///< whether the parameter may be omitted
+    SemanticID expected;  ///< the structure, symbol or process result expected
+    Symbol sig_symbol;    ///< the signature symbol (for reporting unknown kinds)
+} SigSlot;
+
+// precomputed process signature descriptor for fast signature checking
+typedef struct SigDesc {
+    Process process;      ///< the process described
+    int generation;       ///< definitions generation of the SemTable this was built at
+    bool has_signature;   ///< false if the process has an empty signature
+    int slot_count;       ///< number of input signature slots
+    int required;         ///< number of non-optional input slots
+    SigSlot *slots;       ///< input slots in signature order
+    int template_count;   ///< number of template slots (-1 if no TEMPLATE_SIGNATURE)
+    TreeHash *template_hashes; ///< hashes of the semantic refs the template expects to be mapped
+    bool pure;            ///< whether the process is marked PROCESS_PURE
+} SigDesc;
+
+struct SemTable;
+/// native transcoder: builds the to_sym tree directly from src (which it must not free)
+typedef int (*TranscoderFn)(struct SemTable *sem,T *src,Symbol to_sym,T **result);
+
+// key for the transcoder registry, each side can be either a symbol or a structure
+typedef struct TranscoderKey {
+    SemanticID src;
+    SemanticID to;
+} TranscoderKey;
+
+// transcoder registry entry, either a defined process or a native function
+typedef struct Transcoder {
+    TranscoderKey key;
+    Process process;      ///< process to reduce for the transcoding (or NULL_PROCESS)
+    TranscoderFn fn;      ///< native transcoding function (or NULL)
+    UT_hash_handle hh;
+} Transcoder;
+
+// memory a writer replaced in the semtable, which readers may still be looking at
+typedef struct SemRetired {
+    void *p;
+    uint64_t epoch;       ///< epoch at which it was retired
+    struct SemRetired *next;
+} SemRetired;
+
+// a thread that reads the semtable without locking (see _sem_reader_online)
+typedef struct SemReader {
+    uint64_t seen;        ///< epoch at the reader's last quiescent state
+    struct SemReader *next;
+} SemReader;
+
+/// number of contexts in the first segment of the semtable, each segment after that is twice as big
+#define SEM_FIRST_SEGMENT 16
+#define SEM_SEGMENTS 24
 typedef struct SemTable {
     int contexts;
-    ContextStore stores[MAX_CONTEXTS];
+    ContextStore *segments[SEM_SEGMENTS]; ///< the contexts, in segments that never move once allocated
+    int generation;       ///< incremented whenever definitions change
+    Transcoder *transcoders; ///< registry of transcoders keyed by source and target (looked up with the mutex held)
+    GlobalLabel *labels;  ///< index of which contexts define each label
+    pthread_mutex_t mutex;///< serializes writers, and label lookups because label tables are built lazily
+    uint64_t epoch;       ///< incremented whenever memory gets retired
+    SemReader *readers;   ///< threads reading without locking
+    SemRetired *retired;  ///< memory to free once all the readers have been quiescent since it was retired
 } SemTable;
 
 
@@ -243,20 +602,27 @@ struct Receptor {
     T *flux;             ///< pointer for quick access to the flux
     T *pending_signals;
     T *pending_responses;
+    PendingResponseIndex *pending_index;   ///< the PENDING_RESPONSEs hashed by request UUID
     T *conversations;
+    ConversationIndex *conversation_index; ///< all the CONVERSATIONs hashed by their UUID
+    pthread_mutex_t conversations_mutex;   ///< protects conversations and conversation_index
     pthread_mutex_t pending_signals_mutex;
-    pthread_mutex_t pending_responses_mutex;
+    pthread_mutex_t pending_responses_mutex; ///< protects pending_responses and pending_index
     Instances instances; ///< the instances store
     Q *q;                ///< process queue
     int state;           ///< state information about the receptor that the vmhost manages
     T *edge;             ///< data store for edge receptors
+    TimerWheel *timers;  ///< wheel to schedule expiries on (NULL if not running in a vmhost)
+    Timeout *timeouts;   ///< scheduled expiries hashed by the item they expire
+    Timeout *expired;    ///< timeouts that have gone off, waiting for _r_expire_timeouts
+    pthread_mutex_t timeouts_mutex; ///< protects timeouts and expired
+    WAL *wal;            ///< log to record instance and definition changes in (NULL if not persisted)
+    void *image;         ///< serialized receptor to load on first use if this is just a stub, NULL once loaded
+    void *mapping;       ///< mapped file the receptor was evicted to, which the stubs in its instances may point into
+    size_t mapping_size;
+    char *dir;           ///< directory the stub's checkpointed instances are in
 };
 
-typedef struct UUIDt {
-    uint64_t data;
-    uint64_t time;
-} UUIDt;
-
 // aspects appear on either side of the membrane
 enum AspectType {EXTERNAL_ASPECT=0,INTERNAL_ASPECT};
 typedef Symbol Aspect;  //aspects are identified by a semantic Symbol identifier
@@ -278,20 +644,45 @@ typedef int Error;
  */
 typedef struct scape_elem {
     TreeHash key;            ///< has of the key tree that maps to a given data value
-    Xaddr value;             ///< instance of data_source pointed to by the key
+    T *key_tree;             ///< copy of the key tree, to tell apart keys whose hashes collide
+    Xaddr *values;           ///< instances of data_source pointed to by the key
+    int count;               ///< number of values (only ever 1 unless the scape is multi-valued)
+    int size;                ///< allocated size of values
+    struct scape_elem *next; ///< element of another key with the same hash
     UT_hash_handle hh;       ///< makes this structure hashable using the uthash library
 } scape_elem;
 typedef scape_elem *ScapeData;
 
+#define SCAPE_MAX_LEVEL 16
+
+/**
+ * A node in the skiplist of an ordered scape
+ */
+typedef struct ScapeNode ScapeNode;
+struct ScapeNode {
+    T *key;                  ///< copy of the key tree
+    Xaddr value;             ///< the instance with that key
+    int level;               ///< number of levels the node is linked into
+    ScapeNode *next[];       ///< the following node on each level
+};
+
 /**
  * A scape provides indexed, i.e. random access to data sources.  The key source is
  * usually a sub-portion of a the data source, i.e. if the data source is a PROFILE
  * the key_source might be a FIRST_NAME within the profile
  */
-typedef struct Scape {
+typedef struct Scape Scape;
+struct Scape {
     Symbol key_source;
     Symbol data_source;
     ScapeData data;      ///< the scape data store (hash table)
-} Scape;
+    int *key_path;       ///< where the key is in a data_source instance (NULL to find it by key_source)
+    bool multi;          ///< whether more than one instance can have the same key
+    ScapeNode *order;    ///< head of the skiplist of keys in order (NULL if the scape isn't ordered)
+    int levels;          ///< number of levels currently in use in the skiplist
+    uint32_t seed;       ///< for picking the levels of new skiplist nodes
+    SemTable *sem;       ///< for hashing the keys of instances
+    Scape *next;         ///< the next scape maintained on the same instance store
+};
 
 #endif
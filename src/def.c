@@ -13,6 +13,7 @@
 #include "stream.h"
 #include "def.h"
 #include "semtrex.h"
+#include "process.h"
 char __d_extra_buf[100];
 
 int semeq(SemanticID s1,SemanticID s2) {
@@ -28,8 +29,12 @@ SemanticAddr  _d_get_def_addr(T *def) {
 
 SemanticID _d_define(SemTable *sem,T *def,SemanticType semtype,Context c) {
     T *definitions = __sem_get_defs(sem,semtype,c);
-    _t_add(definitions,def);
+    _sem_lock(sem);
+    __sem_add_child(sem,definitions,def);
+    _sem_changed(sem);
+    __sem_index_labels(sem,c);
     SemanticID sid = {c,semtype,_d_get_def_addr(def)};
+    _sem_unlock(sem);
     return sid;
 }
 
@@ -176,6 +181,8 @@ Structure __d_get_symbol_structure(T *symbols,Symbol s) {
  * @snippet spec/def_spec.h testGetSize
  */
 size_t _d_get_symbol_size(SemTable *sem,Symbol s,void *surface) {
+    int size = _sem_get_symbol_size(sem,s);
+    if (size >= 0) return size;
     Structure st = _sem_get_symbol_structure(sem,s);
     return _d_get_structure_size(sem,st,surface);
 }
@@ -244,6 +251,39 @@ size_t _d_get_structure_size(SemTable *sem,Structure s,void *surface) {
     return size;
 }
 
+/**
+ * get the size of a structure if it's the same for every surface
+ *
+ * @param[in] sem is the semantic table where symbols and structures are defined
+ * @param[in] s the structure
+ * @returns the size or SYMBOL_SIZE_VARIABLE if it depends on the surface (or the structure can't be sized at all)
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/def_spec.h testGetSize
+ */
+int __d_get_fixed_size(SemTable *sem,Structure s) {
+    if (is_sys_structure(s)) {
+        if (s.id == CSTRING_ID) return SYMBOL_SIZE_VARIABLE;
+        size_t size = _sys_structure_size(s.id,NULL);
+        return size == -1 ? SYMBOL_SIZE_VARIABLE : size;
+    }
+    T *structure = _t_child(_sem_get_defs(sem,s),s.id);
+    T *parts = structure ? _t_child(structure,StructureDefDefIdx) : NULL;
+    if (!parts) return SYMBOL_SIZE_VARIABLE;
+    if (semeq(_t_symbol(parts),STRUCTURE_SYMBOL))
+        return _sem_get_symbol_size(sem,*(Symbol *)_t_surface(parts));
+    if (!semeq(_t_symbol(parts),STRUCTURE_SEQUENCE)) return SYMBOL_SIZE_VARIABLE;
+    int i,size = 0;
+    for(i=1;i<=_t_children(parts);i++) {
+        T *p = _t_child(parts,i);
+        if (!semeq(_t_symbol(p),STRUCTURE_SYMBOL)) return SYMBOL_SIZE_VARIABLE;
+        int l = _sem_get_symbol_size(sem,*(Symbol *)_t_surface(p));
+        if (l < 0) return SYMBOL_SIZE_VARIABLE;
+        size += l;
+    }
+    return size;
+}
+
 #define MAX_HASHES 10
 // extract the template signature from the code
 void __d_tsig(SemTable *sem,T *code, T *tsig,TreeHash *hashes) {
@@ -322,6 +362,8 @@ T *_d_make_process_def(T *code,char *name,char *intention,T *signature,T *link)
 /**
  * add a new process definition to the processes tree
  *
+ * the constant parts of the code get folded first (see _p_fold_constants)
+ *
  * @param[inout] processes a process def tree containing process codings which will be added to
  * @param[in] code the code tree for this process
  * @param[in] name the name of the process
@@ -334,6 +376,7 @@ T *_d_make_process_def(T *code,char *name,char *intention,T *signature,T *link)
  * @snippet spec/def_spec.h testDefProcess
  */
 Process _d_define_process(SemTable *sem,T *code,char *name,char *intention,T *signature,T *link,Context c) {
+    if (code) _p_fold_constants(sem,code);
     T *def = _d_make_process_def(code,name,intention,signature,link);
     if (signature && code) {
         T *tsig = _t_new_root(TEMPLATE_SIGNATURE);
@@ -345,6 +388,27 @@ Process _d_define_process(SemTable *sem,T *code,char *name,char *intention,T *si
     return _d_define(sem,def,SEM_TYPE_PROCESS,c);
 }
 
+/**
+ * mark a process as pure, i.e. its result depends only on its parameters
+ *
+ * the results of pure processes get memoized by the Q that reduces them
+ *
+ * @param[in] sem is the semantic table in which the process is defined
+ * @param[in] p the process to mark
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessMemoize
+ */
+void _d_set_process_pure(SemTable *sem,Process p) {
+    T *def = _sem_get_def(sem,p);
+    int i,c = _t_children(def);
+    for(i=ProcessDefLinkIdx;i<=c;i++) {
+        if (semeq(_t_symbol(_t_child(def,i)),PROCESS_PURE)) return;
+    }
+    _t_newr(def,PROCESS_PURE);
+    _sem_changed(sem);
+}
+
 /**
  * add a protocol definition to a protocol defs tree
  *
@@ -76,8 +76,10 @@ T * _d_make_vstruc_def(SemTable *sem,char *label,int num_params,va_list params);
 Structure __d_get_symbol_structure(T *symbols,Symbol s);
 size_t _d_get_symbol_size(SemTable *sem,Symbol s,void *surface);
 size_t _d_get_structure_size(SemTable *sem,Symbol s,void *surface);
+int __d_get_fixed_size(SemTable *sem,Structure s);
 T *_d_make_process_def(T *code,char *name,char *intention,T *signature,T *link);
 Process _d_define_process(SemTable *sem,T *code,char *name,char *intention,T *signature,T *link,Context c);
+void _d_set_process_pure(SemTable *sem,Process p);
 Protocol _d_define_protocol(SemTable *sem,T *def,Context c);
 T *_d_make_protocol_def(SemTable *sem,char *label,...);
 T * _d_build_def_semtrex(SemTable *sem,Symbol s,T *parent);
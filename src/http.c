@@ -0,0 +1,196 @@
+/**
+ * @ingroup stream
+ *
+ * @{
+ * @file http.c
+ * @brief native parsing of HTTP requests into HTTP_REQUEST trees
+ *
+ * The parser works directly on the bytes of a framed request (see __st_scan_http)
+ * so that the HTTP edge doesn't have to build an ASCII_CHARS tree and run it
+ * through a semtrex for every request.
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#include "http.h"
+#include "process.h"
+#include "debug.h"
+#include <ctype.h>
+#include <strings.h>
+
+// add a cstring node from a non-terminated run of bytes
+T *__http_new_str(T *parent,Symbol sym,char *s,size_t l,bool is_run_node) {
+    T *t = __t_new(parent,sym,s,l+1,is_run_node);
+    ((char *)_t_surface(t))[l] = 0;
+    return t;
+}
+
+// parse a run of decimal digits, returns pointer to the first non-digit or NULL if there weren't any
+char *__http_parse_int(char *p,char *e,int *result) {
+    char *s = p;
+    *result = 0;
+    while (p < e && isdigit(*p)) {
+        *result = *result*10 + (*p - '0');
+        p++;
+    }
+    return (p == s) ? NULL : p;
+}
+
+// check if a header value contains a token (case insensitive)
+bool __http_has_token(char *v,char *e,char *token) {
+    size_t l = strlen(token);
+    while (e-v >= l) {
+        if (!strncasecmp(v,token,l)) return true;
+        v++;
+    }
+    return false;
+}
+
+/**
+ * parse an HTTP request into an HTTP_REQUEST tree
+ *
+ * produces the same request line tree as the ascii_chars_2_http_req transcoder
+ * followed by HTTP_REQUEST_HEADERS and HTTP_REQUEST_BODY children if the request
+ * has them.  A chunked body is de-chunked.
+ *
+ * @param[in] buf pointer to the first byte of the request
+ * @param[in] len number of bytes in the request
+ * @param[in] is_run_node true to build the tree out of run nodes
+ * @returns HTTP_REQUEST tree or NULL if the request couldn't be parsed
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/stream_spec.h testHTTPParseRequest
+ */
+T *__http_parse_request(char *buf,size_t len,bool is_run_node) {
+    char *p = buf,*e = buf+len,*s,*eol,*le;
+    T *req = NULL;
+
+    // skip any blank lines left over from a previous request
+    while (p < e && (*p == '\r' || *p == '\n')) p++;
+
+    // the request line
+    eol = memchr(p,'\n',e-p);
+    if (!eol) eol = e;
+    le = (eol > p && eol[-1] == '\r') ? eol-1 : eol;
+
+    s = p;
+    while (p < le && *p != ' ') p++;
+    if (p == s || p == le) return NULL;
+    req = __t_newr(0,HTTP_REQUEST,is_run_node);
+    __http_new_str(req,HTTP_REQUEST_METHOD,s,p-s,is_run_node);
+    p++;
+
+    if (p == le || *p != '/') goto fail;
+    T *path = __t_newr(req,HTTP_REQUEST_PATH,is_run_node);
+    T *segments = __t_newr(path,HTTP_REQUEST_PATH_SEGMENTS,is_run_node);
+    while (p < le && *p == '/') {
+        s = ++p;
+        while (p < le && *p != '/' && *p != '?' && *p != ' ') p++;
+        __http_new_str(segments,HTTP_REQUEST_PATH_SEGMENT,s,p-s,is_run_node);
+    }
+    if (p < le && *p == '?') {
+        p++;
+        // (the query goes next to the path, not in it, as ascii_chars_2_http_req does)
+        T *query = __t_newr(req,HTTP_REQUEST_PATH_QUERY,is_run_node);
+        T *params = __t_newr(query,HTTP_REQUEST_PATH_QUERY_PARAMS,is_run_node);
+        while (p < le && *p != ' ') {
+            s = p;
+            while (p < le && *p != '&' && *p != ' ' && *p != '=') p++;
+            if (p == s) goto fail;
+            T *param = __t_newr(params,HTTP_REQUEST_PATH_QUERY_PARAM,is_run_node);
+            __http_new_str(param,PARAM_KEY,s,p-s,is_run_node);
+            if (p < le && *p == '=') p++;
+            s = p;
+            while (p < le && *p != '&' && *p != ' ') p++;
+            __http_new_str(param,PARAM_VALUE,s,p-s,is_run_node);
+            if (p < le && *p == '&') p++;
+        }
+    }
+
+    int major,minor;
+    if (le-p < 6 || strncmp(p," HTTP/",6)) goto fail;
+    p += 6;
+    if (!(p = __http_parse_int(p,le,&major)) || p == le || *p != '.') goto fail;
+    if (!(p = __http_parse_int(p+1,le,&minor)) || p != le) goto fail;
+    T *version = __t_newr(req,HTTP_REQUEST_VERSION,is_run_node);
+    __t_newi(version,VERSION_MAJOR,major,is_run_node);
+    __t_newi(version,VERSION_MINOR,minor,is_run_node);
+
+    // the headers
+    T *headers = NULL;
+    size_t content_length = 0;
+    bool chunked = false;
+    p = (eol < e) ? eol+1 : e;
+    while (p < e) {
+        eol = memchr(p,'\n',e-p);
+        if (!eol) eol = e;
+        le = (eol > p && eol[-1] == '\r') ? eol-1 : eol;
+        if (le == p) {
+            p = (eol < e) ? eol+1 : e;
+            break;
+        }
+        char *colon = memchr(p,':',le-p);
+        if (!colon) goto fail;
+        size_t kl = colon-p;
+        char *v = colon+1,*ve = le;
+        while (v < ve && (*v == ' ' || *v == '\t')) v++;
+        while (ve > v && (ve[-1] == ' ' || ve[-1] == '\t')) ve--;
+
+        if (!headers) headers = __t_newr(req,HTTP_REQUEST_HEADERS,is_run_node);
+        if (kl == 4 && !strncasecmp(p,"host",kl))
+            __http_new_str(headers,HTTP_REQUEST_HOST,v,ve-v,is_run_node);
+        else if (kl == 10 && !strncasecmp(p,"user-agent",kl))
+            __http_new_str(headers,HTTP_REQUEST_USER_AGENT,v,ve-v,is_run_node);
+        else {
+            T *h = __t_newr(headers,HTTP_GENERAL_HEADER,is_run_node);
+            __http_new_str(h,HEADER_KEY,p,kl,is_run_node);
+            __http_new_str(h,HEADER_VALUE,v,ve-v,is_run_node);
+            if (kl == 14 && !strncasecmp(p,"content-length",kl))
+                content_length = strtoul(v,NULL,10);
+            else if (kl == 17 && !strncasecmp(p,"transfer-encoding",kl))
+                chunked = __http_has_token(v,ve,"chunked");
+        }
+        p = (eol < e) ? eol+1 : e;
+    }
+
+    // the body
+    if (chunked) {
+        char *body = malloc(e-p+1);
+        size_t l = 0;
+        while (p < e && (eol = memchr(p,'\n',e-p))) {
+            size_t n = strtoul(p,NULL,16);
+            p = eol+1;
+            if (!n) break;
+            if (n > e-p) n = e-p;
+            memcpy(body+l,p,n);
+            l += n;
+            p += n;
+            if (p < e && *p == '\r') p++;
+            if (p < e && *p == '\n') p++;
+        }
+        if (l) __http_new_str(__t_newr(req,HTTP_REQUEST_BODY,is_run_node),OCTET_STREAM,body,l,is_run_node);
+        free(body);
+    }
+    else if (content_length) {
+        if (content_length > e-p) content_length = e-p;
+        __http_new_str(__t_newr(req,HTTP_REQUEST_BODY,is_run_node),OCTET_STREAM,p,content_length,is_run_node);
+    }
+    return req;
+ fail:
+    debug(D_STREAM,"failed to parse http request: %.*s\n",(int)len,buf);
+    _t_free(req);
+    return NULL;
+}
+
+/**
+ * native transcoder from a CSTRING to an HTTP_REQUEST
+ */
+Error _http_transcode_cstring2request(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    T *x = __http_parse_request((char *)_t_surface(src),_t_size(src)-1,true);
+    if (!x) return incompatibleTypeReductionErr;
+    x->contents.symbol = to_sym;
+    *result = x;
+    return noReductionErr;
+}
+
+/** @}*/
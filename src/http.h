@@ -0,0 +1,21 @@
+/**
+ * @ingroup stream
+ *
+ * @{
+ * @file http.h
+ * @brief native HTTP request parsing header file
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#ifndef _CEPTR_HTTP_H
+#define _CEPTR_HTTP_H
+
+#include "tree.h"
+
+#define _http_parse_request(buf,len) __http_parse_request(buf,len,0)
+T *__http_parse_request(char *buf,size_t len,bool is_run_node);
+Error _http_transcode_cstring2request(SemTable *sem,T *src,Symbol to_sym,T **result);
+
+#endif
+/** @}*/
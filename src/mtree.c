@@ -105,6 +105,8 @@ H __m_new(H parent,Symbol symbol,void *surface,size_t size,uint32_t flags) {
     // add a node
     N *n,*nl;
     n = __m_add_nodes(h,l,1);
+    // clear the padding and unused surface bytes too so that serializing is deterministic
+    memset(n,0,sizeof(N));
 
     n->symbol = symbol;
     n->size = size;
@@ -211,12 +213,8 @@ H _m_new_from_t(T *t) {
     return h;
 }
 
-// mtree walk function for creating ttree nodes
-// used by _t_new_from_m
-void _m_2tfn(H h,N *n,void *data,MwalkState *s,Maddr ap) {
-
-    T **tP = (T**) &(((struct {T *t;} *)data)->t);
-    T *t =  h.a.l ? (s[h.a.l-1].user.t) : NULL;
+// create the ttree node for an mtree node
+T *__m_2t(T *t,N *n) {
     int is_run_node = (n->flags&TFLAG_RUN_NODE);
 
     T *nt;
@@ -236,22 +234,64 @@ void _m_2tfn(H h,N *n,void *data,MwalkState *s,Maddr ap) {
     if (is_run_node) {
         ((rT *)nt)->cur_child = n->cur_child;
     }
-    *tP = nt;
+    return nt;
+}
 
-    s[h.a.l].user.t = nt;
+// recursively create the ttree nodes for an mtree node and its children, where the
+// children of node i of level l are kids[l+1][first[l+1][i]] up to kids[l+1][first[l+1][i+1]]
+T *__t_new_from_m(T *t,H h,Mindex **first,Mindex **kids) {
+    T *nt = __m_2t(t,__m_get(h));
+    if (h.a.l+1 < h.m->levels) {
+        Mindex *f = first[h.a.l+1];
+        Mindex j;
+        H c = {h.m,{h.a.l+1,0}};
+        for(j=f[h.a.i];j<f[h.a.i+1];j++) {
+            c.a.i = kids[h.a.l+1][j];
+            __t_new_from_m(nt,c,first,kids);
+        }
+    }
+    return nt;
 }
 
 /**
  * Create a new ttree that is a copy of an mtree
  *
+ * the nodes of each level are first sorted by parent, so that finding a node's
+ * children doesn't mean scanning the whole of the next level for every node
+ *
  * @param[in] h handle to source mtree
  * @returns handle to mtree
  */
 T *_t_new_from_m(H h) {
-    struct {T *t;} d = {NULL};
-    Maddr ac = {0,0};
-    _m_walk(h,_m_2tfn,&d);
-    return _t_root(d.t);
+    int l,levels = h.m->levels;
+    Mindex *first[levels],*kids[levels];
+    Mindex i;
+    for(l=h.a.l+1;l<levels;l++) {
+        L *pl = _GET_LEVEL(h,l-1);
+        L *cl = _GET_LEVEL(h,l);
+        Mindex *f = first[l] = malloc(sizeof(Mindex)*(pl->nodes+1));
+        Mindex *k = kids[l] = malloc(sizeof(Mindex)*(cl->nodes+1));
+        memset(f,0,sizeof(Mindex)*(pl->nodes+1));
+        for(i=0;i<cl->nodes;i++) {
+            N *n = _GET_NODE(h,cl,i);
+            if (!(n->flags & TFLAG_DELETED)) f[n->parenti+1]++;
+        }
+        for(i=0;i<pl->nodes;i++) f[i+1] += f[i];
+        // fill in each parent's children in order, using the start of the next parent's
+        // as a cursor and then shifting them back
+        for(i=0;i<cl->nodes;i++) {
+            N *n = _GET_NODE(h,cl,i);
+            if (!(n->flags & TFLAG_DELETED)) k[f[n->parenti]++] = i;
+        }
+        for(i=pl->nodes;i>0;i--) f[i] = f[i-1];
+        f[0] = 0;
+    }
+    T *t = __t_new_from_m(0,h,first,kids);
+    for(l=h.a.l+1;l<levels;l++) {
+        free(first[l]);
+        free(kids[l]);
+    }
+    return t;
 }
 
 /**
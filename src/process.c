@@ -17,8 +17,12 @@
 #include "util.h"
 #include "debug.h"
 #include <errno.h>
+#include <sched.h>
 #include "accumulator.h"
 #include "protocol.h"
+#include "http.h"
+#include "trace.h"
+#include "profile.h"
 void rt_check(Receptor *r,T *t) {
     if (!(t->context.flags & TFLAG_RUN_NODE)) raise_error("Whoa! Not a run node! %s\n",_td(r,t));
 }
@@ -34,22 +38,10 @@ void set_rt_cur_child(Receptor *r,T *tP,uint32_t idx) {
 }
 
 void processUnblocker(Stream *st) {
-    int err;
-    // we might need to wait for the process to actually be blocked in the processing thread
-    // so if unblock reports that the process isn't blocked, then just wait for a bit.
-    // @todo, this is really ugly and could lead to deadlock, so we should fix it somehow!
-
-    // sometimes the unblocker gets called by the stream completion after the actual
-    // code finished running for what ever reason,so if the code is already dead, we
-    // just ignore that case.
-    // @todo, this is gonna bite our ass, and should be fixed
-    int i = 1000;
-    while ((i-- > 0) && (err = _p_unblock((Q *)st->callback_arg1,st->callback_arg2))) {
-        if (err == 2) return; //raise_error("can't unblock completed process!");
-        if (err == 3) return; //raise_error("can't unblock non-existent process");
-        sleepms(1);
-    }
-    if (err) raise_error("process never blocked!");
+    // the unblock request is only applied by the thread that owns the q, after it has
+    // moved the process to the blocked list, so there's no need to wait for the block.
+    // if the process has already completed the request is simply dropped.
+    _p_unblock((Q *)st->callback_arg1,st->callback_arg2);
 }
 
 // setup the default until condition (only once, and 30 second timeout)
@@ -79,29 +71,195 @@ void _p_fill_from_match(SemTable *sem,T *t,T *match_results,T *match_tree) {
     _t_free(sem_map);
 }
 
+// (with the semtable locked)
+Transcoder *__p_set_transcoder(SemTable *sem,SemanticID src,SemanticID to) {
+    Transcoder *t;
+    TranscoderKey k;
+    memset(&k,0,sizeof(k));
+    k.src = src;
+    k.to = to;
+    HASH_FIND(hh,sem->transcoders,&k,sizeof(TranscoderKey),t);
+    if (!t) {
+        t = malloc(sizeof(Transcoder));
+        memset(t,0,sizeof(Transcoder));
+        t->key = k;
+        HASH_ADD(hh,sem->transcoders,key,sizeof(TranscoderKey),t);
+    }
+    return t;
+}
+
+/**
+ * register a defined process as the transcoder between two semantic types
+ *
+ * either side may be a Symbol or a Structure.  Registering over an existing
+ * entry replaces it.
+ *
+ * @param[in] sem Semantic table in use
+ * @param[in] src symbol or structure of the source trees
+ * @param[in] to symbol or structure of the resulting trees
+ * @param[in] p the transcoding process
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessTranscoderRegistry
+ */
+void _p_add_transcoder(SemTable *sem,SemanticID src,SemanticID to,Process p) {
+    _sem_lock(sem);
+    Transcoder *t = __p_set_transcoder(sem,src,to);
+    t->process = p;
+    t->fn = NULL;
+    _sem_unlock(sem);
+}
+
+/**
+ * register a native C function as the transcoder between two semantic types
+ *
+ * @param[in] sem Semantic table in use
+ * @param[in] src symbol or structure of the source trees
+ * @param[in] to symbol or structure of the resulting trees
+ * @param[in] fn the transcoding function
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessTranscoderRegistry
+ */
+void _p_add_native_transcoder(SemTable *sem,SemanticID src,SemanticID to,TranscoderFn fn) {
+    _sem_lock(sem);
+    Transcoder *t = __p_set_transcoder(sem,src,to);
+    t->process = NULL_PROCESS;
+    t->fn = fn;
+    _sem_unlock(sem);
+}
+
+// (with the semtable locked)
+Transcoder *__p_find_transcoder(SemTable *sem,SemanticID src,SemanticID to) {
+    Transcoder *t;
+    TranscoderKey k;
+    memset(&k,0,sizeof(k));
+    k.src = src;
+    k.to = to;
+    HASH_FIND(hh,sem->transcoders,&k,sizeof(TranscoderKey),t);
+    return t;
+}
+
+/**
+ * find the registered transcoder from one symbol to another
+ *
+ * the most specific registration wins: symbol to symbol, then symbol to
+ * structure, then structure to symbol, and finally structure to structure.
+ * Transcoding is rare enough that the registry is looked up with the semtable locked, and
+ * entries that go away with their context are retired, so the one found stays valid until
+ * the thread's next quiescent state.
+ *
+ * @param[in] sem Semantic table in use
+ * @param[in] src_sym the symbol to transcode from
+ * @param[in] to_sym the symbol to transcode to
+ * @returns the registry entry or NULL if there isn't one
+ */
+Transcoder *_p_find_transcoder(SemTable *sem,Symbol src_sym,Symbol to_sym) {
+    Transcoder *t;
+    if (!__atomic_load_n(&sem->transcoders,__ATOMIC_ACQUIRE)) return NULL;
+    Structure src_s = _sem_get_symbol_structure(sem,src_sym);
+    Structure to_s = _sem_get_symbol_structure(sem,to_sym);
+    _sem_lock(sem);
+    if (!(t = __p_find_transcoder(sem,src_sym,to_sym)) &&
+        !(t = __p_find_transcoder(sem,src_sym,to_s)) &&
+        !(t = __p_find_transcoder(sem,src_s,to_sym)))
+        t = __p_find_transcoder(sem,src_s,to_s);
+    _sem_unlock(sem);
+    return t;
+}
+
 Process _p_get_transcoder(SemTable *sem,Symbol src_sym,Symbol to_sym) {
+    Transcoder *t = _p_find_transcoder(sem,src_sym,to_sym);
+    return (t && !t->fn) ? t->process : NULL_PROCESS;
+}
+
+Error __p_transcode_cstring2integer(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    *result = __t_newi(0,to_sym,atoi(_t_surface(src)),true);
+    return noReductionErr;
+}
+
+Error __p_transcode_cstring2ascii_chars(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    char *c = (char *)_t_surface(src);
+    int l = _t_size(src);
+    T *x = __t_newr(0,ASCII_CHARS,true);
+    while (--l) { // ignore the terminating null
+        __t_newc(x,ASCII_CHAR,*c,true);
+        c++;
+    }
+    *result = x;
+    return noReductionErr;
+}
+
+Error __p_transcode_integer2cstring(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    char buf[100];
+    sprintf(buf,"%d",*(int *)_t_surface(src));
+    *result = __t_new_str(0,to_sym,buf,true);
+    return noReductionErr;
+}
+
+Error __p_transcode_float2cstring(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    char buf[100];
+    sprintf(buf,"%f",*(float *)_t_surface(src));
+    *result = __t_new_str(0,to_sym,buf,true);
+    return noReductionErr;
+}
+
+Error __p_transcode_char2cstring(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    char buf[2];
+    buf[0] = *(char *)_t_surface(src);
+    buf[1] = 0;
+    *result = __t_new_str(0,to_sym,buf,true);
+    return noReductionErr;
+}
 
-    if (semeq(HTTP_RESPONSE,src_sym) && semeq(LINES,to_sym)) {
-        return http_response_2_lines;
+Error __p_transcode_rope2cstring(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    size_t l;
+    char *str = _t_flatten_rope(src,&l);
+    T *x = __t_new(0,to_sym,0,0,true);
+    // hand the flattened buffer straight to the node unless it fits in the surface
+    if (l+1 <= sizeof(void *)) {
+        memcpy(&x->contents.surface,str,l+1);
+        free(str);
     }
-    else if (semeq(CONTENT_TYPE,src_sym) && semeq(LINE,to_sym))
-        return content_type_2_line;
-    else if (semeq(ASCII_CHARS,src_sym) && semeq(HTTP_REQUEST,to_sym))
-        return ascii_chars_2_http_req;
     else {
-        Structure src_s = _sem_get_symbol_structure(sem,src_sym);
-        Structure to_s = _sem_get_symbol_structure(sem,to_sym);
-        if (semeq(src_s,DATE) && semeq(to_s,CSTRING)) {
-            return date2usshortdate;
-        }
-        if (semeq(src_s,TIME) && semeq(to_s,CSTRING)) {
-            return time2shortime;
-        }
-        if (semeq(HTTP_RESPONSE_STATUS,src_sym) && semeq(to_s,CSTRING)) {
-            return http_response_status_2_ascii_str;
-        }
+        x->contents.surface = str;
+        x->context.flags |= TFLAG_ALLOCATED;
     }
-    return NULL_PROCESS;
+    x->contents.size = l+1;
+    *result = x;
+    return noReductionErr;
+}
+
+Error __p_transcode_cstring2rope(SemTable *sem,T *src,Symbol to_sym,T **result) {
+    T *x = __t_newr(0,to_sym,true);
+    _t_add(x,_t_rclone(src));
+    *result = x;
+    return noReductionErr;
+}
+
+/**
+ * register the built in transcoders
+ *
+ * must be called after the base definitions have been loaded into the semtable
+ *
+ * @param[in] sem Semantic table in use
+ */
+void _p_init_transcoders(SemTable *sem) {
+    _p_add_transcoder(sem,HTTP_RESPONSE,LINES,http_response_2_lines);
+    _p_add_transcoder(sem,CONTENT_TYPE,LINE,content_type_2_line);
+    _p_add_transcoder(sem,ASCII_CHARS,HTTP_REQUEST,ascii_chars_2_http_req);
+    _p_add_transcoder(sem,DATE,CSTRING,date2usshortdate);
+    _p_add_transcoder(sem,TIME,CSTRING,time2shortime);
+    _p_add_transcoder(sem,HTTP_RESPONSE_STATUS,CSTRING,http_response_status_2_ascii_str);
+
+    _p_add_native_transcoder(sem,CSTRING,INTEGER,__p_transcode_cstring2integer);
+    _p_add_native_transcoder(sem,CSTRING,ASCII_CHARS,__p_transcode_cstring2ascii_chars);
+    _p_add_native_transcoder(sem,INTEGER,CSTRING,__p_transcode_integer2cstring);
+    _p_add_native_transcoder(sem,FLOAT,CSTRING,__p_transcode_float2cstring);
+    _p_add_native_transcoder(sem,CHAR,CSTRING,__p_transcode_char2cstring);
+    _p_add_native_transcoder(sem,CSTRING,HTTP_REQUEST,_http_transcode_cstring2request);
+    _p_add_native_transcoder(sem,ROPE,CSTRING,__p_transcode_rope2cstring);
+    _p_add_native_transcoder(sem,CSTRING,ROPE,__p_transcode_cstring2rope);
 }
 
 int _p_transcode(SemTable *sem, T* src,Symbol to_sym, Structure to_s,T **result) {
@@ -115,14 +273,21 @@ int _p_transcode(SemTable *sem, T* src,Symbol to_sym, Structure to_s,T **result)
         dofree = false;
     }
     else {
-        Process p = _p_get_transcoder(sem,src_sym,to_sym);
-        if (!semeq(p,NULL_PROCESS)) {
+        Transcoder *tc = _p_find_transcoder(sem,src_sym,to_sym);
+        if (tc && tc->fn) {
+            // native transcoders build the result directly from the source
+            err = (tc->fn)(sem,src,to_sym,&x);
+            if (err && err != redoReduction) {
+                _t_free(src);
+                return err;
+            }
+        }
+        else if (tc) {
             // we found a defined process for trans coding between the symbols
-            x = __t_newr(0,p,true);
+            x = __t_newr(0,tc->process,true);
             _t_add(x,src);
             err=redoReduction;
             dofree = false;
-            //                    __t_newi(x,TEST_INT_SYMBOL,3333,true);
         }
         else {
             // built in transcodings for built in structures
@@ -132,70 +297,35 @@ int _p_transcode(SemTable *sem, T* src,Symbol to_sym, Structure to_s,T **result)
                 x->contents.symbol = to_sym;
                 dofree = false;
             }
-            else if (semeq(to_s,INTEGER)) {
-                if (semeq(src_s,CSTRING)) {
-                    x = __t_newi(0,to_sym,atoi(_t_surface(src)),true);
-                }
-                else return incompatibleTypeReductionErr;
-            }
-            else if (semeq(to_sym,ASCII_CHARS)) {
-                if (semeq(src_s,CSTRING)) {
-                    char *c = (char *)_t_surface(src);
-                    int l = _t_size(src);
-                    x = __t_newr(0,ASCII_CHARS,true);
-                    while (--l) { // ignore the terminating null
-                        __t_newc(x,ASCII_CHAR,*c,true);
-                        c++;
-                    }
-
-                }
-                else return incompatibleTypeReductionErr;
+            else if (semeq(to_s,INTEGER) || semeq(to_sym,ASCII_CHARS)) {
+                return incompatibleTypeReductionErr;
             }
             else if (semeq(to_s,CSTRING)) {
-                if (semeq(src_s,INTEGER)) {
-                    char buf[100];
-                    sprintf(buf,"%d",*(int *)_t_surface(src));
-                    x = __t_new_str(0,to_sym,buf,true);
-                }
-                else if (semeq(src_s,FLOAT)) {
-                    char buf[100];
-                    sprintf(buf,"%f",*(float *)_t_surface(src));
-                    x = __t_new_str(0,to_sym,buf,true);
-                }
-                else if (semeq(src_s,CHAR)) {
-                    char buf[2];
-                    buf[0] = *(char *)_t_surface(src);
-                    buf[1] = 0;
-                    x = __t_new_str(0,to_sym,buf,true);
-                }
-                else {
-
-                    // get the definition of the structure of the src symbol.
-                    T *def = _sem_get_def(sem,src_s);
-                    Symbol s_def = *(Symbol *)_t_surface(_t_child(def,2));
-
-                    // if it's an optionality structure then we can recurse on transcode
-                    // and dissolve the results into the parent
-                    if (!semeq(s_def,NULL_SYMBOL)) {
-                        if (_t_children(src) == 0) x = __t_new_str(0,to_sym,"",true);
-                        else {
-                            x = __t_newr(0,DISSOLVE,true);
-                            T *xx = __t_newr(x,LINES,true);
-                            T *k,*r;
-                            int e;
-                            while ((k = _t_detach_by_idx(src,1))) {
-                                e = _p_transcode(sem,k,to_sym,to_s,&r);
-                                if (e && e != redoReduction) {
-                                    _t_free(src);
-                                    return e;
-                                }
-                                _t_add(xx,r);
+                // get the definition of the structure of the src symbol.
+                T *def = _sem_get_def(sem,src_s);
+                Symbol s_def = *(Symbol *)_t_surface(_t_child(def,2));
+
+                // if it's an optionality structure then we can recurse on transcode
+                // and dissolve the results into the parent
+                if (!semeq(s_def,NULL_SYMBOL)) {
+                    if (_t_children(src) == 0) x = __t_new_str(0,to_sym,"",true);
+                    else {
+                        x = __t_newr(0,DISSOLVE,true);
+                        T *xx = __t_newr(x,LINES,true);
+                        T *k,*r;
+                        int e;
+                        while ((k = _t_detach_by_idx(src,1))) {
+                            e = _p_transcode(sem,k,to_sym,to_s,&r);
+                            if (e && e != redoReduction) {
+                                _t_free(src);
+                                return e;
                             }
-                            err = redoReduction;
+                            _t_add(xx,r);
                         }
+                        err = redoReduction;
                     }
-                    else x = __t_new_str(0,to_sym,_t2s(sem,src),true);
                 }
+                else x = __t_new_str(0,to_sym,_t2s(sem,src),true);
             }
             else {
                 debug(D_TRANSCODE,"trying to find structural match\n");
@@ -278,97 +408,181 @@ int _p_transcode(SemTable *sem, T* src,Symbol to_sym, Structure to_s,T **result)
 
 
 /**
- * check a group of parameters to see if they match a process input signature
+ * build a flattened descriptor of a process's signature
  *
  * @param[in] sem Semantic table in use
- * @param[in] p the Process we are checking against
- * @param[in] params list of parameters
- *
- * @returns Error code
- *
- * @todo add SIGNATURE_SYMBOL for setting up process signatures by Symbol not just Structure
+ * @param[in] p the Process whose signature to describe
+ * @returns a newly allocated SigDesc
  */
-Error __p_check_signature(SemTable *sem,Process p,T *code,T *sem_map) {
+SigDesc *__p_build_sigdesc(SemTable *sem,Process p) {
     T *processes = _sem_get_defs(sem,p);
     T *def = _d_get_process_code(processes,p);
     T *signature = _t_child(def,ProcessDefSignatureIdx);
-    // @todo if there's no signature we should probably fail, but instead we assume everything's ok
-    // (sig should always have at least 1 child, the output sig)
     int sigs = _t_children(signature);
-    if (!sigs) return 0;
-    int input_sigs = 0;
     int i;
 
+    SigDesc *d = malloc(sizeof(SigDesc));
+    d->process = p;
+    d->generation = sem->generation;
+    // @todo if there's no signature we should probably fail, but instead we assume everything's ok
+    // (sig should always have at least 1 child, the output sig)
+    d->has_signature = sigs > 0;
+    d->slot_count = 0;
+    d->required = 0;
+    d->slots = sigs ? malloc(sizeof(SigSlot)*sigs) : NULL;
+    d->template_count = -1;
+    d->template_hashes = NULL;
+    d->pure = false;
+    for(i=ProcessDefLinkIdx;i<=_t_children(def);i++) {
+        if (semeq(_t_symbol(_t_child(def,i)),PROCESS_PURE)) d->pure = true;
+    }
+
     for(i=SignatureOutputSigIdx+1;i<=sigs;i++) { // skip the output signature which is always first
         T *s = _t_child(signature,i);
         Symbol sym = _t_symbol(s);
         if (semeq(sym,INPUT_SIGNATURE)) {
-            input_sigs++;
-            T *param = _t_child(code,i-1);
-            T *sig = _t_child(s,2); // input signatures start at 2
-            bool is_optional = _t_child(s,InputSigOptionalIdx) != NULL;
-            if (!param && !is_optional)
-                //                raise_error("missing non-optional param");
-                return tooFewParamsReductionErr;
-            if (!param && is_optional) {
-                // don't count as required sig
-                input_sigs--;
-            }
-            if (param) {
-                if(semeq(_t_symbol(sig),SIGNATURE_STRUCTURE)) {
-                    Structure ss = *(Symbol *)_t_surface(sig);
-                    if (!semeq(_sem_get_symbol_structure(sem,_t_symbol(param)),ss) && !semeq(ss,TREE))
-                        return signatureMismatchReductionErr;
-                }
-                else if(semeq(_t_symbol(sig),SIGNATURE_SYMBOL)) {
-                    Symbol ss = *(Symbol *)_t_surface(sig);
-                    if (!semeq(ss,_t_symbol(param)))
-                        raise_error("signatureMismatchReductionErr expected:%s got:%s\n",_sem_get_name(sem,ss),_t2s(sem,param));
-                    //                    return signatureMismatchReductionErr;
-                }
-                else if(semeq(_t_symbol(sig),SIGNATURE_ANY)) {
-                }
-                else if(semeq(_t_symbol(sig),SIGNATURE_PROCESS)) {
-                    Symbol expected = *(Symbol *)_t_surface(sig);
-                    Symbol actual = _t_symbol(param);
-                    if (!semeq(expected,actual)) {
-                        raise_error("expecting process to reduce to %s, got: %s\n",_sem_get_name(sem,expected),_t2s(sem,param));
-                    }
-                }
-                else {
-                    raise_error("unknown signature checking symbol: %s",_sem_get_name(sem,_t_symbol(sig)));
-                }
-            }
+            SigSlot *slot = &d->slots[d->slot_count++];
+            T *sig = _t_child(s,InputSigSemVariantsIdx);
+            Symbol ss = _t_symbol(sig);
+            slot->param_idx = i-1;
+            slot->optional = _t_child(s,InputSigOptionalIdx) != NULL;
+            if (!slot->optional) d->required++;
+            slot->sig_symbol = ss;
+            slot->kind = semeq(ss,SIGNATURE_STRUCTURE) ? SigSlotStructure :
+                semeq(ss,SIGNATURE_SYMBOL) ? SigSlotSymbol :
+                semeq(ss,SIGNATURE_ANY) ? SigSlotAny :
+                semeq(ss,SIGNATURE_PROCESS) ? SigSlotProcess : SigSlotUnknown;
+            if (slot->kind == SigSlotStructure || slot->kind == SigSlotSymbol || slot->kind == SigSlotProcess)
+                slot->expected = *(SemanticID *)_t_surface(sig);
         }
         else if (semeq(sym,TEMPLATE_SIGNATURE)) {
-            if (!sem_map)
-                return missingSemanticMapReductionErr;
-            int c = _t_children(s);
-            int map_children = _t_children(sem_map);
-            if (map_children < c ) return mismatchSemanticMapReductionErr;
-
-            // build up hashes of all the semantic references in our map
-            // @todo cache this someplace so we don't need to do it every time
-            TreeHash mapped[map_children];
-            int j;
-            for(j=1;j<=map_children;j++) {
-                T *t = _t_child(_t_child(sem_map,j),SemanticMapSemanticRefIdx);
-                mapped[j-1] = _t_hash(sem,t);
-            }
-            // now scan through the signature and see if all it's expected slots are actually mapped
-            // @todo convert this to a true hash lookup algorithm
+            int j,c = _t_children(s);
+            d->template_count = c;
+            d->template_hashes = malloc(sizeof(TreeHash)*(c?c:1));
             for(j=1;j<=c;j++) {
-                T *t = _t_child(_t_child(s,j),1);
-                TreeHash h = _t_hash(sem,t);
-                int k;
-                for (k=0;k<map_children;k++) {
-                    if (mapped[k] == h) {
-                        break;
-                    }
+                d->template_hashes[j-1] = _t_hash(sem,_t_child(_t_child(s,j),1));
+            }
+        }
+    }
+    return d;
+}
+
+/**
+ * get the signature descriptor for a process, building it if it's not cached or out of date
+ *
+ * descriptors are cached per context like symbol info, so finding an up to date one
+ * doesn't lock.  Building one takes the semtable's lock, and the descriptor it replaces is
+ * retired rather than freed as other threads may be checking a signature with it.
+ */
+SigDesc *__p_get_sigdesc(SemTable *sem,Process p) {
+    ContextStore *ctx = __sem_context(sem,p.context);
+    // readers check the number of slots before looking in the array, so it's loaded first
+    int slots = __atomic_load_n(&ctx->sig_slots,__ATOMIC_ACQUIRE);
+    SigDesc **sigs = __atomic_load_n(&ctx->sigs,__ATOMIC_ACQUIRE);
+    SigDesc *d;
+    if (sigs && p.id < slots) {
+        d = __atomic_load_n(&sigs[p.id],__ATOMIC_ACQUIRE);
+        if (d && d->generation == __atomic_load_n(&sem->generation,__ATOMIC_ACQUIRE)) return d;
+    }
+    _sem_lock(sem);
+    if (p.id >= ctx->sig_slots) {
+        int i,n = ctx->sig_slots ? ctx->sig_slots : 64;
+        while (n <= p.id) n *= 2;
+        sigs = malloc(n*sizeof(SigDesc *));
+        for(i=0;i<n;i++) sigs[i] = i < ctx->sig_slots ? ctx->sigs[i] : NULL;
+        SigDesc **old = ctx->sigs;
+        __atomic_store_n(&ctx->sigs,sigs,__ATOMIC_RELEASE);
+        __atomic_store_n(&ctx->sig_slots,n,__ATOMIC_RELEASE);
+        __sem_retire(sem,old);
+    }
+    // another thread may have built it while this one waited for the lock
+    d = ctx->sigs[p.id];
+    if (!d || d->generation != sem->generation) {
+        SigDesc *old = d;
+        d = __p_build_sigdesc(sem,p);
+        __atomic_store_n(&ctx->sigs[p.id],d,__ATOMIC_RELEASE);
+        __sem_retire_sigdesc(sem,old);
+    }
+    _sem_unlock(sem);
+    return d;
+}
+
+/**
+ * check a group of parameters to see if they match a process input signature
+ *
+ * the signature is checked against a cached descriptor (see __p_get_sigdesc) so
+ * that the signature tree doesn't have to be walked on every process call.
+ *
+ * @param[in] sem Semantic table in use
+ * @param[in] p the Process we are checking against
+ * @param[in] params list of parameters
+ *
+ * @returns Error code
+ */
+Error __p_check_signature(SemTable *sem,Process p,T *code,T *sem_map) {
+    SigDesc *d = __p_get_sigdesc(sem,p);
+    if (!d->has_signature) return 0;
+    int input_sigs = d->slot_count;
+    int i;
+
+    for(i=0;i<d->slot_count;i++) {
+        SigSlot *slot = &d->slots[i];
+        T *param = _t_child(code,slot->param_idx);
+        if (!param) {
+            if (!slot->optional)
+                return tooFewParamsReductionErr;
+            // don't count as required sig
+            input_sigs--;
+            continue;
+        }
+        switch(slot->kind) {
+        case SigSlotStructure:
+            if (!semeq(slot->expected,TREE) && !semeq(_sem_get_symbol_structure(sem,_t_symbol(param)),slot->expected))
+                return signatureMismatchReductionErr;
+            break;
+        case SigSlotSymbol:
+            if (!semeq(slot->expected,_t_symbol(param)))
+                raise_error("signatureMismatchReductionErr expected:%s got:%s\n",_sem_get_name(sem,slot->expected),_t2s(sem,param));
+            //                    return signatureMismatchReductionErr;
+            break;
+        case SigSlotAny:
+            break;
+        case SigSlotProcess:
+            if (!semeq(slot->expected,_t_symbol(param))) {
+                raise_error("expecting process to reduce to %s, got: %s\n",_sem_get_name(sem,slot->expected),_t2s(sem,param));
+            }
+            break;
+        default:
+            raise_error("unknown signature checking symbol: %s",_sem_get_name(sem,slot->sig_symbol));
+        }
+    }
+
+    if (d->template_count >= 0) {
+        if (!sem_map)
+            return missingSemanticMapReductionErr;
+        int c = d->template_count;
+        int map_children = _t_children(sem_map);
+        if (map_children < c ) return mismatchSemanticMapReductionErr;
+
+        // build up hashes of all the semantic references in our map
+        TreeHash mapped[map_children];
+        int j;
+        for(j=1;j<=map_children;j++) {
+            T *t = _t_child(_t_child(sem_map,j),SemanticMapSemanticRefIdx);
+            mapped[j-1] = _t_hash(sem,t);
+        }
+        // now scan through the signature and see if all it's expected slots are actually mapped
+        // @todo convert this to a true hash lookup algorithm
+        for(j=0;j<c;j++) {
+            TreeHash h = d->template_hashes[j];
+            int k;
+            for (k=0;k<map_children;k++) {
+                if (mapped[k] == h) {
+                    break;
                 }
-                // not found so return a mismatch error
-                if (k == map_children) return mismatchSemanticMapReductionErr;
             }
+            // not found so return a mismatch error
+            if (k == map_children) return mismatchSemanticMapReductionErr;
         }
     }
     int param_count = _t_children(code);
@@ -386,6 +600,24 @@ void __p_unwind_to_point(R *context,T *code_point,T *with) {
     context->node_pointer = with;
 }
 
+// find the scape a QUERY instruction searches, from its "of" param and the symbol of its key
+Error __p_query_scape(Q *q,T *code,T *key,bool ordered,Scape **scp) {
+    Symbol of = *(Symbol *)_t_surface(_t_child(code,1));
+    Scape *sc = _a_find_scape(&q->r->instances,of,_t_symbol(key));
+    if (!sc) return noScapeReductionErr;
+    if (ordered && !sc->order) return unorderedScapeReductionErr;
+    *scp = sc;
+    return noReductionErr;
+}
+
+// get the next instance of the results of a query being iterated on, skipping any deleted since the query
+T *__p_next_result(Q *q,IterationState *state) {
+    T *i = NULL;
+    while (!i && state->cursor < _t_children(state->results))
+        i = _r_get_instance(q->r,*(Xaddr *)_t_surface(_t_child(state->results,++state->cursor)));
+    return i;
+}
+
 /**
  * reduce system level processes in a run tree.  Assumes that the children have already been
  * reduced and all parameters have been filled in
@@ -393,12 +625,16 @@ void __p_unwind_to_point(R *context,T *code_point,T *with) {
  * these system level processes are the equivalent of the instruction set of the ceptr virtual machine
  */
 Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
+    return ___p_reduce_sys_proc(q ? q->r->sem : G_sem,context,s,code,q);
+}
+
+// reduce a system level process using the given semantic table
+Error ___p_reduce_sys_proc(SemTable *sem,R *context,Symbol s,T *code,Q *q) {
     int b,c;
     char *str;
     Symbol sy;
     T *x,*t,*match_results,*match_tree;
     Error err = noReductionErr;
-    SemTable *sem = q ? q->r->sem : G_sem;
 
     debug(D_REDUCE,"Reducing sys proc: %s\n",_sem_get_name(sem,s));
     debug(D_STEP,"Reducing %s\n",_t2s(sem,code));
@@ -424,11 +660,42 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
             }
         }
         break;
+    case QUERY_ID:
+        {
+            T *key = _t_child(code,2);
+            Scape *sc;
+            err = __p_query_scape(q,code,key,false,&sc);
+            if (err) return err;
+            int i,count;
+            Xaddr *xs = _s_get_all(sc,key,&count);
+            x = __t_newr(0,QUERY_RESULTS,true);
+            for(i=0;i<count;i++)
+                __t_new(x,WHICH_XADDR,&xs[i],sizeof(Xaddr),true);
+        }
+        break;
+    case QUERY_RANGE_ID:
+        {
+            T *from = _t_child(code,2);
+            Scape *sc;
+            err = __p_query_scape(q,code,from,true,&sc);
+            if (err) return err;
+            x = __s_range(sc,from,_t_child(code,3),true);
+        }
+        break;
+    case QUERY_PREFIX_ID:
+        {
+            T *prefix = _t_child(code,2);
+            Scape *sc;
+            err = __p_query_scape(q,code,prefix,true,&sc);
+            if (err) return err;
+            x = __s_prefix(sc,prefix,true);
+        }
+        break;
     case DEF_SYMBOL_ID:
         {
             T *def = _t_detach_by_idx(code,1);
             //@todo some kind of validation of the def??
-            SemanticID ns = _d_define(sem,def, SEM_TYPE_SYMBOL,q->r->context);
+            SemanticID ns = _r_define(q->r,def,SEM_TYPE_SYMBOL);
             x = __t_news(0,RESULT_SYMBOL,ns,true);
         }
         break;
@@ -436,7 +703,7 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
         {
             T *def = _t_detach_by_idx(code,1);
             //@todo some kind of validation of the def??
-            SemanticID ns = _d_define(sem,def, SEM_TYPE_STRUCTURE,q->r->context);
+            SemanticID ns = _r_define(q->r,def,SEM_TYPE_STRUCTURE);
             x = __t_news(0,RESULT_STRUCTURE,ns,true);
         }
         break;
@@ -444,7 +711,9 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
         {
             T *def = _t_detach_by_idx(code,1);
             //@todo some kind of validation of the def??
-            SemanticID ns = _d_define(sem,def, SEM_TYPE_PROCESS,q->r->context);
+            T *dc = _t_child(def,ProcessDefCodeIdx);
+            if (dc) _p_fold_constants(sem,dc);
+            SemanticID ns = _r_define(q->r,def,SEM_TYPE_PROCESS);
             x = __t_news(0,RESULT_PROCESS,ns,true);
         }
         break;
@@ -452,7 +721,7 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
         {
             T *def = _t_detach_by_idx(code,1);
             //@todo some kind of validation of the def??
-            SemanticID ns = __d_define_receptor(sem,def,q->r->context);
+            SemanticID ns = _r_define(q->r,def,SEM_TYPE_RECEPTOR);
             x = __t_news(0,RESULT_RECEPTOR,ns,true);
         }
         break;
@@ -460,7 +729,7 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
         {
             T *def = _t_detach_by_idx(code,1);
             //@todo some kind of validation of the def??
-            SemanticID ns = _d_define(sem,def,SEM_TYPE_PROTOCOL,q->r->context);
+            SemanticID ns = _r_define(q->r,def,SEM_TYPE_PROTOCOL);
             x = __t_news(0,RESULT_PROTOCOL,ns,true);
         }
         break;
@@ -477,6 +746,11 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
             }
             else {
                 t->contents.symbol = s;
+                Xaddr xn = {s,0};
+                if (!_a_can_scape(&q->r->instances,t,xn)) {
+                    _t_free(t);
+                    return duplicateKeyReductionErr;
+                }
                 Xaddr xa = _r_new_instance(q->r,t);
                 x = __t_new(0,WHICH_XADDR,&xa,sizeof(Xaddr),1);
             }
@@ -540,7 +814,7 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
             else {
                 // cleanup the state before returning.
                 _t_free(state->conditions);
-                free(state);
+                __p_frame_free(__p_pool(q,conds),state);
                 code->contents.size = 0;
             }
         }
@@ -651,43 +925,80 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
         }
         c = _t_children(code);
 
-        // make sure the surface was allocated and if not, converted to an alloced surface
-        if (c > 0) {
-            if (!(x->context.flags & TFLAG_ALLOCATED)) {
-                str = malloc(x->contents.size);
-                memcpy(str,&x->contents.surface,x->contents.size);
+        // check the types and total up the size of the result so that it can be
+        // allocated and copied just once
+        {
+            Structure struc = _sem_get_symbol_structure(sem,_t_symbol(x));
+            size_t size,total;
+            bool is_char = semeq(struc,CHAR);
+            if (is_char) size = 1;
+            else if (semeq(struc,CSTRING)) size = strlen((char *)_t_surface(x));
+            else {
+                _t_free(x);
+                return incompatibleTypeReductionErr;
+            }
+            total = size;
+            for(b=1;b<=c;b++) {
+                T *t = _t_child(code,b);
+                struc = _sem_get_symbol_structure(sem,_t_symbol(t));
+                if (semeq(struc,CSTRING)) total += strlen((char *)_t_surface(t));
+                else if (semeq(struc,CHAR)) total++;
+                else {
+                    _t_free(x);
+                    return incompatibleTypeReductionErr;
+                }
+            }
+            if (total != size || is_char) {
+                char *p = str = malloc(total+1);
+                memcpy(p,_t_surface(x),size);
+                p += size;
+                for(b=1;b<=c;b++) {
+                    T *t = _t_child(code,b);
+                    if (semeq(_sem_get_symbol_structure(sem,_t_symbol(t)),CHAR)) *p++ = *(char *)_t_surface(t);
+                    else {
+                        size = strlen((char *)_t_surface(t));
+                        memcpy(p,_t_surface(t),size);
+                        p += size;
+                    }
+                }
+                *p = 0;
+                if (x->context.flags & TFLAG_ALLOCATED) free(x->contents.surface);
                 x->contents.surface = str;
-                x->context.flags = TFLAG_ALLOCATED+TFLAG_RUN_NODE;
+                x->contents.size = total+1;
+                x->context.flags |= TFLAG_ALLOCATED;
             }
         }
-        // check type the first node
-        Structure struc = _sem_get_symbol_structure(sem,_t_symbol(x));
-        if (semeq(struc,CHAR)) {
-            x->contents.surface = realloc(x->contents.surface,++x->contents.size);
-            ((char *)x->contents.surface)[1] = 0;
-        }
-        else if (!semeq(struc,CSTRING)) {
-            _t_free(x);
-            return incompatibleTypeReductionErr;
-        }
-        /// @todo this would probably be faster with just one total realloc for all children
-        for(b=1;b<=c;b++) {
-            T *t = _t_child(code,b);
-            struc = _sem_get_symbol_structure(sem,_t_symbol(t));
-            str = (char *)_t_surface(t);
-            int size;
-            if (semeq(struc,CSTRING)) size = strlen(str);
-            else if (semeq(struc,CHAR)) size = 1;
-            else {
+        x->contents.symbol = sy;
+        break;
+    case ROPE_APPEND_ID:
+        {
+            x = _t_detach_by_idx(code,1);
+            if (!x) return tooFewParamsReductionErr;
+            if (!semeq(_sem_get_symbol_structure(sem,_t_symbol(x)),ROPE)) {
                 _t_free(x);
                 return incompatibleTypeReductionErr;
             }
-            x->contents.surface = realloc(x->contents.surface,x->contents.size+size);
-            memcpy(x->contents.surface+x->contents.size-1,str,size);
-            x->contents.size+=size;
-            *( (char *)x->contents.surface + x->contents.size -1) = 0;
+            // the pieces are moved into the rope, never copied
+            T *t;
+            while((t = _t_detach_by_idx(code,1))) {
+                Structure struc = _sem_get_symbol_structure(sem,_t_symbol(t));
+                if (semeq(struc,CHAR)) {
+                    char buf[2] = {*(char *)_t_surface(t),0};
+                    _t_free(t);
+                    _t_add(x,__t_new_str(0,ASCII_STR,buf,true));
+                }
+                else if (semeq(struc,CSTRING)) _t_add(x,t);
+                else if (semeq(struc,ROPE)) {
+                    __t_append_children(x,t);
+                    _t_free(t);
+                }
+                else {
+                    _t_free(t);
+                    _t_free(x);
+                    return incompatibleTypeReductionErr;
+                }
+            }
         }
-        x->contents.symbol = sy;
         break;
     case EXPAND_STR_ID:
         {
@@ -837,8 +1148,8 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                 if (w) {
                     int *code_path = (int *)_t_surface(_t_child(w,WakeupReferenceCodePathIdx));
                     int process_id = *(int *)_t_surface(_t_child(w,WakeupReferenceProcessIdentIdx));
-                    debug(D_LOCK,"complete LOCK\n");
-                    pthread_mutex_lock(&q->mutex);
+                    // we are running in the thread that owns the q so we can
+                    // manipulate the lists directly
                     Qe *e = __p_find_context(q->blocked,process_id);
                     if (e) {
                         if (with) {
@@ -850,8 +1161,6 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                         __p_unblock(q,e,noReductionErr);
                     }
                     else if (with) _t_free(with);
-                    pthread_mutex_unlock(&q->mutex);
-                    debug(D_LOCK,"complete UNLOCK\n");
                 }
                 x = cid;
             }
@@ -960,6 +1269,11 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                 _t_detach_by_idx(code,1);
                 _t_free(s);
                 if (st->err) return(st->err);
+                // i.e. an HTTP request whose body couldn't be framed
+                if (st->flags & StreamUnitBad) {
+                    _st_data_consumed(st);
+                    return incompatibleTypeReductionErr;
+                }
                 // get the result type to use as the symbol type for the ascii data
                 s = _t_detach_by_idx(code,1);
                 sy = _t_symbol(s);
@@ -972,11 +1286,17 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                     Structure to_s = _sem_get_symbol_structure(sem,sy);
                     if (semeq(to_s,CSTRING)) {
                         debug(D_STREAM,"creating CSTRING: %s '%.*s'\n",_sem_get_name(sem,sy),(int)l,c);
-                        // @todo fix this to be a flag instruction to __t_new
-                        // currently it only works because that value is the newline in the
-                        // read buffer.
-                        _st_data(st)[l] = 0;
+                        // terminate the copy, not the read buffer, which may hold the next unit
                         x = __t_new(0,sy,c,l+1,1);
+                        ((char *)_t_surface(x))[l] = 0;
+                    }
+                    else if (semeq(sy,HTTP_REQUEST)) {
+                        debug(D_STREAM,"parsing HTTP_REQUEST directly from the stream buffer\n");
+                        x = __http_parse_request(c,l,true);
+                        if (!x) {
+                            _st_data_consumed(st);
+                            return incompatibleTypeReductionErr;
+                        }
                     }
                     else {
                         debug(D_STREAM,"non CSTRING RESULT_SYMBOL so converting to ASCII_CHARS and transcoding to %s \n",_sem_get_name(sem,sy));
@@ -998,7 +1318,7 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
             else if (_st_is_alive(st)) {
                 st->callback = processUnblocker;
                 st->callback_arg1 = q;
-                st->callback_arg2 = q->active->id;
+                st->callback_arg2 = context->id;
 
                 // start up the thread to read the data,
                 _st_start_read(st);
@@ -1075,11 +1395,24 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                     }
                     else if (semeq(c,ITERATE_ON_SYMBOL)) {
                         state->type = IterateTypeOnSymbol;
-                        T *params = _t_child(code,1);
-                        T *list = _t_newr(params,ITERATION_DATA);
-                        _a_get_instances(&q->r->instances,*(Symbol *)_t_surface(x),list);
-                        // if the list has no children the we are already done
-                        done = !_t_children(list);
+                        state->symbol = *(Symbol *)_t_surface(x);
+                        state->cursor = 0;
+                        // rather than copying all the instances up front we walk the instance
+                        // store with a cursor and only copy the current instance into the data,
+                        // stopping at the instances there are now so the body can add more
+                        state->end = _a_instance_slots(&q->r->instances,state->symbol);
+                        T *i = _a_next_instance(&q->r->instances,state->symbol,&state->cursor,state->end);
+                        // if there are no instances then we are already done
+                        if (!i) done = true;
+                        else _t_add(_t_newr(_t_child(code,1),ITERATION_DATA),_t_clone(i));
+                    }
+                    else if (semeq(c,QUERY_RESULTS)) {
+                        state->type = IterateTypeOnResults;
+                        state->results = _t_clone(x);
+                        state->cursor = 0;
+                        T *i = __p_next_result(q,state);
+                        if (!i) done = true;
+                        else _t_add(_t_newr(_t_child(code,1),ITERATION_DATA),_t_clone(i));
                     }
                     else {
                         Structure s = _sem_get_symbol_structure(sem,c);
@@ -1100,7 +1433,7 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                 case IterateTypeCount:
                     done = (--state->count < 0);
                     break;
-                // IterateTypeOnSymbol handled above
+                // IterateTypeOnSymbol and IterateTypeOnResults handled above
                 }
                 next_phase = EvalBody;
                 break;
@@ -1119,13 +1452,17 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                     // we aren't doing count iteration, use the count var just
                     // to keep track of how many times we've gone through the loop
                     state->count++;
-                    if (state->type == IterateTypeOnSymbol) {
+                    if (state->type == IterateTypeOnSymbol || state->type == IterateTypeOnResults) {
                         T *params = _t_child(code,1);
                         int p = _t_children(params);
                         T *list = _t_child(params,p);  // iterate list should be last child
                         T *t = _t_detach_by_idx(list,1);
                         _t_free(t);
-                        if (!_t_children(list)) done = true;
+                        T *i = state->type == IterateTypeOnSymbol ?
+                            _a_next_instance(&q->r->instances,state->symbol,&state->cursor,state->end) :
+                            __p_next_result(q,state);
+                        if (!i) done = true;
+                        else _t_add(list,_t_clone(i));
                     }
                     //if (state->count > 9) done = true;  // temporary infinite loop breaker
                 }
@@ -1134,7 +1471,8 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                 // we are done so free up the iteration state info
                 /// @todo the value returned from the iteration will be what??(what's in x)
                 _t_free(state->code);
-                free(state);
+                if (state->results) _t_free(state->results);
+                __p_frame_free(__p_pool(q,iterations),state);
                 code->contents.size = 0;
             }
             else {
@@ -1283,6 +1621,28 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
                     x = __t_new_str(0,LINE,"debugging disabled",1);
                 }
                 break;
+            case MagicProfile:
+                if (q && q->profile) x = __pf_report(q->profile,true);
+                else x = __t_newr(0,RECEPTOR_PROFILE,true);
+                break;
+            case MagicTrace:
+                // the first time turns tracing on, after that it writes out the trace so far
+                if (!G_vm)
+                    x = __t_new_str(0,LINE,"no vmhost to trace",1);
+                else if (!G_vm->trace_size) {
+                    _v_trace(G_vm,TRACE_BUFFER_SIZE);
+                    x = __t_new_str(0,LINE,"tracing enabled",1);
+                }
+                else {
+                    FILE *f = fopen(TRACE_FILE,"w");
+                    if (f) {
+                        _v_dump_trace(G_vm,f);
+                        fclose(f);
+                        x = __t_new_str(0,LINE,"trace written to " TRACE_FILE,1);
+                    }
+                    else x = __t_new_str(0,LINE,"unable to write " TRACE_FILE,1);
+                }
+                break;
             case MagicQuit:
                 if (G_vm) {
                     __r_kill(G_vm->r);
@@ -1341,9 +1701,11 @@ Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q) {
 
 /**
  * create a run-tree execution context.
+ *
+ * @param[in] q the q whose context pool to allocate from, or NULL to malloc
  */
-R *__p_make_context(T *run_tree,R *caller,int process_id,T *sem_map) {
-    R *context = malloc(sizeof(R));
+R *___p_make_context(Q *q,T *run_tree,R *caller,int process_id,T *sem_map) {
+    R *context = __p_frame_alloc(__p_pool(q,contexts),sizeof(R));
     context->id = process_id;
     context->state = Eval;
     context->err = 0;
@@ -1356,6 +1718,9 @@ R *__p_make_context(T *run_tree,R *caller,int process_id,T *sem_map) {
     context->sem_map = sem_map;
     // copy in the callers conversation context too.
     context->conversation = caller ? caller->conversation : NULL;
+    context->memo = NULL_PROCESS;
+    context->memo_params = NULL;
+    context->process = NULL_PROCESS;
     if (caller) caller->callee = context;
     return context;
 }
@@ -1412,64 +1777,37 @@ Qe *__p_find_context(Qe *e,int process_id) {
     return e;
 }
 
-// low level unblock. Should be called only when q mutex is locked
+// low level unblock. Should be called only by the thread that owns the q
 void __p_unblock(Q *q,Qe *e,Error err) {
     __p_dequeue(q->blocked,e);
     __p_enqueue(q->active,e);
     q->contexts_count++;
     e->context->state = err ? err : Eval;
+    _tr_event(q->trace,TraceUnblock,NULL_SYMBOL,e->id);
 }
 
-/**
- * search for the context in the q and unblock it
- */
-Error _p_unblock(Q *q,int id) {
-    // find the context in the queue
-    int err = 0;
-    debug(D_LOCK,"unblock LOCK\n");
-    pthread_mutex_lock(&q->mutex);
-    Qe *e = __p_find_context(q->blocked,id);
-    if (e) {
-        __p_unblock(q,e,noReductionErr);
+// lock-free push of a chain of elements (from head to tail) onto a singly linked stack
+#define __p_push(stackP,head,tail) {                                    \
+        typeof(head) _top;                                              \
+        do {                                                            \
+            _top = __atomic_load_n(stackP,__ATOMIC_RELAXED);            \
+            (tail)->next = _top;                                        \
+        } while(!__atomic_compare_exchange_n(stackP,&_top,head,1,__ATOMIC_RELEASE,__ATOMIC_RELAXED)); \
     }
-    else {
-        // if the process has been completed then return err 2 otherwise 1
-        e = __p_find_context(q->completed,id);
-        if (e) err = 2;
-        else {
-            e = __p_find_context(q->active,id);
-            err = e ? 1 : 3;
-        }
-    }
-    pthread_mutex_unlock(&q->mutex);
-    debug(D_LOCK,"unblock UNLOCK\n");
-    return err;
-}
 
+// take ownership of the q's lists, returning false if some other thread already has it
+#define __p_own(q) (__atomic_exchange_n(&(q)->owned,1,__ATOMIC_ACQUIRE) == 0)
+#define __p_disown(q) __atomic_store_n(&(q)->owned,0,__ATOMIC_RELEASE)
 
-/**
- * wakeup a process that's been paused
- *
- * @param[in] q the processing q in which to search for the process
- * @param[in] wakeup the WAKEUP_REF tree that identifies what needs waking up
- * @param[in] with a value to replace the current node_pointer with (i.e. a result)
- * @param[in] err an error value if the wakeup should trigger the error handler instead of resuming processing
- */
-void _p_wakeup(Q *q,T *wakeup, T *with,Error err) {
-    int process_id = *(int *)_t_surface(_t_child(wakeup,WakeupReferenceProcessIdentIdx));
-    //int *code_path = (int *)_t_surface(_t_child(wakeup,WakeupReferenceCodePathIdx));
+// spin until we own the q, owners other than the reducer only hold it briefly
+void __p_own_wait(Q *q) {
+    while (!__p_own(q)) sched_yield();
+}
 
-    debug(D_LOCK,"wakeup LOCK\n");
-    pthread_mutex_lock(&q->mutex);
+// low level wakeup. Should be called only by the thread that owns the q
+void __p_wakeup(Q *q,int process_id,T *with,Error err) {
     Qe *e = __p_find_context(q->blocked,process_id);
     if (e) {
-        // code_path is something I thought I needed to restart execution at the right place
-        // I currently think that was a mistake, because a blocked process should really only
-        // be blocked at ONE place, wherever the node_pointer is.
-        /* T *t = _t_get(e->context->run_tree,code_path); */
-        /* if (!t) raise_error("failed to find code path when waking up expectation!"); */
-        /* if (t != e->context->node_pointer) */
-        /*     raise_error("wakeup ref and node_pointer don't match"); */
         if (with) {
             if (!(with->context.flags & TFLAG_RUN_NODE)) {
                 T *w = _t_rclone(with);
@@ -1484,8 +1822,102 @@ void _p_wakeup(Q *q,T *wakeup, T *with,Error err) {
         __p_unblock(q,e,err);
     }
     else { if (with) _t_free(with);}
-    pthread_mutex_unlock(&q->mutex);
-    debug(D_LOCK,"wakeup UNLOCK\n");
+}
+
+/**
+ * move everything posted to the q's inbox onto the q's lists
+ *
+ * new processes are appended to the active list, and then pending wakeups are applied.
+ * Should be called only by the thread that owns the q.
+ */
+void __p_drain(Q *q) {
+    Qe *e = __atomic_exchange_n(&q->inbox,NULL,__ATOMIC_ACQUIRE);
+    // the inbox is a stack so reverse it to preserve arrival order
+    Qe *l = NULL;
+    while (e) {
+        Qe *n = e->next;
+        e->next = l;
+        l = e;
+        e = n;
+    }
+    while (l) {
+        Qe *n = l->next;
+        l->prev = NULL;
+        __p_append(q->active,l);
+        q->contexts_count++;
+        l = n;
+    }
+
+    Qwakeup *w = __atomic_exchange_n(&q->wakeups,NULL,__ATOMIC_ACQUIRE);
+    Qwakeup *wl = NULL;
+    while (w) {
+        Qwakeup *n = w->next;
+        w->next = wl;
+        wl = w;
+        w = n;
+    }
+    while (wl) {
+        Qwakeup *n = wl->next;
+        __p_wakeup(q,wl->id,wl->with,wl->err);
+        free(wl);
+        wl = n;
+    }
+}
+
+/**
+ * drain the q's inbox right away if no other thread owns the q
+ *
+ * if some other thread does own the q, it will do the draining, either between
+ * reduction steps or when it gives up ownership.
+ */
+void __p_try_drain(Q *q) {
+    while ((__atomic_load_n(&q->inbox,__ATOMIC_RELAXED) || __atomic_load_n(&q->wakeups,__ATOMIC_RELAXED)) && __p_own(q)) {
+        __p_drain(q);
+        __p_disown(q);
+    }
+}
+
+// post a wakeup request onto the q's inbox
+void __p_post_wakeup(Q *q,int process_id,T *with,Error err) {
+    Qwakeup *w = malloc(sizeof(Qwakeup));
+    w->id = process_id;
+    w->with = with;
+    w->err = err;
+    __p_push(&q->wakeups,w,w);
+    __p_try_drain(q);
+}
+
+/**
+ * unblock a blocked process
+ *
+ * safe to call from any thread.  The unblock request is posted to the q and applied by
+ * the thread that owns it, if the process isn't blocked at that point the request is dropped.
+ *
+ * @param[in] q the processing q in which to search for the process
+ * @param[in] id the process id to unblock
+ */
+void _p_unblock(Q *q,int id) {
+    __p_post_wakeup(q,id,NULL,noReductionErr);
+}
+
+
+/**
+ * wakeup a process that's been paused
+ *
+ * safe to call from any thread, see _p_unblock
+ *
+ * @param[in] q the processing q in which to search for the process
+ * @param[in] wakeup the WAKEUP_REF tree that identifies what needs waking up
+ * @param[in] with a value to replace the current node_pointer with (i.e. a result)
+ * @param[in] err an error value if the wakeup should trigger the error handler instead of resuming processing
+ */
+void _p_wakeup(Q *q,T *wakeup, T *with,Error err) {
+    int process_id = *(int *)_t_surface(_t_child(wakeup,WakeupReferenceProcessIdentIdx));
+    // code_path is something I thought I needed to restart execution at the right place
+    // I currently think that was a mistake, because a blocked process should really only
+    // be blocked at ONE place, wherever the node_pointer is.
+    //int *code_path = (int *)_t_surface(_t_child(wakeup,WakeupReferenceCodePathIdx));
+    __p_post_wakeup(q,process_id,with,err);
 }
 
 /**
@@ -1505,20 +1937,24 @@ void _p_wakeup(Q *q,T *wakeup, T *with,Error err) {
  */
 Error _p_reduce(SemTable *sem,T *rt) {
     T *run_tree = rt;
-    R *context = __p_make_context(run_tree,0,0,NULL);
     Error e;
 
     // build a fake Receptor and Q on the stack so _p_step will work
     Receptor r;
     Q q;
+    memset(&q,0,sizeof(Q));
     r.root = NULL;
     r.sem = sem;
     r.q = &q;
+    r.timers = NULL;
+    r.timeouts = NULL;
     q.r = &r;
 
+    R *context = ___p_make_context(&q,run_tree,0,0,NULL);
     while(_p_step(&q, &context) != Done);
     e = context->err;
-    free(context);
+    __p_frame_free(&q.contexts,context);
+    __p_free_pools(&q);
     return e;
 }
 
@@ -1545,6 +1981,10 @@ T * __p_buildErr(R *context) {
     case missingSemanticMapReductionErr: se=MISSING_SEMANTIC_MAP_ERR;break;
     case mismatchSemanticMapReductionErr: se=MISMATCH_SEMANTIC_MAP_ERR;break;
     case structureMismatchReductionErr: se=STRUCTURE_MISMATCH_ERR;break;
+    case timeoutReductionErr: se=TIMEOUT_ERR;break;
+    case duplicateKeyReductionErr: se=DUPLICATE_KEY_ERR;break;
+    case noScapeReductionErr: se=NO_SCAPE_ERR;break;
+    case unorderedScapeReductionErr: se=UNORDERED_SCAPE_ERR;break;
         //    case conversatonCompletedReductionErr: se=CONVERSATION_COMPLETED_ERR;break;
     case unixErrnoReductionErr:
         se=UNIX_ERRNO_ERR;
@@ -1565,6 +2005,78 @@ T * __p_buildErr(R *context) {
     return err;
 }
 
+// check if a sys process has no side effects and the right number of params to be reduced
+// at definition time
+bool __p_is_foldable(Process s,T *code) {
+    if (!is_sys_process(s)) return false;
+    int c = _t_children(code);
+    switch(s.id) {
+    case NOOP_ID:
+    case EXPAND_STR_ID:
+        return c == 1;
+    case IF_ID:
+        return c == 3;
+    case ADD_INT_ID:
+    case SUB_INT_ID:
+    case MULT_INT_ID:
+    case DIV_INT_ID:
+    case MOD_INT_ID:
+    case EQ_INT_ID:
+    case LT_INT_ID:
+    case GT_INT_ID:
+    case LTE_INT_ID:
+    case GTE_INT_ID:
+    case EQ_SYM_ID:
+        return c == 2;
+    case CONCAT_STR_ID:
+    case CONTRACT_STR_ID:
+        return c >= 2;
+    }
+    return false;
+}
+
+// check that nothing in a tree depends on the context it gets reduced in
+bool __p_is_constant(T *t) {
+    Symbol s = _t_symbol(t);
+    if (is_process(s) || semeq(s,PARAM_REF) || semeq(s,SIGNAL_REF) || semeq(s,PARAMETER) || semeq(s,SLOT))
+        return false;
+    if (t->context.flags & (TFLAG_SURFACE_IS_TREE|TFLAG_SURFACE_IS_RECEPTOR|TFLAG_SURFACE_IS_SCAPE|TFLAG_SURFACE_IS_CPTR))
+        return false;
+    DO_KIDS(t,if (!__p_is_constant(_t_child(t,i))) return false;);
+    return true;
+}
+
+/**
+ * fold the constant parts of a process's code
+ *
+ * any sys process in the code that has no side effects and whose params don't depend
+ * on the context (i.e. no PARAM_REFs, SIGNAL_REFs, SLOTs or other process calls) gets
+ * reduced once, in place, so it doesn't have to be reduced every time the code is run.
+ * Quoted code is left alone, and so are reductions that fail (like a divide by zero) so
+ * the error still happens when the code runs.
+ *
+ * @param[in] sem Semantic table in use
+ * @param[in,out] code the code tree to fold
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessFoldConstants
+ */
+void _p_fold_constants(SemTable *sem,T *code) {
+    Symbol s = _t_symbol(code);
+    if (semeq(s,QUOTE)) return;
+    DO_KIDS(code,_p_fold_constants(sem,_t_child(code,i)));
+    if (!__p_is_foldable(s,code)) return;
+    DO_KIDS(code,if (!__p_is_constant(_t_child(code,i))) return;);
+
+    // reduce a run-node copy because the sys procs build their results out of run nodes
+    T *r = _t_rclone(code);
+    if (___p_reduce_sys_proc(sem,NULL,s,r,NULL) == noReductionErr) {
+        debug(D_REDUCE,"folded %s to %s\n",_sem_get_name(sem,s),_t2s(sem,r));
+        _t_replace_node(code,(code->context.flags & TFLAG_RUN_NODE) ? _t_rclone(r) : _t_clone(r));
+    }
+    _t_free(r);
+}
+
 /**
  * take one step in the execution state machine given a run-tree context
  *
@@ -1593,6 +2105,12 @@ Error _p_step(Q *q, R **contextP) {
                 _t_replace(context->run_tree,1,t);
 
                 context->err = noReductionErr;
+                // an error handler's result isn't the process's result so don't memoize it
+                context->memo = NULL_PROCESS;
+                if (context->memo_params) {
+                    _t_free(context->memo_params);
+                    context->memo_params = NULL;
+                }
             }
         }
 
@@ -1610,10 +2128,15 @@ Error _p_step(Q *q, R **contextP) {
             // otherwise pop the context
             R *ctx = context;
             context = context->caller;  // set the new context
+            _tr_event(q->trace,TraceStepEnd,NULL_SYMBOL,ctx->id);
 
             if (!ctx->err) {
                 // get results of the run_tree
                 T *np = _t_detach_by_idx(ctx->run_tree,1);
+                if (!semeq(ctx->memo,NULL_PROCESS)) {
+                    __p_memo_put(q,ctx->memo,ctx->memo_hash,ctx->memo_params,np);
+                    ctx->memo_params = NULL;
+                }
                 _t_replace(context->parent,context->idx,np); // replace the process call node with the result
                 set_rt_cur_child(q->r,np,RUN_TREE_EVALUATED);
                 context->node_pointer = np;
@@ -1622,7 +2145,8 @@ Error _p_step(Q *q, R **contextP) {
             else context->state = ctx->err;
             // cleanup
             _t_free(ctx->run_tree);
-            free(ctx);
+            if (ctx->memo_params) _t_free(ctx->memo_params);
+            __p_frame_free(__p_pool(q,contexts),ctx);
             context->callee = 0;
             *contextP = context;
         }
@@ -1721,10 +2245,11 @@ Error _p_step(Q *q, R **contextP) {
                         // sanity check
                         if (_t_children(np) != 3) {raise_error("ITERATE must have 3 params");}
                         // create a copy of the code and stick it in the iteration state struct
-                        IterationState *state = malloc(sizeof(IterationState));
+                        IterationState *state = __p_frame_alloc(__p_pool(q,iterations),sizeof(IterationState));
                         state->phase = EvalCondition;
                         state->code = _t_rclone(np);
                         state->type = IterateTypeUnknown;
+                        state->results = NULL;
                         *((IterationState **)&np->contents.surface) = state;
                         np->contents.size = sizeof(IterationState *);
 
@@ -1737,7 +2262,7 @@ Error _p_step(Q *q, R **contextP) {
                     // if first time we are hitting the cond
                     // the we need to set up the state data to track flow control
                     if (_t_size(np) == 0) {
-                        CondState *state = malloc(sizeof(CondState));
+                        CondState *state = __p_frame_alloc(__p_pool(q,conds),sizeof(CondState));
                         // remove the conditions and store them in state
                         T *c = state->conditions = _t_detach_by_idx(np,1);
                         c = _t_child(c,1);
@@ -1807,16 +2332,43 @@ Error _p_step(Q *q, R **contextP) {
                         // a new run-tree run that process
 
                         Error e = __p_check_signature(sem,s,np,context->sem_map);
+                        T *m = NULL;
+                        TreeHash h;
+                        // pure processes called with the same params (and no semantic map
+                        // in effect) reduce to the same result, so check the memo cache
+                        bool pure = !e && !context->sem_map && __p_get_sigdesc(sem,s)->pure;
+                        if (pure) {
+                            // the process node itself has no surface to hash
+                            h = _t_children(np) ? _t_hash(sem,np) : 0;
+                            m = __p_memo_get(q,s,h,np);
+                        }
+                        if (q->profile && !e) __pf_call(q->profile,s);
                         if (e) {
                             context->state = e;
                         }
+                        else if (m) {
+                            m = _t_rclone(m);
+                            _t_replace(context->parent,context->idx,m);
+                            set_rt_cur_child(q->r,m,RUN_TREE_EVALUATED);
+                            context->node_pointer = m;
+                            context->state = Eval;
+                        }
                         else {
+                            // copy the params before making the run tree takes them
+                            T *memo_params = pure ? _t_clone(np) : NULL;
                             T *run_tree = _p_make_run_tree(sem,s,np,context->sem_map);
                             context->state = Pushed;
                             // @todo for now we just are just passing the semantic map from one
                             // context to the next, but I'm pretty sure we're going to need a way
                             // for folks to modify this on the fly as processes are called
-                            *contextP = __p_make_context(run_tree,context,context->id,context->sem_map);
+                            *contextP = ___p_make_context(q,run_tree,context,context->id,context->sem_map);
+                            (*contextP)->process = s;
+                            if (pure) {
+                                (*contextP)->memo = s;
+                                (*contextP)->memo_hash = h;
+                                (*contextP)->memo_params = memo_params;
+                            }
+                            _tr_event(q->trace,TraceStepBegin,s,context->id);
                             debug(D_REDUCE,"New context for %s: %s\n\n",_sem_get_name(sem,s),_t2s(sem,run_tree));
                         }
                     }
@@ -1827,7 +2379,11 @@ Error _p_step(Q *q, R **contextP) {
                         //Error e = __p_check_signature(sem,s,np,context->sem_map);
                         //if (e) raise_error("SIG FAILURE on %s\n",_t2s(sem,np));
 
+                        _tr_event(q->trace,TraceStepBegin,s,context->id);
+                        if (q->profile) __pf_sys_begin(q->profile);
                         Error e = __p_reduce_sys_proc(context,s,np,q);
+                        if (q->profile) __pf_sys_end(q->profile,s);
+                        _tr_event(q->trace,TraceStepEnd,s,context->id);
                         if (e == redoReduction) {
                             // reset the node_pointer
                             np = context->node_pointer = _t_child(context->parent,context->idx);
@@ -1846,7 +2402,9 @@ Error _p_step(Q *q, R **contextP) {
                                 p->structure.children[i-1] = dummy;
                                 dummy->structure.parent = p;
                                 np->structure.parent = NULL;
-                                *contextP = __p_make_context(np,context,context->id,context->sem_map);
+                                *contextP = ___p_make_context(q,np,context,context->id,context->sem_map);
+                                // the new context gets popped like any other call, so it gets bracketed like one too
+                                _tr_event(q->trace,TraceStepBegin,_t_symbol(_t_child(np,1)),context->id);
                                 debug(D_REDUCE,"Redoing with a new context for: %s\n\n",_t2s(sem,np));
                             }
                             else {
@@ -2019,20 +2577,39 @@ Q *_p_newq(Receptor *r) {
     q->active = NULL;
     q->completed = NULL;
     q->blocked = NULL;
-    pthread_mutex_init(&(q->mutex), NULL);
+    q->inbox = NULL;
+    q->wakeups = NULL;
+    memset(&q->qes,0,sizeof(FramePool));
+    memset(&q->contexts,0,sizeof(FramePool));
+    memset(&q->iterations,0,sizeof(FramePool));
+    memset(&q->conds,0,sizeof(FramePool));
+    memset(&q->memo,0,sizeof(MemoCache));
+    q->memo.size = MEMO_CACHE_SIZE;
+    q->trace = NULL;
+    q->profile = NULL;
+    q->owned = 0;
     return q;
 }
 
-// clean up a context including its run-trees
-void _p_free_context(R *c) {
+// free the frames in all of a q's pools
+void __p_free_pools(Q *q) {
+    __p_pool_free(&q->qes);
+    __p_pool_free(&q->contexts);
+    __p_pool_free(&q->iterations);
+    __p_pool_free(&q->conds);
+}
+
+// clean up a context including its run-trees, returning the frames to the q's pool
+void __p_free_context(Q *q,R *c) {
     while(c) {
         // free any run_trees that are roots, i.e. assume
         // that a tree in a context that's part of another tree
         // will get freed elsewhere.
         if (!_t_parent(c->run_tree))
             _t_free(c->run_tree);
+        if (c->memo_params) _t_free(c->memo_params);
         R *n = c->caller;
-        free(c);
+        __p_frame_free(__p_pool(q,contexts),c);
         c = n;
     }
 }
@@ -2056,28 +2633,224 @@ void _p_freeq(Q *q) {
     _p_free_elements(q->active);
     _p_free_elements(q->completed);
     _p_free_elements(q->blocked);
+    _p_free_elements(q->inbox);
+    Qwakeup *w = q->wakeups;
+    while (w) {
+        Qwakeup *n = w->next;
+        if (w->with) _t_free(w->with);
+        free(w);
+        w = n;
+    }
+    __p_free_pools(q);
+    __p_memo_free(&q->memo);
+    if (q->trace) _tr_free(q->trace);
+    if (q->profile) _pf_free(q->profile);
     free(q);
 }
 
+/**
+ * turn on tracing of the reductions in a queue
+ *
+ * step begin/end, blocking and unblocking, signal delivery and expectation matching
+ * events all get recorded into a ring buffer on the q which can be dumped with _tr_dump.
+ * The buffer lives until the q is freed.
+ *
+ * @param[in] q the queue to trace
+ * @param[in] size number of events to keep in the ring buffer
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessTrace
+ */
+void _p_trace(Q *q,size_t size) {
+    if (!q->trace) q->trace = _tr_new(size,q->r->addr.addr);
+}
+
+/**
+ * turn on per-process profiling of the reductions in a queue
+ *
+ * call counts, cpu time and tree node allocations get accumulated for each process
+ * reduced on the q.  The profile can be had as a tree with _pf_report (or at runtime by
+ * reducing the MAGIC process with MagicProfile) and as folded stacks with _pf_folded.
+ *
+ * @param[in] q the queue to profile
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessProfile
+ */
+void _p_profile(Q *q) {
+    if (!q->profile) q->profile = _pf_new();
+}
+
+/**
+ * look up the memoized result of a pure process
+ *
+ * a hit moves the entry to the most recently used end of the cache.  Entries computed
+ * before the definitions last changed are dropped rather than returned, and so are ones
+ * whose parameters only have the same hash.
+ *
+ * @param[in] q the Q whose cache to check
+ * @param[in] p the process
+ * @param[in] h hash of the process node with its reduced parameters
+ * @param[in] params the process node with its reduced parameters
+ * @returns the cached result (owned by the cache) or NULL
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessMemoize
+ */
+T *__p_memo_get(Q *q,Process p,TreeHash h,T *params) {
+    MemoCache *m = &q->memo;
+    MemoEntry *e;
+    MemoKey k;
+    memset(&k,0,sizeof(MemoKey));
+    k.process = p;
+    k.hash = h;
+    HASH_FIND(hh,m->entries,&k,sizeof(MemoKey),e);
+    if (e && e->generation != q->r->sem->generation) {
+        HASH_DEL(m->entries,e);
+        _t_free(e->params);
+        _t_free(e->result);
+        free(e);
+        e = NULL;
+    }
+    if (e && !_t_equal(q->r->sem,e->params,params)) e = NULL;
+    if (!e) {
+        m->misses++;
+        return NULL;
+    }
+    // uthash keeps insertion order, so re-adding makes this the most recently used
+    HASH_DEL(m->entries,e);
+    HASH_ADD(hh,m->entries,key,sizeof(MemoKey),e);
+    m->hits++;
+    return e->result;
+}
+
+/**
+ * memoize the result of a pure process, evicting the least recently used results if the cache is full
+ *
+ * @param[in] q the Q whose cache to add to
+ * @param[in] p the process
+ * @param[in] h hash of the process node with its reduced parameters
+ * @param[in] params the process node with its reduced parameters, which the cache takes over
+ * @param[in] result the result, which is copied
+ */
+void __p_memo_put(Q *q,Process p,TreeHash h,T *params,T *result) {
+    MemoCache *m = &q->memo;
+    MemoEntry *e;
+    MemoKey k;
+    if (m->size <= 0) {
+        _t_free(params);
+        return;
+    }
+    memset(&k,0,sizeof(MemoKey));
+    k.process = p;
+    k.hash = h;
+    HASH_FIND(hh,m->entries,&k,sizeof(MemoKey),e);
+    if (e) {
+        HASH_DEL(m->entries,e);
+        _t_free(e->params);
+        _t_free(e->result);
+    }
+    else {
+        while (HASH_COUNT(m->entries) >= m->size) {
+            MemoEntry *lru = m->entries;
+            HASH_DEL(m->entries,lru);
+            _t_free(lru->params);
+            _t_free(lru->result);
+            free(lru);
+            m->evictions++;
+        }
+        e = malloc(sizeof(MemoEntry));
+        e->key = k;
+    }
+    e->generation = q->r->sem->generation;
+    e->params = params;
+    e->result = _t_clone(result);
+    HASH_ADD(hh,m->entries,key,sizeof(MemoKey),e);
+}
+
+// free all the entries of a memo cache
+void __p_memo_free(MemoCache *m) {
+    MemoEntry *e,*tmp;
+    HASH_ITER(hh,m->entries,e,tmp) {
+        HASH_DEL(m->entries,e);
+        _t_free(e->params);
+        _t_free(e->result);
+        free(e);
+    }
+}
+
+/**
+ * get a frame from a pool, or malloc one if the pool is empty
+ *
+ * the whole free stack is taken in one atomic exchange so that no two threads can
+ * ever pop the same frame, then the remainder is pushed back.
+ *
+ * @param[in] p the pool to allocate from, or NULL to just malloc
+ * @param[in] size the size of the frames in this pool
+ */
+void *__p_frame_alloc(FramePool *p,size_t size) {
+    if (!p) return malloc(size);
+    __atomic_add_fetch(&p->allocs,1,__ATOMIC_RELAXED);
+    int in_use = __atomic_add_fetch(&p->in_use,1,__ATOMIC_RELAXED);
+    int peak = __atomic_load_n(&p->peak,__ATOMIC_RELAXED);
+    while (in_use > peak && !__atomic_compare_exchange_n(&p->peak,&peak,in_use,1,__ATOMIC_RELAXED,__ATOMIC_RELAXED));
+
+    Frame *f = __atomic_exchange_n(&p->free,NULL,__ATOMIC_ACQUIRE);
+    if (!f) return malloc(size);
+    __atomic_sub_fetch(&p->free_count,1,__ATOMIC_RELAXED);
+    __atomic_add_fetch(&p->reuses,1,__ATOMIC_RELAXED);
+    if (f->next) {
+        Frame *t = f->next;
+        while (t->next) t = t->next;
+        __p_push(&p->free,f->next,t);
+    }
+    return f;
+}
+
+/**
+ * return a frame to a pool, or free it if the pool is full
+ *
+ * @param[in] p the pool the frame was allocated from, or NULL to just free
+ * @param[in] f the frame
+ */
+void __p_frame_free(FramePool *p,void *f) {
+    if (!p) {free(f);return;}
+    __atomic_sub_fetch(&p->in_use,1,__ATOMIC_RELAXED);
+    if (__atomic_load_n(&p->free_count,__ATOMIC_RELAXED) >= FRAME_POOL_MAX) free(f);
+    else {
+        __atomic_add_fetch(&p->free_count,1,__ATOMIC_RELAXED);
+        __p_push(&p->free,(Frame *)f,(Frame *)f);
+    }
+}
+
+// free all the frames on a pool's free stack
+void __p_pool_free(FramePool *p) {
+    Frame *f = p->free;
+    while (f) {
+        Frame *n = f->next;
+        free(f);
+        f = n;
+    }
+    p->free = NULL;
+    p->free_count = 0;
+}
+
 int G_next_process_id = 0;
 /**
  * add a run tree into a processing queue
  *
- * @todo make thread safe.  currently you shouldn't call this if the Q is being actively reduced
+ * safe to call from any thread.  The new element is pushed onto the q's lock-free inbox
+ * and moved to the active list either right away, or, if the q is currently being
+ * reduced, by the reducing thread between reduction steps.
  */
 Qe *__p_addrt2q(Q *q,T *run_tree,T *sem_map) {
-    Qe *n = malloc(sizeof(Qe));
-    n->id = ++G_next_process_id;
+    Qe *n = __p_frame_alloc(&q->qes,sizeof(Qe));
+    n->id = __atomic_add_fetch(&G_next_process_id,1,__ATOMIC_RELAXED);
     n->prev = NULL;
-    n->context = __p_make_context(run_tree,0,n->id,sem_map);
+    n->context = ___p_make_context(q,run_tree,0,n->id,sem_map);
     n->accounts.elapsed_time = 0;
-    debug(D_LOCK,"addrt2q LOCK\n");
-    pthread_mutex_lock(&q->mutex);
-    __p_append(q->active,n);
-    q->contexts_count++;
-    pthread_mutex_unlock(&q->mutex);
-    debug(D_LOCK,"addrt2q UNLOCK\n");
-
+    __p_push(&q->inbox,n,n);
+    __p_try_drain(q);
     return n;
 }
 
@@ -2126,6 +2899,8 @@ char *__debug_state_str(R *context) {
 Error _p_reduceq(Q *q) {
     debug(D_REDUCE+D_REDUCEV,"Starting reduce:\n");
 
+    __p_own_wait(q);
+    __p_drain(q);
     Qe *qe = q->active;
     Error next_state;
     struct timespec start, end;
@@ -2154,9 +2929,11 @@ Error _p_reduceq(Q *q) {
         }
 #endif
 
+        if (q->profile) __pf_step_begin(q->profile,qe->context);
         clock_gettime(CLOCK_MONOTONIC, &start);
         next_state = _p_step(q, &qe->context); // next state is set in directly in the context
         clock_gettime(CLOCK_MONOTONIC, &end);
+        if (q->profile) __pf_step_end(q->profile);
         qe->accounts.elapsed_time +=  diff_micro(&start, &end);
 
 #ifdef CEPTR_DEBUG
@@ -2166,8 +2943,6 @@ Error _p_reduceq(Q *q) {
             debug(D_REDUCE,"Eval: %s\n\n",_t2s(q->r->sem,qe->context->run_tree));
         }
 #endif
-        debug(D_LOCK,"reduce LOCK\n");
-        pthread_mutex_lock(&q->mutex);
         Qe *next = qe->next;
         if (next_state == Done) {
             // remove from the round-robin
@@ -2180,6 +2955,7 @@ Error _p_reduceq(Q *q) {
             q->contexts_count--;
         }
         else if (next_state == Block) {
+            _tr_event(q->trace,TraceBlock,NULL_SYMBOL,qe->id);
             // remove from the round-robin
             __p_dequeue(q->active,qe);
 
@@ -2187,10 +2963,12 @@ Error _p_reduceq(Q *q) {
             __p_enqueue(q->blocked,qe);
             q->contexts_count--;
         }
+        // pick up anything posted to the inbox during that step
+        __p_drain(q);
         qe = next ? next : q->active;  // next in round robin or wrap back to first
-        pthread_mutex_unlock(&q->mutex);
-        debug(D_LOCK,"reduce UNLOCK\n");
     };
+    __p_disown(q);
+    __p_try_drain(q);
 
     /// @todo figure out what error we should be sending back here, i.e. what if
     // one process ended ok, but one did not.  What's the error?  Probably
@@ -2206,19 +2984,20 @@ Error _p_reduceq(Q *q) {
  * @param[in] q the queue to be cleaned up
  */
 void _p_cleanup(Q *q) {
-    debug(D_LOCK,"cleanup LOCK\n");
-    pthread_mutex_lock(&q->mutex);
+    __p_own_wait(q);
     Qe *e = q->completed;
     while (e) {
         T *ett = _t_child(_t_child(q->r->root,ReceptorInstanceStateIdx),ReceptorElapsedTimeIdx);
         int *et = (int *)_t_surface(ett);
         (*et) += e->accounts.elapsed_time;
-        e = e->next;
+        __p_free_context(q,e->context);
+        Qe *n = e->next;
+        __p_frame_free(&q->qes,e);
+        e = n;
     }
-    _p_free_elements(q->completed);
     q->completed = NULL;
-    pthread_mutex_unlock(&q->mutex);
-    debug(D_LOCK,"cleanup UNLOCK\n");
+    __p_disown(q);
+    __p_try_drain(q);
 }
 
 /**
@@ -15,20 +15,31 @@
 
 #include "tree.h"
 
-enum ReductionError {Ascend=-1,Descend=-2,Pushed=-3,Pop=-4,Eval=-5,Block=-6,Done=0,noReductionErr=0,redoReduction,raiseReductionErr,tooFewParamsReductionErr=TOO_FEW_PARAMS_ERR_ID,tooManyParamsReductionErr=TOO_MANY_PARAMS_ERR_ID,signatureMismatchReductionErr=SIGNATURE_MISMATCH_ERR_ID,notProcessReductionError=NOT_A_PROCESS_ERR_ID,divideByZeroReductionErr=ZERO_DIVIDE_ERR_ID,notInSignalContextReductionError=NOT_IN_SIGNAL_CONTEXT_ERR_ID,incompatibleTypeReductionErr=INCOMPATIBLE_TYPE_ERR_ID,unixErrnoReductionErr=UNIX_ERRNO_ERR_ID,deadStreamReadReductionErr=DEAD_STREAM_READ_ERR_ID,missingSemanticMapReductionErr=MISSING_SEMANTIC_MAP_ERR_ID,mismatchSemanticMapReductionErr=MISMATCH_SEMANTIC_MAP_ERR_ID,structureMismatchReductionErr=STRUCTURE_MISMATCH_ERR_ID//,conversatonCompletedReductionErr=CONVERSATION_COMPLETED_ERR_ID
+enum ReductionError {Ascend=-1,Descend=-2,Pushed=-3,Pop=-4,Eval=-5,Block=-6,Done=0,noReductionErr=0,redoReduction,raiseReductionErr,tooFewParamsReductionErr=TOO_FEW_PARAMS_ERR_ID,tooManyParamsReductionErr=TOO_MANY_PARAMS_ERR_ID,signatureMismatchReductionErr=SIGNATURE_MISMATCH_ERR_ID,notProcessReductionError=NOT_A_PROCESS_ERR_ID,divideByZeroReductionErr=ZERO_DIVIDE_ERR_ID,notInSignalContextReductionError=NOT_IN_SIGNAL_CONTEXT_ERR_ID,incompatibleTypeReductionErr=INCOMPATIBLE_TYPE_ERR_ID,unixErrnoReductionErr=UNIX_ERRNO_ERR_ID,deadStreamReadReductionErr=DEAD_STREAM_READ_ERR_ID,missingSemanticMapReductionErr=MISSING_SEMANTIC_MAP_ERR_ID,mismatchSemanticMapReductionErr=MISMATCH_SEMANTIC_MAP_ERR_ID,structureMismatchReductionErr=STRUCTURE_MISMATCH_ERR_ID,timeoutReductionErr=TIMEOUT_ERR_ID,duplicateKeyReductionErr=DUPLICATE_KEY_ERR_ID,noScapeReductionErr=NO_SCAPE_ERR_ID,unorderedScapeReductionErr=UNORDERED_SCAPE_ERR_ID//,conversatonCompletedReductionErr=CONVERSATION_COMPLETED_ERR_ID
 };
 
 enum QueueError {noErr = 0, contextNotFoundErr};
 
-enum MagicProcesses {MagicReceptors,MagicQuit,MagicDebug};
+/// maximum number of free frames kept for reuse in each of a Q's pools
+#define FRAME_POOL_MAX 64
+/// maximum number of pure process results memoized by each Q
+#define MEMO_CACHE_SIZE 256
+/// the given pool of a q, or NULL for no q
+#define __p_pool(q,pool) ((q) ? &(q)->pool : NULL)
+
+enum MagicProcesses {MagicReceptors,MagicQuit,MagicDebug,MagicProfile,MagicTrace};
 
 enum IterationPhase {EvalCondition,EvalBody};
-enum IterationType {IterateTypeCount,IterateTypeUnknown,IterateTypeCond,IterateTypeOnSymbol};
+enum IterationType {IterateTypeCount,IterateTypeUnknown,IterateTypeCond,IterateTypeOnSymbol,IterateTypeOnResults};
 typedef struct IterationState {
     T *code;
     int phase;
     int count;
     int type;
+    Symbol symbol;  ///< symbol being iterated on for IterateTypeOnSymbol
+    int cursor;     ///< instance cursor for IterateTypeOnSymbol, see _a_next_instance, or index into results
+    int end;        ///< number of instance slots when an IterateTypeOnSymbol iteration started
+    T *results;     ///< QUERY_RESULTS being iterated on for IterateTypeOnResults
 } IterationState;
 
 enum CondPhase {EvalCondCondtions,EvalCondResult};
@@ -38,20 +49,41 @@ typedef struct CondState {
 } CondState;
 
 T *defaultRequestUntil();
-R *__p_make_context(T *run_tree,R *caller,int process_id,T *sem_map);
+#define __p_make_context(run_tree,caller,process_id,sem_map) ___p_make_context(0,run_tree,caller,process_id,sem_map)
+R *___p_make_context(Q *q,T *run_tree,R *caller,int process_id,T *sem_map);
 Error _p_step(Q *q, R **contextP);
 void _p_fill_from_match(SemTable *sem,T *t,T *match_results,T *match_tree);
+void _p_add_transcoder(SemTable *sem,SemanticID src,SemanticID to,Process p);
+void _p_add_native_transcoder(SemTable *sem,SemanticID src,SemanticID to,TranscoderFn fn);
+Transcoder *_p_find_transcoder(SemTable *sem,Symbol src_sym,Symbol to_sym);
+Process _p_get_transcoder(SemTable *sem,Symbol src_sym,Symbol to_sym);
+void _p_init_transcoders(SemTable *sem);
+int _p_transcode(SemTable *sem,T* src,Symbol to_sym,Structure to_s,T **result);
+SigDesc *__p_get_sigdesc(SemTable *sem,Process p);
 Error __p_check_signature(SemTable *sem,Process p,T *params,T *sem_map);
 Error __p_reduce_sys_proc(R *context,Symbol s,T *code,Q *q);
+Error ___p_reduce_sys_proc(SemTable *sem,R *context,Symbol s,T *code,Q *q);
+void _p_fold_constants(SemTable *sem,T *code);
 void _p_enqueue(Qe **listP,Qe *e);
 Qe *__p_find_context(Qe *e,int process_id);
 void __p_unblock(Q *q,Qe *e,Error err);
-Error _p_unblock(Q *q,int id);
+void _p_unblock(Q *q,int id);
+void __p_try_drain(Q *q);
 void _p_wakeup(Q *q,T *wakeup, T *with,Error err);
 Error _p_reduce(SemTable *sem,T *run_tree);
 Q *_p_newq(Receptor *r);
 void _p_freeq(Q *q);
-void _p_free_context(R *c);
+void _p_trace(Q *q,size_t size);
+void _p_profile(Q *q);
+#define _p_free_context(c) __p_free_context(0,c)
+void __p_free_context(Q *q,R *c);
+void *__p_frame_alloc(FramePool *p,size_t size);
+void __p_frame_free(FramePool *p,void *f);
+void __p_pool_free(FramePool *p);
+T *__p_memo_get(Q *q,Process p,TreeHash h,T *params);
+void __p_memo_put(Q *q,Process p,TreeHash h,T *params,T *result);
+void __p_memo_free(MemoCache *m);
+void __p_free_pools(Q *q);
 #define _p_addrt2q(q,t) __p_addrt2q(q,t,NULL);
 Qe *__p_addrt2q(Q *q,T *t,T *sem_map);
 Error _p_reduceq(Q *q);
@@ -0,0 +1,238 @@
+/**
+ * @ingroup receptor
+ *
+ * @{
+ * @file profile.c
+ * @brief per-process profiling of reductions
+ *
+ * The profiler attributes the cpu time and tree node allocations of each reduction step
+ * to the process doing the work.  Sys processes are measured around their reduction, and
+ * what's left of the step is the interpreter walking the code of the defined process at
+ * the top of the call stack.  Every process on the stack gets the time added to its
+ * inclusive total, and the exclusive time is also kept per call stack so that hot paths
+ * can be exported as folded stacks for flamegraphs.
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#include "profile.h"
+#include "def.h"
+#include "semtable.h"
+#include <time.h>
+#include <inttypes.h>
+
+// take a snapshot of the current thread's cpu time and allocation counters
+void __pf_mark(ProfileMark *m) {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&t);
+    m->time = (uint64_t)t.tv_sec*1000000000LL+t.tv_nsec;
+    m->allocs = G_tree_allocs;
+    m->bytes = G_tree_alloc_bytes;
+}
+
+/**
+ * create an empty profile
+ *
+ * @returns the new Profile
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessProfile
+ */
+Profile *_pf_new() {
+    Profile *p = malloc(sizeof(Profile));
+    memset(p,0,sizeof(Profile));
+    return p;
+}
+
+/**
+ * get the counters of a process, adding them if this is the first time we've seen it
+ */
+ProfileEntry *__pf_entry(Profile *p,Process s) {
+    ProfileEntry *e;
+    HASH_FIND(hh,p->processes,&s,sizeof(Process),e);
+    if (!e) {
+        e = malloc(sizeof(ProfileEntry));
+        memset(e,0,sizeof(ProfileEntry));
+        e->process = s;
+        HASH_ADD(hh,p->processes,process,sizeof(Process),e);
+    }
+    return e;
+}
+
+// add time to the stack made of the first depth processes of the current path
+void __pf_add_stack(Profile *p,int depth,uint64_t time) {
+    ProfileStack *s;
+    size_t l = depth*sizeof(Process);
+    HASH_FIND(hh,p->stacks,p->path,l,s);
+    if (!s) {
+        s = malloc(sizeof(ProfileStack));
+        s->path = malloc(l);
+        memcpy(s->path,p->path,l);
+        s->depth = depth;
+        s->time = 0;
+        HASH_ADD_KEYPTR(hh,p->stacks,s->path,l,s);
+    }
+    s->time += time;
+}
+
+// add inclusive time to the processes on the current path, counting recursive calls only once
+void __pf_add_inclusive(Profile *p,uint64_t time) {
+    int i,j;
+    for(i=0;i<p->depth;i++) {
+        for(j=0;j<i && !semeq(p->path[j],p->path[i]);j++);
+        if (j == i) __pf_entry(p,p->path[i])->inclusive_time += time;
+    }
+}
+
+/**
+ * start profiling a reduction step
+ *
+ * @param[in] p the profile
+ * @param[in] context the context about to be stepped, whose callers make up the call stack
+ */
+void __pf_step_begin(Profile *p,R *context) {
+    int d = 0;
+    R *c;
+    for(c=context;c;c=c->caller)
+        if (!semeq(c->process,NULL_PROCESS)) d++;
+    if (d > PROFILE_MAX_DEPTH) d = PROFILE_MAX_DEPTH;
+    p->depth = d;
+    // fill in from the innermost, dropping the outermost processes of very deep stacks
+    for(c=context;c && d;c=c->caller)
+        if (!semeq(c->process,NULL_PROCESS)) p->path[--d] = c->process;
+    memset(&p->spent,0,sizeof(ProfileMark));
+    __pf_mark(&p->step);
+}
+
+/**
+ * finish profiling a reduction step
+ *
+ * whatever wasn't spent in sys processes during the step goes to the process at the top
+ * of the call stack.  Steps of plain run trees not in any process aren't attributed.
+ */
+void __pf_step_end(Profile *p) {
+    ProfileMark m;
+    __pf_mark(&m);
+    if (!p->depth) return;
+    uint64_t time = m.time-p->step.time-p->spent.time;
+    ProfileEntry *e = __pf_entry(p,p->path[p->depth-1]);
+    e->exclusive_time += time;
+    e->allocs += m.allocs-p->step.allocs-p->spent.allocs;
+    e->alloc_bytes += m.bytes-p->step.bytes-p->spent.bytes;
+    __pf_add_inclusive(p,time);
+    __pf_add_stack(p,p->depth,time);
+}
+
+/**
+ * start profiling the reduction of a sys process
+ */
+void __pf_sys_begin(Profile *p) {
+    __pf_mark(&p->sys);
+}
+
+/**
+ * finish profiling the reduction of a sys process
+ *
+ * @param[in] p the profile
+ * @param[in] s the sys process that was reduced
+ */
+void __pf_sys_end(Profile *p,Process s) {
+    ProfileMark m;
+    __pf_mark(&m);
+    uint64_t time = m.time-p->sys.time;
+    uint64_t allocs = m.allocs-p->sys.allocs;
+    uint64_t bytes = m.bytes-p->sys.bytes;
+    ProfileEntry *e = __pf_entry(p,s);
+    e->calls++;
+    e->inclusive_time += time;
+    e->exclusive_time += time;
+    e->allocs += allocs;
+    e->alloc_bytes += bytes;
+    __pf_add_inclusive(p,time);
+    p->path[p->depth] = s;
+    __pf_add_stack(p,p->depth+1,time);
+    p->spent.time += time;
+    p->spent.allocs += allocs;
+    p->spent.bytes += bytes;
+}
+
+/**
+ * count a call to a defined process
+ */
+void __pf_call(Profile *p,Process s) {
+    __pf_entry(p,s)->calls++;
+}
+
+int __pf_cmp_inclusive(ProfileEntry *a,ProfileEntry *b) {
+    if (a->inclusive_time == b->inclusive_time) return 0;
+    return a->inclusive_time < b->inclusive_time ? 1 : -1;
+}
+
+/**
+ * build a tree of the profile
+ *
+ * @param[in] p the profile
+ * @param[in] is_run_node true to build the tree out of run nodes
+ * @returns RECEPTOR_PROFILE tree with a PROCESS_PROFILE for each process, in order of inclusive time
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessProfile
+ */
+T *__pf_report(Profile *p,bool is_run_node) {
+    ProfileEntry *e,*tmp;
+    T *t = __t_newr(0,RECEPTOR_PROFILE,is_run_node);
+    HASH_SORT(p->processes,__pf_cmp_inclusive);
+    HASH_ITER(hh,p->processes,e,tmp) {
+        T *pp = __t_newr(t,PROCESS_PROFILE,is_run_node);
+        __t_news(pp,PROFILED_PROCESS,e->process,is_run_node);
+        __t_newi64(pp,PROFILE_CALLS,e->calls,is_run_node);
+        __t_newi64(pp,PROFILE_INCLUSIVE_TIME,e->inclusive_time,is_run_node);
+        __t_newi64(pp,PROFILE_EXCLUSIVE_TIME,e->exclusive_time,is_run_node);
+        __t_newi64(pp,PROFILE_ALLOCATIONS,e->allocs,is_run_node);
+        __t_newi64(pp,PROFILE_ALLOCATED_BYTES,e->alloc_bytes,is_run_node);
+    }
+    return t;
+}
+
+/**
+ * write out the profile in the folded stack format used by flamegraph tools
+ *
+ * each line is the process names of a call stack, outermost first, separated by
+ * semicolons, followed by the cpu nanoseconds spent at the top of that stack
+ *
+ * @param[in] sem the semantic table to get names from
+ * @param[in] p the profile
+ * @param[in] out where to write the stacks
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessProfile
+ */
+void _pf_folded(SemTable *sem,Profile *p,FILE *out) {
+    ProfileStack *s,*tmp;
+    int i;
+    HASH_ITER(hh,p->stacks,s,tmp) {
+        for(i=0;i<s->depth;i++)
+            fprintf(out,"%s%s",i ? ";" : "",_sem_get_name(sem,s->path[i]));
+        fprintf(out," %" PRIu64 "\n",s->time);
+    }
+}
+
+/**
+ * free a profile
+ */
+void _pf_free(Profile *p) {
+    ProfileEntry *e,*etmp;
+    HASH_ITER(hh,p->processes,e,etmp) {
+        HASH_DEL(p->processes,e);
+        free(e);
+    }
+    ProfileStack *s,*stmp;
+    HASH_ITER(hh,p->stacks,s,stmp) {
+        HASH_DEL(p->stacks,s);
+        free(s->path);
+        free(s);
+    }
+    free(p);
+}
+
+/** @}*/
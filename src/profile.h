@@ -0,0 +1,29 @@
+/**
+ * @ingroup receptor
+ *
+ * @{
+ * @file profile.h
+ * @brief process profiling header file
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#ifndef _CEPTR_PROFILE_H
+#define _CEPTR_PROFILE_H
+
+#include "tree.h"
+
+Profile *_pf_new();
+void __pf_step_begin(Profile *p,R *context);
+void __pf_step_end(Profile *p);
+void __pf_sys_begin(Profile *p);
+void __pf_sys_end(Profile *p,Process s);
+void __pf_call(Profile *p,Process s);
+ProfileEntry *__pf_entry(Profile *p,Process s);
+#define _pf_report(p) __pf_report(p,0)
+T *__pf_report(Profile *p,bool is_run_node);
+void _pf_folded(SemTable *sem,Profile *p,FILE *out);
+void _pf_free(Profile *p);
+
+#endif
+/** @}*/
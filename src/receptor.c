@@ -16,9 +16,14 @@
 #include "debug.h"
 #include "mtree.h"
 #include "protocol.h"
+#include "trace.h"
+#include "timer.h"
+#include "wal.h"
+#include "def.h"
 #include <stdarg.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
 Xaddr G_null_xaddr  = {0,0};
 /*****************  create and destroy receptors */
@@ -26,6 +31,15 @@ Xaddr G_null_xaddr  = {0,0};
 /* set up the c structures for a receptor from a semantic tree */
 Receptor * __r_init(T *t,SemTable *sem) {
     Receptor *r = malloc(sizeof(Receptor));
+    ___r_init(r,t,sem);
+    r->wal = NULL;
+    r->image = r->mapping = NULL;
+    r->dir = NULL;
+    return r;
+}
+
+// set up the c structures of an allocated receptor (everything but the stub and its log)
+void ___r_init(Receptor *r,T *t,SemTable *sem) {
     r->root = t;
     r->parent = *(int *)_t_surface(_t_child(t,ReceptorInstanceParentContextIdx));
     r->context = *(int *)_t_surface(_t_child(t,ReceptorInstanceContextNumIdx));
@@ -39,11 +53,76 @@ Receptor * __r_init(T *t,SemTable *sem) {
     r->flux = _t_child(state,ReceptorFluxIdx);
     r->pending_signals = _t_child(state,ReceptorPendingSignalsIdx);
     r->pending_responses = _t_child(state,ReceptorPendingResponsesIdx);
+    r->pending_index = NULL;
+    pthread_mutex_init(&r->pending_responses_mutex,NULL);
     r->conversations = _t_child(state,ReceptorConversationsIdx);
+    r->conversation_index = NULL;
+    pthread_mutex_init(&r->conversations_mutex,NULL);
+    // a receptor unserialized from a tree may already have requests and conversations going
+    T *c;
+    DO_KIDS(r->pending_responses,
+            c = _t_child(r->pending_responses,i);
+            __r_index_pending_response(r,c);
+            );
+    DO_KIDS(r->conversations,
+            c = _t_child(r->conversations,i);
+            __r_index_conversation(r,c);
+            );
     r->edge = NULL;
+    r->timers = NULL;
+    r->timeouts = NULL;
+    r->expired = NULL;
+    pthread_mutex_init(&r->timeouts_mutex,NULL);
+}
+
+/**
+ * make a stub for a receptor that gets loaded from its serialized image on first use
+ *
+ * @param[in] sem the semantic table
+ * @param[in] c the context of the receptor
+ * @param[in] image the serialized receptor, which must stay put until the stub is loaded
+ * @param[in] dir directory the receptor's checkpointed instances are in
+ * @returns the stub
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccLazyReceptors
+ */
+Receptor *__r_new_stub(SemTable *sem,Context c,void *image,char *dir) {
+    Receptor *r = malloc(sizeof(Receptor));
+    memset(r,0,sizeof(Receptor));
+    r->sem = sem;
+    r->context = c;
+    r->addr.addr = c;  //@fixme as in __r_init
+    r->image = image;
+    r->dir = dir;
     return r;
 }
 
+/**
+ * load a stub receptor from its image, in place so that pointers to it stay good
+ *
+ * does nothing to a receptor that's already loaded
+ *
+ * @param[in] r the receptor
+ * @param[in] lazy true to just make stubs for the receptors in its instances
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccLazyReceptors
+ */
+void __r_materialize(Receptor *r,bool lazy) {
+    if (!r->image) return;
+    S *s = r->image;
+    H h = _m_unserialize(s);
+    T *t = _t_new_from_m(h);
+    _m_free(h);
+    ___r_init(r,t,r->sem);
+    ___a_unserialize_instances(r->sem,&r->instances,((void *)s)+s->total_size,r->context,r->dir,lazy);
+    // the receptors just stubbed in its instances log to wherever it does
+    if (r->wal) __a_set_wal(r,r->wal);
+    // the mapping, if the receptor has one of its own, stays until the stubs no longer need it
+    r->image = NULL;
+}
+
 T *__r_add_aspect(T *flux,Aspect aspect) {
     T *a = _t_newr(flux,aspect);
     _t_newr(a,EXPECTATIONS);
@@ -169,9 +248,11 @@ void _r_add_expectation(Receptor *r,Aspect aspect,Symbol carrier,T *pattern,T *a
 void __r_add_expectation(Receptor *r,Aspect aspect,T *e) {
     T *a = __r_get_expectations(r,aspect);
     _t_add(a,e);
+    __r_set_timeout(r,e,_t_child(e,ExpectationEndCondsIdx));
 }
 
 void _r_remove_expectation(Receptor *r,T *expectation) {
+    __r_cancel_timeout(r,expectation);
     T *a = _t_parent(expectation);
     _t_detach_by_ptr(a,expectation);
     _t_free(expectation);
@@ -184,6 +265,67 @@ void _r_remove_expectation(Receptor *r,T *expectation) {
  * Destroys a receptor freeing all the memory it uses.
  */
 void _r_free(Receptor *r) {
+    if (!r->image) __r_free_state(r);
+    if (r->mapping) munmap(r->mapping,r->mapping_size);
+    free(r);
+}
+
+/**
+ * turn a loaded receptor back into a stub
+ *
+ * @param[in] r the receptor
+ * @param[in] image its serialized image
+ * @param[in] mapping the mapped file the image is in, which the receptor takes over (once
+ *            the receptor has been serialized, any mapping it had before is no longer needed)
+ * @param[in] size size of the mapping
+ * @param[in] dir directory the receptor's checkpointed instances are in
+ */
+void __r_stub(Receptor *r,void *image,void *mapping,size_t size,char *dir) {
+    __r_free_state(r);
+    r->root = r->flux = r->pending_signals = r->pending_responses = r->conversations = r->edge = NULL;
+    r->instances = NULL;
+    r->q = NULL;
+    r->timers = NULL;
+    r->timeouts = NULL;
+    r->expired = NULL;
+    if (r->mapping) munmap(r->mapping,r->mapping_size);
+    r->image = image;
+    r->mapping = mapping;
+    r->mapping_size = size;
+    r->dir = dir;
+}
+
+// free everything but the struct of a loaded receptor
+void __r_free_state(Receptor *r) {
+    Timeout *to,*tmp;
+    // hold the wheel so none of the timers go off while they're unscheduled (timers of
+    // cancelled timeouts are left to go off, as all they do is free themselves)
+    if (r->timers) _tw_lock(r->timers);
+    HASH_ITER(hh,r->timeouts,to,tmp) {
+        HASH_DEL(r->timeouts,to);
+        if (!to->fired) {
+            _tw_cancel(r->timers,&to->timer);
+            free(to);
+        }
+    }
+    if (r->timers) _tw_unlock(r->timers);
+    while ((to = r->expired)) {
+        r->expired = to->next;
+        free(to);
+    }
+    pthread_mutex_destroy(&r->timeouts_mutex);
+    ConversationIndex *ci,*citmp;
+    HASH_ITER(hh,r->conversation_index,ci,citmp) {
+        HASH_DEL(r->conversation_index,ci);
+        free(ci);
+    }
+    pthread_mutex_destroy(&r->conversations_mutex);
+    PendingResponseIndex *pi,*pitmp;
+    HASH_ITER(hh,r->pending_index,pi,pitmp) {
+        HASH_DEL(r->pending_index,pi);
+        free(pi);
+    }
+    pthread_mutex_destroy(&r->pending_responses_mutex);
     _t_free(r->root);
     _a_free_instances(&r->instances);
     if (r->q) _p_freeq(r->q);
@@ -201,7 +343,6 @@ void _r_free(Receptor *r) {
         }
         _t_free(r->edge);
     }
-    free(r);
 }
 
 /*****************  receptor symbols, structures and processes */
@@ -217,6 +358,7 @@ void _r_free(Receptor *r) {
  */
 Symbol _r_define_symbol(Receptor *r,Structure s,char *label){
     Symbol sym = _d_define_symbol(r->sem,s,label,r->context);
+    __r_log_define(r,sym);
     return sym;
 }
 
@@ -239,6 +381,7 @@ Structure _r_define_structure(Receptor *r,char *label,int num_params,...) {
     T *def = _d_make_vstruc_def(r->sem,label,num_params,params);
     va_end(params);
     Structure s = _d_define_structure(r->sem,label,def,r->context);
+    __r_log_define(r,s);
     return s;
 }
 
@@ -257,6 +400,7 @@ Structure _r_define_structure(Receptor *r,char *label,int num_params,...) {
  */
 Structure __r_define_structure(Receptor *r,char *label,T *structure_def) {
     Structure s = _d_define_structure(r->sem,label,structure_def,r->context);
+    __r_log_define(r,s);
     return s;
 }
 
@@ -274,11 +418,13 @@ Structure __r_define_structure(Receptor *r,char *label,T *structure_def) {
  */
 Process _r_define_process(Receptor *r,T *code,char *name,char *intention,T *signature,T *link) {
     Process p = _d_define_process(r->sem,code,name,intention,signature,link,r->context);
+    __r_log_define(r,p);
     return p;
 }
 
 Protocol _r_define_protocol(Receptor *r,T *protocol_def) {
     Protocol p = _d_define_protocol(r->sem,protocol_def,r->context);
+    __r_log_define(r,p);
     return p;
 }
 
@@ -363,7 +509,9 @@ int _r_def_match(Receptor *r,Symbol s,T *t) {
  * @snippet spec/receptor_spec.h testReceptorInstances
  */
 Xaddr _r_new_instance(Receptor *r,T *t) {
-    return _a_new_instance(&r->instances,t);
+    Xaddr x = _a_new_instance(&r->instances,t);
+    if (r->wal) __r_log_instance(r,WalNewInstance,x,t);
+    return x;
 }
 
 /**
@@ -392,7 +540,9 @@ T * _r_get_instance(Receptor *r,Xaddr x) {
  * @snippet spec/receptor_spec.h testReceptorInstances
  */
 T * _r_set_instance(Receptor *r,Xaddr x,T *t) {
-    return _a_set_instance(&r->instances,x,t);
+    T *i = _a_set_instance(&r->instances,x,t);
+    if (i && r->wal) __r_log_instance(r,WalSetInstance,x,t);
+    return i;
 }
 
 /**
@@ -406,6 +556,92 @@ T * _r_set_instance(Receptor *r,Xaddr x,T *t) {
  */
 T * _r_delete_instance(Receptor *r,Xaddr x) {
     _a_delete_instance(&r->instances,x);
+    if (r->wal) __r_log_instance(r,WalDeleteInstance,x,NULL);
+}
+
+/**
+ * record a change to a receptor's instances in its write-ahead log
+ *
+ * receptor instances are logged as the whole serialized receptor, so receptors created
+ * since the last checkpoint come back when the log is replayed like any other instance.
+ *
+ * @param[in] r the receptor
+ * @param[in] type WalNewInstance, WalSetInstance or WalDeleteInstance
+ * @param[in] x the xaddr of the instance
+ * @param[in] t the new value of the instance (NULL for deletes)
+ */
+void __r_log_instance(Receptor *r,int type,Xaddr x,T *t) {
+    if (!t) {
+        _wl_append(r->wal,type,r->context,&x,sizeof(Xaddr),NULL,0);
+        return;
+    }
+    void *surface;
+    size_t length;
+    if (is_receptor(x.symbol)) __r_serialize(__r_get_receptor(t),&surface,&length,NULL);
+    else {
+        H h = _m_new_from_t(t);
+        S *s = _m_serialize(h.m);
+        _m_free(h);
+        surface = s;
+        length = s->total_size;
+    }
+    _wl_append(r->wal,type,r->context,&x,sizeof(Xaddr),surface,length);
+    free(surface);
+}
+
+/**
+ * record a definition added to a receptor's context in its write-ahead log, if it has one
+ *
+ * all of a receptor's defines have to go through here, as replaying the log expects the
+ * definitions in it to get the same ids they got the first time round
+ *
+ * @param[in] r the receptor
+ * @param[in] sid the definition that was just added
+ */
+void __r_log_define(Receptor *r,SemanticID sid) {
+    if (!r->wal) return;
+    H h = _m_new_from_t(_sem_get_def(r->sem,sid));
+    S *s = _m_serialize(h.m);
+    _wl_append(r->wal,WalDefine,r->context,&sid,sizeof(SemanticID),s,s->total_size);
+    free(s);
+    _m_free(h);
+}
+
+/**
+ * add a definition to a receptor's context
+ *
+ * the definition is recorded in the receptor's write-ahead log if it has one
+ *
+ * @param[in] r the receptor
+ * @param[in] def the definition, which is added to the semantic table
+ * @param[in] semtype what kind of definition it is
+ * @returns the SemanticID of the definition
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccBootReplay
+ */
+SemanticID _r_define(Receptor *r,T *def,SemanticType semtype) {
+    SemanticID sid = semtype == SEM_TYPE_RECEPTOR ?
+        __d_define_receptor(r->sem,def,r->context) :
+        _d_define(r->sem,def,semtype,r->context);
+    __r_log_define(r,sid);
+    return sid;
+}
+
+/**
+ * add a scape to a receptor's instances
+ *
+ * the scape is kept up to date as the receptor's instances change and can be searched
+ * with the QUERY instruction
+ *
+ * @param[in] r the receptor
+ * @param[in] s the scape, which the receptor takes ownership of
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessQuery
+ */
+void _r_add_scape(Receptor *r,Scape *s) {
+    _a_add_scape(r->sem,&r->instances,s);
 }
 
 /**
@@ -417,6 +653,12 @@ TreeHash _r_hash(Receptor *r,Xaddr t) {
 
 /******************  receptor serialization */
 
+// size of a serialized receptor, i.e. its tree followed by its instances
+size_t __r_image_size(void *image) {
+    S *s = image;
+    return s->total_size+((S *)(image+s->total_size))->total_size;
+}
+
 /**
  * Serialize a receptor
  *
@@ -425,20 +667,29 @@ TreeHash _r_hash(Receptor *r,Xaddr t) {
  * @param[in] r Receptor to serialize
  * @param[inout] surfaceP pointer to a void * to hold the resulting serialized data
  * @param[inout] lengthP pointer to a size_t to hold the resulting serialized data length
+ * @param[in,out] files list to add the files of changed instances to when checkpointing, or NULL
  *
  * <b>Examples (from test suite):</b>
  * @snippet spec/receptor_spec.h testReceptorSerialize
  */
-void _r_serialize(Receptor *r,void **surfaceP,size_t *lengthP) {
+void __r_serialize(Receptor *r,void **surfaceP,size_t *lengthP,CheckpointFile **files) {
     /* size_t buf_size = 10000; */
     /* *surfaceP  = malloc(buf_size); */
     /* *lengthP = __t_serialize(&r->defs,r->root,surfaceP,sizeof(size_t),buf_size,0); */
     /* *(size_t *)(*surfaceP) = *lengthP; */
 
+    // a stub is serialized just as it was loaded
+    if (r->image) {
+        *lengthP = __r_image_size(r->image);
+        *surfaceP = malloc(*lengthP);
+        memcpy(*surfaceP,r->image,*lengthP);
+        return;
+    }
+
     H h = _m_new_from_t(r->root);
     S *s = _m_serialize(h.m);
 
-    S *is = __a_serialize_instances(&r->instances);
+    S *is = ___a_serialize_instances(&r->instances,r->context,files);
     s = (S *)realloc(s,s->total_size+is->total_size);
     memcpy(((void *)s)+s->total_size,is,is->total_size);
 
@@ -454,30 +705,12 @@ void _r_serialize(Receptor *r,void **surfaceP,size_t *lengthP) {
  * Given a serialized receptor, return an instantiated receptor tree
  *
  * @param[in] surface serialized receptor data
+ * @param[in] dir directory to load checkpointed instances from, or NULL
  * @returns Receptor
  */
-Receptor * _r_unserialize(SemTable *sem,void *surface) {
-
-    S *s = (S *)surface;
-    H h = _m_unserialize(s);
-
-    T *t = _t_new_from_m(h);
-    _m_free(h);
-
-    Receptor *r = __r_init(t,sem);
-
-    /* size_t length = *(size_t *)surface; */
-    /* Receptor *r = _r_new(*(Symbol *)(surface+sizeof(size_t))); */
-    /* surface += sizeof(size_t); */
-    /* T *t =  _t_unserialize(&r->defs,&surface,&length,0); */
-    /* _t_free(r->root); */
-    /* r->root = t; */
-    //    T *defs = _t_child(t,1);
-    //  DO_KIDS(defs,__r_set_labels(r,_t_child(defs,i),i));
-
-    // move to the instances
-    s = (S *) (surface + s->total_size);
-    __a_unserialize_instances(sem,&r->instances,(S *)s);
+Receptor * __r_unserialize(SemTable *sem,void *surface,char *dir) {
+    Receptor *r = __r_new_stub(sem,0,surface,dir);
+    _r_materialize(r);
     return r;
 }
 
@@ -574,9 +807,8 @@ T* _r_send(Receptor *r,T *signal) {
  */
 T* _r_request(Receptor *r,T *signal,Symbol response_carrier,T *code_point,int process_id,T *cid) {
 
-    //@todo lock resources
     T *result = __r_send(r,signal); // result is signal UUID
-    T *pr = _t_newr(r->pending_responses,PENDING_RESPONSE);
+    T *pr = _t_new_root(PENDING_RESPONSE);
     _t_add(pr,_t_clone(result));
     _t_news(pr,CARRIER,response_carrier);
     _t_add(pr,__p_build_wakeup_info(code_point,process_id));
@@ -587,11 +819,276 @@ T* _r_request(Receptor *r,T *signal,Symbol response_carrier,T *code_point,int pr
     if (cid) _t_add(pr,_t_clone(cid));
 
     debug(D_SIGNALS,"sending request and adding pending response: %s\n",_td(r,pr));
-    //@todo unlock resources
+    pthread_mutex_lock(&r->pending_responses_mutex);
+    _t_add(r->pending_responses,pr);
+    __r_index_pending_response(r,pr);
+    // the timeout has to be there before a response can come in and cancel it, but it only
+    // gets scheduled once the lock is released, so the wheel isn't held up by requests
+    uint64_t delay;
+    Timeout *to = __r_add_timeout(r,pr,_t_child(pr,PendingResponseEndCondsIdx),&delay);
+    pthread_mutex_unlock(&r->pending_responses_mutex);
+    if (to) _tw_add(r->timers,&to->timer,delay,0);
 
     return result;
 }
 
+// adds a pending response to the receptor's index (the caller must hold the pending responses mutex)
+void __r_index_pending_response(Receptor *r,T *pr) {
+    PendingResponseIndex *pi = malloc(sizeof(PendingResponseIndex));
+    pi->uuid = *(UUIDt *)_t_surface(_t_child(pr,PendingResponseUUIDIdx));
+    pi->pending_response = pr;
+    HASH_ADD(hh,r->pending_index,uuid,sizeof(UUIDt),pi);
+}
+
+// removes a pending response from the index and the PENDING_RESPONSES tree, returning false
+// if something else already has (the caller must hold the pending responses mutex)
+bool __r_unindex_pending_response(Receptor *r,T *pr) {
+    PendingResponseIndex *pi;
+    HASH_FIND(hh,r->pending_index,_t_surface(_t_child(pr,PendingResponseUUIDIdx)),sizeof(UUIDt),pi);
+    if (!pi || pi->pending_response != pr) return false;
+    HASH_DEL(r->pending_index,pi);
+    free(pi);
+    _t_detach_by_ptr(r->pending_responses,pr);
+    return true;
+}
+
+/**
+ * find the pending response for a request
+ *
+ * @param[in] r the receptor that made the request
+ * @param[in] u the UUID of the request signal
+ * @returns the PENDING_RESPONSE or NULL if there isn't one (i.e. it's been responded to or expired)
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/receptor_spec.h testReceptorResponseDeliver
+ */
+T *_r_find_pending_response(Receptor *r,UUIDt *u) {
+    PendingResponseIndex *pi;
+    pthread_mutex_lock(&r->pending_responses_mutex);
+    HASH_FIND(hh,r->pending_index,u,sizeof(UUIDt),pi);
+    pthread_mutex_unlock(&r->pending_responses_mutex);
+    return pi ? pi->pending_response : NULL;
+}
+
+// convert a timestamp tree (i.e. TICK or TIMEOUT_AT) to seconds since the epoch
+time_t __r_timestamp_time(T *ts) {
+    T *td = _t_child(ts,1);
+    T *nw = _t_child(ts,2);
+    struct tm t;
+    memset(&t,0,sizeof(t));
+    t.tm_year = *(int *)_t_surface(_t_child(td,1))-1900;
+    t.tm_mon = *(int *)_t_surface(_t_child(td,2))-1;
+    t.tm_mday = *(int *)_t_surface(_t_child(td,3));
+    t.tm_hour = *(int *)_t_surface(_t_child(nw,1));
+    t.tm_min = *(int *)_t_surface(_t_child(nw,2));
+    t.tm_sec = *(int *)_t_surface(_t_child(nw,3));
+    return timegm(&t);
+}
+
+// wake whatever is blocked on a pending response or expectation (if anything) with an error
+void __r_wake_blocked(Receptor *r,T *t,Error err) {
+    T *w;
+    if (semeq(_t_symbol(t),PENDING_RESPONSE))
+        w = _t_child(t,PendingResponseWakeupIdx);
+    else {
+        w = _t_child(t,ExpectationActionIdx);
+        if (!semeq(_t_symbol(w),WAKEUP_REFERENCE)) return;
+    }
+    _p_wakeup(r->q,w,NULL,err);
+}
+
+// timer callback for a pending response, expectation or conversation whose TIMEOUT_AT has come
+// (the wheel is shared by all the receptors and locked while this runs, so it just queues
+// the timeout up for _r_expire_timeouts)
+void __r_timeout(Timer *timer) {
+    Timeout *to = (Timeout *)timer;
+    // a cancelled timeout is all that's left of its item, which may have gone with its receptor
+    if (__atomic_load_n(&to->cancelled,__ATOMIC_ACQUIRE)) {
+        free(to);
+        return;
+    }
+    Receptor *r = to->r;
+    pthread_mutex_lock(&r->timeouts_mutex);
+    bool cancelled = to->cancelled;
+    if (!cancelled) {
+        to->fired = true;
+        to->next = r->expired;
+        r->expired = to;
+    }
+    pthread_mutex_unlock(&r->timeouts_mutex);
+    if (cancelled) free(to);
+}
+
+// take the item of a timeout that's gone off off the receptor's hands, returning false if
+// it's been cancelled since, i.e. the item is gone
+bool __r_claim_timeout(Receptor *r,Timeout *to) {
+    pthread_mutex_lock(&r->timeouts_mutex);
+    bool live = !to->cancelled;
+    if (live) HASH_DEL(r->timeouts,to);
+    pthread_mutex_unlock(&r->timeouts_mutex);
+    return live;
+}
+
+// expire the item of a timeout that's gone off, taking the lock its removal is guarded by
+// so that it can't go away in the middle of it
+void __r_expire_timeout(Receptor *r,Timeout *to) {
+    T *t = to->t;
+    if (semeq(to->kind,CONVERSATION)) {
+        pthread_mutex_lock(&r->conversations_mutex);
+        if (__r_claim_timeout(r,to)) {
+            debug(D_SIGNALS,"expiring %s\n",_td(r,t));
+            __r_expire_conversation(r,t);
+        }
+        pthread_mutex_unlock(&r->conversations_mutex);
+    }
+    else if (semeq(to->kind,PENDING_RESPONSE)) {
+        pthread_mutex_lock(&r->pending_responses_mutex);
+        bool expired = __r_claim_timeout(r,to) && __r_unindex_pending_response(r,t);
+        pthread_mutex_unlock(&r->pending_responses_mutex);
+        if (expired) {
+            debug(D_SIGNALS,"expiring %s\n",_td(r,t));
+            __r_wake_blocked(r,t,timeoutReductionErr);
+            _t_free(t);
+        }
+    }
+    // expectations only get removed on the receptor's own thread, which is the one doing this
+    else if (__r_claim_timeout(r,to)) {
+        debug(D_SIGNALS,"expiring %s\n",_td(r,t));
+        __r_wake_blocked(r,t,timeoutReductionErr);
+        _t_detach_by_ptr(_t_parent(t),t);
+        _t_free(t);
+    }
+    free(to);
+}
+
+/**
+ * expire the pending responses, expectations and conversations whose TIMEOUT_AT has come
+ * since the last call
+ *
+ * the timer callbacks run with the vmhost's wheel locked, so rather than holding up every
+ * other receptor's timers (and inverting the order the receptor's own locks are taken in)
+ * they just queue their timeouts, and this does the actual expiring.  A pending response or
+ * expectation is removed and a process blocked on it gets woken up with a
+ * timeoutReductionErr.  A conversation has its listeners and pending requests expired, and
+ * the process blocked in its CONVERSE is woken up with the error.  Items that got removed in
+ * the meantime are skipped.
+ *
+ * @param[in] r the receptor
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/receptor_spec.h testReceptorTimeouts
+ */
+void _r_expire_timeouts(Receptor *r) {
+    if (!__atomic_load_n(&r->expired,__ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&r->timeouts_mutex);
+    Timeout *to = r->expired,*next,*in_order = NULL;
+    r->expired = NULL;
+    pthread_mutex_unlock(&r->timeouts_mutex);
+    // they were queued last first
+    for(;to;to=next) {
+        next = to->next;
+        to->next = in_order;
+        in_order = to;
+    }
+    for(to=in_order;to;to=next) {
+        next = to->next;
+        __r_expire_timeout(r,to);
+    }
+}
+
+// make the timeout for an item at the TIMEOUT_AT in its END_CONDITIONS, so it can be
+// cancelled, but leave it to the caller to schedule it after *delayP
+Timeout *__r_add_timeout(Receptor *r,T *t,T *ec,uint64_t *delayP) {
+    if (!r->timers || !ec) return NULL;
+    T *at = __t_find(ec,TIMEOUT_AT,1);
+    if (!at) return NULL;
+    // the wheel runs on the monotonic clock, so work out how far off the wall clock deadline is
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME,&now);
+    int64_t delay = (int64_t)__r_timestamp_time(at)*NS_PER_SEC - ((int64_t)now.tv_sec*NS_PER_SEC+now.tv_nsec);
+    *delayP = delay > 0 ? delay : 0;
+    Timeout *to = malloc(sizeof(Timeout));
+    _tw_init_timer(&to->timer,__r_timeout,to);
+    to->t = t;
+    to->kind = _t_symbol(t);
+    to->r = r;
+    to->cancelled = false;
+    to->fired = false;
+    to->next = NULL;
+    pthread_mutex_lock(&r->timeouts_mutex);
+    HASH_ADD_PTR(r->timeouts,t,to);
+    pthread_mutex_unlock(&r->timeouts_mutex);
+    return to;
+}
+
+/**
+ * schedule the expiry of an item at the TIMEOUT_AT in its END_CONDITIONS
+ *
+ * when the time comes the item is queued up for _r_expire_timeouts to expire.
+ * Does nothing if the receptor isn't running on a timer wheel or there's no TIMEOUT_AT.
+ *
+ * @param[in] r the receptor
+ * @param[in] t the PENDING_RESPONSE, EXPECTATION or CONVERSATION
+ * @param[in] ec the item's END_CONDITIONS
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/receptor_spec.h testReceptorTimeouts
+ */
+void __r_set_timeout(Receptor *r,T *t,T *ec) {
+    uint64_t delay;
+    Timeout *to = __r_add_timeout(r,t,ec,&delay);
+    if (to) _tw_add(r->timers,&to->timer,delay,0);
+}
+
+/**
+ * unschedule the expiry of an item, for when it gets removed
+ *
+ * this doesn't touch the wheel, the timeout is just marked as cancelled, and it's freed
+ * when its timer goes off or, if that's already happened, when it would have been expired.
+ * Whatever removes an item has to cancel its timeout while holding the lock the item's
+ * removal is guarded by (see __r_expire_timeout).
+ */
+void __r_cancel_timeout(Receptor *r,T *t) {
+    if (!r->timers) return;
+    Timeout *to;
+    pthread_mutex_lock(&r->timeouts_mutex);
+    HASH_FIND_PTR(r->timeouts,&t,to);
+    if (to) {
+        HASH_DEL(r->timeouts,to);
+        __atomic_store_n(&to->cancelled,true,__ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&r->timeouts_mutex);
+}
+
+/**
+ * start expiring a receptor's pending responses, expectations and conversations on a timer wheel
+ *
+ * any of them that already exist (i.e. from unserializing) get scheduled too.
+ *
+ * @param[in] r the receptor
+ * @param[in] w the wheel
+ */
+void _r_start_timeouts(Receptor *r,TimerWheel *w) {
+    r->timers = w;
+    T *t;
+    int j;
+    DO_KIDS(r->pending_responses,
+            t = _t_child(r->pending_responses,i);
+            __r_set_timeout(r,t,_t_child(t,PendingResponseEndCondsIdx));
+            );
+    for(j=1;j<=_t_children(r->flux);j++) {
+        T *es = _t_child(_t_child(r->flux,j),aspectExpectationsIdx);
+        DO_KIDS(es,
+                t = _t_child(es,i);
+                __r_set_timeout(r,t,_t_child(t,ExpectationEndCondsIdx));
+                );
+    }
+    DO_KIDS(r->conversations,
+            t = _t_child(r->conversations,i);
+            __r_set_timeout(r,t,_t_child(t,ConversationUntilIdx));
+            );
+}
+
 // check if the end condition has been met
 // @todo find the correct home for this function
 void evaluateEndCondition(T *ec,bool *cleanup,bool *allow) {
@@ -611,26 +1108,7 @@ void evaluateEndCondition(T *ec,bool *cleanup,bool *allow) {
             break;  // this is final, even if there's a timeout
         }
         else if (semeq(sym,TIMEOUT_AT)) {
-            T *td = _t_child(c,1);
-            T *nw = _t_child(c,2);
-            int year = *(int *)_t_surface(_t_child(td,1))-1900;
-            int mon = *(int *)_t_surface(_t_child(td,2))-1;
-            int mday = *(int *)_t_surface(_t_child(td,3));
-            int hour = *(int *)_t_surface(_t_child(nw,1));
-            int min = *(int *)_t_surface(_t_child(nw,2));
-            int sec = *(int *)_t_surface(_t_child(nw,3));
-
-            //debug(D_SIGNALS,"T: y:%d,m:%d,d:%d,h:%d,m:%d,s:%d\n")
-            time_t now_t;
-            time(&now_t);
-            struct tm now;
-            gmtime_r(&now_t, &now);
-            if ((year > now.tm_year) ||
-                (mon > now.tm_mon) ||
-                (mday > now.tm_mday) ||
-                (hour > now.tm_hour) ||
-                (min > now.tm_min) ||
-                (sec > now.tm_sec)) {
+            if (__r_timestamp_time(c) > time(NULL)) {
                 *allow = true;
             }
 
@@ -698,6 +1176,7 @@ void __r_test_expectation(Receptor *r,T *expectation,T *signal) {
 
     if (allow && matched) {
         debug(D_SIGNALS,"got a match on %s\n",_td(q->r,stx));
+        _tr_event(q->trace,TraceMatch,*(Symbol *)_t_surface(s_carrier),0);
 
         T *rt=0;
         T *action = _t_child(expectation,ExpectationActionIdx);
@@ -743,56 +1222,67 @@ T* __r_sanatize_response(Receptor *r,T* response) {
     return _t_rclone(response);
 }
 
+/**
+ * deliver a response to the process waiting for it
+ *
+ * the pending response for the request is found by the request's UUID, and gets removed
+ * once its END_CONDITIONS say so.
+ *
+ * @param[in] r the receptor that made the request
+ * @param[in] response_to the IN_RESPONSE_TO_UUID of the response
+ * @param[in] signal the response signal (which gets freed)
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/receptor_spec.h testReceptorResponseDeliver
+ */
 int __r_deliver_response(Receptor *r,T *response_to,T *signal) {
     T *head = _t_getv(signal,SignalMessageIdx,MessageHeadIdx,TREE_PATH_TERMINATOR);
     // responses don't trigger expectation matching, instead they
-    // go through the pending_responses list to see where the signal goes
+    // go to the pending response of the request they are in response to
     UUIDt *u = (UUIDt*)_t_surface(response_to);
     debug(D_SIGNALS,"Delivering response: %s\n",_td(r,signal));
     Symbol signal_carrier = *(Symbol *)_t_surface(_t_child(head,HeadCarrierIdx));
 
     T *body = _t_getv(signal,SignalMessageIdx,MessageBodyIdx,TREE_PATH_TERMINATOR);
     T *response = (T *)_t_surface(body);
-    T *l;
-    DO_KIDS(r->pending_responses,
-            l = _t_child(r->pending_responses,i);
-            if (__uuid_equal(u,(UUIDt *)_t_surface(_t_child(l,PendingResponseUUIDIdx)))) {
-
-                // get the end conditions so we can see if we should actually respond
-                T *ec = _t_child(l,PendingResponseEndCondsIdx);
-                bool allow;
-                bool cleanup;
-                evaluateEndCondition(ec,&cleanup,&allow);
-
-                if (allow) {
-                    Symbol carrier = *(Symbol *)_t_surface(_t_child(l,PendingResponseCarrierIdx));
-                    T *wakeup = _t_child(l,PendingResponseWakeupIdx);
-                    // now set up the signal so when it's freed below, the body doesn't get freed too
-                    signal->context.flags &= ~TFLAG_SURFACE_IS_TREE;
-                    if (!semeq(carrier,signal_carrier)) {
-                        debug(D_SIGNALS,"response failed carrier check, expecting %s, but got %s!\n",_r_get_symbol_name(r,carrier),_r_get_symbol_name(r,signal_carrier));
-                        //@todo what kind of logging of these kinds of events?
-                        break;
-                    }
-
-                    response = __r_sanatize_response(r,response);
-                    // if the response isn't safe just break
-                    if (!response) {
-                        //@todo figure out if this means we should throw away the pending response too
-                        break;
-                    }
-                    _p_wakeup(r->q,wakeup,response,noReductionErr);
-                }
-
-                if (cleanup) {
-                    debug(D_SIGNALS,"removing pending response: %s\n",_td(r,l));
-                    _t_detach_by_idx(r->pending_responses,i);
-                    //i--;
-                    _t_free(l);
-                }
-                break;
+    T *l = NULL;
+    PendingResponseIndex *pi;
+    pthread_mutex_lock(&r->pending_responses_mutex);
+    HASH_FIND(hh,r->pending_index,u,sizeof(UUIDt),pi);
+    if (pi) {
+        l = pi->pending_response;
+        // get the end conditions so we can see if we should actually respond
+        T *ec = _t_child(l,PendingResponseEndCondsIdx);
+        bool allow;
+        bool cleanup;
+        evaluateEndCondition(ec,&cleanup,&allow);
+
+        if (allow) {
+            Symbol carrier = *(Symbol *)_t_surface(_t_child(l,PendingResponseCarrierIdx));
+            T *wakeup = _t_child(l,PendingResponseWakeupIdx);
+            // now set up the signal so when it's freed below, the body doesn't get freed too
+            signal->context.flags &= ~TFLAG_SURFACE_IS_TREE;
+            if (!semeq(carrier,signal_carrier)) {
+                debug(D_SIGNALS,"response failed carrier check, expecting %s, but got %s!\n",_r_get_symbol_name(r,carrier),_r_get_symbol_name(r,signal_carrier));
+                //@todo what kind of logging of these kinds of events?
+                cleanup = false;
             }
-            );
+            // if the response isn't safe don't deliver it
+            //@todo figure out if this means we should throw away the pending response too
+            else if (!(response = __r_sanatize_response(r,response)))
+                cleanup = false;
+            else _p_wakeup(r->q,wakeup,response,noReductionErr);
+        }
+
+        if (cleanup) {
+            debug(D_SIGNALS,"removing pending response: %s\n",_td(r,l));
+            __r_unindex_pending_response(r,l);
+            __r_cancel_timeout(r,l);
+        }
+        else l = NULL;
+    }
+    pthread_mutex_unlock(&r->pending_responses_mutex);
+    if (l) _t_free(l);
     _t_free(signal);
     return noDeliveryErr;
 }
@@ -815,9 +1305,61 @@ UUIDt *__cid_getUUID(T *cid) {
     return (UUIDt *)_t_surface(_t_child(cid,ConversationIdentUUIDIdx));
 }
 
-// registers a new conversation at the receptor level.  Note that this routine
-// expects that the until param (if provided) can be added to the conversation tree,
-// i.e. it must not be part of some other tree.
+// adds a conversation and its sub-conversations to the receptor's index
+// (the caller must hold the conversations mutex)
+void __r_index_conversation(Receptor *r,T *c) {
+    ConversationIndex *ci = malloc(sizeof(ConversationIndex));
+    ci->uuid = *__cid_getUUID(_t_child(c,ConversationIdentIdx));
+    ci->conversation = c;
+    HASH_ADD(hh,r->conversation_index,uuid,sizeof(UUIDt),ci);
+    T *conversations = _t_child(c,ConversationConversationsIdx);
+    T *sc;
+    DO_KIDS(conversations,
+            sc = _t_child(conversations,i);
+            __r_index_conversation(r,sc);
+            );
+}
+
+// removes a conversation and its sub-conversations from the receptor's index
+// (the caller must hold the conversations mutex)
+void __r_unindex_conversation(Receptor *r,T *c) {
+    ConversationIndex *ci;
+    HASH_FIND(hh,r->conversation_index,__cid_getUUID(_t_child(c,ConversationIdentIdx)),sizeof(UUIDt),ci);
+    if (ci) {
+        HASH_DEL(r->conversation_index,ci);
+        free(ci);
+    }
+    T *conversations = _t_child(c,ConversationConversationsIdx);
+    T *sc;
+    DO_KIDS(conversations,
+            sc = _t_child(conversations,i);
+            __r_unindex_conversation(r,sc);
+            );
+}
+
+// finds a conversation in the index (the caller must hold the conversations mutex)
+T *__r_find_conversation(Receptor *r,UUIDt *uuid) {
+    ConversationIndex *ci;
+    HASH_FIND(hh,r->conversation_index,uuid,sizeof(UUIDt),ci);
+    return ci ? ci->conversation : NULL;
+}
+
+/**
+ * register a new conversation at the receptor level
+ *
+ * Note that this routine expects that the until param (if provided) can be added to the
+ * conversation tree, i.e. it must not be part of some other tree.
+ *
+ * @param[in] r the receptor
+ * @param[in] parent_u UUID of the conversation this is a sub-conversation of, or NULL
+ * @param[in] u UUID of the new conversation
+ * @param[in] until END_CONDITIONS for the conversation (defaults to UNLIMITED)
+ * @param[in] wakeup WAKEUP_REFERENCE of the CONVERSE waiting on this conversation, or NULL
+ * @returns the CONVERSATION tree
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/receptor_spec.h testReceptorConversations
+ */
 T * _r_add_conversation(Receptor *r,UUIDt *parent_u,UUIDt *u,T *until,T *wakeup) {
     T *c = _t_new_root(CONVERSATION);
     T *cu = __cid_new(c,u,0);
@@ -826,45 +1368,39 @@ T * _r_add_conversation(Receptor *r,UUIDt *parent_u,UUIDt *u,T *until,T *wakeup)
     _t_newr(c,CONVERSATIONS); // add the root for any sub-conversations
     if (wakeup) _t_add(c,wakeup);
 
-    //@todo NOT THREAD SAFE, add locking
+    pthread_mutex_lock(&r->conversations_mutex);
     T *p;
     if (parent_u) {
-        p = _r_find_conversation(r,parent_u);
+        p = __r_find_conversation(r,parent_u);
+        if (!p) {
+            pthread_mutex_unlock(&r->conversations_mutex);
+            raise_error("parent conversation not found!");
+        }
         p = _t_child(p,ConversationConversationsIdx);
-        if (!p) raise_error("parent conversation not found!");
     }
     else p = r->conversations;
     _t_add(p,c);
-    //@todo UNLOCK
+    __r_index_conversation(r,c);
+    __r_set_timeout(r,c,_t_child(c,ConversationUntilIdx));
+    pthread_mutex_unlock(&r->conversations_mutex);
     return c;
 }
 
-// finds a conversation searching recursively through sub-conversations
-T *__r_find_conversation(T *conversations, UUIDt *uuid) {
-    T *c,*ci;
-    bool found = false;
-
-    // @todo lock?
-    DO_KIDS(conversations,
-            c = _t_child(conversations,i);
-            UUIDt *u = __cid_getUUID(_t_child(c,ConversationIdentIdx));
-            if (__uuid_equal(uuid,u)) {
-                found = true;
-                break;
-            }
-            T *sub_conversations = _t_child(c,ConversationConversationsIdx);
-            if (_t_children(sub_conversations)) {
-                c = __r_find_conversation(sub_conversations,uuid);
-                if (c) {found = true;break;}
-            }
-            );
-    // @todo unlock
-    return found?c:NULL;
-}
-
+/**
+ * find a conversation (or sub-conversation) by its UUID
+ *
+ * @param[in] r the receptor
+ * @param[in] uuid the conversation's UUID
+ * @returns the CONVERSATION tree or NULL if there's no such conversation
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/receptor_spec.h testReceptorConversations
+ */
 T *_r_find_conversation(Receptor *r, UUIDt *uuid) {
-    // @todo reimplement with semtrex?
-    return __r_find_conversation(r->conversations, uuid);
+    pthread_mutex_lock(&r->conversations_mutex);
+    T *c = __r_find_conversation(r,uuid);
+    pthread_mutex_unlock(&r->conversations_mutex);
+    return c;
 }
 
 
@@ -877,13 +1413,14 @@ void __r_walk_conversation(T *conversation, doConversationFn fn,void *param) {
         T *c;
         DO_KIDS(conversations,
                 c = _t_child(conversations,i);
-                __r_walk_conversation(c,param,fn);
+                __r_walk_conversation(c,fn,param);
             );
     }
 }
 
-void _cleaner(T *cid,void *p) {
-    Receptor *r = (Receptor *)p;
+// removes the listeners and pending requests of a conversation, waking anything blocked on them
+// if there's an error to wake them with
+void __r_clean_conversation_items(Receptor *r,T *cid,Error err) {
     UUIDt *u = __cid_getUUID(cid);
     T *e,*ex;
     int i,j;
@@ -896,6 +1433,8 @@ void _cleaner(T *cid,void *p) {
             e = _t_child(ex,i);
             T *cid = __t_find(e,CONVERSATION_IDENT,ExpectationOptionalsIdx);
             if (cid && __uuid_equal(u,__cid_getUUID(cid))) {
+                __r_cancel_timeout(r,e);
+                if (err) __r_wake_blocked(r,e,err);
                 _t_detach_by_ptr(ex,e);
                 _t_free(e);
                 i--;
@@ -903,32 +1442,68 @@ void _cleaner(T *cid,void *p) {
         }
     }
     // remove any pending response handlers from requests
+    T *done = _t_new_root(PENDING_RESPONSES);
+    pthread_mutex_lock(&r->pending_responses_mutex);
     for(i=1;i<=_t_children(r->pending_responses);i++) {
         e = _t_child(r->pending_responses,i);
         T *cid = _t_child(e,PendingResponseConversationIdentIdx);
         if (cid && __uuid_equal(u,__cid_getUUID(cid))) {
-            _t_detach_by_ptr(r->pending_responses,e);
-            _t_free(e);
+            __r_unindex_pending_response(r,e);
+            __r_cancel_timeout(r,e);
+            _t_add(done,e);
             i--;
         }
     }
+    pthread_mutex_unlock(&r->pending_responses_mutex);
+    DO_KIDS(done,
+            e = _t_child(done,i);
+            if (err) __r_wake_blocked(r,e,err);
+            );
+    _t_free(done);
+}
+
+void _cleaner(T *cid,void *p) {
+    Receptor *r = (Receptor *)p;
+    __r_cancel_timeout(r,_t_parent(cid));
+    __r_clean_conversation_items(r,cid,noReductionErr);
+}
+
+void _expirer(T *cid,void *p) {
+    __r_clean_conversation_items((Receptor *)p,cid,timeoutReductionErr);
 }
 
+/**
+ * expire a conversation whose TIMEOUT_AT has come
+ *
+ * the listeners and pending requests in it (and its sub-conversations) are removed with
+ * anything blocked on them woken up with a timeoutReductionErr, as is a CONVERSE blocked
+ * waiting for it.  The conversation record itself stays until it's completed because the
+ * CONVERSE's context still refers to it.
+ */
+void __r_expire_conversation(Receptor *r,T *c) {
+    __r_walk_conversation(c,_expirer,r);
+    T *w = _t_child(c,ConversationWakeupIdx);
+    if (w) _p_wakeup(r->q,w,NULL,timeoutReductionErr);
+}
+
+
 // cleans up any pending requests, listens and the conversation record
 // returns the wakeup reference
 T * __r_cleanup_conversation(Receptor *r, UUIDt *cuuid) {
-    // @todo lock conversations?
-    T *c = _r_find_conversation(r,cuuid);
+    pthread_mutex_lock(&r->conversations_mutex);
+    T *c = __r_find_conversation(r,cuuid);
     if (!c) {
+        pthread_mutex_unlock(&r->conversations_mutex);
         raise_error("can't find conversation");
     }
     T *w = _t_detach_by_idx(c,ConversationWakeupIdx);
 
     __r_walk_conversation(c,_cleaner,r);
 
+    __r_unindex_conversation(r,c);
     _t_detach_by_ptr(_t_parent(c),c);
+    pthread_mutex_unlock(&r->conversations_mutex);
     _t_free(c);
-    // @todo unlock conversations?
     return w;
 }
 
@@ -954,6 +1529,7 @@ T * __r_cleanup_conversation(Receptor *r, UUIDt *cuuid) {
 Error _r_deliver(Receptor *r, T *signal) {
 
     T *head = _t_getv(signal,SignalMessageIdx,MessageHeadIdx,TREE_PATH_TERMINATOR);
+    _tr_event(r->q->trace,TraceDeliver,*(Symbol *)_t_surface(_t_child(head,HeadCarrierIdx)),0);
 
     T *conversation = NULL;
     T *end_conditions = NULL;
@@ -1096,10 +1672,10 @@ void __r_listenerCallback(Stream *st,void *arg) {
 
 }
 
-SocketListener *_r_addListener(Receptor *r,int port,T *code,T*params,T *err_handler,char *delim) {
+SocketListener *_r_addListener(Receptor *r,int port,T *code,T*params,T *err_handler,char *delim,int stream_flags) {
     T *e = _t_new_root(PARAMS);
 
-    SocketListener *l = _st_new_socket_listener(port,__r_listenerCallback,r,delim);
+    SocketListener *l = _st_new_socket_listener(port,__r_listenerCallback,r,delim,stream_flags);
     _t_new_cptr(e,EDGE_LISTENER,l);
     _t_add(e,code);
     if (!params) params = _t_newr(e,PARAMS);
@@ -1236,14 +1812,29 @@ Receptor *_r_makeClockReceptor(SemTable *sem) {
 }
 
 /**
-    bad implementation of the clock receptor thread (but easy):
-   - wake up every second
-   - build a TICK symbol based on the current time.
-   - set the Xaddr of the current tick
-
-  @todo: a better implementation would be to analyze the semtrex expectations that have been planted
-  and only wakeup when needed based on those semtrexes
+ * timer callback that sets the clock receptor's current TICK
+ *
+ * the timer's arg is the clock receptor.  The vmhost runs this as a periodic timer on its
+ * wheel at the clock resolution.
+ *
+ * @todo: a better implementation would be to analyze the semtrex expectations that have been planted
+ * and only wakeup when needed based on those semtrexes
+ */
+void __r_tick(Timer *t) {
+    Receptor *r = (Receptor*)t->arg;
+    T *tick =__r_make_tick();
+    debug(D_CLOCK,"%s\n",_td(r,tick));
+    Xaddr x = {TICK,1};
+    _r_set_instance(r,x,tick);
+    //        T *signal = __r_make_signal(self,self,DEFAULT_ASPECT,TICK,tick,0,0,0);
+    //        _r_deliver(r,signal);
+}
 
+/**
+ * run a clock receptor on its own thread, for when it's not running in a vmhost
+ *
+ * sets the TICK right away and then on every second, sleeping till each second comes
+ * round on a timer wheel of its own.
  *
  * @param[in] the clock receptor
  */
@@ -1251,18 +1842,18 @@ void *___clock_thread(void *arg){
     Receptor *r = (Receptor*)arg;
     debug(D_CLOCK,"clock started\n");
     int err =0;
-    ReceptorAddress self = __r_get_self_address(r);
+    TimerWheel *w = _tw_new(CLOCK_RESOLUTION);
+    Timer tick;
+    _tw_init_timer(&tick,__r_tick,r);
+    __r_tick(&tick);
+    _tw_add(w,&tick,CLOCK_RESOLUTION,CLOCK_RESOLUTION);
     while (r->state == Alive) {
-        T *tick =__r_make_tick();
-        debug(D_CLOCK,"%s\n",_td(r,tick));
-        Xaddr x = {TICK,1};
-        _r_set_instance(r,x,tick);
-        //        T *signal = __r_make_signal(self,self,DEFAULT_ASPECT,TICK,tick,0,0,0);
-        //        _r_deliver(r,signal);
-        sleep(1);
-        /// @todo this will skip some seconds over time.... make more sophisticated
-        //       with nano-sleep so that we get every second?
+        uint64_t ns = _tw_next_tick(w)-_tw_now();
+        struct timespec d = {ns/NS_PER_SEC,ns%NS_PER_SEC};
+        nanosleep(&d,NULL);
+        _tw_advance(w,_tw_now());
     }
+    _tw_free(w);
     debug(D_CLOCK,"clock stopped\n");
     pthread_exit(&err); //@todo determine if we should use pthread_exit or just return 0
     return 0;
@@ -1298,6 +1889,6 @@ ReceptorAddress __r_get_self_address(Receptor *r) {
 }
 
 void __r_dump_instances(Receptor *r) {
-    printf("\nINSTANCES:%s\n",_t2s(r->sem,r->instances));
+    printf("\nINSTANCES:%s\n",r->instances ? _t2s(r->sem,r->instances->store) : "");
 }
 /** @}*/
@@ -23,6 +23,8 @@
 enum {noDeliveryErr};
 
 /******************  create and destroy receptors */
+Receptor * __r_init(T *t,SemTable *sem);
+void ___r_init(Receptor *r,T *t,SemTable *sem);
 T *__r_make_definitions();
 T *_r_make_state();
 Receptor *_r_new(SemTable *sem,SemanticID r);
@@ -32,6 +34,7 @@ void _r_add_expectation(Receptor *r,Aspect aspect,Symbol carrier,T *pattern,T *a
 void __r_add_expectation(Receptor *r,Aspect aspect,T *e);
 void _r_remove_expectation(Receptor *r,T *expectation);
 void _r_free(Receptor *r);
+void __r_free_state(Receptor *r);
 
 /*****************  receptor symbols, structures, and processes */
 
@@ -53,11 +56,22 @@ Xaddr _r_new_instance(Receptor *r,T *t);
 T *_r_get_instance(Receptor *r,Xaddr x);
 T * _r_set_instance(Receptor *r,Xaddr x,T *t);
 T * _r_delete_instance(Receptor *r,Xaddr x);
+void _r_add_scape(Receptor *r,Scape *s);
+void __r_log_instance(Receptor *r,int type,Xaddr x,T *t);
+void __r_log_define(Receptor *r,SemanticID sid);
+SemanticID _r_define(Receptor *r,T *def,SemanticType semtype);
 TreeHash _r_hash(Receptor *r,Xaddr t);
 
 /******************  receptor serialization */
-void _r_serialize(Receptor *r,void **surfaceP,size_t *lengthP);
-Receptor * _r_unserialize(SemTable *sem,void *surface);
+void __r_serialize(Receptor *r,void **surfaceP,size_t *lengthP,CheckpointFile **files);
+#define _r_serialize(r,surfaceP,lengthP) __r_serialize(r,surfaceP,lengthP,NULL)
+Receptor * __r_unserialize(SemTable *sem,void *surface,char *dir);
+size_t __r_image_size(void *image);
+Receptor *__r_new_stub(SemTable *sem,Context c,void *image,char *dir);
+void __r_materialize(Receptor *r,bool lazy);
+#define _r_materialize(r) __r_materialize(r,false)
+void __r_stub(Receptor *r,void *image,void *mapping,size_t size,char *dir);
+#define _r_unserialize(sem,surface) __r_unserialize(sem,surface,NULL)
 
 /******************  receptor signaling */
 #define __r_make_addr(p,t,a) ___r_make_addr(p,t,a,0)
@@ -69,11 +83,21 @@ T* __r_send(Receptor *r,T *signal);
 T* _r_send(Receptor *r,T *signal);
 T* _r_request(Receptor *r,T *signal,Symbol response_carrier,T *code_point,int process_id,T *cid);
 void evaluateEndCondition(T *ec,bool *cleanup,bool *allow);
+time_t __r_timestamp_time(T *ts);
+Timeout *__r_add_timeout(Receptor *r,T *t,T *ec,uint64_t *delayP);
+void __r_set_timeout(Receptor *r,T *t,T *ec);
+void __r_cancel_timeout(Receptor *r,T *t);
+void _r_start_timeouts(Receptor *r,TimerWheel *w);
+void _r_expire_timeouts(Receptor *r);
+void __r_expire_conversation(Receptor *r,T *c);
 void __r_test_expectation(Receptor *r,T *expectation,T *signal);
 bool __cid_equal(SemTable *sem,T *cid1,T*cid2);
 T *__cid_new(T *parent,UUIDt *c,T *topic);
 UUIDt *__cid_getUUID(T *cid);
 T * _r_add_conversation(Receptor *r,UUIDt *parent_u,UUIDt *u,T *until,T *wakeup);
+void __r_index_conversation(Receptor *r,T *c);
+void __r_index_pending_response(Receptor *r,T *pr);
+T *_r_find_pending_response(Receptor *r,UUIDt *u);
 T *_r_find_conversation(Receptor *r, UUIDt *cuuid);
 T *__r_cleanup_conversation(Receptor *r, UUIDt *cuuid);
 Error _r_deliver(Receptor *r, T *signal);
@@ -106,11 +130,12 @@ Xaddr G_null_xaddr;
 
 /*****************  Built-in core and edge receptors */
 Receptor *_r_makeStreamEdgeReceptor(SemTable *sem);
-SocketListener *_r_addListener(Receptor *r,int port,T *code,T*params,T *err_handler,char *delim);
+SocketListener *_r_addListener(Receptor *r,int port,T *code,T*params,T *err_handler,char *delim,int stream_flags);
 void _r_addReader(Receptor *r,Stream *st,ReceptorAddress to,Aspect aspect,Symbol carrier,Symbol result_symbol,bool conversation);
 void _r_addWriter(Receptor *r,Stream *st,Aspect aspect);
 void _r_defineClockReceptor(SemTable *sem);
 Receptor *_r_makeClockReceptor(SemTable *sem);
+void __r_tick(Timer *t);
 void *___clock_thread(void *arg);
 #define __r_make_tick() __r_make_timestamp(TICK,00)
 T *__r_make_timestamp(Symbol s,int delta);
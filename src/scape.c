@@ -9,6 +9,8 @@
  */
 
 #include "scape.h"
+#include "semtable.h"
+#include "def.h"
 
 /**
  * create a new scape
@@ -21,19 +23,63 @@
  * @snippet spec/scape_spec.h testScapeNew
  */
 Scape *_s_new(Symbol key_source,Symbol data_source) {
+    return __s_new(key_source,data_source,NULL,false,false);
+}
+
+/**
+ * create a new scape for indexing instances
+ *
+ * @params[in] key_source the symbol type key hashes are of
+ * @params[in] data_source the symbol type of xaddrs to be associated with keys
+ * @params[in] key_path path to the key within a data_source instance, or NULL to use the first key_source node found in it
+ * @params[in] multi whether more than one instance can have the same key
+ * @params[in] ordered whether to also keep the keys in order for range and prefix scans
+ * @returns a pointer to a newly allocated Scape
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeIndex
+ */
+Scape *__s_new(Symbol key_source,Symbol data_source,int *key_path,bool multi,bool ordered) {
     Scape *s = malloc(sizeof(Scape));
     s->key_source = key_source;
     s->data_source = data_source;
     s->data = NULL;
+    s->key_path = NULL;
+    if (key_path) {
+        size_t l = sizeof(int)*(_t_path_depth(key_path)+1);
+        s->key_path = malloc(l);
+        memcpy(s->key_path,key_path,l);
+    }
+    s->multi = multi;
+    s->order = NULL;
+    s->levels = 1;
+    s->seed = 0x9e3779b9;
+    if (ordered) {
+        s->order = malloc(sizeof(ScapeNode)+sizeof(ScapeNode *)*SCAPE_MAX_LEVEL);
+        memset(s->order,0,sizeof(ScapeNode)+sizeof(ScapeNode *)*SCAPE_MAX_LEVEL);
+        s->order->level = SCAPE_MAX_LEVEL;
+    }
+    s->sem = NULL;
+    s->next = NULL;
     return s;
 }
 
+// free an element of the hash table
+void __s_free_elem(scape_elem *e) {
+    _t_free(e->key_tree);
+    free(e->values);
+    free(e);
+}
+
 // free the hash table data
 void scapedataFree(ScapeData *i) {
-    scape_elem *cur,*tmp;
+    scape_elem *cur,*tmp,*next;
     HASH_ITER(hh, *i, cur, tmp) {
     HASH_DEL(*i,cur);  /* delete; cur advances to next */
-    free(cur);
+    for(;cur;cur=next) {
+        next = cur->next;
+        __s_free_elem(cur);
+    }
     }
 }
 
@@ -42,31 +88,104 @@ void scapedataFree(ScapeData *i) {
  */
 void _s_free(Scape *s) {
     scapedataFree(&s->data);
+    if (s->order) {
+        ScapeNode *n = s->order->next[0],*next;
+        for(;n;n=next) {
+            next = n->next[0];
+            _t_free(n->key);
+            free(n);
+        }
+        free(s->order);
+    }
+    if (s->key_path) free(s->key_path);
     free(s);
 }
+// find the element of a key.  Keys with the same hash are chained off the one in the hash table
+// so the key trees themselves get compared.
+scape_elem *__s_find_elem(Scape *s,T *key,TreeHash h,scape_elem **head) {
+    scape_elem *e;
+    HASH_FIND_INT( s->data, &h, e );
+    if (head) *head = e;
+    while (e && !_t_equal(s->sem,e->key_tree,key)) e = e->next;
+    return e;
+}
+
 /**
  * add a new element into a scape
  *
  * @params[in] s the scape
- * @params[in] h a hash of the tree node which is the key
+ * @params[in] key the tree node which is the key (which gets copied)
  * @params[in] xaddr the instance address to be scaped
+ * @returns false if the scape isn't multi-valued and already has the key, in which case nothing was added
  *
  * <b>Examples (from test suite):</b>
  * @snippet spec/scape_spec.h testScapeAddElement
  */
-void _s_add(Scape *s,TreeHash h,Xaddr x) {
-    ScapeData *data = &s->data;
-    scape_elem *e;
+bool _s_add(Scape *s,T *key,Xaddr x) {
+    TreeHash h = _t_hash(s->sem,key);
+    scape_elem *head,*e = __s_find_elem(s,key,h,&head);
 
-    HASH_FIND_INT( *data, &h, e );
     if (e) {
-    raise_error("allready there!");
+    if (!s->multi) return false;
+    if (e->count == e->size) {
+        e->size *= 2;
+        e->values = realloc(e->values,sizeof(Xaddr)*e->size);
+    }
+    e->values[e->count++] = x;
     }
     else {
     e = malloc(sizeof(struct scape_elem));
     e->key = h;
-    e->value = x;
-    HASH_ADD_INT(*data,key,e);
+    e->key_tree = _t_clone(key);
+    e->size = 1;
+    e->values = malloc(sizeof(Xaddr));
+    e->values[0] = x;
+    e->count = 1;
+    if (head) {
+        e->next = head->next;
+        head->next = e;
+    }
+    else {
+        e->next = NULL;
+        HASH_ADD_INT(s->data,key,e);
+    }
+    }
+    return true;
+}
+
+/**
+ * remove an element from a scape
+ *
+ * @params[in] s the scape
+ * @params[in] key the tree node which is the key
+ * @params[in] xaddr the instance address to remove from the key
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeIndex
+ */
+void _s_remove(Scape *s,T *key,Xaddr x) {
+    scape_elem *head,*e = __s_find_elem(s,key,_t_hash(s->sem,key),&head);
+
+    if (e) {
+        int i;
+        for(i=0;i<e->count;i++) {
+            if (semeq(e->values[i].symbol,x.symbol) && e->values[i].addr == x.addr) {
+                e->values[i] = e->values[--e->count];
+                break;
+            }
+        }
+        if (!e->count) {
+            if (e == head) {
+                // the next key with the same hash (if any) takes its place in the table
+                HASH_DEL(s->data,e);
+                if (e->next) HASH_ADD_INT(s->data,key,e->next);
+            }
+            else {
+                while (head->next != e) head = head->next;
+                head->next = e->next;
+            }
+            __s_free_elem(e);
+        }
     }
 }
 
@@ -80,14 +199,318 @@ void _s_add(Scape *s,TreeHash h,Xaddr x) {
  * <b>Examples (from test suite):</b>
  * @snippet spec/scape_spec.h testScapeAddElement
  */
-Xaddr _s_get(Scape *s,TreeHash h) {
+Xaddr _s_get(Scape *s,T *key) {
     Xaddr x = {0,0};
-    scape_elem *e = 0;
-    ScapeData *data = &s->data;
+    scape_elem *e = __s_find_elem(s,key,_t_hash(s->sem,key),NULL);
 
-    HASH_FIND_INT( *data, &h, e );
-    if (e) return e->value;
+    if (e) return e->values[0];
     return x;
 }
 
+/**
+ * retrieve all the Xaddrs with a key from a multi-valued scape
+ *
+ * @params[in] s the scape
+ * @params[in] key the tree node which is the key
+ * @params[out] count the number of Xaddrs
+ * @returns the Xaddrs (owned by the scape and only good till it next changes) or NULL
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeIndex
+ */
+Xaddr *_s_get_all(Scape *s,T *key,int *count) {
+    scape_elem *e = __s_find_elem(s,key,_t_hash(s->sem,key),NULL);
+
+    *count = e ? e->count : 0;
+    return e ? e->values : NULL;
+}
+
+// depth first search for the first node of a symbol
+T *__s_find(T *t,Symbol sym) {
+    if (semeq(_t_symbol(t),sym)) return t;
+    T *k;
+    DO_KIDS(t,
+            if ((k = __s_find(_t_child(t,i),sym))) return k;
+            );
+    return NULL;
+}
+
+/**
+ * find the key of an instance
+ *
+ * @params[in] s the scape
+ * @params[in] t an instance of the scape's data_source
+ * @returns the key_source node in the instance or NULL if it doesn't have one
+ */
+T *_s_key(Scape *s,T *t) {
+    if (s->key_path) {
+        T *k = _t_get(t,s->key_path);
+        return (k && semeq(_t_symbol(k),s->key_source)) ? k : NULL;
+    }
+    return __s_find(t,s->key_source);
+}
+
+/**
+ * compare two keys
+ *
+ * keys with children (i.e. DATE, TIME etc.) are compared child by child, and leaves by the
+ * values of their surfaces for the basic numeric and string structures, or byte by byte
+ * otherwise.  A key that has the same first children as a longer one sorts before it.
+ *
+ * @param[in] sem the semantic table to look up the structures of the keys in
+ * @param[in] a a key
+ * @param[in] b another key
+ * @returns <0, 0 or >0 as a is less than, equal to or greater than b
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeOrdered
+ */
+int _s_cmp(SemTable *sem,T *a,T *b) {
+    int ca = _t_children(a),cb = _t_children(b);
+    if (ca || cb) {
+        int i,r;
+        for(i=1;i<=ca && i<=cb;i++)
+            if ((r = _s_cmp(sem,_t_child(a,i),_t_child(b,i)))) return r;
+        return ca-cb;
+    }
+    void *sa = _t_surface(a),*sb = _t_surface(b);
+    Structure st = _sem_get_symbol_structure(sem,_t_symbol(a));
+    if (semeq(st,INTEGER)) {
+        int x = *(int *)sa,y = *(int *)sb;
+        return (x > y) - (x < y);
+    }
+    if (semeq(st,INTEGER64)) {
+        int64_t x = *(int64_t *)sa,y = *(int64_t *)sb;
+        return (x > y) - (x < y);
+    }
+    if (semeq(st,FLOAT)) {
+        float x = *(float *)sa,y = *(float *)sb;
+        return (x > y) - (x < y);
+    }
+    if (semeq(st,CSTRING)) return strcmp(sa,sb);
+    size_t la = _t_size(a),lb = _t_size(b);
+    int r = memcmp(sa,sb,la < lb ? la : lb);
+    return r ? r : (la > lb) - (la < lb);
+}
+
+// order the skiplist by key, and by address among instances with the same key
+// (all the instances in a scape are of its data_source)
+int __s_node_cmp(Scape *s,ScapeNode *n,T *key,Xaddr x) {
+    int r = _s_cmp(s->sem,n->key,key);
+    return r ? r : n->value.addr - x.addr;
+}
+
+// find the last node before key/x on each level
+void __s_order_find(Scape *s,T *key,Xaddr x,ScapeNode **update) {
+    ScapeNode *n = s->order;
+    int l;
+    for(l=s->levels-1;l>=0;l--) {
+        while (n->next[l] && __s_node_cmp(s,n->next[l],key,x) < 0) n = n->next[l];
+        update[l] = n;
+    }
+}
+
+void __s_order_add(Scape *s,T *key,Xaddr x) {
+    ScapeNode *update[SCAPE_MAX_LEVEL];
+    __s_order_find(s,key,x,update);
+    // each level has a quarter of the nodes of the one below it
+    int level = 1;
+    s->seed ^= s->seed << 13; s->seed ^= s->seed >> 17; s->seed ^= s->seed << 5;
+    uint32_t r = s->seed;
+    while (level < SCAPE_MAX_LEVEL && !(r & 3)) {
+        level++;
+        r >>= 2;
+    }
+    for(;s->levels < level;s->levels++) update[s->levels] = s->order;
+    ScapeNode *n = malloc(sizeof(ScapeNode)+sizeof(ScapeNode *)*level);
+    n->key = _t_clone(key);
+    n->value = x;
+    n->level = level;
+    int l;
+    for(l=0;l<level;l++) {
+        n->next[l] = update[l]->next[l];
+        update[l]->next[l] = n;
+    }
+}
+
+void __s_order_remove(Scape *s,T *key,Xaddr x) {
+    ScapeNode *update[SCAPE_MAX_LEVEL];
+    __s_order_find(s,key,x,update);
+    ScapeNode *n = update[0]->next[0];
+    if (n && !__s_node_cmp(s,n,key,x)) {
+        int l;
+        for(l=0;l<n->level;l++) update[l]->next[l] = n->next[l];
+        while (s->levels > 1 && !s->order->next[s->levels-1]) s->levels--;
+        _t_free(n->key);
+        free(n);
+    }
+}
+
+/**
+ * find where a key is, or would be, in an ordered scape
+ *
+ * ordered iteration is just following the next[0] links from the node returned.
+ *
+ * @param[in] s the scape
+ * @param[in] key the key to look for, or NULL for the start of the scape
+ * @returns the first node with a key not less than key, or NULL if there is none
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeOrdered
+ */
+ScapeNode *_s_seek(Scape *s,T *key) {
+    if (!s->order) raise_error("scape isn't ordered");
+    ScapeNode *n = s->order;
+    if (key) {
+        int l;
+        for(l=s->levels-1;l>=0;l--)
+            while (n->next[l] && _s_cmp(s->sem,n->next[l]->key,key) < 0) n = n->next[l];
+    }
+    return n->next[0];
+}
+
+/**
+ * get the instances in a range of keys from an ordered scape
+ *
+ * @param[in] s the scape
+ * @param[in] from the lowest key to include, or NULL to start at the beginning
+ * @param[in] to the highest key to include, or NULL to go to the end
+ * @param[in] is_run_node true to build the results out of run nodes
+ * @returns QUERY_RESULTS with a WHICH_XADDR of each instance, in key order
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeOrdered
+ */
+T *__s_range(Scape *s,T *from,T *to,bool is_run_node) {
+    T *t = __t_newr(0,QUERY_RESULTS,is_run_node);
+    ScapeNode *n;
+    for(n=_s_seek(s,from);n && (!to || _s_cmp(s->sem,n->key,to) <= 0);n=n->next[0])
+        __t_new(t,WHICH_XADDR,&n->value,sizeof(Xaddr),is_run_node);
+    return t;
+}
+
+// check if a key starts with a prefix, i.e. the prefix's children or string
+bool __s_is_prefix(SemTable *sem,T *prefix,T *key) {
+    int c = _t_children(prefix);
+    if (c) {
+        if (_t_children(key) < c) return false;
+        int i;
+        for(i=1;i<=c;i++)
+            if (_s_cmp(sem,_t_child(prefix,i),_t_child(key,i))) return false;
+        return true;
+    }
+    if (_t_children(key)) return false;
+    if (semeq(_sem_get_symbol_structure(sem,_t_symbol(prefix)),CSTRING)) {
+        char *p = _t_surface(prefix);
+        return !strncmp(p,_t_surface(key),strlen(p));
+    }
+    return !_s_cmp(sem,prefix,key);
+}
+
+/**
+ * get the instances whose keys start with a prefix from an ordered scape
+ *
+ * a string key starts with the prefix if the prefix is the start of the string, and a
+ * key with children if its first children are the prefix's children, i.e. a DATE with just
+ * a YEAR is the prefix of all the dates in that year.
+ *
+ * @param[in] s the scape
+ * @param[in] prefix the prefix
+ * @param[in] is_run_node true to build the results out of run nodes
+ * @returns QUERY_RESULTS with a WHICH_XADDR of each instance, in key order
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeOrdered
+ */
+T *__s_prefix(Scape *s,T *prefix,bool is_run_node) {
+    T *t = __t_newr(0,QUERY_RESULTS,is_run_node);
+    ScapeNode *n;
+    for(n=_s_seek(s,prefix);n && __s_is_prefix(s->sem,prefix,n->key);n=n->next[0])
+        __t_new(t,WHICH_XADDR,&n->value,sizeof(Xaddr),is_run_node);
+    return t;
+}
+
+/**
+ * add an instance to the scape under its key
+ *
+ * instances without a key aren't scaped
+ *
+ * @returns false if the scape isn't multi-valued and another instance already has the key, in which case it wasn't added
+ */
+bool _s_index(Scape *s,T *t,Xaddr x) {
+    T *k = _s_key(s,t);
+    if (k) {
+        if (!_s_add(s,k,x)) return false;
+        if (s->order) __s_order_add(s,k,x);
+    }
+    return true;
+}
+
+/**
+ * check whether an instance can be scaped at an address
+ *
+ * @param[in] s the scape
+ * @param[in] t the instance
+ * @param[in] x the address it would have
+ * @returns false if the scape isn't multi-valued and an instance at some other address already has the key
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeIndex
+ */
+bool _s_can_index(Scape *s,T *t,Xaddr x) {
+    T *k = _s_key(s,t);
+    if (!k || s->multi) return true;
+    scape_elem *e = __s_find_elem(s,k,_t_hash(s->sem,k),NULL);
+    return !e || (semeq(e->values[0].symbol,x.symbol) && e->values[0].addr == x.addr);
+}
+
+/**
+ * remove an instance from the scape
+ */
+void _s_unindex(Scape *s,T *t,Xaddr x) {
+    T *k = _s_key(s,t);
+    if (k) {
+        _s_remove(s,k,x);
+        if (s->order) __s_order_remove(s,k,x);
+    }
+}
+
+/**
+ * build the SCAPE_SPEC that defines a scape
+ *
+ * @param[in] parent the tree to add the spec to, or NULL
+ * @param[in] s the scape
+ * @returns the SCAPE_SPEC
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeOrdered
+ */
+T *_s_spec(T *parent,Scape *s) {
+    T *t = _t_newr(parent,SCAPE_SPEC);
+    _t_news(t,SCAPE_KEY_SOURCE,s->key_source);
+    _t_news(t,SCAPE_DATA_SOURCE,s->data_source);
+    _t_newi(t,SCAPE_MULTI,s->multi);
+    _t_newi(t,SCAPE_ORDERED,s->order != NULL);
+    if (s->key_path) _t_new(t,SCAPE_KEY_PATH,s->key_path,sizeof(int)*(_t_path_depth(s->key_path)+1));
+    return t;
+}
+
+/**
+ * create a new (empty) scape from its SCAPE_SPEC
+ *
+ * @param[in] spec the SCAPE_SPEC
+ * @returns a pointer to a newly allocated Scape
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/scape_spec.h testScapeOrdered
+ */
+Scape *_s_new_from_spec(T *spec) {
+    T *p = _t_child(spec,5);
+    return __s_new(*(Symbol *)_t_surface(_t_child(spec,1)),
+                   *(Symbol *)_t_surface(_t_child(spec,2)),
+                   p ? (int *)_t_surface(p) : NULL,
+                   *(int *)_t_surface(_t_child(spec,3)),
+                   *(int *)_t_surface(_t_child(spec,4)));
+}
+
 /** @}*/
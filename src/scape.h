@@ -16,9 +16,26 @@
 #include "tree.h"
 
 Scape *_s_new(Symbol key_source,Symbol data_source);
+Scape *__s_new(Symbol key_source,Symbol data_source,int *key_path,bool multi,bool ordered);
 void _s_free(Scape *s);
-void _s_add(Scape *s,TreeHash h,Xaddr x);
-Xaddr _s_get(Scape *s,TreeHash h);
+bool _s_add(Scape *s,T *key,Xaddr x);
+void _s_remove(Scape *s,T *key,Xaddr x);
+Xaddr _s_get(Scape *s,T *key);
+Xaddr *_s_get_all(Scape *s,T *key,int *count);
+T *_s_key(Scape *s,T *t);
+bool _s_index(Scape *s,T *t,Xaddr x);
+bool _s_can_index(Scape *s,T *t,Xaddr x);
+void _s_unindex(Scape *s,T *t,Xaddr x);
+int _s_cmp(SemTable *sem,T *a,T *b);
+ScapeNode *_s_seek(Scape *s,T *key);
+void __s_order_add(Scape *s,T *key,Xaddr x);
+void __s_order_remove(Scape *s,T *key,Xaddr x);
+#define _s_range(s,from,to) __s_range(s,from,to,0)
+T *__s_range(Scape *s,T *from,T *to,bool is_run_node);
+#define _s_prefix(s,prefix) __s_prefix(s,prefix,0)
+T *__s_prefix(Scape *s,T *prefix,bool is_run_node);
+T *_s_spec(T *parent,Scape *s);
+Scape *_s_new_from_spec(T *spec);
 
 #endif
 /** @}*/
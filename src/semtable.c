@@ -5,6 +5,14 @@
  * @file semtable.c
  * @brief implementation of table for coordinating meaning across a vmhost
  *
+ * The semtable gets read from the vmhost thread while definitions get added by reductions,
+ * so readers never lock it.  Contexts live in segments that never move, and when a writer
+ * has to replace memory readers might be looking at (i.e. the child array of a definitions
+ * tree that grows) the new memory gets published atomically and the old gets retired.
+ * Retired memory is freed once every registered reader thread has passed through a
+ * quiescent state, i.e. a point where it holds on to nothing from the semtable, since it
+ * was retired.  Writers are serialized by the semtable's mutex.
+ *
  * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
  */
 
@@ -14,34 +22,296 @@
 SemTable *_sem_new() {
     SemTable * sem= malloc(sizeof(SemTable));
     memset(sem,0,sizeof(SemTable));
+    pthread_mutexattr_t a;
+    pthread_mutexattr_init(&a);
+    // writers call each other, i.e. defining a symbol updates the label tables
+    pthread_mutexattr_settype(&a,PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sem->mutex,&a);
+    pthread_mutexattr_destroy(&a);
+    return sem;
 }
 
+/**
+ * add a context to the semtable
+ *
+ * @param[in] sem the semantic table
+ * @param[in] definitions the context's definitions tree
+ * @returns the new context
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/semtable_spec.h testSemTableCreate
+ */
 int _sem_new_context(SemTable *sem,T *definitions) {
-
-    if (sem->contexts >= MAX_CONTEXTS-1) raise_error("no more room in semtable");
-    int idx = sem->contexts++;
-    //    sem->stores[idx].table = NULL;
-    sem->stores[idx].definitions = definitions;
+    _sem_lock(sem);
+    int idx = sem->contexts;
+    unsigned int n = idx/SEM_FIRST_SEGMENT+1;
+    int k = 31-__builtin_clz(n);
+    if (k >= SEM_SEGMENTS) raise_error("no more room in semtable");
+    if (!sem->segments[k]) {
+        size_t size = sizeof(ContextStore)*(SEM_FIRST_SEGMENT<<k);
+        ContextStore *seg = malloc(size);
+        memset(seg,0,size);
+        __atomic_store_n(&sem->segments[k],seg,__ATOMIC_RELEASE);
+    }
+    ContextStore *ctx = __sem_context(sem,idx);
+    memset(ctx,0,sizeof(ContextStore));
+    ctx->definitions = definitions;
+    __atomic_store_n(&sem->contexts,idx+1,__ATOMIC_RELEASE);
+    _sem_changed(sem);
+    _sem_unlock(sem);
     return idx;
 }
 
+/**
+ * get where each context's definitions are in the definitions tree of the root context
+ *
+ * together with that tree this is all that's needed to restore the semtable (see
+ * _sem_restore_contexts)
+ *
+ * @param[in] sem the semantic table
+ * @returns RECEPTOR_PATHS tree with a RECEPTOR_PATH for each context
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/def_spec.h testDefImage
+ */
+T *_sem_context_paths(SemTable *sem) {
+    T *paths = _t_new_root(RECEPTOR_PATHS);
+    int i;
+    for (i=0;i<sem->contexts;i++) {
+        int *p = _t_get_path(__sem_context(sem,i)->definitions);
+        if (p) {
+            _t_new(paths,RECEPTOR_PATH,p,sizeof(int)*(_t_path_depth(p)+1));
+            free(p);
+        }
+        else
+            _t_newr(paths,STRUCTURE_ANYTHING); // should be something like DELETED_CONTEXT
+    }
+    return paths;
+}
+
+/**
+ * restore the contexts of an empty semtable from a definitions tree
+ *
+ * @param[in] sem the semantic table
+ * @param[in] t the definitions tree of the root context, which the semtable takes over
+ * @param[in] paths where each context's definitions are in t, from _sem_context_paths
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/def_spec.h testDefImage
+ */
+void _sem_restore_contexts(SemTable *sem,T *t,T *paths) {
+    int i;
+    int c = _t_children(paths);
+    for(i=0;i<c;i++) _sem_new_context(sem,i ? NULL : t);
+    for(i=1;i<=c;i++) {
+        T *p = _t_child(paths,i);
+        if (semeq(RECEPTOR_PATH,_t_symbol(p))) {
+            T *x = _t_get(t,(int *)_t_surface(p));
+            __sem_context(sem,i-1)->definitions = x;
+            // the context number stashed in the receptor definition (see __d_define_receptor)
+            // isn't part of the tree so it has to be put back
+            (*(int *)_t_surface(_t_parent(x))) = i-1;
+        }
+    }
+}
+
+// throw away a cached process signature descriptor once no reader can be using it (with the semtable locked)
+void __sem_retire_sigdesc(SemTable *sem,SigDesc *d) {
+    if (!d) return;
+    __sem_retire(sem,d->slots);
+    __sem_retire(sem,d->template_hashes);
+    __sem_retire(sem,d);
+}
+
+// throw away the cached process signature descriptors of a context (with the semtable locked)
+void __sem_free_sigs(SemTable *sem,Context c) {
+    ContextStore *ctx = __sem_context(sem,c);
+    int i,n = ctx->sig_slots;
+    __atomic_store_n(&ctx->sig_slots,0,__ATOMIC_RELEASE);
+    for(i=0;i<n;i++) __sem_retire_sigdesc(sem,ctx->sigs[i]);
+    __sem_retire(sem,ctx->sigs);
+    __atomic_store_n(&ctx->sigs,NULL,__ATOMIC_RELEASE);
+}
+
+// free the transcoder registry entries, either all of them when the semtable goes, or just
+// the ones involving a context, which a reader may have just found (with the semtable locked)
+void __sem_free_transcoders(SemTable *sem,int c) {
+    Transcoder *cur,*tmp;
+    HASH_ITER(hh, sem->transcoders, cur, tmp) {
+        if (c < 0 || cur->key.src.context == c || cur->key.to.context == c ||
+            (!cur->fn && cur->process.context == c)) {
+            HASH_DEL(sem->transcoders,cur);
+            if (c < 0) free(cur);
+            else __sem_retire(sem,cur);
+        }
+    }
+}
+
 void _sem_free(SemTable *sem) {
+    int i;
+    for(i=0;i<sem->contexts;i++) {
+        __sem_free_labels(sem,i);
+        __sem_free_symbols(sem,i);
+        __sem_free_sigs(sem,i);
+    }
+    // nobody can be reading any more
+    SemRetired *r;
+    while ((r = sem->retired)) {
+        sem->retired = r->next;
+        free(r->p);
+        free(r);
+    }
+    for(i=0;i<SEM_SEGMENTS;i++) free(sem->segments[i]);
+    pthread_mutex_destroy(&sem->mutex);
+    GlobalLabel *g,*tmp;
+    HASH_ITER(hh, sem->labels, g, tmp) {
+        HASH_DEL(sem->labels,g);
+        free(g->contexts);
+        free(g->label);
+        free(g);
+    }
+    __sem_free_transcoders(sem,-1);
     free(sem);
 }
 
+/**
+ * get the store of a context
+ *
+ * the store stays where it is for the life of the semtable, so it's safe to hold on to
+ */
 ContextStore *__sem_context(SemTable *sem,Context c) {
-    return &sem->stores[c];
+    unsigned int n = c/SEM_FIRST_SEGMENT+1;
+    int k = 31-__builtin_clz(n);
+    ContextStore *seg = k < SEM_SEGMENTS ? __atomic_load_n(&sem->segments[k],__ATOMIC_ACQUIRE) : NULL;
+    if (!seg) raise_error("context %d not in semtable",c);
+    return &seg[c-SEM_FIRST_SEGMENT*((1<<k)-1)];
 }
 
 void _sem_free_context(SemTable *sem,Context c) {
+    _sem_lock(sem);
     ContextStore *ctx = __sem_context(sem,c);
     // definition tree belong to the receptors that allocated them so
     // we never free them.
     ctx->definitions = NULL;
-    //if (ctx->table) lableTableFree(ctx->table);
+    __sem_free_labels(sem,c);
+    __sem_free_symbols(sem,c);
+    __sem_free_sigs(sem,c);
+    // the context's semantic ids may get reused so anything cached about them is stale
+    _sem_changed(sem);
+    __sem_free_transcoders(sem,c);
 
     if ((c+1) == sem->contexts)
-        sem->contexts--;
+        __atomic_store_n(&sem->contexts,c,__ATOMIC_RELEASE);
+    _sem_unlock(sem);
+}
+
+/*****************  concurrent readers */
+
+/**
+ * register the calling thread as a reader of the semtable
+ *
+ * memory retired by writers isn't freed until all the registered readers have called
+ * _sem_quiescent since it was retired.  Threads that read the semtable while others write
+ * to it have to register, and must not hold on to definitions across quiescent states.
+ *
+ * @param[in] sem the semantic table
+ * @param[in] r the reader's state, which the thread owns
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/semtable_spec.h testSemConcurrentReaders
+ */
+void _sem_reader_online(SemTable *sem,SemReader *r) {
+    _sem_lock(sem);
+    r->seen = __atomic_load_n(&sem->epoch,__ATOMIC_ACQUIRE);
+    r->next = sem->readers;
+    sem->readers = r;
+    _sem_unlock(sem);
+}
+
+/**
+ * unregister a reader of the semtable
+ */
+void _sem_reader_offline(SemTable *sem,SemReader *r) {
+    _sem_lock(sem);
+    SemReader **rp;
+    for(rp=&sem->readers;*rp && *rp != r;rp=&(*rp)->next);
+    if (*rp) *rp = r->next;
+    __sem_reclaim(sem);
+    _sem_unlock(sem);
+}
+
+/**
+ * tell the semtable that a reader isn't holding on to anything from it
+ *
+ * never blocks, if a writer is busy the retired memory just gets freed later
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/semtable_spec.h testSemConcurrentReaders
+ */
+void _sem_quiescent(SemTable *sem,SemReader *r) {
+    __atomic_store_n(&r->seen,__atomic_load_n(&sem->epoch,__ATOMIC_ACQUIRE),__ATOMIC_RELEASE);
+    if (__atomic_load_n(&sem->retired,__ATOMIC_RELAXED) && !pthread_mutex_trylock(&sem->mutex)) {
+        __sem_reclaim(sem);
+        _sem_unlock(sem);
+    }
+}
+
+// hand memory readers may still be looking at over to be freed later (with the semtable locked)
+void __sem_retire(SemTable *sem,void *p) {
+    if (!p) return;
+    SemRetired *r = malloc(sizeof(SemRetired));
+    r->p = p;
+    r->epoch = __atomic_add_fetch(&sem->epoch,1,__ATOMIC_ACQ_REL);
+    r->next = sem->retired;
+    sem->retired = r;
+    __sem_reclaim(sem);
+}
+
+// free the retired memory all the readers have been quiescent since (with the semtable locked)
+void __sem_reclaim(SemTable *sem) {
+    uint64_t min = UINT64_MAX;
+    SemReader *rd;
+    for(rd=sem->readers;rd;rd=rd->next) {
+        uint64_t seen = __atomic_load_n(&rd->seen,__ATOMIC_ACQUIRE);
+        if (seen < min) min = seen;
+    }
+    SemRetired **rp = &sem->retired,*r;
+    while ((r = *rp)) {
+        if (r->epoch <= min) {
+            *rp = r->next;
+            free(r->p);
+            free(r);
+        }
+        else rp = &r->next;
+    }
+}
+
+/**
+ * add a child to a node of the semtable (i.e. a definition to a definitions tree) without
+ * getting in the way of readers
+ *
+ * when the node's child array has to grow it gets copied rather than realloced, and the old
+ * one is retired.  The child is in place before the count that makes it visible goes up.
+ *
+ * @param[in] sem the semantic table
+ * @param[in] t the node to add to
+ * @param[in] c the child, which must be a root
+ */
+void __sem_add_child(SemTable *sem,T *t,T *c) {
+    root_check(c);
+    _sem_lock(sem);
+    int n = t->structure.child_count;
+    if (_t_children_full(n)) {
+        T **children = malloc(sizeof(T *)*_t_children_grow(n));
+        if (n) memcpy(children,t->structure.children,sizeof(T *)*n);
+        T **old = n ? t->structure.children : NULL;
+        __atomic_store_n(&t->structure.children,children,__ATOMIC_RELEASE);
+        __sem_retire(sem,old);
+    }
+    c->structure.parent = t;
+    t->structure.children[n] = c;
+    __atomic_store_n(&t->structure.child_count,n+1,__ATOMIC_RELEASE);
+    _sem_unlock(sem);
 }
 
 char G_ctx_buf[20];
@@ -148,41 +418,291 @@ T * _sem_get_label(SemTable *sem,SemanticID s,Symbol label_type) {
 void _sem_add_label(SemTable *sem,SemanticID s,Symbol label_type,char *label) {
     T *def = _sem_get_def(sem,s);
     T *labels  = _t_child(def,DefLabelIdx);
-    _t_new_str(labels,label_type,label);
+    _sem_lock(sem);
+    __sem_add_child(sem,labels,_t_new_str(0,label_type,label));
+    // definitions are only looked up by their first label
+    if (_t_children(labels) == 1) __sem_index_label(sem,s.context,s.semtype,s.id,label);
+    _sem_unlock(sem);
+}
+
+/*****************  symbol cache */
+
+// throw away the cached symbol info of a context
+void __sem_free_symbols(SemTable *sem,Context c) {
+    ContextStore *ctx = __sem_context(sem,c);
+    __atomic_store_n(&ctx->symbol_slots,0,__ATOMIC_RELEASE);
+    __sem_retire(sem,ctx->symbols);
+    ctx->symbols = NULL;
+    ctx->symbols_defs = NULL;
+}
+
+/**
+ * work out what there is to know about a symbol from its definition and cache it
+ *
+ * symbols only get cached once they have a structure, because symbols declared with
+ * NULL_STRUCTURE get their real structure set later.  The structure of a symbol can't
+ * change after that, and neither can its size because structures can only be defined once.
+ *
+ * @param[in] sem the semantic table
+ * @param[in] s the symbol
+ * @returns the symbol's cache entry or NULL if it can't be cached yet
+ */
+SymbolInfo *__sem_cache_symbol(SemTable *sem,Symbol s) {
+    ContextStore *ctx = __sem_context(sem,s.context);
+    T *symbols = _sem_get_defs(sem,s);
+    Structure st = __d_get_symbol_structure(symbols,s);
+    if (semeq(st,NULL_STRUCTURE)) return NULL;
+    _sem_lock(sem);
+    if (ctx->symbols_defs != ctx->definitions) __sem_free_symbols(sem,s.context);
+    ctx->symbols_defs = ctx->definitions;
+    // make room for all the symbols in the context so that caching the symbols of the
+    // structure's parts, which happens while working out this one, doesn't move the cache
+    int i,n = _t_children(symbols);
+    if (n >= ctx->symbol_slots) {
+        int slots = ctx->symbol_slots ? ctx->symbol_slots : 64;
+        while (slots <= n) slots *= 2;
+        SymbolInfo *si = malloc(slots*sizeof(SymbolInfo));
+        if (ctx->symbol_slots) memcpy(si,ctx->symbols,ctx->symbol_slots*sizeof(SymbolInfo));
+        for(i=ctx->symbol_slots;i<slots;i++) si[i].size = SYMBOL_SIZE_UNKNOWN;
+        // readers check the number of slots before looking in the array, so the bigger
+        // array goes in first
+        SymbolInfo *old = ctx->symbols;
+        __atomic_store_n(&ctx->symbols,si,__ATOMIC_RELEASE);
+        __atomic_store_n(&ctx->symbol_slots,slots,__ATOMIC_RELEASE);
+        __sem_retire(sem,old);
+    }
+    SymbolInfo *si = &ctx->symbols[s.id];
+    if (si->size == SYMBOL_SIZE_UNKNOWN) {
+        int size = __d_get_fixed_size(sem,st);
+        si->structure = st;
+        // the size going in is what makes the entry valid for readers
+        __atomic_store_n(&si->size,size,__ATOMIC_RELEASE);
+    }
+    _sem_unlock(sem);
+    return si;
 }
 
+// the cache entry of a symbol, or NULL if it's not cached
+SymbolInfo *__sem_cached_symbol(ContextStore *ctx,Symbol s) {
+    if (s.id >= __atomic_load_n(&ctx->symbol_slots,__ATOMIC_ACQUIRE) || ctx->symbols_defs != ctx->definitions) return NULL;
+    SymbolInfo *si = &__atomic_load_n(&ctx->symbols,__ATOMIC_ACQUIRE)[s.id];
+    return __atomic_load_n(&si->size,__ATOMIC_ACQUIRE) == SYMBOL_SIZE_UNKNOWN ? NULL : si;
+}
+
+/**
+ * get the structure of a symbol
+ *
+ * @param[in] sem the semantic table
+ * @param[in] s the symbol
+ * @returns the symbol's Structure
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/semtable_spec.h testSemGetSymbolStructure
+ */
 Structure _sem_get_symbol_structure(SemTable *sem,Symbol s){
     if (!is_symbol(s)) raise_error("Bad symbol: semantic type not SEM_TYPE_SYMBOL");
-    return __d_get_symbol_structure(_sem_get_defs(sem,s),s);
+    ContextStore *ctx = __sem_context(sem,s.context);
+    SymbolInfo *si = __sem_cached_symbol(ctx,s);
+    if (si) return si->structure;
+    si = __sem_cache_symbol(sem,s);
+    return si ? si->structure : __d_get_symbol_structure(_sem_get_defs(sem,s),s);
+}
+
+/**
+ * get the size of a symbol's surface, if it's the same for all instances of the symbol
+ *
+ * @param[in] sem the semantic table
+ * @param[in] s the symbol
+ * @returns the size or SYMBOL_SIZE_VARIABLE if it has to be worked out from the surface
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/semtable_spec.h testSemGetSymbolStructure
+ */
+int _sem_get_symbol_size(SemTable *sem,Symbol s) {
+    if (!is_symbol(s)) raise_error("Bad symbol: semantic type not SEM_TYPE_SYMBOL");
+    ContextStore *ctx = __sem_context(sem,s.context);
+    SymbolInfo *si = __sem_cached_symbol(ctx,s);
+    if (si) return si->size;
+    si = __sem_cache_symbol(sem,s);
+    return si ? si->size : SYMBOL_SIZE_VARIABLE;
 }
 
-// @todo, convert this to hash table label table!!
-bool __sem_get_by_label(SemTable *sem,char *label,SemanticID *sid,Context c) {
+/*****************  label tables */
+
+// add a context to the list of contexts that define a label
+void __sem_global_add(SemTable *sem,char *label,Context c) {
+    GlobalLabel *g;
+    HASH_FIND_STR(sem->labels,label,g);
+    if (!g) {
+        g = malloc(sizeof(GlobalLabel));
+        memset(g,0,sizeof(GlobalLabel));
+        g->label = strdup(label);
+        HASH_ADD_KEYPTR(hh,sem->labels,g->label,strlen(g->label),g);
+    }
+    int i;
+    for(i=0;i<g->count && g->contexts[i] < c;i++);
+    if (i < g->count && g->contexts[i] == c) return;
+    if (g->count == g->size) {
+        g->size = g->size ? g->size*2 : 2;
+        g->contexts = realloc(g->contexts,g->size*sizeof(Context));
+    }
+    memmove(&g->contexts[i+1],&g->contexts[i],(g->count-i)*sizeof(Context));
+    g->contexts[i] = c;
+    g->count++;
+}
+
+// remove a context from the list of contexts that define a label
+void __sem_global_remove(SemTable *sem,char *label,Context c) {
+    GlobalLabel *g;
+    HASH_FIND_STR(sem->labels,label,g);
+    if (!g) return;
+    int i;
+    for(i=0;i<g->count && g->contexts[i] != c;i++);
+    if (i == g->count) return;
+    memmove(&g->contexts[i],&g->contexts[i+1],(g->count-i-1)*sizeof(Context));
+    if (!--g->count) {
+        HASH_DEL(sem->labels,g);
+        free(g->contexts);
+        free(g->label);
+        free(g);
+    }
+}
+
+/**
+ * add a definition to its context's label table
+ *
+ * @param[in] sem the semantic table
+ * @param[in] c the context of the definition
+ * @param[in] semtype the semantic type of the definition
+ * @param[in] id the address of the definition
+ * @param[in] label the definition's first label
+ */
+void __sem_index_label(SemTable *sem,Context c,SemanticType semtype,SemanticAddr id,char *label) {
+    if (semtype > MAX_SEM_TYPE) return;
+    ContextStore *ctx = __sem_context(sem,c);
+    LabelEntry *e;
+    HASH_FIND_STR(ctx->labels,label,e);
+    if (!e) {
+        e = malloc(sizeof(LabelEntry));
+        memset(e,0,sizeof(LabelEntry));
+        e->label = strdup(label);
+        HASH_ADD_KEYPTR(hh,ctx->labels,e->label,strlen(e->label),e);
+        __sem_global_add(sem,e->label,c);
+    }
+    // a linear search would find the lowest id first
+    if (!e->ids[semtype] || id < e->ids[semtype]) e->ids[semtype] = id;
+}
+
+// throw away the label table of a context
+void __sem_free_labels(SemTable *sem,Context c) {
+    ContextStore *ctx = __sem_context(sem,c);
+    LabelEntry *e,*tmp;
+    HASH_ITER(hh, ctx->labels, e, tmp) {
+        HASH_DEL(ctx->labels,e);
+        __sem_global_remove(sem,e->label,c);
+        free(e->label);
+        free(e);
+    }
+    memset(ctx->indexed,0,sizeof(ctx->indexed));
+    ctx->indexed_defs = NULL;
+}
+
+/**
+ * bring a context's label table up to date with its definitions
+ *
+ * definitions can get added straight to the definitions tree (i.e. when bootstrapping or
+ * unserializing) so whatever got appended to each semtype since the last time gets added
+ * here, and the table gets rebuilt if the definitions tree was replaced.
+ *
+ * @param[in] sem the semantic table
+ * @param[in] c the context
+ */
+void __sem_index_labels(SemTable *sem,Context c) {
     ContextStore *ctx = __sem_context(sem,c);
     T *d = ctx->definitions;
-    if (!d) raise_error("no definitions in context %s",_sem_ctx2s(sem,c));
-    int i,j;
-    for(i=1;i<=_t_children(d);i++) {
+    if (ctx->indexed_defs != d) __sem_free_labels(sem,c);
+    if (!d) return;
+    ctx->indexed_defs = d;
+    int i,j,n = _t_children(d);
+    if (n > MAX_SEM_TYPE) n = MAX_SEM_TYPE;
+    for(i=1;i<=n;i++) {
         T *defs = _t_child(d,i);
-        for(j=1;j<=_t_children(defs);j++) {
-            T *def = _t_child(defs,j);
-            if (strcmp(label,(char *)_t_surface(_t_child(_t_child(def,DefLabelIdx),1)))==0) {
-                sid->semtype = i;
-                sid->id = j;
-                sid->context = c;
-                return true;
-            }
+        int k = _t_children(defs);
+        if (k < ctx->indexed[i]) {
+            // definitions got removed so start over
+            __sem_free_labels(sem,c);
+            __sem_index_labels(sem,c);
+            return;
+        }
+        for(j=ctx->indexed[i]+1;j<=k;j++) {
+            T *labels = _t_child(_t_child(defs,j),DefLabelIdx);
+            T *l = labels ? _t_child(labels,1) : NULL;
+            if (l) __sem_index_label(sem,c,i,j,(char *)_t_surface(l));
+        }
+        ctx->indexed[i] = k;
+    }
+}
+
+/**
+ * find a definition by its label in a context
+ *
+ * @param[in] sem the semantic table
+ * @param[in] label the label to look for, which is matched against the first label of definitions
+ * @param[out] sid the semantic id of the definition found
+ * @param[in] c the context to look in
+ * @param[in] semtype only look for definitions of this semtype, or 0 for any
+ * @returns true if found
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/semtable_spec.h testSemGetByLabel
+ */
+bool __sem_get_by_label_of_type(SemTable *sem,char *label,SemanticID *sid,Context c,SemanticType semtype) {
+    ContextStore *ctx = __sem_context(sem,c);
+    if (!ctx->definitions) raise_error("no definitions in context %s",_sem_ctx2s(sem,c));
+    bool found = false;
+    _sem_lock(sem);
+    __sem_index_labels(sem,c);
+    LabelEntry *e;
+    HASH_FIND_STR(ctx->labels,label,e);
+    int i;
+    for(i=1;e && !found && i<=MAX_SEM_TYPE;i++) {
+        if ((!semtype || semtype == i) && e->ids[i]) {
+            sid->semtype = i;
+            sid->id = e->ids[i];
+            sid->context = c;
+            found = true;
         }
     }
-    return false;
+    _sem_unlock(sem);
+    return found;
 }
 
-bool _sem_get_by_label(SemTable *sem,char *label,SemanticID *sid) {
+/**
+ * find a definition by its label in any context
+ *
+ * contexts are searched in order, i.e. the sys context first
+ *
+ * @param[in] sem the semantic table
+ * @param[in] label the label to look for, which is matched against the first label of definitions
+ * @param[out] sid the semantic id of the definition found
+ * @param[in] semtype only look for definitions of this semtype, or 0 for any
+ * @returns true if found
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/semtable_spec.h testSemGetByLabel
+ */
+bool _sem_get_by_label_of_type(SemTable *sem,char *label,SemanticID *sid,SemanticType semtype) {
     int i;
     if (!strcmp(label,"NULL_SYMBOL")) {*sid = NULL_SYMBOL; return true;}
-    for(i=0;i<sem->contexts;i++)
-        if (__sem_get_by_label(sem,label,sid,i)) return true;
-    return false;
+    bool found = false;
+    _sem_lock(sem);
+    for(i=0;i<sem->contexts;i++) __sem_index_labels(sem,i);
+    GlobalLabel *g;
+    HASH_FIND_STR(sem->labels,label,g);
+    for(i=0;g && !found && i<g->count;i++)
+        found = __sem_get_by_label_of_type(sem,label,sid,g->contexts[i],semtype);
+    _sem_unlock(sem);
+    return found;
 }
 
 /** @}*/
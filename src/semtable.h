@@ -14,10 +14,26 @@
 
 SemTable *_sem_new();
 int _sem_new_context(SemTable *sem,T *definitions);
+T *_sem_context_paths(SemTable *sem);
+void _sem_restore_contexts(SemTable *sem,T *t,T *paths);
 void _sem_free(SemTable *sem);
+void __sem_retire_sigdesc(SemTable *sem,struct SigDesc *d);
+void __sem_free_sigs(SemTable *sem,Context c);
+void __sem_free_transcoders(SemTable *sem,int c);
+/// mark that definitions have changed, invalidating anything cached about them
+#define _sem_changed(sem) __atomic_add_fetch(&(sem)->generation,1,__ATOMIC_RELEASE)
+/// serialize writers to the semtable (the lock is recursive)
+#define _sem_lock(sem) pthread_mutex_lock(&(sem)->mutex)
+#define _sem_unlock(sem) pthread_mutex_unlock(&(sem)->mutex)
 #define _sem_context(sem,s) __sem_context(sem,(s).context)
 ContextStore *__sem_context(SemTable *sem,Context c);
 void _sem_free_context(SemTable *sem,Context c);
+void _sem_reader_online(SemTable *sem,SemReader *r);
+void _sem_reader_offline(SemTable *sem,SemReader *r);
+void _sem_quiescent(SemTable *sem,SemReader *r);
+void __sem_retire(SemTable *sem,void *p);
+void __sem_reclaim(SemTable *sem);
+void __sem_add_child(SemTable *sem,T *t,T *c);
 #define _sem_get_defs(sem,s) __sem_get_defs(sem,(s).semtype,(s).context)
 T *__sem_get_defs(SemTable *st,SemanticType semtype,Context c);
 #define _sem_get_def(sem,s) __sem_get_def(sem,(s).semtype,(s).context,(s).id)
@@ -25,8 +41,16 @@ T *__sem_get_def(SemTable *sem,SemanticType semtype,Context c,SemanticAddr i);
 char *_sem_get_name(SemTable *sem,SemanticID s);
 T * _sem_get_label(SemTable *sem,SemanticID s,Symbol label_type);
 void _sem_add_label(SemTable *sem,SemanticID s,Symbol label_type,char *label);
+void __sem_free_symbols(SemTable *sem,Context c);
+SymbolInfo *__sem_cache_symbol(SemTable *sem,Symbol s);
 Structure _sem_get_symbol_structure(SemTable *sem,Symbol s);
-bool __sem_get_by_label(SemTable *sem,char *label,SemanticID *s,Context ctx);
-bool _sem_get_by_label(SemTable *sem,char *label,SemanticID *s);
+int _sem_get_symbol_size(SemTable *sem,Symbol s);
+void __sem_index_label(SemTable *sem,Context c,SemanticType semtype,SemanticAddr id,char *label);
+void __sem_index_labels(SemTable *sem,Context c);
+void __sem_free_labels(SemTable *sem,Context c);
+bool __sem_get_by_label_of_type(SemTable *sem,char *label,SemanticID *s,Context ctx,SemanticType semtype);
+#define __sem_get_by_label(sem,label,s,ctx) __sem_get_by_label_of_type(sem,label,s,ctx,0)
+bool _sem_get_by_label_of_type(SemTable *sem,char *label,SemanticID *s,SemanticType semtype);
+#define _sem_get_by_label(sem,label,s) _sem_get_by_label_of_type(sem,label,s,0)
 
 #endif
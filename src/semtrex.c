@@ -1099,23 +1099,10 @@ void _stxl(T *stxx) {
     _stxcs(stxx,"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._");
 }
 
-// temporary function until we get system label table operational
+// resolve a symbol name using the semtable's label index
 Symbol get_symbol(char *symbol_name,SemTable *sem) {
-    int ctx;
-    for (ctx=0;ctx<sem->contexts;ctx++) {
-        ContextStore *cs = __sem_context(sem,ctx);
-        if (!cs->definitions) continue;
-        T *symbols = __sem_get_defs(sem,SEM_TYPE_SYMBOL,ctx);
-        int i,c = _t_children(symbols);
-        for(i=1;i<=c;i++) {
-            T *t = _t_child(symbols,i);
-            T *c = _t_child(_t_child(t,DefLabelIdx),1);
-            if (!strcmp(symbol_name,(char *)_t_surface(c))) {
-                Symbol r = {ctx,SEM_TYPE_SYMBOL,i};
-                return r;
-            }
-        }
-    }
+    Symbol r;
+    if (_sem_get_by_label_of_type(sem,symbol_name,&r,SEM_TYPE_SYMBOL)) return r;
     return NULL_SYMBOL;
 }
 
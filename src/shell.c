@@ -128,6 +128,10 @@ void makeShell(VMHost *v,FILE *input, FILE *output,Receptor **irp,Receptor **orp
     code = _t_newi(0,MAGIC,MagicDebug);
     addCommand(r,o_r->addr,"debug","toggle debug mode",code,NULL);
 
+    // (expect (on flux SHELL_COMMAND:trace) action (send std_out (convert_to_lines (magic trace)))
+    code = _t_newi(0,MAGIC,MagicTrace);
+    addCommand(r,o_r->addr,"trace","start tracing reductions, then write the trace to " TRACE_FILE,code,NULL);
+
 }
 
 /** @}*/
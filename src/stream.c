@@ -21,6 +21,8 @@
 #include <signal.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <strings.h>
+#include <ctype.h>
 
 
 #include "process.h"
@@ -123,7 +125,13 @@ size_t __st_socket_stream_load(Stream *st) {
  * @todo allow other delimiters, or even simply a length, to mark off a unit.
  */
 void __st_scan(Stream *st) {
-    int delim_len = st->delim_len;
+    // http units aren't followed by a delimiter
+    int delim_len = (st->flags & StreamUnitHTTP) ? 0 : st->delim_len;
+    // nothing after a unit that couldn't be framed can be framed either
+    if (st->flags & StreamUnitBad) {
+        st->scan_state = StreamScanComplete;
+        return;
+    }
     // if this is the initial scan, then setup the unit_start to 0
     if (st->scan_state == StreamScanInitial)
         st->unit_start = 0;
@@ -137,6 +145,11 @@ void __st_scan(Stream *st) {
         return;
     }
 
+    if (st->flags & StreamUnitHTTP) {
+        __st_scan_http(st);
+        return;
+    }
+
     // set the current read offset taking into account previous partial scans
     size_t i=  (st->scan_state == StreamScanPartial) ? st->partial : st->unit_start;
 
@@ -155,6 +168,165 @@ void __st_scan(Stream *st) {
 }
 
 
+// find the next newline in the stream buffer at or after i, returns false if it hasn't been loaded yet
+bool __st_find_lf(Stream *st,size_t i,size_t *lf) {
+    char *c = memchr(&st->buf[i],'\n',st->bytes_used-i);
+    if (!c) return false;
+    *lf = c - st->buf;
+    return true;
+}
+
+// parse a body or chunk size that must be all digits in the given base (up to optional
+// trailing whitespace) and no larger than HTTP_MAX_BODY_SIZE, returns false if it isn't
+bool __st_http_size(char *v,char *eol,int base,size_t *size) {
+    while (v < eol && (*v == ' ' || *v == '\t')) v++;
+    if (v == eol || !(base == 16 ? isxdigit(*v) : isdigit(*v))) return false;
+    char *end;
+    errno = 0;
+    unsigned long long n = strtoull(v,&end,base);
+    if (errno == ERANGE || n > HTTP_MAX_BODY_SIZE) return false;
+    // chunk sizes may be followed by extensions
+    if (base == 16 && end < eol && *end == ';') end = eol;
+    while (end < eol && (*end == ' ' || *end == '\t' || *end == '\r')) end++;
+    if (end != eol) return false;
+    *size = n;
+    return true;
+}
+
+// set the unit_body_size from the Content-Length or Transfer-Encoding headers of a scanned request,
+// returns false if the Content-Length is invalid or too large
+bool __st_http_body_size(Stream *st) {
+    char *h = &st->buf[st->unit_start];
+    char *e = h + st->unit_header_size;
+    st->unit_body_size = 0;
+    while (h < e) {
+        char *eol = memchr(h,'\n',e-h);
+        if (!eol) break;
+        if (!strncasecmp(h,"content-length:",15)) {
+            if (!__st_http_size(h+15,eol,10,&st->unit_body_size)) return false;
+        }
+        else if (!strncasecmp(h,"transfer-encoding:",18)) {
+            char *v;
+            for(v=h+18;v+7<=eol;v++) {
+                if (!strncasecmp(v,"chunked",7)) {
+                    st->unit_body_size = StreamChunked;
+                    break;
+                }
+            }
+        }
+        h = eol+1;
+    }
+    return true;
+}
+
+// give up on the request being scanned because its body can't be framed, so the headers
+// are the unit, and because nothing after them can be framed either the stream is done.
+void __st_http_bad(Stream *st) {
+    debug(D_STREAM,"unable to frame HTTP request body\n");
+    st->unit_size = st->unit_header_size;
+    st->flags |= StreamUnitBad;
+    st->scan_state = StreamScanSuccess;
+}
+
+/**
+ * scan a stream's buffer for a complete HTTP request
+ *
+ * a unit is the request line and headers up to the blank line, plus the body as
+ * given by the Content-Length header or the chunked transfer encoding.  Scanning
+ * is incremental, i.e. on a partial scan st->partial records how far we got so the
+ * bytes aren't rescanned when more data is loaded.  Pipelined requests are simply
+ * the next unit in the buffer.  If the body size is invalid or larger than
+ * HTTP_MAX_BODY_SIZE the unit is flagged StreamUnitBad and the stream ends with it.
+ */
+void __st_scan_http(Stream *st) {
+    char *buf = st->buf;
+    size_t i,lf,end = st->bytes_used;
+
+    if (st->scan_state != StreamScanPartial) {
+        // skip any blank lines left between requests
+        while (st->unit_start < end && (buf[st->unit_start] == '\r' || buf[st->unit_start] == '\n'))
+            st->unit_start++;
+        if (st->unit_start >= end) {
+            st->scan_state = StreamScanComplete;
+            return;
+        }
+        st->unit_header_size = 0;
+        i = st->unit_start;
+    }
+    else i = st->partial;
+
+    if (!st->unit_header_size) {
+        // look for the blank line that ends the headers
+        while (__st_find_lf(st,i,&lf)) {
+            size_t j = lf+1;
+            if (j < end && buf[j] == '\r') j++;
+            if (j >= end) break;
+            if (buf[j] == '\n') {
+                st->unit_header_size = j+1-st->unit_start;
+                break;
+            }
+            i = lf+1;
+        }
+        if (!st->unit_header_size) {
+            st->partial = i;
+            st->scan_state = StreamScanPartial;
+            return;
+        }
+        if (!__st_http_body_size(st)) {
+            __st_http_bad(st);
+            return;
+        }
+        i = st->unit_start+st->unit_header_size;
+    }
+
+    if (st->unit_body_size != StreamChunked) {
+        size_t size = st->unit_header_size + st->unit_body_size;
+        if (st->unit_start + size <= end) {
+            st->unit_size = size;
+            st->scan_state = StreamScanSuccess;
+            return;
+        }
+    }
+    else {
+        // walk the chunks, i is always at the start of a chunk size line
+        while (__st_find_lf(st,i,&lf)) {
+            size_t n;
+            if (!__st_http_size(&buf[i],&buf[lf],16,&n) || lf+1+n-(st->unit_start+st->unit_header_size) > HTTP_MAX_BODY_SIZE) {
+                __st_http_bad(st);
+                return;
+            }
+            if (n == 0) {
+                // the last chunk is followed by optional trailers and a blank line
+                size_t k = lf+1;
+                while (k < end && __st_find_lf(st,k,&lf)) {
+                    if (lf == k || (lf == k+1 && buf[k] == '\r')) {
+                        st->unit_size = lf+1-st->unit_start;
+                        st->scan_state = StreamScanSuccess;
+                        return;
+                    }
+                    k = lf+1;
+                }
+                break;
+            }
+            // skip the chunk data and the line ending that follows it
+            if (lf+1+n >= end || !__st_find_lf(st,lf+1+n,&lf)) break;
+            i = lf+1;
+        }
+    }
+    st->partial = i;
+    st->scan_state = StreamScanPartial;
+}
+
+// move the partially scanned unit to the front of the buffer to make room for loading more data
+void __st_compact(Stream *st) {
+    size_t s = st->unit_start;
+    debug(D_STREAM,"compacting buffer by %ld\n",s);
+    memmove(st->buf,st->buf+s,st->bytes_used-s);
+    st->bytes_used -= s;
+    st->partial -= s;
+    st->unit_start = 0;
+}
+
 char *ss2str(int s) {
     switch(s) {
     case StreamScanSuccess:return "StreamScanSuccess";
@@ -186,6 +358,8 @@ void __st_stream_read(Stream *st) {
  init:
     __st_init_scan(st);
  load:
+    if (st->scan_state == StreamScanPartial && st->unit_start && __st_buf_full(st))
+        __st_compact(st);
     if (st->type == UnixStream) {
         l = __st_unix_stream_load(st);
     }
@@ -220,6 +394,11 @@ void __st_stream_read(Stream *st) {
         goto load;
     }
     else if (st->scan_state == StreamScanComplete) {
+        if (st->flags & StreamUnitBad) {
+            debug(D_STREAM,"stream ended by an unframeable unit\n");
+            st->flags &= ~StreamAlive;
+            return;
+        }
         debug(D_STREAM,"buffer fully read, reinitialzing buffer\n");
         st->bytes_used = 0;
         goto init;
@@ -358,6 +537,7 @@ void *__st_socket_stream_accept(void *arg) {
         Stream *st = _st_new_socket_stream(new_fd);
         st->delim = l->delim;
         st->delim_len = strlen(st->delim);
+        st->flags |= l->stream_flags;
 
         (l->callback)(st,l->callback_arg);
 
@@ -369,7 +549,7 @@ void *__st_socket_stream_accept(void *arg) {
 /**
  * create a socket listener on a port which will generate socket streams when connections arrive
  */
-SocketListener *_st_new_socket_listener(int port,lisenterConnectionCallbackFn fn,void *callback_arg,char * delim) {
+SocketListener *_st_new_socket_listener(int port,lisenterConnectionCallbackFn fn,void *callback_arg,char * delim,int stream_flags) {
     char portstr[255];
     sprintf(portstr,"%d",port);
     SocketListener *l = malloc(sizeof(SocketListener));
@@ -378,6 +558,7 @@ SocketListener *_st_new_socket_listener(int port,lisenterConnectionCallbackFn fn
     l->callback_arg = callback_arg;
     l->alive = true;
     l->delim = delim;
+    l->stream_flags = stream_flags;
 
     int sockfd;  // listen on sock_fd, new connection on new_fd
     struct addrinfo hints, *servinfo, *p;
@@ -17,7 +17,7 @@
 #include <stdbool.h>
 
 enum StreamTypes {UnixStream,SocketStream};
-enum {StreamHasData=0x0001,StreamCloseOnFree=0x0002,StreamReader=0x0004,StreamWaiting=0x0008,StreamAlive=0x8000,StreamCloseAfterOneWrite=0x0010,StreamDying=0x0100,StreamLoadByLine=0x0200};
+enum {StreamHasData=0x0001,StreamCloseOnFree=0x0002,StreamReader=0x0004,StreamWaiting=0x0008,StreamAlive=0x8000,StreamCloseAfterOneWrite=0x0010,StreamDying=0x0100,StreamLoadByLine=0x0200,StreamUnitHTTP=0x0400,StreamUnitBad=0x0800};
 
 typedef struct Stream Stream;
 
@@ -41,6 +41,8 @@ struct Stream {
     size_t unit_start;
     size_t unit_size;
     size_t partial;
+    size_t unit_header_size;  ///< size of the headers of the HTTP request being scanned (0 if not yet found)
+    size_t unit_body_size;    ///< size of the body of the HTTP request being scanned (or StreamChunked)
     hasDataCallbackFn callback;
     void *callback_arg1;
     int callback_arg2;
@@ -65,11 +67,17 @@ struct SocketListener {
     void *callback_arg;
     bool alive;
     char *delim;
+    int stream_flags;   ///< flags to set on the streams of accepted connections, i.e. StreamUnitHTTP
 };
 
 char *DELIM_LF;
 char *DELIM_CRLF;
 
+/// unit_body_size value for requests with a chunked transfer encoding
+#define StreamChunked ((size_t)-1)
+/// largest body accepted for an HTTP request, anything bigger (or unparseable) fails the request
+#define HTTP_MAX_BODY_SIZE (16*1024*1024)
+
 #define DEFAULT_READER_BUFFER_SIZE 1000
 #define _st_new_unix_stream(s,r) __st_new_unix_stream(s,r?DEFAULT_READER_BUFFER_SIZE:0)
 Stream *__st_new_unix_stream(FILE *stream,size_t reader_buffer_size);
@@ -79,8 +87,9 @@ size_t __st_unix_stream_load(Stream *st);
 #define __st_buf_full(s) (s->bytes_used == s->buf_size)
 
 void __st_scan(Stream *st);
+void __st_scan_http(Stream *st);
 
-SocketListener *_st_new_socket_listener(int port,lisenterConnectionCallbackFn fn,void *callback_arg,char * delim);
+SocketListener *_st_new_socket_listener(int port,lisenterConnectionCallbackFn fn,void *callback_arg,char * delim,int stream_flags);
 void _st_close_listener(SocketListener *l);
 
 void _st_start_read(Stream *st);
@@ -11,6 +11,7 @@
 #include "tree.h"
 #include "def.h"
 #include "receptor.h"
+#include "mtree.h"
 
 #include "base_defs.h"
 #include <stdarg.h>
@@ -57,10 +58,9 @@ SemTable *def_sys() {
     _sd(RECEPTOR_LABEL,SYS_CONTEXT,SEM_TYPE_SYMBOL,RECEPTOR_LABEL_ID);
     _sd(ENGLISH_LABEL,SYS_CONTEXT,SEM_TYPE_SYMBOL,ENGLISH_LABEL_ID);
 
-    base_contexts(sem);
-
     // this has to happen after the _sd declarations so that the basic Symbols will be valid
-    base_defs(sem);
+    load_base_defs(sem);
+    _p_init_transcoders(sem);
 
     _r_defineClockReceptor(sem);
     return sem;
@@ -68,10 +68,63 @@ SemTable *def_sys() {
 
 
 void sys_free(SemTable *sem) {
-    _t_free(_t_root(sem->stores[0].definitions));
+    _t_free(_t_root(__sem_context(sem,0)->definitions));
     _sem_free(sem);
 }
 
+/**
+ * set up the base system definitions from the image compiled into the binary
+ *
+ * the image holds the definitions tree that base_contexts and base_defs build, along with
+ * the paths of the contexts in it, the global data trees and the values of the
+ * SemanticIDs they set, so loading it is just unserializing a few trees instead of
+ * making and checking thousands of definitions.
+ *
+ * @param[in] sem an empty semtable
+ * @returns false, leaving sem untouched, if there's no image or it was made from a different base_defs
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/def_spec.h testDefImage
+ */
+bool load_base_defs_image(SemTable *sem) {
+    if (!G_base_defs_image_size || G_base_defs_image_hash != BASE_DEFS_IMAGE_HASH || G_base_defs_image_ids_count != NUM_BASE_DEF_IDS) return false;
+
+    // the ids have to be set first as they're needed to make sense of the trees
+    int i;
+    for(i=0;i<NUM_BASE_DEF_IDS;i++) *G_base_def_ids[i] = G_base_defs_image_ids[i];
+
+    // the image is the serialized trees one after the other, each 8 byte aligned
+    T *trees[2+NUM_BASE_DEF_DATA];
+    size_t offset = 0;
+    for(i=0;i<2+NUM_BASE_DEF_DATA;i++) {
+        S *s = (S *)(G_base_defs_image+offset);
+        H h = _m_unserialize(s);
+        trees[i] = _t_new_from_m(h);
+        _m_free(h);
+        offset += (s->total_size+7) & ~7;
+    }
+    if (offset != G_base_defs_image_size) raise_error("corrupt base definitions image");
+
+    _sem_restore_contexts(sem,trees[0],trees[1]);
+    _t_free(trees[1]);
+    for(i=0;i<NUM_BASE_DEF_DATA;i++) *G_base_def_data[i] = trees[2+i];
+    return true;
+}
+
+/**
+ * set up the base system definitions in an empty semtable
+ *
+ * uses the prebuilt image if it's up to date and otherwise builds them from scratch
+ *
+ * @param[in] sem the semtable
+ */
+void load_base_defs(SemTable *sem) {
+    if (load_base_defs_image(sem)) return;
+    debug(D_BOOT,"building base definitions\n");
+    base_contexts(sem);
+    base_defs(sem);
+}
+
 Context G_ctx;
 char * G_label;
 
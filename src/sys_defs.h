@@ -51,6 +51,21 @@ char * G_label;
 
 T *sT_(SemTable *sem,Symbol sym,int num_params,...);
 
+// prebuilt image of what base_contexts and base_defs set up, generated into
+// base_defs_image.c by src/tools/mkimage.c (see the Makefile)
+extern const uint32_t G_base_defs_image_hash;
+extern const int G_base_defs_image_ids_count;
+extern const SemanticID G_base_defs_image_ids[];
+extern const size_t G_base_defs_image_size;
+extern const unsigned char G_base_defs_image[];
+
+// the hash an image has to have to be loaded here: the hash of the base definitions and the code
+// that builds and serializes them, mixed with the layout of serialized trees on this machine
+#define BASE_DEFS_IMAGE_LAYOUT (sizeof(N)<<16 | sizeof(size_t)<<8 | (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? 1 : 2))
+#define BASE_DEFS_IMAGE_HASH ((uint32_t)(BASE_DEFS_HASH ^ BASE_DEFS_IMAGE_LAYOUT))
+
+bool load_base_defs_image(SemTable *sem);
+void load_base_defs(SemTable *sem);
 void load_contexts(SemTable *sem);
 void load_context(char *name, Receptor *parent);
 
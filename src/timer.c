@@ -0,0 +1,218 @@
+/**
+ * @ingroup vmhost
+ *
+ * @{
+ * @file timer.c
+ * @brief hierarchical timer wheel
+ *
+ * Timers are kept in TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots.  A timer due
+ * within TIMER_WHEEL_SLOTS ticks sits in the first level at its exact tick, later timers sit
+ * in coarser levels and get cascaded down as the wheel turns, so adding, cancelling and
+ * firing are all constant time no matter how many timers are outstanding.  Timers further
+ * out than the wheel spans wait in the last level and get re-cascaded until they're due.
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#include "timer.h"
+#include <time.h>
+
+#define __tw_span(level) (1ULL << (TIMER_WHEEL_BITS*(level)))
+#define __tw_slot(when,level) (((when) >> (TIMER_WHEEL_BITS*(level))) & (TIMER_WHEEL_SLOTS-1))
+
+/**
+ * monotonic time in nanoseconds
+ */
+uint64_t _tw_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*NS_PER_SEC+t.tv_nsec;
+}
+
+/**
+ * create a timer wheel
+ *
+ * @param[in] resolution nanoseconds per tick of the wheel
+ * @returns the new TimerWheel
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/vmhost_spec.h testTimerWheel
+ */
+TimerWheel *_tw_new(uint64_t resolution) {
+    TimerWheel *w = malloc(sizeof(TimerWheel));
+    memset(w,0,sizeof(TimerWheel));
+    w->resolution = resolution;
+    w->origin = _tw_now();
+    pthread_mutexattr_t a;
+    pthread_mutexattr_init(&a);
+    // timer callbacks are called with the wheel locked and may add or cancel timers
+    pthread_mutexattr_settype(&a,PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&w->mutex,&a);
+    pthread_mutexattr_destroy(&a);
+    return w;
+}
+
+/**
+ * set up a timer that isn't scheduled yet
+ */
+void _tw_init_timer(Timer *t,TimerFn fn,void *arg) {
+    t->fn = fn;
+    t->arg = arg;
+    t->interval = 0;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+// link a timer into the slot for its expiry relative to the current tick
+// (a timer cascaded down on the tick it's due lands in the slot about to be fired)
+void __tw_insert(TimerWheel *w,Timer *t) {
+    uint64_t when = t->expires;
+    if (when < w->now) when = w->now;
+    uint64_t delta = when - w->now;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS-1 && delta >= __tw_span(level+1)) level++;
+    // timers past the end of the wheel wait in the furthest slot and get re-cascaded
+    if (delta >= __tw_span(TIMER_WHEEL_LEVELS)) when = w->now + __tw_span(TIMER_WHEEL_LEVELS)-1;
+    Timer **slot = &w->slots[level][__tw_slot(when,level)];
+    t->next = *slot;
+    if (t->next) t->next->pprev = &t->next;
+    t->pprev = slot;
+    *slot = t;
+}
+
+void __tw_unlink(Timer *t) {
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+/**
+ * schedule a timer
+ *
+ * rescheduling a timer that's already scheduled moves it.
+ *
+ * @param[in] w the wheel
+ * @param[in] t the timer
+ * @param[in] delay nanoseconds from now till the timer fires (rounded up to the wheel's resolution)
+ * @param[in] interval nanoseconds between firings after that, or 0 for a one-shot timer
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/vmhost_spec.h testTimerWheel
+ */
+void _tw_add(TimerWheel *w,Timer *t,uint64_t delay,uint64_t interval) {
+    pthread_mutex_lock(&w->mutex);
+    if (_tw_scheduled(t)) {
+        __tw_unlink(t);
+        w->count--;
+    }
+    uint64_t now = (_tw_now()-w->origin)/w->resolution;
+    t->expires = now + (delay+w->resolution-1)/w->resolution;
+    // the current tick's slot has already been fired
+    if (t->expires <= w->now) t->expires = w->now+1;
+    t->interval = interval ? (interval+w->resolution-1)/w->resolution : 0;
+    __tw_insert(w,t);
+    w->count++;
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/**
+ * unschedule a timer
+ *
+ * cancelling a timer that isn't scheduled (i.e. has already fired) does nothing
+ */
+void _tw_cancel(TimerWheel *w,Timer *t) {
+    pthread_mutex_lock(&w->mutex);
+    if (_tw_scheduled(t)) {
+        __tw_unlink(t);
+        w->count--;
+    }
+    pthread_mutex_unlock(&w->mutex);
+}
+
+// move all the timers in a slot of a coarser level down to where they now belong
+void __tw_cascade(TimerWheel *w,int level) {
+    Timer **slot = &w->slots[level][__tw_slot(w->now,level)];
+    Timer *t;
+    while ((t = *slot)) {
+        __tw_unlink(t);
+        __tw_insert(w,t);
+    }
+}
+
+/**
+ * turn the wheel up to a time, firing all the timers that have come due
+ *
+ * timers fire in tick order.  Periodic timers are rescheduled before their callback is
+ * called, and a one-shot timer is no longer scheduled when its callback is called so the
+ * callback may free it.
+ *
+ * @param[in] w the wheel
+ * @param[in] now monotonic time in nanoseconds (see _tw_now)
+ * @returns the number of timers fired
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/vmhost_spec.h testTimerWheel
+ */
+int _tw_advance(TimerWheel *w,uint64_t now) {
+    int fired = 0;
+    uint64_t target = (now-w->origin)/w->resolution;
+    pthread_mutex_lock(&w->mutex);
+    while (w->now < target) {
+        // nothing to fire, so there's no need to visit every tick on the way
+        if (!w->count) {
+            w->now = target;
+            break;
+        }
+        w->now++;
+        int level;
+        for (level=1;level<TIMER_WHEEL_LEVELS && !__tw_slot(w->now,level-1);level++)
+            __tw_cascade(w,level);
+        Timer **slot = &w->slots[0][__tw_slot(w->now,0)];
+        Timer *t;
+        while ((t = *slot)) {
+            __tw_unlink(t);
+            if (t->expires > w->now) {
+                // a timer from past the end of the wheel that isn't due yet
+                __tw_insert(w,t);
+                continue;
+            }
+            if (t->interval) {
+                t->expires = w->now + t->interval;
+                __tw_insert(w,t);
+            }
+            else w->count--;
+            fired++;
+            (t->fn)(t);
+        }
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return fired;
+}
+
+/**
+ * monotonic time in nanoseconds at which the wheel's next tick begins
+ */
+uint64_t _tw_next_tick(TimerWheel *w) {
+    uint64_t now = _tw_now()-w->origin;
+    return w->origin + (now/w->resolution+1)*w->resolution;
+}
+
+/**
+ * free a timer wheel
+ *
+ * the timers themselves belong to whoever scheduled them, so they are just unlinked.
+ */
+void _tw_free(TimerWheel *w) {
+    int l,s;
+    for(l=0;l<TIMER_WHEEL_LEVELS;l++) {
+        for(s=0;s<TIMER_WHEEL_SLOTS;s++) {
+            Timer *t;
+            while ((t = w->slots[l][s])) __tw_unlink(t);
+        }
+    }
+    pthread_mutex_destroy(&w->mutex);
+    free(w);
+}
+
+/** @}*/
@@ -0,0 +1,39 @@
+/**
+ * @ingroup vmhost
+ *
+ * @{
+ * @file timer.h
+ * @brief hierarchical timer wheel header file
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#ifndef _CEPTR_TIMER_H
+#define _CEPTR_TIMER_H
+
+#include "tree.h"
+
+#define NS_PER_MS 1000000LL
+#define NS_PER_SEC 1000000000LL
+
+/// default tick of the vmhost's wheel
+#define TIMER_RESOLUTION (10*NS_PER_MS)
+/// default interval between updates of the clock receptor's TICK
+#define CLOCK_RESOLUTION NS_PER_SEC
+
+#define _tw_scheduled(t) ((t)->pprev != NULL)
+/// keep timers from firing while changing what they refer to (the lock is recursive)
+#define _tw_lock(w) pthread_mutex_lock(&(w)->mutex)
+#define _tw_unlock(w) pthread_mutex_unlock(&(w)->mutex)
+
+uint64_t _tw_now();
+TimerWheel *_tw_new(uint64_t resolution);
+void _tw_init_timer(Timer *t,TimerFn fn,void *arg);
+void _tw_add(TimerWheel *w,Timer *t,uint64_t delay,uint64_t interval);
+void _tw_cancel(TimerWheel *w,Timer *t);
+int _tw_advance(TimerWheel *w,uint64_t now);
+uint64_t _tw_next_tick(TimerWheel *w);
+void _tw_free(TimerWheel *w);
+
+#endif
+/** @}*/
@@ -0,0 +1,75 @@
+/**
+ * @file mkimage.c
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ * @ingroup def
+ * @brief implements a main() that writes out base_defs_image.c
+ *
+ * builds the base definitions the slow way and prints them as c source of an image that
+ * load_base_defs_image can restore them from.  This gets linked with everything in src
+ * but ceptr.c and base_defs_image.c, so it never uses a stale image itself.
+ */
+
+#include "../ceptr.h"
+#include "../mtree.h"
+#include "../def.h"
+
+// no image, so load_base_defs builds the definitions
+const uint32_t G_base_defs_image_hash = 0;
+const int G_base_defs_image_ids_count = 0;
+const SemanticID G_base_defs_image_ids[] = {{0,0,0}};
+const size_t G_base_defs_image_size = 0;
+const unsigned char G_base_defs_image[] = {0};
+
+size_t G_bytes;
+
+void add_tree(T *t) {
+    H h = _m_new_from_t(t);
+    S *s = _m_serialize(h.m);
+    _m_free(h);
+    size_t i,size = (s->total_size+7) & ~7;
+    unsigned char *b = (unsigned char *)s;
+    for(i=0;i<size;i++,G_bytes++)
+        printf("%s0x%02x,",G_bytes%16 ? "" : "\n    ",i < s->total_size ? b[i] : 0);
+    free(s);
+}
+
+int main(int argc, const char **argv) {
+    // def_sys sets up the bootstrap symbols that base_defs needs
+    G_sem = def_sys();
+
+    SemTable *sem = _sem_new();
+    load_base_defs(sem);
+
+    printf("/**\n"
+           " * @ingroup def\n"
+           " *\n"
+           " * @file base_defs_image.c\n"
+           " * @brief auto-generated image of the system definitions\n"
+           " *\n"
+           " * NOTE: this file is auto-generated by src/tools/mkimage.c so DON'T EDIT IT MANUALLY!\n"
+           " *\n"
+           " * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).\n"
+           " */\n\n"
+           "#include \"base_defs.h\"\n\n");
+
+    printf("const uint32_t G_base_defs_image_hash = 0x%08x;\n\n",BASE_DEFS_IMAGE_HASH);
+    printf("const int G_base_defs_image_ids_count = %d;\n",NUM_BASE_DEF_IDS);
+    printf("const SemanticID G_base_defs_image_ids[] = {");
+    int i;
+    for(i=0;i<NUM_BASE_DEF_IDS;i++) {
+        SemanticID s = *G_base_def_ids[i];
+        printf("%s{%d,%d,%d},",i%8 ? "" : "\n    ",s.context,s.semtype,s.id);
+    }
+    printf("\n};\n\n");
+
+    printf("const unsigned char G_base_defs_image[] __attribute__((aligned(8))) = {");
+    add_tree(_t_root(__sem_context(sem,0)->definitions));
+    T *paths = _sem_context_paths(sem);
+    add_tree(paths);
+    _t_free(paths);
+    for(i=0;i<NUM_BASE_DEF_DATA;i++) add_tree(*G_base_def_data[i]);
+    printf("\n};\n\n");
+    printf("const size_t G_base_defs_image_size = %ld;\n",G_bytes);
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+/**
+ * @ingroup receptor
+ *
+ * @{
+ * @file trace.c
+ * @brief low overhead tracing of reductions
+ *
+ * Trace events are fixed size binary records written into a per-Q ring buffer.  Recording
+ * one is just a timestamp and an atomic increment, so tracing can be left on under load,
+ * and the buffer gets decoded (using the semantic table for names) only when it's dumped.
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#include "trace.h"
+#include "semtable.h"
+#include <time.h>
+
+uint64_t __tr_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000LL+t.tv_nsec;
+}
+
+// the cheapest timestamp available, the cycle counter on x86, otherwise nanoseconds
+static inline uint64_t __tr_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return __tr_ns();
+#endif
+}
+
+// work out how long a tick is by comparing against the clock since the buffer was created
+double __tr_ns_per_tick(TraceBuffer *tb) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t ticks = __tr_ticks()-tb->start_ticks;
+    uint64_t ns = __tr_ns()-tb->start_ns;
+    return ticks ? (double)ns/ticks : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+/**
+ * create a trace buffer
+ *
+ * @param[in] size number of events to keep, rounded up to a power of 2
+ * @param[in] pid what to report as the pid of the events when dumping
+ * @returns the new TraceBuffer
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessTrace
+ */
+TraceBuffer *_tr_new(size_t size,int pid) {
+    size_t s = 1;
+    while (s < size) s <<= 1;
+    TraceBuffer *tb = malloc(sizeof(TraceBuffer));
+    tb->events = malloc(sizeof(TraceEvent)*s);
+    tb->mask = s-1;
+    tb->head = 0;
+    tb->pid = pid;
+    tb->start_ns = __tr_ns();
+    tb->start_ticks = __tr_ticks();
+    return tb;
+}
+
+/**
+ * record a trace event
+ *
+ * safe to call from any thread, the slot is claimed with an atomic increment so no
+ * locking is needed.  Once the buffer is full the oldest events get overwritten.
+ *
+ * @param[in] tb the buffer
+ * @param[in] type the TraceEventType
+ * @param[in] sym the process, carrier etc. the event is about
+ * @param[in] id the process id the event happened in
+ */
+void __tr_event(TraceBuffer *tb,int type,SemanticID sym,int id) {
+    uint64_t i = __atomic_fetch_add(&tb->head,1,__ATOMIC_RELAXED);
+    TraceEvent *e = &tb->events[i & tb->mask];
+    e->time = __tr_ticks();
+    e->symbol = sym;
+    e->id = id;
+    e->type = type;
+}
+
+/**
+ * number of events currently held by a trace buffer
+ */
+size_t _tr_count(TraceBuffer *tb) {
+    uint64_t head = __atomic_load_n(&tb->head,__ATOMIC_ACQUIRE);
+    return head > tb->mask ? tb->mask+1 : head;
+}
+
+// write out a string escaped for use inside a json string value
+void __tr_json_escape(FILE *out,char *s) {
+    while (*s) {
+        if (*s == '"' || *s == '\\') fputc('\\',out);
+        fputc(*s++,out);
+    }
+}
+
+// write out the events of a buffer with timestamps in microseconds since base_ns
+void __tr_dump_events(SemTable *sem,TraceBuffer *tb,FILE *out,char **sep,uint64_t base_ns) {
+    uint64_t head = __atomic_load_n(&tb->head,__ATOMIC_ACQUIRE);
+    uint64_t i = head > tb->mask ? head-tb->mask-1 : 0;
+    double ns_per_tick = __tr_ns_per_tick(tb);
+    double offset = (double)(int64_t)(tb->start_ns-base_ns)/1000.0;
+
+    for(;i<head;i++) {
+        TraceEvent *e = &tb->events[i & tb->mask];
+        double ts = offset+(double)(int64_t)(e->time-tb->start_ticks)*ns_per_tick/1000.0;
+        fputs(*sep,out);
+        *sep = ",\n";
+        switch(e->type) {
+        case TraceStepBegin:
+            fputs("{\"name\":\"",out);
+            __tr_json_escape(out,_sem_get_name(sem,e->symbol));
+            fputs("\",\"cat\":\"reduce\",\"ph\":\"B\"",out);
+            break;
+        case TraceStepEnd:
+            fputs("{\"ph\":\"E\"",out);
+            break;
+        case TraceBlock:
+        case TraceUnblock:
+            fprintf(out,"{\"name\":\"%s\",\"cat\":\"queue\",\"ph\":\"i\",\"s\":\"t\"",e->type == TraceBlock ? "block" : "unblock");
+            break;
+        case TraceDeliver:
+        case TraceMatch:
+            fprintf(out,"{\"name\":\"%s ",e->type == TraceDeliver ? "deliver" : "match");
+            __tr_json_escape(out,_sem_get_name(sem,e->symbol));
+            fputs("\",\"cat\":\"signal\",\"ph\":\"i\",\"s\":\"p\"",out);
+            break;
+        }
+        fprintf(out,",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",ts,tb->pid,e->id);
+    }
+}
+
+/**
+ * dump a trace buffer in the Chrome trace event JSON format
+ *
+ * process reductions become duration events on a thread per process id, blocking
+ * and unblocking are thread instant events and signal delivery and expectation matches
+ * are process instant events.  Timestamps are in microseconds since the buffer was created.
+ * Events recorded while the dump is happening may show up torn, so dump a quiet buffer.
+ *
+ * @param[in] sem the semantic table to get names from
+ * @param[in] tb the buffer
+ * @param[in] out where to write the JSON
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessTrace
+ */
+void _tr_dump(SemTable *sem,TraceBuffer *tb,FILE *out) {
+    _tr_dump_all(sem,&tb,1,out);
+}
+
+/**
+ * dump several trace buffers, i.e. those of all the receptors in a vmhost, as one trace
+ *
+ * each buffer's events show up as a process of their own, with timestamps in microseconds
+ * since the oldest buffer was created.  See _tr_dump.
+ *
+ * @param[in] sem the semantic table to get names from
+ * @param[in] tbs the buffers
+ * @param[in] count how many buffers there are
+ * @param[in] out where to write the JSON
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/vmhost_spec.h testVMHostTrace
+ */
+void _tr_dump_all(SemTable *sem,TraceBuffer **tbs,int count,FILE *out) {
+    int i;
+    uint64_t base_ns = 0;
+    for(i=0;i<count;i++)
+        if (!i || tbs[i]->start_ns < base_ns) base_ns = tbs[i]->start_ns;
+    char *sep = "";
+    fputs("{\"traceEvents\":[",out);
+    for(i=0;i<count;i++) __tr_dump_events(sem,tbs[i],out,&sep,base_ns);
+    fputs("]}\n",out);
+}
+
+/**
+ * free a trace buffer
+ */
+void _tr_free(TraceBuffer *tb) {
+    free(tb->events);
+    free(tb);
+}
+
+/** @}*/
@@ -0,0 +1,30 @@
+/**
+ * @ingroup receptor
+ *
+ * @{
+ * @file trace.h
+ * @brief reduction tracing header file
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#ifndef _CEPTR_TRACE_H
+#define _CEPTR_TRACE_H
+
+#include "tree.h"
+
+/// default number of events kept by a trace buffer
+#define TRACE_BUFFER_SIZE 65536
+
+/// record a trace event if tracing is on (i.e. the buffer isn't NULL)
+#define _tr_event(tb,type,sym,id) do {if (tb) __tr_event(tb,type,sym,id);} while(0)
+
+TraceBuffer *_tr_new(size_t size,int pid);
+void __tr_event(TraceBuffer *tb,int type,SemanticID sym,int id);
+size_t _tr_count(TraceBuffer *tb);
+void _tr_dump(SemTable *sem,TraceBuffer *tb,FILE *out);
+void _tr_dump_all(SemTable *sem,TraceBuffer **tbs,int count,FILE *out);
+void _tr_free(TraceBuffer *tb);
+
+#endif
+/** @}*/
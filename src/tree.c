@@ -19,20 +19,25 @@
 #include "util.h"
 #include "debug.h"
 
+__thread uint64_t G_tree_allocs = 0;
+__thread uint64_t G_tree_alloc_bytes = 0;
+
 /*****************  Node creation */
 void __t_append_child(T *t,T *c) {
-    if (t->structure.child_count == 0) {
-        t->structure.children = malloc(sizeof(T *)*TREE_CHILDREN_BLOCK);
-    } else if (!(t->structure.child_count % TREE_CHILDREN_BLOCK)){
-        int b = t->structure.child_count/TREE_CHILDREN_BLOCK + 1;
-        t->structure.children = realloc(t->structure.children,sizeof(T *)*(TREE_CHILDREN_BLOCK*b));
+    int n = t->structure.child_count;
+    if (_t_children_full(n)) {
+        if (n == 0) t->structure.children = malloc(sizeof(T *)*TREE_CHILDREN_BLOCK);
+        else t->structure.children = realloc(t->structure.children,sizeof(T *)*_t_children_grow(n));
     }
 
     t->structure.children[t->structure.child_count++] = c;
 }
 
 T * __t_init(T *parent,Symbol symbol,bool is_run_node) {
-    T *t = malloc(is_run_node ? sizeof(rT) : sizeof(T));
+    size_t size = is_run_node ? sizeof(rT) : sizeof(T);
+    T *t = malloc(size);
+    G_tree_allocs++;
+    G_tree_alloc_bytes += size;
     t->structure.child_count = 0;
     t->structure.parent = parent;
     t->contents.symbol = symbol;
@@ -67,6 +72,7 @@ T * __t_new(T *parent,Symbol symbol,void *surface,size_t size,bool is_run_node)
         else {
             t->context.flags |= TFLAG_ALLOCATED;
             dst = t->contents.surface = malloc(size);
+            G_tree_alloc_bytes += size;
         }
         memcpy(dst,surface,size);
     }
@@ -264,6 +270,23 @@ void _t_add(T *t,T *c) {
     __t_append_child(t,c);
 }
 
+/**
+ * move all the children of one node onto the end of another
+ *
+ * @param[in] t tree onto which the children will be added
+ * @param[in] from node whose children are moved, which is left with none
+ */
+void __t_append_children(T *t,T *from) {
+    int i,c = from->structure.child_count;
+    for(i=0;i<c;i++) {
+        T *k = from->structure.children[i];
+        k->structure.parent = t;
+        __t_append_child(t,k);
+    }
+    if (c) free(from->structure.children);
+    from->structure.child_count = 0;
+}
+
 /**
  * Detatch the specified child from a node and return it
  *
@@ -330,6 +353,7 @@ void __t_morph(T *t,Symbol s,void *surface,size_t size,int allocate) {
 
     if (allocate) {
         t->contents.surface = malloc(size);
+        G_tree_alloc_bytes += size;
         memcpy(t->contents.surface,surface,size);
         t->context.flags = TFLAG_ALLOCATED; /// @todo Handle the case where the surface of the node to be morphed is itself a tree
     }
@@ -1577,6 +1601,33 @@ int _t_hash_equal(TreeHash h1,TreeHash h2) {
     return h1 == h2;
 }
 
+/**
+ * compare two trees
+ *
+ * looks at the same things _t_hash does, i.e. the symbols and shape of the trees and the
+ * surfaces of their leaves, so it can tell whether trees with equal hashes really are equal.
+ *
+ * @param[in] sem current semantic contexts
+ * @param[in] t1 a tree
+ * @param[in] t2 the tree to compare it with
+ * @returns true if the trees are equal
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/tree_spec.h testTreeEqual
+ */
+int _t_equal(SemTable *sem,T *t1,T *t2) {
+    int i,c = _t_children(t1);
+    if (c != _t_children(t2) || !semeq(_t_symbol(t1),_t_symbol(t2))) return false;
+    if (c == 0) {
+        size_t l = _d_get_symbol_size(sem,_t_symbol(t1),_t_surface(t1));
+        if (l != _d_get_symbol_size(sem,_t_symbol(t2),_t_surface(t2))) return false;
+        return l == 0 || !memcmp(_t_surface(t1),_t_surface(t2),l);
+    }
+    for(i=1;i<=c;i++)
+        if (!_t_equal(sem,_t_child(t1,i),_t_child(t2,i))) return false;
+    return true;
+}
+
 // scaffolding for uuid generator
 // for now we just use the current time
 UUIDt __uuid_gen() {
@@ -1982,6 +2033,38 @@ int __t_writeln(T *t,Stream *stream) {
     return _st_writeln(stream,str);
 }
 
+/**
+ * flatten the CSTRING pieces of a ROPE into a single string
+ *
+ * sums the pieces first so the result is allocated and copied just once
+ *
+ * @param[in] t the rope
+ * @param[out] lenP if not NULL gets the length of the result (not counting the terminating null)
+ * @returns newly allocated null terminated string which the caller must free
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/process_spec.h testProcessRope
+ */
+char *_t_flatten_rope(T *t,size_t *lenP) {
+    size_t l = 0;
+    DO_KIDS(t,
+            size_t s = _t_size(_t_child(t,i));
+            if (s) l += s-1;
+            );
+    char *str = malloc(l+1),*p = str;
+    DO_KIDS(t,
+            T *k = _t_child(t,i);
+            size_t s = _t_size(k);
+            if (s) {
+                memcpy(p,_t_surface(k),s-1);
+                p += s-1;
+            }
+            );
+    *p = 0;
+    if (lenP) *lenP = l;
+    return str;
+}
+
 /**
  * write a tree out to a stream
  *
@@ -2008,6 +2091,13 @@ int _t_write(SemTable *sem,T *t,Stream *stream) {
         if (semeq(struc,CSTRING)) {
             str = _t_surface(t);
         }
+        else if (semeq(struc,ROPE)) {
+            size_t l;
+            str = _t_flatten_rope(t,&l);
+            err = _st_write(stream,str,l);
+            free(str);
+            return err;
+        }
         else {
             str = _t2s(sem,t);
         }
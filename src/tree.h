@@ -26,8 +26,15 @@
 #include "stream.h"
 
 #define TREE_CHILDREN_BLOCK 5
+// child arrays start with a block and double whenever they fill, so this is true for a count of children that leaves no room for another
+#define _t_children_full(n) (!((n)%TREE_CHILDREN_BLOCK) && !(((n)/TREE_CHILDREN_BLOCK) & ((n)/TREE_CHILDREN_BLOCK-1)))
+#define _t_children_grow(n) ((n) ? (n)*2 : TREE_CHILDREN_BLOCK)
 #define TREE_PATH_TERMINATOR -9999
 
+// running counts of the tree nodes (and their surfaces) allocated by the current thread
+extern __thread uint64_t G_tree_allocs;
+extern __thread uint64_t G_tree_alloc_bytes;
+
 enum TreeSurfaceFlags {TFLAG_ALLOCATED=0x0001,TFLAG_SURFACE_IS_TREE=0x0002,TFLAG_SURFACE_IS_RECEPTOR = 0x0004,TFLAG_SURFACE_IS_SCAPE=0x0008,TFLAG_SURFACE_IS_CPTR=0x0010,TFLAG_DELETED=0x0020,TFLAG_RUN_NODE=0x0040,TFLAG_REFERENCE=0x8000};
 
 /*****************  Node creation and deletion*/
@@ -53,6 +60,7 @@ T *_t_new_cptr(T *parent,Symbol symbol,void *s);
 T *_t_newp(T *parent,Symbol symbol,Process surface);
 
 void _t_add(T *t,T *c);
+void __t_append_children(T *t,T *from);
 void _t_detach_by_ptr(T *t,T *c);
 T *_t_detach_by_idx(T *t,int i);
 void _t_replace(T *t,int i,T *r);
@@ -103,6 +111,7 @@ char * _t_sprint_path(int *fp,char *buf);
 /*****************  Tree hashing utilities */
 TreeHash _t_hash(SemTable *sem,T *t);
 int _t_hash_equal(TreeHash h1,TreeHash h2);
+int _t_equal(SemTable *sem,T *t1,T *t2);
 
 /*****************  UUID utilities */
 UUIDt __uuid_gen();
@@ -118,6 +127,7 @@ char * _t2json(SemTable *sem,T *t,int level,char *buf);
 
 /*****************  Misc... */
 
+char *_t_flatten_rope(T *t,size_t *lenP);
 int _t_write(SemTable *sem,T *t,Stream *stream);
 
 #define DO_KIDS(t,x) {int i,_c=_t_children(t);for(i=1;i<=_c;i++){x;}}
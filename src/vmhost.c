@@ -12,6 +12,8 @@
 #include "tree.h"
 #include "accumulator.h"
 #include "debug.h"
+#include "trace.h"
+#include <sys/mman.h>
 /******************  create and destroy virtual machine */
 
 
@@ -22,9 +24,24 @@ VMHost *__v_init(Receptor *r,SemTable *sem) {
     v->active_receptor_count = 0;
     v->receptor_count = 0;
     v->installed_receptors = _s_new(RECEPTOR_IDENTIFIER,RECEPTOR_SURFACE);
+    v->installed_receptors->sem = sem;
     v->vm_thread.state = 0;
     v->clock_thread.state = 0;
+    v->timers = _tw_new(TIMER_RESOLUTION);
+    _tw_init_timer(&v->clock_timer,__r_tick,NULL);
+    v->clock_resolution = CLOCK_RESOLUTION;
     v->sem = sem;
+    v->dir = NULL;
+    v->wal = NULL;
+    _tw_init_timer(&v->checkpoint_timer,0,v);
+    v->checkpoint_thread.state = 0;
+    v->checkpoint = NULL;
+    v->checkpointing = false;
+    v->checkpoint_failed = false;
+    v->image = NULL;
+    v->image_size = 0;
+    v->max_loaded_receptors = 0;
+    v->trace_size = 0;
     return v;
 }
 
@@ -41,8 +58,8 @@ VMHost *__v_init(Receptor *r,SemTable *sem) {
 VMHost * _v_new() {
     SemTable *sem = _sem_new();
 
-    base_contexts(sem);
-    base_defs(sem);
+    load_base_defs(sem);
+    _p_init_transcoders(sem);
 
     Receptor *r = _r_new(sem,SYS_RECEPTOR);
     VMHost *v = __v_init(r,sem);
@@ -69,9 +86,16 @@ VMHost * _v_new() {
  * @param[in] v the VMHost to free
  */
 void _v_free(VMHost *v) {
+    _tw_cancel(v->timers,&v->clock_timer);
+    _tw_cancel(v->timers,&v->checkpoint_timer);
+    _v_join_thread(&v->checkpoint_thread);
+    if (v->wal) _wl_close(v->wal);
     _r_free(v->r);
+    // the receptor stubs that were never loaded pointed into the boot image
+    if (v->image) munmap(v->image,v->image_size);
+    _tw_free(v->timers);
     _s_free(v->installed_receptors);
-    _t_free(_t_root(v->sem->stores[0].definitions));
+    _t_free(_t_root(__sem_context(v->sem,0)->definitions));
     _sem_free(v->sem);
     free(v);
 }
@@ -110,12 +134,9 @@ Xaddr _v_install_r(VMHost *v,Xaddr package,T *bindings,char *label) {
     raise_error("not implemented");
     T *p;// = _r_get_instance(v->c,package);
     T *id = _t_child(p,2);
-    TreeHash h = _t_hash(v->r->sem,id);
 
     // make sure we aren't re-installing an already installed receptor
-    Xaddr x = _s_get(v->installed_receptors,h);
-    if (!(is_null_xaddr(x))) return G_null_xaddr;
-    _s_add(v->installed_receptors,h,package);
+    if (!_s_add(v->installed_receptors,id,package)) return G_null_xaddr;
 
     // confirm that the bindings match the manifest
     /// @todo expand the manifest to allow optional binding, etc, using semtrex to do the matching instead of assuming positional matching
@@ -156,6 +177,7 @@ Xaddr _v_new_receptor(VMHost *v,Receptor *parent,Symbol s, Receptor *r) {
     v->routing_table[c].r=r;
     v->routing_table[c].s=s;
     r->addr.addr = c;
+    r->wal = v->wal;
 
     //@todo what ever else is needed at the vmhost level to add the receptor's
     // process queue to the process tables etc...
@@ -175,13 +197,17 @@ void _v_activate(VMHost *v, Xaddr x) {
     }
     T *t = _r_get_instance(v->r,x);
     Receptor *r = __r_get_receptor(t);
+    _r_materialize(r);
     int c = v->active_receptor_count++;
     v->active_receptors[c].r=r;
     v->active_receptors[c].x=x;
+    _r_start_timeouts(r,v->timers);
 
     // handle special cases
     if (semeq(x.symbol,CLOCK_RECEPTOR)) {
-        _v_start_thread(&v->clock_thread,___clock_thread,r);
+        v->clock_timer.arg = r;
+        __r_tick(&v->clock_timer);
+        _tw_add(v->timers,&v->clock_timer,v->clock_resolution,v->clock_resolution);
     }
 }
 
@@ -258,6 +284,7 @@ void _v_deliver_signals(VMHost *v, Receptor *sender) {
                 raise_error("to address: %d doesn't exist!",toP->addr);
             }
             r = v->routing_table[toP->addr].r;
+            _r_materialize(r);
         }
 
         Error err = _r_deliver(r,s);
@@ -273,8 +300,17 @@ void _v_deliver_signals(VMHost *v, Receptor *sender) {
 void *__v_process(void *arg) {
     VMHost *v = (VMHost *) arg;
     int c,i;
+    SemReader reader;
+    _sem_reader_online(v->sem,&reader);
 
     while(v->r->state == Alive) {
+        // nothing from the last round of reductions is held on to, so definitions the
+        // reductions replaced can be freed
+        _sem_quiescent(v->sem,&reader);
+
+        // fire any timers that have come due, i.e. the clock tick and expiries
+        _tw_advance(v->timers,_tw_now());
+
         // make sure everybody's doing the right thing...
         // reallocate threads as necessary...
         // do edge-receptor type stuff..
@@ -289,6 +325,10 @@ void *__v_process(void *arg) {
 
         for (i=0;v->r->state == Alive && i<v->active_receptor_count;i++) {
             Receptor *r = v->active_receptors[i].r;
+            // receptors that were loaded since tracing was turned on have new queues
+            if (v->trace_size && r->q && !r->q->trace) _p_trace(r->q,v->trace_size);
+            // expire anything the timers found to be over
+            _r_expire_timeouts(r);
             if (r->q && r->q->contexts_count > 0) {
                 _p_reduceq(r->q);
             }
@@ -307,6 +347,7 @@ void *__v_process(void *arg) {
         // if other receptors have threads associated with them, the possibly we should
         // be doing a thread_join here, or maybe even inside __r_kill @fixme
     }
+    _sem_reader_offline(v->sem,&reader);
 
     int err =0;
     pthread_exit(&err);  //@todo determine if we should use pthread_exit or just return 0
@@ -318,6 +359,51 @@ void _v_start_vmhost(VMHost *v) {
     _v_start_thread(&v->vm_thread,__v_process,v);
 }
 
+/**
+ * turn on tracing of the reductions of all the active receptors
+ *
+ * each receptor's queue gets its own trace buffer (see _p_trace), including the queues of
+ * receptors activated or loaded later.  Tracing stays on until the vmhost is freed.  Turn it
+ * on before starting the vmhost, or from the vmhost thread (as the trace shell command does).
+ *
+ * @param[in] v the vmhost
+ * @param[in] size number of events to keep for each receptor
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/vmhost_spec.h testVMHostTrace
+ */
+void _v_trace(VMHost *v,size_t size) {
+    int i;
+    v->trace_size = size;
+    for (i=0;i<v->active_receptor_count;i++) {
+        Receptor *r = v->active_receptors[i].r;
+        if (r->q) _p_trace(r->q,size);
+    }
+}
+
+/**
+ * dump the reduction traces of all the active receptors as one Chrome trace
+ *
+ * the receptors show up as processes by their address.  Events of receptors that were
+ * evicted since tracing was turned on are gone.  Dump from the vmhost thread or after it
+ * has stopped, see _tr_dump.
+ *
+ * @param[in] v the vmhost
+ * @param[in] out where to write the JSON
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/vmhost_spec.h testVMHostTrace
+ */
+void _v_dump_trace(VMHost *v,FILE *out) {
+    TraceBuffer *tbs[MAX_ACTIVE_RECEPTORS];
+    int i,c = 0;
+    for (i=0;i<v->active_receptor_count;i++) {
+        Receptor *r = v->active_receptors[i].r;
+        if (r->q && r->q->trace) tbs[c++] = r->q->trace;
+    }
+    _tr_dump_all(v->sem,tbs,c,out);
+}
+
 /**
  * create all the built in receptors that exist in all VMhosts
  */
@@ -14,6 +14,8 @@
 #define _CEPTR_VMHOST_H
 
 #include "receptor.h"
+#include "timer.h"
+#include "wal.h"
 
 #define SELF_RECEPTOR_ADDR -1
 
@@ -32,6 +34,9 @@ typedef struct ReceptorRoute {
     SemanticID s;
 } ReceptorRoute;
 
+/// file the trace shell command writes the vmhost's trace to
+#define TRACE_FILE "trace.json"
+
 #define MAX_ACTIVE_RECEPTORS 1000
 #define MAX_RECEPTORS 1000
 /**
@@ -47,8 +52,21 @@ struct VMHost {
     Scape *installed_receptors;
     thread vm_thread;
     thread clock_thread;
+    TimerWheel *timers;         ///< wheel driving the clock and expiring requests, listens and conversations
+    Timer clock_timer;          ///< periodic timer that updates the clock receptor's TICK
+    uint64_t clock_resolution;  ///< nanoseconds between TICK updates (set before activating the clock)
     int process_state;
     char *dir;
+    WAL *wal;                   ///< log of changes since the last checkpoint (NULL if not persisted)
+    Timer checkpoint_timer;     ///< periodic timer that checkpoints the vmhost
+    thread checkpoint_thread;   ///< thread writing out a checkpoint
+    CheckpointFile *checkpoint; ///< files of the checkpoint being written
+    bool checkpointing;         ///< whether a checkpoint is being written
+    bool checkpoint_failed;     ///< whether the last checkpoint couldn't be written out
+    void *image;                ///< mapped file the vmhost was booted from, which its receptor stubs load from
+    size_t image_size;
+    int max_loaded_receptors;   ///< evict idle receptors when more than this many are loaded (0 never to)
+    size_t trace_size;          ///< events to keep per receptor when tracing reductions (0 if not tracing)
 };
 typedef struct VMHost VMHost;
 
@@ -70,6 +88,8 @@ void * __v_process(void *arg);
 
 void _v_instantiate_builtins(VMHost *v);
 void _v_start_vmhost(VMHost *v);
+void _v_trace(VMHost *v,size_t size);
+void _v_dump_trace(VMHost *v,FILE *out);
 
 /******************  thread handling */
 void _v_start_thread(thread *t,void *(*start_routine)(void*), void *arg);
@@ -0,0 +1,368 @@
+/**
+ * @ingroup accumulator
+ *
+ * @{
+ * @file wal.c
+ * @brief write-ahead log of instance and definition changes
+ *
+ * Changes get appended to an in-memory batch as checksummed binary records, and the batch
+ * is written and synced to disk as one group commit, either periodically by a commit
+ * thread of the log's own or by a thread that needs to know its record is durable.  Threads that need a sync while
+ * another is already syncing wait for it rather than syncing again, so many changes share
+ * one fsync.  At boot the log gets replayed on top of the last snapshot, stopping at the
+ * first torn or corrupt record, which is the unsynced tail of a crash.
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#include "wal.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+uint32_t G_wl_crc_table[256];
+pthread_once_t G_wl_crc_once = PTHREAD_ONCE_INIT;
+
+void __wl_crc_init() {
+    uint32_t i,j,c;
+    for(i=0;i<256;i++) {
+        for(c=i,j=0;j<8;j++) c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        G_wl_crc_table[i] = c;
+    }
+}
+
+/**
+ * CRC-32 (as used by zlib etc.) of some data
+ *
+ * @param[in] crc the crc so far, or 0 to start
+ * @param[in] data the data
+ * @param[in] len length of the data
+ * @returns the crc including the data
+ */
+uint32_t _wl_crc(uint32_t crc,void *data,size_t len) {
+    // logs get appended to from many threads, so the table is built exactly once
+    pthread_once(&G_wl_crc_once,__wl_crc_init);
+    unsigned char *p = data;
+    crc = ~crc;
+    while (len--) crc = G_wl_crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+/**
+ * open a log for appending, creating it if it doesn't exist
+ *
+ * @param[in] file the path of the log
+ * @returns the WAL
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccWAL
+ */
+WAL *_wl_open(char *file) {
+    int fd = open(file,O_WRONLY|O_APPEND|O_CREAT,0600);
+    if (fd == -1) raise_error("unable to open log: %s",file);
+    WAL *w = malloc(sizeof(WAL));
+    memset(w,0,sizeof(WAL));
+    w->fd = fd;
+    w->file = strdup(file);
+    pthread_mutex_init(&w->mutex,0);
+    pthread_cond_init(&w->cond,0);
+    pthread_cond_init(&w->stop,0);
+    return w;
+}
+
+/**
+ * append a record to the log
+ *
+ * the record only gets to disk with the next sync, so this never blocks on i/o.  The
+ * payload can be given in two parts to save callers from having to concatenate them.
+ *
+ * @param[in] w the log
+ * @param[in] type the WalRecordType
+ * @param[in] c the context of the receptor the record is about
+ * @param[in] data1 first part of the payload
+ * @param[in] len1 its length
+ * @param[in] data2 second part of the payload or NULL
+ * @param[in] len2 its length
+ * @returns sequence number of the record, to pass to _wl_sync to wait for it to be durable
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccWAL
+ */
+uint64_t _wl_append(WAL *w,int type,Context c,void *data1,size_t len1,void *data2,size_t len2) {
+    WalRecord r;
+    r.length = len1+len2;
+    r.type = type;
+    r.context = c;
+    r.crc = _wl_crc(0,&r.length,sizeof(WalRecord)-offsetof(WalRecord,length));
+    r.crc = _wl_crc(r.crc,data1,len1);
+    if (len2) r.crc = _wl_crc(r.crc,data2,len2);
+
+    pthread_mutex_lock(&w->mutex);
+    size_t l = sizeof(WalRecord)+r.length;
+    if (w->len+l > w->size) {
+        while (w->len+l > w->size) w->size = w->size ? w->size*2 : 4096;
+        w->buf = realloc(w->buf,w->size);
+    }
+    char *b = w->buf+w->len;
+    memcpy(b,&r,sizeof(WalRecord));
+    memcpy(b+sizeof(WalRecord),data1,len1);
+    if (len2) memcpy(b+sizeof(WalRecord)+len1,data2,len2);
+    w->len += l;
+    uint64_t seq = ++w->appended;
+    pthread_mutex_unlock(&w->mutex);
+    return seq;
+}
+
+// write out and sync a batch of records
+void __wl_write(WAL *w,char *buf,size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(w->fd,buf+done,len-done);
+        if (n < 0) raise_error("unable to write log");
+        done += n;
+    }
+    if (len && fdatasync(w->fd)) raise_error("unable to sync log: %s",w->file);
+}
+
+/**
+ * make sure a record is on disk
+ *
+ * if no other thread is syncing, this one writes everything appended so far and syncs
+ * it, otherwise it waits for the sync in progress (and the one after that if its record
+ * wasn't in that batch).
+ *
+ * @param[in] w the log
+ * @param[in] seq sequence number of the record from _wl_append
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccWAL
+ */
+void _wl_sync(WAL *w,uint64_t seq) {
+    pthread_mutex_lock(&w->mutex);
+    while (w->synced < seq) {
+        if (w->syncing) {
+            pthread_cond_wait(&w->cond,&w->mutex);
+            continue;
+        }
+        // take the batch so appends can carry on while it's being written
+        char *buf = w->buf;
+        size_t len = w->len;
+        uint64_t upto = w->appended;
+        w->buf = NULL;
+        w->len = w->size = 0;
+        w->syncing = true;
+        pthread_mutex_unlock(&w->mutex);
+
+        __wl_write(w,buf,len);
+        free(buf);
+
+        pthread_mutex_lock(&w->mutex);
+        w->synced = upto;
+        w->syncing = false;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/**
+ * make sure everything appended to a log so far is on disk
+ *
+ * @param[in] w the log
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccWAL
+ */
+void _wl_flush(WAL *w) {
+    pthread_mutex_lock(&w->mutex);
+    uint64_t seq = w->appended;
+    pthread_mutex_unlock(&w->mutex);
+    _wl_sync(w,seq);
+}
+
+// commit whatever has been appended every interval until the log gets closed
+void *__wl_commit_thread(void *arg) {
+    WAL *w = arg;
+    struct timespec at;
+    pthread_mutex_lock(&w->mutex);
+    while (w->committing) {
+        clock_gettime(CLOCK_REALTIME,&at);
+        uint64_t ns = at.tv_nsec+w->interval;
+        at.tv_sec += ns/NS_PER_SEC;
+        at.tv_nsec = ns%NS_PER_SEC;
+        pthread_cond_timedwait(&w->stop,&w->mutex,&at);
+        if (!w->committing) break;
+        uint64_t seq = w->appended;
+        pthread_mutex_unlock(&w->mutex);
+        _wl_sync(w,seq);
+        pthread_mutex_lock(&w->mutex);
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return NULL;
+}
+
+/**
+ * start group committing a log periodically
+ *
+ * the commits happen on a thread of the log's own, so the syncing never holds up the
+ * vmhost's timers or processing.
+ *
+ * @param[in] w the log
+ * @param[in] interval nanoseconds between commits
+ */
+void _wl_start(WAL *w,uint64_t interval) {
+    w->interval = interval;
+    w->committing = true;
+    int rc = pthread_create(&w->thread,0,__wl_commit_thread,w);
+    if (rc) raise_error("Error starting log commit thread; return code from pthread_create() is %d\n", rc);
+}
+
+/**
+ * empty the log, i.e. because everything in it is in a new snapshot
+ *
+ * anything appended but not yet synced is dropped too.
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccWAL
+ */
+void _wl_truncate(WAL *w) {
+    pthread_mutex_lock(&w->mutex);
+    while (w->syncing) pthread_cond_wait(&w->cond,&w->mutex);
+    w->len = 0;
+    w->synced = w->appended;
+    if (ftruncate(w->fd,0)) raise_error("unable to truncate log");
+    if (fdatasync(w->fd)) raise_error("unable to sync log: %s",w->file);
+    pthread_mutex_unlock(&w->mutex);
+}
+
+// copy the contents of a file onto the end of another
+void __wl_append_file(int fd,char *file) {
+    char buf[4096];
+    int in = open(file,O_RDONLY);
+    if (in == -1) raise_error("unable to open log: %s",file);
+    ssize_t n;
+    while ((n = read(in,buf,sizeof(buf))) > 0) {
+        ssize_t done = 0;
+        while (done < n) {
+            ssize_t m = write(fd,buf+done,n-done);
+            if (m < 0) raise_error("unable to write log");
+            done += m;
+        }
+    }
+    if (n < 0) raise_error("unable to read log: %s",file);
+    close(in);
+}
+
+/**
+ * move the log aside and carry on in a new empty one
+ *
+ * everything appended so far is synced to the old log first, so the old log holds exactly
+ * the changes up to the moment of the rotation, i.e. the ones a checkpoint taken at that
+ * moment includes.  The old log can be removed once the checkpoint is safely on disk.
+ * If it's still there because that checkpoint couldn't be written, the log gets added to
+ * the end of it instead, so no changes since the last good checkpoint are lost.
+ *
+ * @param[in] w the log
+ * @param[in] old the path to move the log to
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccWAL
+ */
+void _wl_rotate(WAL *w,char *old) {
+    pthread_mutex_lock(&w->mutex);
+    while (w->syncing) pthread_cond_wait(&w->cond,&w->mutex);
+    __wl_write(w,w->buf,w->len);
+    w->len = 0;
+    w->synced = w->appended;
+    int fd = open(old,O_WRONLY|O_APPEND);
+    if (fd != -1) {
+        __wl_append_file(fd,w->file);
+        if (fdatasync(fd)) raise_error("unable to sync log: %s",old);
+        close(fd);
+        if (ftruncate(w->fd,0)) raise_error("unable to truncate log");
+        if (fdatasync(w->fd)) raise_error("unable to sync log: %s",w->file);
+        pthread_mutex_unlock(&w->mutex);
+        return;
+    }
+    if (rename(w->file,old)) raise_error("unable to move log to: %s",old);
+    fd = open(w->file,O_WRONLY|O_APPEND|O_CREAT,0600);
+    if (fd == -1) raise_error("unable to open log: %s",w->file);
+    close(w->fd);
+    w->fd = fd;
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/**
+ * sync and close a log, stopping its commit thread if it was started
+ *
+ * @param[in] w the log
+ */
+void _wl_close(WAL *w) {
+    pthread_mutex_lock(&w->mutex);
+    bool committing = w->committing;
+    w->committing = false;
+    pthread_cond_signal(&w->stop);
+    pthread_mutex_unlock(&w->mutex);
+    if (committing) pthread_join(w->thread,NULL);
+    _wl_flush(w);
+    close(w->fd);
+    pthread_mutex_destroy(&w->mutex);
+    pthread_cond_destroy(&w->cond);
+    pthread_cond_destroy(&w->stop);
+    free(w->buf);
+    free(w->file);
+    free(w);
+}
+
+/**
+ * replay a log
+ *
+ * calls fn with every record up to the end of the log or the first record that is
+ * incomplete or fails its checksum.  Anything after that is the part of a batch that
+ * didn't make it to disk, so it gets cut off for new records to be appended after the
+ * valid ones.
+ *
+ * @param[in] file the path of the log
+ * @param[in] fn function to call with each record
+ * @param[in] arg passed to fn
+ * @returns the number of records replayed, or -1 if there's no log
+ *
+ * <b>Examples (from test suite):</b>
+ * @snippet spec/accumulator_spec.h testAccWAL
+ */
+int _wl_replay(char *file,WalReplayFn fn,void *arg) {
+    int fd = open(file,O_RDWR);
+    if (fd == -1) return -1;
+    struct stat st;
+    fstat(fd,&st);
+    size_t size = st.st_size;
+    char *buf = malloc(size ? size : 1);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd,buf+done,size-done);
+        if (n <= 0) break;
+        done += n;
+    }
+    size = done;
+
+    int count = 0;
+    size_t pos = 0;
+    while (pos+sizeof(WalRecord) <= size) {
+        WalRecord *r = (WalRecord *)(buf+pos);
+        if (pos+sizeof(WalRecord)+r->length > size) break;
+        void *payload = buf+pos+sizeof(WalRecord);
+        uint32_t crc = _wl_crc(0,&r->length,sizeof(WalRecord)-offsetof(WalRecord,length));
+        if (_wl_crc(crc,payload,r->length) != r->crc) break;
+        (fn)(r,payload,arg);
+        pos += sizeof(WalRecord)+r->length;
+        count++;
+    }
+    if (pos < size) {
+        if (ftruncate(fd,pos)) raise_error("unable to truncate log: %s",file);
+        if (fdatasync(fd)) raise_error("unable to sync log: %s",file);
+    }
+    close(fd);
+    free(buf);
+    return count;
+}
+
+/** @}*/
@@ -0,0 +1,35 @@
+/**
+ * @ingroup accumulator
+ *
+ * @{
+ * @file wal.h
+ * @brief write-ahead log header file
+ *
+ * @copyright Copyright (C) 2013-2016, The MetaCurrency Project (Eric Harris-Braun, Arthur Brock, et. al).  This file is part of the Ceptr platform and is released under the terms of the license contained in the file LICENSE (GPLv3).
+ */
+
+#ifndef _CEPTR_WAL_H
+#define _CEPTR_WAL_H
+
+#include "tree.h"
+#include "timer.h"
+
+/// default interval between group commits of the log, i.e. the most that can be lost in a crash
+#define WAL_SYNC_INTERVAL (50*NS_PER_MS)
+
+/// called with each valid record when replaying a log
+typedef void (*WalReplayFn)(WalRecord *r,void *payload,void *arg);
+
+WAL *_wl_open(char *file);
+uint64_t _wl_append(WAL *w,int type,Context c,void *data1,size_t len1,void *data2,size_t len2);
+void _wl_sync(WAL *w,uint64_t seq);
+void _wl_flush(WAL *w);
+void _wl_start(WAL *w,uint64_t interval);
+void _wl_truncate(WAL *w);
+void _wl_rotate(WAL *w,char *old);
+void _wl_close(WAL *w);
+int _wl_replay(char *file,WalReplayFn fn,void *arg);
+uint32_t _wl_crc(uint32_t crc,void *data,size_t len);
+
+#endif
+/** @}*/